@@ -104,6 +104,7 @@ int main(int argc, char** _argv)
 				CLibCZISite site(options);
 				libCZI::SetSiteObject(&site);
 
+				libCZI::SetBitmapOperationsThreadCount(options.GetThreadCount());
 				execute(options);
 			}
 		}
@@ -120,6 +121,9 @@ int main(int argc, char** _argv)
 		retVal = 1000;
 	}
 
+	// shut down the worker-threads (if any) here, instead of having them joined during the destruction of static objects
+	libCZI::SetBitmapOperationsThreadCount(1);
+
 #if defined(WIN32ENV)
 	CoUninitialize();
 	LocalFree(argv);
@@ -168,7 +172,9 @@ int myMain(std::vector<std::string> args)
 		delete pSite;
 	}
 
+	libCZI::SetBitmapOperationsThreadCount(options.GetThreadCount());
 	execute(options);
+	libCZI::SetBitmapOperationsThreadCount(1);
 
 	free(argv);
 	optind = 0;
@@ -79,6 +79,7 @@ bool CCmdLineOptions::Parse(int argc, char** argv)
 		{ OPTTEXTSPEC("selection"),					 required_argument, 0, OPTTEXTSPEC('e') },
 		{ OPTTEXTSPEC("tile-filter"),				 required_argument, 0, OPTTEXTSPEC('f') },
 		{ OPTTEXTSPEC("channelcompositionformat"),	 required_argument, 0, OPTTEXTSPEC('m') },
+		{ OPTTEXTSPEC("threads"),					 required_argument, 0, OPTTEXTSPEC('n') },
 		{ 0, 0, 0, 0 }
 	};
 
@@ -88,10 +89,10 @@ bool CCmdLineOptions::Parse(int argc, char** argv)
 	{
 		int option_index;
 #if defined(WIN32ENV)
-		int c = getoptW_long(argc, argv, L"?v:j:s:c:p:r:o:d:htb:y:z:i:e:f:m:", long_options, &option_index);
+		int c = getoptW_long(argc, argv, L"?v:j:s:c:p:r:o:d:htb:y:z:i:e:f:m:n:", long_options, &option_index);
 #endif
 #if defined(LINUXENV)
-		int c = getopt_long(argc, argv, "?v:j:s:c:p:r:o:d:htb:y:z:i:e:f:m:", long_options, &option_index);
+		int c = getopt_long(argc, argv, "?v:j:s:c:p:r:o:d:htb:y:z:i:e:f:m:n:", long_options, &option_index);
 #endif
 		if (c == -1)
 		{
@@ -170,6 +171,9 @@ bool CCmdLineOptions::Parse(int argc, char** argv)
 		case 'm':
 			this->ParseChannelCompositionFormat(optarg);
 			break;
+		case 'n':
+			this->ParseThreadCount(optarg);
+			break;
 		default:
 			break;
 		}
@@ -226,6 +230,7 @@ void CCmdLineOptions::Clear()
 	this->infoLevel = InfoLevel::Statistics;
 	this->channelCompositePixelType = libCZI::PixelType::Bgr24;
 	this->channelCompositeAlphaValue = 0xff;
+	this->threadCount = 1;
 }
 
 void CCmdLineOptions::PrintUsage(int switchesCnt, std::function<std::tuple<std::wstring, std::wstring>(int idx)> getSwitch)
@@ -237,7 +242,7 @@ void CCmdLineOptions::PrintUsage(int switchesCnt, std::function<std::tuple<std::
 	static const char* Synopsis3 =
 		"                 [-v VERBOSITYLEVEL] [-y PYRAMIDINFO] [-z ZOOM] [-i INFOLEVEL]";
 	static const char* Synopsis4 =
-		"                 [-e SELECTION] [-f FILTER] [-p CHANNELCOMPOSITIONFORMAT]";
+		"                 [-e SELECTION] [-f FILTER] [-p CHANNELCOMPOSITIONFORMAT] [-n THREADS]";
 	this->GetLog()->WriteStdOut(Synopsis1);
 	this->GetLog()->WriteStdOut(Synopsis2);
 	this->GetLog()->WriteStdOut(Synopsis3);
@@ -317,7 +322,9 @@ void CCmdLineOptions::PrintUsage(int switchesCnt, std::function<std::tuple<std::
 		{
 			L"h",
 			L"",
-			LR"(Calculate a hash for the output-picture. The MD5Sum-algorithm is used for this.)"
+			LR"(Calculate a hash for the output-picture. The MD5Sum-algorithm is used for this. If more than one thread is
+			specified with the argument 'threads', the hash of a bitmap is calculated as a tree-hash (the MD5Sum of the MD5Sums of bands
+			of 64 rows), which is calculated in parallel - the result is then different from the plain MD5Sum.)"
 		},
 		{
 			L"b",
@@ -383,6 +390,12 @@ void CCmdLineOptions::PrintUsage(int switchesCnt, std::function<std::tuple<std::
 			L"CHANNELCOMPOSITIONFORMAT",
 			LR"_(In case of a channel-composition, specifies the pixeltype of the output. Possible values are "bgr24" (the default) and "bgra32".
 			If specifying "bgra32" it is possible to give the value of the alpha-pixels in the form "bgra32(128)" - for an alpha-value of 128.)_"
+		},
+		{
+			L"n",
+			L"THREADS",
+			LR"(Specify the number of threads used for the operations on large bitmaps (e.g. creating the composite, scaling
+			the tiles and calculating the hash). The default is 1, i.e. everything is done on the main thread.)"
 		}
 	};
 
@@ -1000,6 +1013,18 @@ void CCmdLineOptions::ParseChannelCompositionFormat(const wchar_t* s)
 	throw std::invalid_argument("Invalid channel-composition-format.");
 }
 
+void CCmdLineOptions::ParseThreadCount(const wchar_t* sz)
+{
+	const wchar_t* endPtr;
+	long threadCount = wcstol(sz, (wchar_t**)&endPtr, 10);
+	if (endPtr == sz || *skipWhiteSpaceAndOneOfThese(endPtr, nullptr) != L'\0' || threadCount < 1 || threadCount > 256)
+	{
+		throw std::invalid_argument("Invalid threads argument.");
+	}
+
+	this->threadCount = (int)threadCount;
+}
+
 /*static*/bool CCmdLineOptions::TryParseChannelCompositionFormatWithAlphaValue(const std::wstring& s, libCZI::PixelType& channelCompositePixelType, std::uint8_t& channelCompositeAlphaValue)
 {
 	std::wregex regex(LR"_(bgra32\((\d+|0x[\d|a-f|A-F]+)\))_", regex_constants::ECMAScript | regex_constants::icase);
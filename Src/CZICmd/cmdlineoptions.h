@@ -178,6 +178,8 @@ private:
 	libCZI::PixelType channelCompositePixelType;
 	std::uint8_t channelCompositeAlphaValue;
 
+	int threadCount;
+
 	std::map<std::string, ItemValue> mapSelection;
 	std::shared_ptr<libCZI::IIndexSet> sceneIndexSet;
 public:
@@ -231,6 +233,7 @@ public:
 
 	libCZI::PixelType GetChannelCompositeOutputPixelType() const { return this->channelCompositePixelType; }
 	std::uint8_t GetChannelCompositeOutputAlphaValue() const { return this->channelCompositeAlphaValue; }
+	int GetThreadCount() const { return this->threadCount; }
 private:
 	void PrintUsage(int switchesCnt, std::function<std::tuple<std::wstring, std::wstring>(int idx)> getSwitch);
 	bool CheckArgumentConsistency() const;
@@ -277,5 +280,8 @@ private:
 	void ParseChannelCompositionFormat(const wchar_t* s);
 	void ParseChannelCompositionFormat(const std::string& s) { auto sucs2 = convertUtf8ToUCS2(s); this->ParseChannelCompositionFormat(sucs2.c_str()); }
 
+	void ParseThreadCount(const wchar_t* sz);
+	void ParseThreadCount(const std::string& s) { auto sucs2 = convertUtf8ToUCS2(s); this->ParseThreadCount(sucs2.c_str()); }
+
 	static bool TryParseChannelCompositionFormatWithAlphaValue(const std::wstring& s, libCZI::PixelType& channelCompositePixelType, std::uint8_t& channelCompositeAlphaValue);
 };
@@ -151,7 +151,15 @@ protected:
 		HandleHashOfResult(
 			[&](uint8_t* ptrHash, size_t size)->bool
 		{
-			Utils::CalcMd5SumHash(bm, ptrHash, (int)size);
+			if (options.GetThreadCount() > 1)
+			{
+				Utils::CalcMd5SumTreeHash(bm, ptrHash, (int)size);
+			}
+			else
+			{
+				Utils::CalcMd5SumHash(bm, ptrHash, (int)size);
+			}
+
 			return true;
 		},
 			options);
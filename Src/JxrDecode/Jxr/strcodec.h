@@ -47,11 +47,15 @@
 //#define WMP_OPT_TRFM_ENC
 //#define WMP_OPT_QT
 
-#define WMP_OPT_CC_DEC
-#define WMP_OPT_TRFM_DEC
-
 #define X86OPT_INLINE
 
+#endif
+
+// the decoder optimizations are written with intrinsics (SSE2 and AVX2, selected at runtime),
+// so they are available with 32-bit MSVC and with 64-bit MSVC/GCC/Clang
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WMP_OPT_CC_DEC
+#define WMP_OPT_TRFM_DEC
 #endif
 #endif // ENABLE_OPTIMIZATIONS
 
@@ -1202,9 +1202,9 @@ Int outputMBRow(CWMImageStrCodec * pSC)
 						pDst = (U16 *)pSC->WMIBI.pv + pOffsetX[iColumn] + iY;
 						
 						if ((g | b | r) & ~0xffff)
-							pDst[0] = _CLIPU16(r),  pDst[1] = _CLIPU16(g), pDst[2] = _CLIPU16(b);
+							pDst[iR] = _CLIPU16(r),  pDst[1] = _CLIPU16(g), pDst[iB] = _CLIPU16(b);
 						else
-							pDst[0] = (U16)r, pDst[1] = (U16)g, pDst[2] = (U16)b;
+							pDst[iR] = (U16)r, pDst[1] = (U16)g, pDst[iB] = (U16)b;
 					}
 			}
 			else{
@@ -1219,9 +1219,9 @@ Int outputMBRow(CWMImageStrCodec * pSC)
 						g = (g >> iShift) << nLen, b = (b >> iShift) << nLen, r = (r >> iShift) << nLen;
 						pDst = (U16 *)pSC->WMIBI.pv + pOffsetX[iColumn] + iY;
 						if ((g | b | r) & ~0xffff)
-							pDst[0] = _CLIPU16(r),  pDst[1] = _CLIPU16(g), pDst[2] = _CLIPU16(b);
+							pDst[iR] = _CLIPU16(r),  pDst[1] = _CLIPU16(g), pDst[iB] = _CLIPU16(b);
 						else
-							pDst[0] = (U16)r, pDst[1] = (U16)g, pDst[2] = (U16)b;
+							pDst[iR] = (U16)r, pDst[1] = (U16)g, pDst[iB] = (U16)b;
 					}
 			}
             break;
@@ -2079,9 +2079,9 @@ Int decodeThumbnail(CWMImageStrCodec * pSC)
                                                 
                         pDst = (U16 *)pSC->WMIBI.pv + pOffsetX[iColumn >> nBits] + iY;
                         r <<= nLen, g <<= nLen, b <<= nLen;
-                        pDst[0] = _CLIPU16(r);
+                        pDst[iR] = _CLIPU16(r);
                         pDst[1] = _CLIPU16(g);
-                        pDst[2] = _CLIPU16(b);
+                        pDst[iB] = _CLIPU16(b);
                 }
             }
             break;
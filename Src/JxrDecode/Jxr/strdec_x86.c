@@ -28,1613 +28,526 @@
 #include "strcodec.h"
 #include "decode.h"
 
-#if defined(WMP_OPT_SSE2)
+#if defined(WMP_OPT_CC_DEC) || defined(WMP_OPT_TRFM_DEC)
 #include <emmintrin.h>
-#include <windows.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
-//================================================================
-static __m128i g_const_d0;
-static __m128i g_const_d1;
+/*************************************************************************
+  Optimized decoder stages for x86 - written with intrinsics, so that they
+  are available with MSVC (32-bit and 64-bit) as well as with GCC/Clang.
+  The instruction set is chosen at runtime (see StrDecOpt), the AVX2 code
+  is compiled with a function attribute and does not require the whole
+  library to be built for AVX2.
+*************************************************************************/
+#if defined(_MSC_VER)
+#define SIMD_INLINE __forceinline
+#define X86_TARGET_SSE2
+#define X86_TARGET_AVX2
+#else
+#define SIMD_INLINE inline __attribute__((always_inline))
+#define X86_TARGET_SSE2 __attribute__((target("sse2")))
+#define X86_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#define _ICC(r, g, b)  (g -= ((r + 0) >> 1), r -= ((b + 1) >> 1) - g, b += r)
+#define _CLIP2(l, v, h) ((v) < (l) ? (l) : ((h) < (v) ? (h) : (v)))
+#define _CLIP8(v) ((U8)_CLIP2(0, v, 255))
+#define _CLIPU16(v) ((U16)_CLIP2(0, v, 65535))
+#ifndef min
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+#endif
+
+/** parameters of the color conversion **/
+typedef struct tagOUTPUTPARAMS
+{
+    PixelI iBias;
+    int iShift;
+    int nLen;
+    Bool bRGB;
+} OUTPUTPARAMS;
+
+/** pixel formats handled by outputMBRow_OPT **/
+typedef enum OUTPUTFORMAT
+{
+    OF_GRAY8 = 0,
+    OF_GRAY16,
+    OF_RGB24
+} OUTPUTFORMAT;
 
-__m128i g_const_d3;
-__m128i g_const_d4;
-__m128i g_const_d0x80;
-__m128i g_const_w0x80;
-__m128i g_const_b0x80;
+/** converts 16 pixels (starting at a macroblock boundary) of line iRow **/
+typedef Void (*OutputLineProc)(const OUTPUTPARAMS* pParams, const PixelI* const* ppMB, size_t iRow, U8* pDst);
 
 //================================================================
-#if defined(WMP_OPT_CC_DEC)
-__declspec(naked) void __stdcall storeRGB24_5(
-    U8* pbYCoCg,
-    size_t cbYCoCg,
-    const U8* pbRGB,
-    size_t cbRGB,
-    size_t cmb)
+// row pointers for the first level transform of a macroblock
+//================================================================
+static Void setBlockRows(PixelI* apRows[4], PixelI* p)
 {
-#define DISP 8
-    UNREFERENCED_PARAMETER( pbYCoCg );
-    UNREFERENCED_PARAMETER( cbYCoCg );
-    UNREFERENCED_PARAMETER( pbRGB );
-    UNREFERENCED_PARAMETER( cbRGB );
-    UNREFERENCED_PARAMETER( cmb );
-    __asm {
-        push ebp
-        push ebx    
-        push esi
-        push edi
-
-        mov ebx, [esp + 36]         // $ebx = cmb
-        mov edi, [esp + 28]         // $edi = pbRGB
-        lea ebx, [ebx + ebx * 2]    // $ebx = cmb * 3
-        mov edx, [esp + 32]         // $edx = cbRGB
-        shl ebx, 4                  // $ebx = cmb * 3 * 16
-        mov esi, [esp + 20]         // $esi = pbYCoCg
-        add edi, ebx                // $edi = pbRGB + 3 * 16 * cmb
-        mov ebp, [esp + 24]         // $ebp = cbYCoCg
-        neg ebx
-
-        mov eax, esp
-        and esp, 0xffffff80
-        sub esp, 64 * 4 + DISP
-
-        mov [esp], eax              // original $esp
-        mov [esp + 4], edi
-    }
-Loop0:
-    __asm {
-        mov edi, [esp + 4]          // $edi = pbRGB + 3 * 16 * cmb
-
-            // first 8 pixels
-            pxor xmm1, xmm1
-            pxor xmm5, xmm5
-            movdqa xmm0, [esi]
-            movdqa xmm4, [esi + 16]
-            psubd xmm1, [esi + ebp]
-            psubd xmm5, [esi + ebp + 16]
-            movdqa xmm2, [esi + ebp * 2]
-            movdqa xmm6, [esi + ebp * 2 + 16]
-
-            paddd xmm0, [g_const_d0x80]
-            paddd xmm4, [g_const_d0x80]
-
-            // ICC
-            movdqa xmm3, xmm1           // g -= r >> 1
-            movdqa xmm7, xmm5
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm0, xmm3
-            psubd xmm4, xmm7
-
-            movdqa xmm3, [g_const_d1]   // r -= ((b + 1) >> 1) - g
-            movdqa xmm7, [g_const_d1]
-            paddd xmm3, xmm2
-            paddd xmm7, xmm6
-            paddd xmm1, xmm0
-            paddd xmm5, xmm4
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            paddd xmm2, xmm1            // b += r
-            paddd xmm6, xmm5
-
-            pslld xmm0, 8
-            pslld xmm2, 16
-            pslld xmm4, 8
-            pslld xmm6, 16
-            por xmm0, xmm1
-            por xmm4, xmm5
-            por xmm0, xmm2
-            por xmm4, xmm6
-
-            movdqa [esp + DISP + 64 * 0 + 16 * 0], xmm0
-            pslld xmm0, 8
-            movdqa [esp + DISP + 64 * 0 + 16 * 1], xmm4
-            pslld xmm4, 8
-            movdqa [esp + DISP + 64 * 0 + 16 * 2], xmm0
-            movdqa [esp + DISP + 64 * 0 + 16 * 3], xmm4
-
-            // second 8 pixels
-            pxor xmm1, xmm1
-            pxor xmm5, xmm5
-            movdqa xmm0, [esi + 32]
-            movdqa xmm4, [esi + 48]
-            psubd xmm1, [esi + ebp + 32]
-            psubd xmm5, [esi + ebp + 48]
-            movdqa xmm2, [esi + ebp * 2 + 32]
-            movdqa xmm6, [esi + ebp * 2 + 48]
-
-            paddd xmm0, [g_const_d0x80]
-            paddd xmm4, [g_const_d0x80]
-
-            // ICC
-            movdqa xmm3, xmm1           // g -= r >> 1
-            movdqa xmm7, xmm5
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm0, xmm3
-            psubd xmm4, xmm7
-
-            movdqa xmm3, [g_const_d1]   // r -= ((b + 1) >> 1) - g
-            movdqa xmm7, [g_const_d1]
-            paddd xmm3, xmm2
-            paddd xmm7, xmm6
-            paddd xmm1, xmm0
-            paddd xmm5, xmm4
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            paddd xmm2, xmm1            // b += r
-            paddd xmm6, xmm5
-
-            pslld xmm0, 8
-            pslld xmm2, 16
-            pslld xmm4, 8
-            pslld xmm6, 16
-            por xmm0, xmm1
-            por xmm4, xmm5
-            por xmm0, xmm2
-            por xmm4, xmm6
-
-            movdqa [esp + DISP + 64 * 1 + 16 * 0], xmm0
-            pslld xmm0, 8
-            movdqa [esp + DISP + 64 * 1 + 16 * 1], xmm4
-            pslld xmm4, 8
-            movdqa [esp + DISP + 64 * 1 + 16 * 2], xmm0
-            movdqa [esp + DISP + 64 * 1 + 16 * 3], xmm4
-
-            //================
-            add esi, 64
-
-            // first 8 pixels
-            pxor xmm1, xmm1
-            pxor xmm5, xmm5
-            movdqa xmm0, [esi]
-            movdqa xmm4, [esi + 16]
-            psubd xmm1, [esi + ebp]
-            psubd xmm5, [esi + ebp + 16]
-            movdqa xmm2, [esi + ebp * 2]
-            movdqa xmm6, [esi + ebp * 2 + 16]
-
-            paddd xmm0, [g_const_d0x80]
-            paddd xmm4, [g_const_d0x80]
-
-            // ICC
-            movdqa xmm3, xmm1           // g -= r >> 1
-            movdqa xmm7, xmm5
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm0, xmm3
-            psubd xmm4, xmm7
-
-            movdqa xmm3, [g_const_d1]   // r -= ((b + 1) >> 1) - g
-            movdqa xmm7, [g_const_d1]
-            paddd xmm3, xmm2
-            paddd xmm7, xmm6
-            paddd xmm1, xmm0
-            paddd xmm5, xmm4
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            paddd xmm2, xmm1            // b += r
-            paddd xmm6, xmm5
-
-            pslld xmm0, 8
-            pslld xmm2, 16
-            pslld xmm4, 8
-            pslld xmm6, 16
-
-            por xmm0, xmm1
-            por xmm4, xmm5
-            por xmm0, xmm2
-            por xmm4, xmm6
-
-            movdqa [esp + DISP + 64 * 2 + 16 * 0], xmm0
-            pslld xmm0, 8
-            movdqa [esp + DISP + 64 * 2 + 16 * 1], xmm4
-            pslld xmm4, 8
-            movdqa [esp + DISP + 64 * 2 + 16 * 2], xmm0
-            movdqa [esp + DISP + 64 * 2 + 16 * 3], xmm4
-
-            // second 8 pixels
-            pxor xmm1, xmm1
-            pxor xmm5, xmm5
-            movdqa xmm0, [esi + 32]
-            movdqa xmm4, [esi + 48]
-            psubd xmm1, [esi + ebp + 32]
-            psubd xmm5, [esi + ebp + 48]
-            movdqa xmm2, [esi + ebp * 2 + 32]
-            movdqa xmm6, [esi + ebp * 2 + 48]
-
-            paddd xmm0, [g_const_d0x80]
-            paddd xmm4, [g_const_d0x80]
-
-            // ICC
-            movdqa xmm3, xmm1           // g -= r >> 1
-            movdqa xmm7, xmm5
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm0, xmm3
-            psubd xmm4, xmm7
-
-            movdqa xmm3, [g_const_d1]   // r -= ((b + 1) >> 1) - g
-            movdqa xmm7, [g_const_d1]
-            paddd xmm3, xmm2
-            paddd xmm7, xmm6
-            paddd xmm1, xmm0
-            paddd xmm5, xmm4
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            paddd xmm2, xmm1            // b += r
-            paddd xmm6, xmm5
-
-            pslld xmm0, 8
-            pslld xmm2, 16
-            pslld xmm4, 8
-            pslld xmm6, 16
-            por xmm0, xmm1
-            por xmm4, xmm5
-            por xmm0, xmm2
-            por xmm4, xmm6
-
-            movdqa [esp + DISP + 64 * 3 + 16 * 0], xmm0
-            pslld xmm0, 8
-            movdqa [esp + DISP + 64 * 3 + 16 * 1], xmm4
-            pslld xmm4, 8
-            movdqa [esp + DISP + 64 * 3 + 16 * 2], xmm0
-            movdqa [esp + DISP + 64 * 3 + 16 * 3], xmm4
-
-            //================================
-            // RGBX32 -> RGB24
-            mov eax, [esp + DISP + 64 * 0 + 4]      // ..B1G1R1
-            mov ecx, [esp + DISP + 64 * 0 + 32]     // B0G0R0..
-            shld eax, ecx, 24                       // R1B0G0R0
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + DISP + 64 * 0 + 20]     // ..B5G5R5
-            mov ecx, [esp + DISP + 64 * 0 + 36]     // B1G1R1..
-            shld eax, ecx, 16                       // G5R5B1G1
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + DISP + 64 * 0 + 16]     // ..B4G4R4
-            mov ecx, [esp + DISP + 64 * 0 + 52]     // B5G5R5..
-            shld eax, ecx, 8                        // B4G4R4B5
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            mov eax, [esp + DISP + 64 * 0 + 4 + 8]  // ..B3G3R3
-            mov ecx, [esp + DISP + 64 * 0 + 32 + 8] // B2G2R2..
-            shld eax, ecx, 24                       // R3B2G2R2
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + DISP + 64 * 0 + 20 + 8] // ..B7G7R7
-            mov ecx, [esp + DISP + 64 * 0 + 36 + 8] // B3G3R3..
-            shld eax, ecx, 16                       // G7R7B3G3
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + DISP + 64 * 0 + 16 + 8] // ..B6G6R6
-            mov ecx, [esp + DISP + 64 * 0 + 52 + 8] // B7G7R7..
-            shld eax, ecx, 8                        // B6G6R6B7
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            // RGBX32 -> RGB24
-            mov eax, [esp + DISP + 64 * 1 + 4 + 8]  // ..B3G3R3
-            mov ecx, [esp + DISP + 64 * 1 + 32 + 8] // B2G2R2..
-            shld eax, ecx, 24                       // R3B2G2R2
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + DISP + 64 * 1 + 20 + 8] // ..B7G7R7
-            mov ecx, [esp + DISP + 64 * 1 + 36 + 8] // B3G3R3..
-            shld eax, ecx, 16                       // G7R7B3G3
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + DISP + 64 * 1 + 16 + 8] // ..B6G6R6
-            mov ecx, [esp + DISP + 64 * 1 + 52 + 8] // B7G7R7..
-            shld eax, ecx, 8                        // B6G6R6B7
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            mov eax, [esp + DISP + 64 * 1 + 4]  // ..B1G1R1
-            mov ecx, [esp + DISP + 64 * 1 + 32] // B0G0R0..
-            shld eax, ecx, 24                   // R1B0G0R0
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + DISP + 64 * 1 + 20] // ..B5G5R5
-            mov ecx, [esp + DISP + 64 * 1 + 36] // B1G1R1..
-            shld eax, ecx, 16                   // G5R5B1G1
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + DISP + 64 * 1 + 16] // ..B4G4R4
-            mov ecx, [esp + DISP + 64 * 1 + 52] // B5G5R5..
-            shld eax, ecx, 8                    // B4G4R4B5
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            // RGBX32 -> RGB24
-            mov eax, [esp + DISP + 64 * 2 + 4]  // ..B1G1R1
-            mov ecx, [esp + DISP + 64 * 2 + 32] // B0G0R0..
-            shld eax, ecx, 24                   // R1B0G0R0
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + DISP + 64 * 2 + 20] // ..B5G5R5
-            mov ecx, [esp + DISP + 64 * 2 + 36] // B1G1R1..
-            shld eax, ecx, 16                   // G5R5B1G1
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + DISP + 64 * 2 + 16] // ..B4G4R4
-            mov ecx, [esp + DISP + 64 * 2 + 52] // B5G5R5..
-            shld eax, ecx, 8                    // B4G4R4B5
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            mov eax, [esp + DISP + 64 * 2 + 4 + 8]  // ..B3G3R3
-            mov ecx, [esp + DISP + 64 * 2 + 32 + 8] // B2G2R2..
-            shld eax, ecx, 24                       // R3B2G2R2
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + DISP + 64 * 2 + 20 + 8] // ..B7G7R7
-            mov ecx, [esp + DISP + 64 * 2 + 36 + 8] // B3G3R3..
-            shld eax, ecx, 16                       // G7R7B3G3
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + DISP + 64 * 2 + 16 + 8] // ..B6G6R6
-            mov ecx, [esp + DISP + 64 * 2 + 52 + 8] // B7G7R7..
-            shld eax, ecx, 8                        // B6G6R6B7
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            // RGBX32 -> RGB24
-            mov eax, [esp + DISP + 64 * 3 + 4 + 8]  // ..B3G3R3
-            mov ecx, [esp + DISP + 64 * 3 + 32 + 8] // B2G2R2..
-            shld eax, ecx, 24                       // R3B2G2R2
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + DISP + 64 * 3 + 20 + 8] // ..B7G7R7
-            mov ecx, [esp + DISP + 64 * 3 + 36 + 8] // B3G3R3..
-            shld eax, ecx, 16                       // G7R7B3G3
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + DISP + 64 * 3 + 16 + 8] // ..B6G6R6
-            mov ecx, [esp + DISP + 64 * 3 + 52 + 8] // B7G7R7..
-            shld eax, ecx, 8                        // B6G6R6B7
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            mov eax, [esp + DISP + 64 * 3 + 4]      // ..B1G1R1
-            mov ecx, [esp + DISP + 64 * 3 + 32]     // B0G0R0..
-            shld eax, ecx, 24                       // R1B0G0R0
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + DISP + 64 * 3 + 20]     // ..B5G5R5
-            mov ecx, [esp + DISP + 64 * 3 + 36]     // B1G1R1..
-            shld eax, ecx, 16                       // G5R5B1G1
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + DISP + 64 * 3 + 16]     // ..B4G4R4
-            mov ecx, [esp + DISP + 64 * 3 + 52]     // B5G5R5..
-            shld eax, ecx, 8                        // B4G4R4B5
-            mov [edi + ebx + 8], eax
-
-        //================================
-        add esi, 256 - 64
-        add ebx, 12
-        jnz Loop0
-
-        //================
-        pop esp
-        pop edi
-        pop esi
-        pop ebx
-        pop ebp
-        ret 20
-    }
+    apRows[0] = p, apRows[1] = p + 4, apRows[2] = p + 8, apRows[3] = p + 12;
 }
 
-Int outputMBRow_RGB24_Lossless_1(CWMImageStrCodec* pSC)
+/** the rows of strPost4x4Stage1Split_alternate(p0, p1, 0) **/
+static Void setWindowRows(PixelI* apRows[4], PixelI* p0, PixelI* p1)
 {
-#ifdef REENTRANT_MODE
-    const size_t cHeight = min((pSC->m_Dparam->cROIBottomY + 1) - (pSC->cRow - 1) * 16, 16);
-    const size_t iFirstRow = ((pSC->cRow - 1) * 16 > pSC->m_Dparam->cROITopY ? 0 : (pSC->m_Dparam->cROITopY & 0xf));
-#endif
-    const size_t cbRGB = pSC->WMIBI.cbStride;
-    const U8* const pbRGB = (U8*)pSC->WMIBI.pv + cbRGB * (pSC->cRow - 1) * 16;
+    apRows[0] = p0 + 12, apRows[1] = p0 + 72, apRows[2] = p1 + 4, apRows[3] = p1 + 64;
+}
 
-    U8* const pbY = (U8*)pSC->a0MBbuffer[0];
-    U8* const pbU = (U8*)pSC->a0MBbuffer[1];
-    // U8* const pbV = (U8*)pSC->a0MBbuffer[2];
+/** the 16 blocks which strIDCT4x4Stage1 is applied to for a center macroblock **/
+static Void getBlockRows(PixelI* p0, PixelI* p1, PixelI* apBlock[16][4])
+{
+    static const int aOffset0[8] = { -96, -80, -32, -16, 32, 48, 96, 112 };
+    static const int aOffset1[8] = { -128, -112, -64, -48, 0, 16, 64, 80 };
+    size_t k;
 
-    const size_t cmbColumn = (pSC->WMII.cWidth + 15) / 16;
+    for (k = 0; k < 8; k++) {
+        setBlockRows(apBlock[k], p0 + aOffset0[k]);
+        setBlockRows(apBlock[8 + k], p1 + aOffset1[k]);
+    }
+}
 
-    assert(BD_8 == pSC->WMII.bdBitDepth);
-    assert(CF_RGB == pSC->WMII.cfColorFormat);
-    assert(24 == pSC->WMII.cBitsPerUnit);
-    assert(pSC->WMII.bRGB);
-    assert(O_NONE == pSC->WMII.oOrientation);
+/** the 16 (disjoint) windows of the first level overlap for a center macroblock **/
+static Void getOverlapRows(PixelI* p0, PixelI* p1, PixelI* apWindow[16][4])
+{
+    size_t k = 0;
+    int j;
+
+    for (j = -192; j < 64; j += 64) {
+        setWindowRows(apWindow[k++], p0 + 16 + j, p0 + 32 + j);
+        setWindowRows(apWindow[k++], p0 + 32 + j, p0 + 48 + j);
+        setWindowRows(apWindow[k++], p0 + 48 + j, p1 + j);
+        setWindowRows(apWindow[k++], p1 + j, p1 + 16 + j);
+    }
+}
 
-    assert(YUV_444 == pSC->m_param.cfColorFormat);
-    assert(!pSC->m_param.bScaledArith);
+//================================================================
+// color conversion driver
+//================================================================
+static Void outputPixel(const OUTPUTPARAMS* pParams, OUTPUTFORMAT ofFormat, const PixelI* const* ppChannel, size_t iRow, size_t iColumn, U8* pDst)
+{
+    const size_t iIdx = ((iColumn >> 4) << 8) + idxCC[iRow][iColumn & 15];
 
-    assert(pSC->m_Dparam->bDecodeFullFrame);
+    switch (ofFormat) {
+    case OF_GRAY8:
+    {
+        const PixelI p = (ppChannel[0][iIdx] + pParams->iBias) >> pParams->iShift;
+        pDst[0] = _CLIP8(p);
+        break;
+    }
 
-    storeRGB24_5(pbY + 64 * 0, pbU - pbY, pbRGB + cbRGB *  0, cbRGB, cmbColumn);
-    storeRGB24_5(pbY + 64 * 2, pbU - pbY, pbRGB + cbRGB *  8, cbRGB, cmbColumn);
+    case OF_GRAY16:
+    {
+        const PixelI p = ((ppChannel[0][iIdx] + pParams->iBias) >> pParams->iShift) << pParams->nLen;
+        ((U16*)pDst)[0] = _CLIPU16(p);
+        break;
+    }
 
-#ifdef REENTRANT_MODE
-    pSC->WMIBI.cLinesDecoded = cHeight - iFirstRow;
-#endif
-    return ICERR_OK;
-}
+    case OF_RGB24:
+    {
+        const size_t iB = (pParams->bRGB ? 2 : 0), iR = 2 - iB;
+        PixelI g = ppChannel[0][iIdx] + pParams->iBias, r = -ppChannel[1][iIdx], b = ppChannel[2][iIdx];
 
+        _ICC(r, g, b);
 
-__declspec(naked) void __stdcall storeRGB24_3(
-    U8* pbYCoCg,
-    size_t cbYCoCg,
-    const U8* pbRGB,
-    size_t cbRGB,
-    size_t cmb,
-    const U8* Shift)
-{
-    UNREFERENCED_PARAMETER( pbYCoCg );
-    UNREFERENCED_PARAMETER( cbYCoCg );
-    UNREFERENCED_PARAMETER( pbRGB );
-    UNREFERENCED_PARAMETER( cbRGB );
-    UNREFERENCED_PARAMETER( cmb );
-    UNREFERENCED_PARAMETER( Shift );
-    __asm {
-        push ebp
-        push ebx    
-        push esi
-        push edi
-
-        mov ecx, [esp + 40]         // $ecx = Shift
-        mov ebx, [esp + 36]         // $ebx = cmb
-        mov edi, [esp + 28]         // $edi = pbRGB
-        lea ebx, [ebx + ebx * 2]    // $ebx = cmb * 3
-        mov edx, [esp + 32]         // $edx = cbRGB
-        shl ebx, 4                  // $ebx = cmb * 3 * 16
-        mov esi, [esp + 20]         // $esi = pbYCoCg
-        add edi, ebx                // $edi = pbRGB + 3 * 16 * cmb
-        mov ebp, [esp + 24]         // $ebp = cbYCoCg
-        neg ebx
-
-        mov eax, esp
-        and esp, 0xffffff80
-        sub esp, 320
-
-        mov [esp], eax              // original $esp
-        mov [esp + 4], edi
-        mov [esp + 8], ecx
+        g >>= pParams->iShift, b >>= pParams->iShift, r >>= pParams->iShift;
+        pDst[iR] = _CLIP8(r), pDst[1] = _CLIP8(g), pDst[iB] = _CLIP8(b);
+        break;
     }
-Loop0:
-    __asm {
-        mov edi, [esp + 4]          // $edi = pbRGB + 3 * 16 * cmb
-
-            //================
-            // first 8 pixels
-            movdqa xmm0, [esi]
-            movdqa xmm4, [esi + 16]
-            movdqa xmm3, [esi + ebp]
-            movdqa xmm7, [esi + ebp + 16]
-            movdqa xmm2, [esi + ebp * 2]
-            movdqa xmm6, [esi + ebp * 2 + 16]
-
-            mov ecx, [esp + 8]
-            movdqa xmm1, [ecx]
-            movdqa xmm5, [g_const_d0x80]
-            pslld xmm5, xmm1
-            paddd xmm5, xmm1
-            paddd xmm0, xmm5            // bias
-            paddd xmm4, xmm5            // bias
-            pxor xmm1, xmm1
-            pxor xmm5, xmm5
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            // ICC
-            movdqa xmm3, xmm1           // g -= r >> 1
-            movdqa xmm7, xmm5
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm0, xmm3
-            psubd xmm4, xmm7
-
-            movdqa xmm3, [g_const_d1]   // r -= ((b + 1) >> 1) - g
-            movdqa xmm7, [g_const_d1]
-            paddd xmm3, xmm2
-            paddd xmm7, xmm6
-            paddd xmm1, xmm0
-            paddd xmm5, xmm4
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            paddd xmm2, xmm1            // b += r
-            paddd xmm6, xmm5
-
-            // clip
-            movdqa xmm3, [g_const_w0x80]
-            packssdw xmm0, xmm4
-            packssdw xmm1, xmm5
-            packssdw xmm2, xmm6
-
-            mov ecx, [esp + 8]
-            movdqa xmm4, [ecx]
-            psraw xmm0, xmm4
-            psraw xmm1, xmm4
-            psraw xmm2, xmm4
-
-            psubw xmm0, xmm3
-            psubw xmm1, xmm3
-            psubw xmm2, xmm3
-
-            movdqa [esp + 16], xmm0
-            movdqa [esp + 32], xmm1
-            movdqa [esp + 48], xmm2
-
-            //================
-            // second 8 pixels
-            movdqa xmm0, [esi + 32]
-            movdqa xmm4, [esi + 48]
-            movdqa xmm3, [esi + ebp + 32]
-            movdqa xmm7, [esi + ebp + 48]
-            movdqa xmm2, [esi + ebp * 2 + 32]
-            movdqa xmm6, [esi + ebp * 2 + 48]
-
-            mov ecx, [esp + 8]
-            movdqa xmm1, [ecx]
-            movdqa xmm5, [g_const_d0x80]
-            pslld xmm5, xmm1
-            paddd xmm5, xmm1
-            paddd xmm0, xmm5            // bias
-            paddd xmm4, xmm5            // bias
-            pxor xmm1, xmm1
-            pxor xmm5, xmm5
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            // ICC
-            movdqa xmm3, xmm1           // g -= r >> 1
-            movdqa xmm7, xmm5
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm0, xmm3
-            psubd xmm4, xmm7
-
-            movdqa xmm3, [g_const_d1]   // r -= ((b + 1) >> 1) - g
-            movdqa xmm7, [g_const_d1]
-            paddd xmm3, xmm2
-            paddd xmm7, xmm6
-            paddd xmm1, xmm0
-            paddd xmm5, xmm4
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            paddd xmm2, xmm1            // b += r
-            paddd xmm6, xmm5
-
-            // clip
-            movdqa xmm3, [g_const_w0x80]
-            packssdw xmm0, xmm4
-            packssdw xmm1, xmm5
-            packssdw xmm2, xmm6
-
-            mov ecx, [esp + 8]
-            movdqa xmm4, [ecx]
-            psraw xmm0, xmm4
-            psraw xmm1, xmm4
-            psraw xmm2, xmm4
-
-            psubw xmm0, xmm3
-            psubw xmm1, xmm3
-            psubw xmm2, xmm3
-
-            //================
-            // 16 pixels
-            movdqa xmm3, [g_const_b0x80]
-            packsswb xmm0, [esp + 16]
-            packsswb xmm1, [esp + 32]
-            packsswb xmm2, [esp + 48]
-
-            psubb xmm0, xmm3
-            psubb xmm1, xmm3
-            psubb xmm2, xmm3
-
-            pxor xmm7, xmm7
-            movdqa xmm4, xmm0
-            movdqa xmm5, xmm1
-            movdqa xmm6, xmm2
-
-            punpckhbw xmm0, xmm7
-            punpckhbw xmm1, xmm7
-            punpckhbw xmm2, xmm7
-            punpcklbw xmm4, xmm7
-            punpcklbw xmm5, xmm7
-            punpcklbw xmm6, xmm7
-
-            // spill second 8 pixels
-            movdqa [esp + 16], xmm4
-            movdqa [esp + 32], xmm5
-            movdqa [esp + 48], xmm6
-
-            // first 8 pixels
-            movdqa xmm4, xmm0
-            movdqa xmm5, xmm1
-            movdqa xmm6, xmm2
-
-            punpcklwd xmm0, xmm7
-            punpcklwd xmm1, xmm7
-            punpcklwd xmm2, xmm7
-
-            punpckhwd xmm4, xmm7
-            punpckhwd xmm5, xmm7
-            punpckhwd xmm6, xmm7
-
-            pslld xmm0, 8
-            pslld xmm2, 16
-            pslld xmm4, 8
-            pslld xmm6, 16
-
-            por xmm0, xmm1
-            por xmm4, xmm5
-            por xmm0, xmm2
-            por xmm4, xmm6
-
-            movdqa [esp + 64], xmm0
-            pslld xmm0, 8
-            movdqa [esp + 80], xmm4
-            pslld xmm4, 8
-            movdqa [esp + 96], xmm0
-            movdqa [esp + 112], xmm4
-
-            // second 8 pixels
-            movdqa xmm0, [esp + 16]
-            movdqa xmm1, [esp + 32]
-            movdqa xmm2, [esp + 48]
-            movdqa xmm4, xmm0
-            movdqa xmm5, xmm1
-            movdqa xmm6, xmm2
-
-            punpcklwd xmm0, xmm7
-            punpcklwd xmm1, xmm7
-            punpcklwd xmm2, xmm7
-            punpckhwd xmm4, xmm7
-            punpckhwd xmm5, xmm7
-            punpckhwd xmm6, xmm7
-
-            pslld xmm0, 8
-            pslld xmm2, 16
-            pslld xmm4, 8
-            pslld xmm6, 16
-            por xmm0, xmm1
-            por xmm4, xmm5
-            por xmm0, xmm2
-            por xmm4, xmm6
-
-            movdqa [esp + 128], xmm0
-            pslld xmm0, 8
-            movdqa [esp + 144], xmm4
-            pslld xmm4, 8
-            movdqa [esp + 160], xmm0
-            movdqa [esp + 176], xmm4
-
-        //================================
-        add esi, 64
-
-            //================
-            // first 8 pixels
-            movdqa xmm0, [esi]
-            movdqa xmm4, [esi + 16]
-            movdqa xmm3, [esi + ebp]
-            movdqa xmm7, [esi + ebp + 16]
-            movdqa xmm2, [esi + ebp * 2]
-            movdqa xmm6, [esi + ebp * 2 + 16]
-
-            mov ecx, [esp + 8]
-            movdqa xmm1, [ecx]
-            movdqa xmm5, [g_const_d0x80]
-            pslld xmm5, xmm1
-            paddd xmm5, xmm1
-            paddd xmm0, xmm5            // bias
-            paddd xmm4, xmm5            // bias
-            pxor xmm1, xmm1
-            pxor xmm5, xmm5
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            // ICC
-            movdqa xmm3, xmm1           // g -= r >> 1
-            movdqa xmm7, xmm5
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm0, xmm3
-            psubd xmm4, xmm7
-
-            movdqa xmm3, [g_const_d1]   // r -= ((b + 1) >> 1) - g
-            movdqa xmm7, [g_const_d1]
-            paddd xmm3, xmm2
-            paddd xmm7, xmm6
-            paddd xmm1, xmm0
-            paddd xmm5, xmm4
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            paddd xmm2, xmm1            // b += r
-            paddd xmm6, xmm5
-
-            // clip
-            movdqa xmm3, [g_const_w0x80]
-            packssdw xmm0, xmm4
-            packssdw xmm1, xmm5
-            packssdw xmm2, xmm6
-
-            mov ecx, [esp + 8]
-            movdqa xmm4, [ecx]
-            psraw xmm0, xmm4
-            psraw xmm1, xmm4
-            psraw xmm2, xmm4
-
-            psubw xmm0, xmm3
-            psubw xmm1, xmm3
-            psubw xmm2, xmm3
-
-            movdqa [esp + 16], xmm0
-            movdqa [esp + 32], xmm1
-            movdqa [esp + 48], xmm2
-
-            //================
-            // second 8 pixels
-            movdqa xmm0, [esi + 32]
-            movdqa xmm4, [esi + 48]
-            movdqa xmm3, [esi + ebp + 32]
-            movdqa xmm7, [esi + ebp + 48]
-            movdqa xmm2, [esi + ebp * 2 + 32]
-            movdqa xmm6, [esi + ebp * 2 + 48]
-
-            mov ecx, [esp + 8]
-            movdqa xmm1, [ecx]
-            movdqa xmm5, [g_const_d0x80]
-            pslld xmm5, xmm1
-            paddd xmm5, xmm1
-            paddd xmm0, xmm5            // bias
-            paddd xmm4, xmm5            // bias
-            pxor xmm1, xmm1
-            pxor xmm5, xmm5
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            // ICC
-            movdqa xmm3, xmm1           // g -= r >> 1
-            movdqa xmm7, xmm5
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm0, xmm3
-            psubd xmm4, xmm7
-
-            movdqa xmm3, [g_const_d1]   // r -= ((b + 1) >> 1) - g
-            movdqa xmm7, [g_const_d1]
-            paddd xmm3, xmm2
-            paddd xmm7, xmm6
-            paddd xmm1, xmm0
-            paddd xmm5, xmm4
-            psrad xmm3, 1
-            psrad xmm7, 1
-            psubd xmm1, xmm3
-            psubd xmm5, xmm7
-
-            paddd xmm2, xmm1            // b += r
-            paddd xmm6, xmm5
-
-            // clip
-            movdqa xmm3, [g_const_w0x80]
-            packssdw xmm0, xmm4
-            packssdw xmm1, xmm5
-            packssdw xmm2, xmm6
-
-            mov ecx, [esp + 8]
-            movdqa xmm4, [ecx]
-            psraw xmm0, xmm4
-            psraw xmm1, xmm4
-            psraw xmm2, xmm4
-
-            psubw xmm0, xmm3
-            psubw xmm1, xmm3
-            psubw xmm2, xmm3
-
-            //================
-            // 16 pixels
-            movdqa xmm3, [g_const_b0x80]
-            packsswb xmm0, [esp + 16]
-            packsswb xmm1, [esp + 32]
-            packsswb xmm2, [esp + 48]
-
-            psubb xmm0, xmm3
-            psubb xmm1, xmm3
-            psubb xmm2, xmm3
-
-            pxor xmm7, xmm7
-            movdqa xmm4, xmm0
-            movdqa xmm5, xmm1
-            movdqa xmm6, xmm2
-
-            punpckhbw xmm0, xmm7
-            punpckhbw xmm1, xmm7
-            punpckhbw xmm2, xmm7
-            punpcklbw xmm4, xmm7
-            punpcklbw xmm5, xmm7
-            punpcklbw xmm6, xmm7
-
-            // spill second 8 pixels
-            movdqa [esp + 16], xmm4
-            movdqa [esp + 32], xmm5
-            movdqa [esp + 48], xmm6
-
-            // first 8 pixels
-            movdqa xmm4, xmm0
-            movdqa xmm5, xmm1
-            movdqa xmm6, xmm2
-
-            punpcklwd xmm0, xmm7
-            punpcklwd xmm1, xmm7
-            punpcklwd xmm2, xmm7
-
-            punpckhwd xmm4, xmm7
-            punpckhwd xmm5, xmm7
-            punpckhwd xmm6, xmm7
-
-            pslld xmm0, 8
-            pslld xmm2, 16
-            pslld xmm4, 8
-            pslld xmm6, 16
-
-            por xmm0, xmm1
-            por xmm4, xmm5
-            por xmm0, xmm2
-            por xmm4, xmm6
-
-            movdqa [esp + 192], xmm0
-            pslld xmm0, 8
-            movdqa [esp + 208], xmm4
-            pslld xmm4, 8
-            movdqa [esp + 224], xmm0
-            movdqa [esp + 240], xmm4
-
-            // second 8 pixels
-            movdqa xmm0, [esp + 16]
-            movdqa xmm1, [esp + 32]
-            movdqa xmm2, [esp + 48]
-            movdqa xmm4, xmm0
-            movdqa xmm5, xmm1
-            movdqa xmm6, xmm2
-
-            punpcklwd xmm0, xmm7
-            punpcklwd xmm1, xmm7
-            punpcklwd xmm2, xmm7
-            punpckhwd xmm4, xmm7
-            punpckhwd xmm5, xmm7
-            punpckhwd xmm6, xmm7
-
-            pslld xmm0, 8
-            pslld xmm2, 16
-            pslld xmm4, 8
-            pslld xmm6, 16
-            por xmm0, xmm1
-            por xmm4, xmm5
-            por xmm0, xmm2
-            por xmm4, xmm6
-
-            movdqa [esp + 256], xmm0
-            pslld xmm0, 8
-            movdqa [esp + 272], xmm4
-            pslld xmm4, 8
-            movdqa [esp + 288], xmm0
-            movdqa [esp + 304], xmm4
-
-            // RGBX32 -> RGB24
-            mov eax, [esp + 68]         // ..B1G1R1
-            mov ecx, [esp + 96]         // B0G0R0..
-            shld eax, ecx, 24           // R1B0G0R0
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + 84]         // ..B5G5R5
-            mov ecx, [esp + 100]        // B1G1R1..
-            shld eax, ecx, 16           // G5R5B1G1
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + 80]         // ..B4G4R4
-            mov ecx, [esp + 116]        // B5G5R5..
-            shld eax, ecx, 8            // B4G4R4B5
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            mov eax, [esp + 76]         // ..B3G3R3
-            mov ecx, [esp + 104]        // B2G2R2..
-            shld eax, ecx, 24           // R3B2G2R2
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + 92]         // ..B7G7R7
-            mov ecx, [esp + 108]        // B3G3R3..
-            shld eax, ecx, 16           // G7R7B3G3
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + 88]         // ..B6G6R6
-            mov ecx, [esp + 124]        // B7G7R7..
-            shld eax, ecx, 8            // B6G6R6B7
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            // RGBX32 -> RGB24
-            mov eax, [esp + 140]        // ..B3G3R3
-            mov ecx, [esp + 168]        // B2G2R2..
-            shld eax, ecx, 24           // R3B2G2R2
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + 156]        // ..B7G7R7
-            mov ecx, [esp + 172]        // B3G3R3..
-            shld eax, ecx, 16           // G7R7B3G3
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + 152]        // ..B6G6R6
-            mov ecx, [esp + 188]        // B7G7R7..
-            shld eax, ecx, 8            // B6G6R6B7
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            mov eax, [esp + 132]        // ..B1G1R1
-            mov ecx, [esp + 160]        // B0G0R0..
-            shld eax, ecx, 24           // R1B0G0R0
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + 148]        // ..B5G5R5
-            mov ecx, [esp + 164]        // B1G1R1..
-            shld eax, ecx, 16           // G5R5B1G1
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + 144]        // ..B4G4R4
-            mov ecx, [esp + 180]        // B5G5R5..
-            shld eax, ecx, 8            // B4G4R4B5
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            // RGBX32 -> RGB24
-            mov eax, [esp + 196]        // ..B1G1R1
-            mov ecx, [esp + 224]        // B0G0R0..
-            shld eax, ecx, 24           // R1B0G0R0
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + 212]        // ..B5G5R5
-            mov ecx, [esp + 228]        // B1G1R1..
-            shld eax, ecx, 16           // G5R5B1G1
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + 208]        // ..B4G4R4
-            mov ecx, [esp + 244]        // B5G5R5..
-            shld eax, ecx, 8            // B4G4R4B5
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            mov eax, [esp + 204]        // ..B3G3R3
-            mov ecx, [esp + 232]        // B2G2R2..
-            shld eax, ecx, 24           // R3B2G2R2
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + 220]        // ..B7G7R7
-            mov ecx, [esp + 236]        // B3G3R3..
-            shld eax, ecx, 16           // G7R7B3G3
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + 216]        // ..B6G6R6
-            mov ecx, [esp + 252]        // B7G7R7..
-            shld eax, ecx, 8            // B6G6R6B7
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            // RGBX32 -> RGB24
-            mov eax, [esp + 268]         // ..B3G3R3
-            mov ecx, [esp + 296]        // B2G2R2..
-            shld eax, ecx, 24           // R3B2G2R2
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + 284]         // ..B7G7R7
-            mov ecx, [esp + 300]        // B3G3R3..
-            shld eax, ecx, 16           // G7R7B3G3
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + 280]         // ..B6G6R6
-            mov ecx, [esp + 316]        // B7G7R7..
-            shld eax, ecx, 8            // B6G6R6B7
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-            mov eax, [esp + 260]         // ..B1G1R1
-            mov ecx, [esp + 288]         // B0G0R0..
-            shld eax, ecx, 24           // R1B0G0R0
-            mov [edi + ebx + 0], eax
-            mov eax, [esp + 276]         // ..B5G5R5
-            mov ecx, [esp + 292]        // B1G1R1..
-            shld eax, ecx, 16           // G5R5B1G1
-            mov [edi + ebx + 4], eax
-            mov eax, [esp + 272]         // ..B4G4R4
-            mov ecx, [esp + 308]        // B5G5R5..
-            shld eax, ecx, 8            // B4G4R4B5
-            mov [edi + ebx + 8], eax
-            add edi, edx                // $edi = pbRGB += cbRGB
-
-        //================================
-        add esi, 256 - 64
-        add ebx, 12
-        jnz Loop0
-
-        //================
-        pop esp
-        pop edi
-        pop esi
-        pop ebx
-        pop ebp
-        ret 24
     }
 }
 
-Int outputMBRow_RGB24_Lossy_3(CWMImageStrCodec* pSC)
+/** outputMBRow for the formats in OUTPUTFORMAT, with no alpha, no orientation and no resolution change **/
+static Int outputMBRow_OPT(CWMImageStrCodec* pSC, OUTPUTFORMAT ofFormat, OutputLineProc outputLine)
 {
-#ifdef REENTRANT_MODE
     const size_t cHeight = min((pSC->m_Dparam->cROIBottomY + 1) - (pSC->cRow - 1) * 16, 16);
-    const size_t iFirstRow = ((pSC->cRow - 1) * 16 > pSC->m_Dparam->cROITopY ? 0 : (pSC->m_Dparam->cROITopY & 0xf));
-#endif
-    const size_t cbRGB = pSC->WMIBI.cbStride;
-    const U8* const pbRGB = (U8*)pSC->WMIBI.pv + cbRGB * (pSC->cRow - 1) * 16;
+    const size_t cWidth = (pSC->m_Dparam->cROIRightX + 1);
+    const size_t iFirstRow = ((pSC->cRow - 1) * 16 > pSC->m_Dparam->cROITopY ? 0 : (pSC->m_Dparam->cROITopY & 0xf)), iFirstColumn = pSC->m_Dparam->cROILeftX;
+    const size_t cbElement = (OF_GRAY16 == ofFormat ? sizeof(U16) : sizeof(U8));
+    const size_t * pOffsetX = pSC->m_Dparam->pOffsetX, * pOffsetY = pSC->m_Dparam->pOffsetY + (pSC->cRow - 1) * 16;
+    const PixelI* apChannel[3];
+    OUTPUTPARAMS params;
+    size_t iRow, iColumn, iChannel;
+
+    assert(O_NONE == pSC->WMII.oOrientation);
 
-    U8* const pbY = (U8*)pSC->a0MBbuffer[0];
-    U8* const pbU = (U8*)pSC->a0MBbuffer[1];
-    // U8* const pbV = (U8*)pSC->a0MBbuffer[2];
+    params.iShift = (pSC->m_param.bScaledArith ? SHIFTZERO + QPFRACBITS : 0);
+    params.nLen = pSC->WMISCP.nLenMantissaOrShift;
+    params.bRGB = pSC->WMII.bRGB;
+    if (OF_GRAY16 == ofFormat)
+        params.iBias = (((1 << 15) >> params.nLen) << params.iShift) + (params.iShift == 0 ? 0 : (1 << (params.iShift - 1)));
+    else
+        params.iBias = (128 << params.iShift) + (pSC->m_param.bScaledArith ? ((1 << (SHIFTZERO + QPFRACBITS - 1)) - 1) : 0);
 
-    const size_t cmbColumn = (pSC->WMII.cWidth + 15) / 16;
+    // guard output buffer
+    if(checkImageBuffer(pSC, pSC->WMII.cROIWidth, cHeight - iFirstRow) != ICERR_OK)
+        return ICERR_ERROR;
 
-    __declspec(align(16)) U8 Shift[16];
+    for (iChannel = 0; iChannel < 3; iChannel++)
+        apChannel[iChannel] = (OF_RGB24 == ofFormat || 0 == iChannel ? pSC->a0MBbuffer[iChannel] : NULL);
 
-    assert(BD_8 == pSC->WMII.bdBitDepth);
-    assert(CF_RGB == pSC->WMII.cfColorFormat);
-    assert(24 == pSC->WMII.cBitsPerUnit);
-    assert(pSC->WMII.bRGB);
-    assert(O_NONE == pSC->WMII.oOrientation);
+    for (iRow = iFirstRow; iRow < cHeight; iRow++) {
+        U8* const pLine = (U8*)pSC->WMIBI.pv + pOffsetY[iRow] * cbElement;
 
-    assert(YUV_444 == pSC->m_param.cfColorFormat);
+        for (iColumn = iFirstColumn; iColumn < cWidth; ) {
+            if (0 == (iColumn & 15) && iColumn + 16 <= cWidth) {
+                const size_t iMB = (iColumn >> 4) << 8;
+                const PixelI* apMB[3];
 
-    assert(pSC->m_Dparam->bDecodeFullFrame);
+                for (iChannel = 0; iChannel < 3; iChannel++)
+                    apMB[iChannel] = (apChannel[iChannel] != NULL ? apChannel[iChannel] + iMB : NULL);
 
-    _mm_store_si128((__m128i *) Shift, pSC->m_param.bScaledArith ? g_const_d3 : g_const_d0);
-    storeRGB24_3(pbY + 64 * 0, pbU - pbY, pbRGB + cbRGB *  0, cbRGB, cmbColumn,
-        Shift);
-    storeRGB24_3(pbY + 64 * 2, pbU - pbY, pbRGB + cbRGB *  8, cbRGB, cmbColumn,
-        Shift);
+                outputLine(&params, apMB, iRow, pLine + pOffsetX[iColumn] * cbElement);
+                iColumn += 16;
+            }
+            else {
+                outputPixel(&params, ofFormat, apChannel, iRow, iColumn, pLine + pOffsetX[iColumn] * cbElement);
+                iColumn++;
+            }
+        }
+    }
 
 #ifdef REENTRANT_MODE
     pSC->WMIBI.cLinesDecoded = cHeight - iFirstRow;
 #endif
+
     return ICERR_OK;
 }
-#endif
 
 //================================================================
-#if defined(WMP_OPT_TRFM_DEC)
-FORCE_INLINE Void strDCT2x2up_OPT(PixelI *pa, PixelI *pb, PixelI *pc, PixelI *pd)
+// SSE2
+//================================================================
+#define SIMD_V __m128i
+#define SIMD_LANES 4
+#define SIMD_FN(name) name##_SSE2
+#define SIMD_TARGET X86_TARGET_SSE2
+#define SIMD_ADD(a, b) _mm_add_epi32(a, b)
+#define SIMD_SUB(a, b) _mm_sub_epi32(a, b)
+#define SIMD_SRAI(a, n) _mm_srai_epi32(a, n)
+#define SIMD_SRA(a, n) _mm_sra_epi32(a, _mm_cvtsi32_si128(n))
+#define SIMD_SLL(a, n) _mm_sll_epi32(a, _mm_cvtsi32_si128(n))
+#define SIMD_SET1(x) _mm_set1_epi32(x)
+#define SIMD_ZERO _mm_setzero_si128()
+
+/** 4x4 transpose of 32-bit elements **/
+#define TRANSPOSE4_SSE2(r0, r1, r2, r3) \
+{ \
+    const __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpacklo_epi32(r2, r3); \
+    const __m128i t2 = _mm_unpackhi_epi32(r0, r1), t3 = _mm_unpackhi_epi32(r2, r3); \
+    r0 = _mm_unpacklo_epi64(t0, t1), r1 = _mm_unpackhi_epi64(t0, t1); \
+    r2 = _mm_unpacklo_epi64(t2, t3), r3 = _mm_unpackhi_epi64(t2, t3); \
+}
+
+/** v[4 * q + i] gets element i of row q of the four blocks/windows **/
+SIMD_TARGET static SIMD_INLINE Void LoadTransposed_SSE2(__m128i* v, PixelI* (*apRows)[4])
 {
-    PixelI a, b, c, d, C, t;
-    a = *pa;
-    b = *pb;
-    C = *pc;
-    d = *pd;
-
-    a += d;
-    b -= C;
-    t = ((a - b + 1) >> 1);
-    c = t - d;
-    d = t - C;
-    a -= d;
-    b += c;
-
-    *pa = a;
-    *pb = b;
-    *pc = c;
-    *pd = d;
+    size_t q;
+
+    for (q = 0; q < 4; q++) {
+        __m128i r0 = _mm_loadu_si128((const __m128i*)apRows[0][q]), r1 = _mm_loadu_si128((const __m128i*)apRows[1][q]);
+        __m128i r2 = _mm_loadu_si128((const __m128i*)apRows[2][q]), r3 = _mm_loadu_si128((const __m128i*)apRows[3][q]);
+
+        TRANSPOSE4_SSE2(r0, r1, r2, r3);
+        v[4 * q + 0] = r0, v[4 * q + 1] = r1, v[4 * q + 2] = r2, v[4 * q + 3] = r3;
+    }
 }
 
-FORCE_INLINE Void invOdd_OPT(PixelI *pa, PixelI *pb, PixelI *pc, PixelI *pd)
+SIMD_TARGET static SIMD_INLINE Void StoreTransposed_SSE2(const __m128i* v, PixelI* (*apRows)[4])
 {
-    PixelI a, b, c, d;
-    a = *pa;
-    b = *pb;
-    c = *pc;
-    d = *pd;
-
-    /** butterflies **/
-    b += d;
-    a -= c;
-    d -= (b) >> 1;
-    c += (a + 1) >> 1;
-
-    /** rotate pi/8 **/
-#define IROTATE2(a, b) (a) -= (((b)*3 + 4) >> 3), (b) += (((a)*3 + 4) >> 3)
-    IROTATE2(a, b);
-    IROTATE2(c, d);
-
-    /** butterflies **/
-    c -= (b + 1) >> 1;
-    d = ((a + 1) >> 1) - d;
-    b += c;
-    a -= d;
-
-    *pa = a;
-    *pb = b;
-    *pc = c;
-    *pd = d;
+    size_t q;
+
+    for (q = 0; q < 4; q++) {
+        __m128i r0 = v[4 * q + 0], r1 = v[4 * q + 1], r2 = v[4 * q + 2], r3 = v[4 * q + 3];
+
+        TRANSPOSE4_SSE2(r0, r1, r2, r3);
+        _mm_storeu_si128((__m128i*)apRows[0][q], r0), _mm_storeu_si128((__m128i*)apRows[1][q], r1);
+        _mm_storeu_si128((__m128i*)apRows[2][q], r2), _mm_storeu_si128((__m128i*)apRows[3][q], r3);
+    }
 }
 
-FORCE_INLINE Void invOddOdd_OPT(PixelI* pa, PixelI* pb, PixelI* pc, PixelI* pd)
+/** pixels 4 * q ... 4 * q + 3 of line iRow of a macroblock (see idxCC) **/
+SIMD_TARGET static SIMD_INLINE __m128i LoadQuad_SSE2(const PixelI* pMB, size_t iRow, size_t q)
 {
-    PixelI a, b, c, d, t1, t2;
-    a = *pa;
-    b = *pb;
-    c = *pc;
-    d = *pd;
-
-    /** butterflies **/
-    d += a;
-    c -= b;
-    a -= (t1 = d >> 1);
-    b += (t2 = c >> 1);
-
-    /** rotate pi/4 **/
-    a -= (b * 3 + 3) >> 3;
-    b += (a * 3 + 3) >> 2;
-    a -= (b * 3 + 4) >> 3;
-
-    /** butterflies **/
-    b -= t2;
-    a += t1;
-    c += b;
-    d -= a;
-
-    /** sign flips **/
-    *pa = a;
-    *pb = -b;
-    *pc = -c;
-    *pd = d;
+    const PixelI* pHalf = pMB + q * 64 + (iRow >> 2) * 16 + ((iRow & 2) << 2);
+    const __m128i x = _mm_loadu_si128((const __m128i*)pHalf);
+    const __m128i y = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(pHalf + 4)), _MM_SHUFFLE(2, 3, 0, 1));
+
+    return ((iRow + 1) & 2) ? _mm_unpackhi_epi64(x, y) : _mm_unpacklo_epi64(x, y);
 }
 
-FORCE_INLINE Void strDCT2x2dn_SSE2_1(PixelI* p)
+SIMD_TARGET static SIMD_INLINE Void LoadLine_SSE2(__m128i* v, const PixelI* pMB, size_t iRow)
 {
-    __m128i* const pdq = (__m128i*)p;
-    __m128i a = pdq[0];
-    __m128i b = pdq[1];
-    const __m128i C = pdq[2];
-    __m128i d = pdq[3];
-    __m128i t;
-    __m128i c;
-
-    a = _mm_add_epi32(a, d);
-    b = _mm_sub_epi32(b, C);
-    t = _mm_sub_epi32(a, b);
-    t = _mm_srai_epi32(t, 1);
-    c = _mm_sub_epi32(t, d);
-    d = _mm_sub_epi32(t, C);
-    a = _mm_sub_epi32(a, d);
-    b = _mm_add_epi32(b, c);
-
-    pdq[0] = a;
-    pdq[1] = b;
-    pdq[2] = c;
-    pdq[3] = d;
+    v[0] = LoadQuad_SSE2(pMB, iRow, 0), v[1] = LoadQuad_SSE2(pMB, iRow, 1);
+    v[2] = LoadQuad_SSE2(pMB, iRow, 2), v[3] = LoadQuad_SSE2(pMB, iRow, 3);
 }
 
-Void strIDCT4x4Stage1_OPT_H1(PixelI* p)
+SIMD_TARGET static SIMD_INLINE __m128i PackU8_SSE2(const __m128i* v)
 {
-    /** top left corner, butterfly => butterfly **/
-    strDCT2x2up_OPT(p + 0, p + 1, p + 2, p + 3);
+    return _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3]));
+}
 
-    /** top right corner, -pi/8 rotation => butterfly **/
-    invOdd_OPT(p + 5, p + 4, p + 7, p + 6);
+/** clip to [0, 65535] and store (SSE2 has no unsigned saturation for 32 bits) **/
+SIMD_TARGET static SIMD_INLINE __m128i PackU16_SSE2(__m128i a, __m128i b)
+{
+    const __m128i vMax = _mm_set1_epi32(65535), vBias32 = _mm_set1_epi32(32768), vBias16 = _mm_set1_epi16(-32768);
+    __m128i m;
+
+    a = _mm_andnot_si128(_mm_cmplt_epi32(a, _mm_setzero_si128()), a);
+    m = _mm_cmpgt_epi32(a, vMax);
+    a = _mm_or_si128(_mm_andnot_si128(m, a), _mm_and_si128(m, vMax));
+    b = _mm_andnot_si128(_mm_cmplt_epi32(b, _mm_setzero_si128()), b);
+    m = _mm_cmpgt_epi32(b, vMax);
+    b = _mm_or_si128(_mm_andnot_si128(m, b), _mm_and_si128(m, vMax));
+
+    return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(a, vBias32), _mm_sub_epi32(b, vBias32)), vBias16);
+}
 
-    /** bottom left corner, butterfly => -pi/8 rotation **/
-    invOdd_OPT(p + 10, p + 8, p + 11, p + 9);
+SIMD_TARGET static SIMD_INLINE Void StoreU16_SSE2(U16* pDst, const __m128i* v)
+{
+    _mm_storeu_si128((__m128i*)pDst, PackU16_SSE2(v[0], v[1]));
+    _mm_storeu_si128((__m128i*)(pDst + 8), PackU16_SSE2(v[2], v[3]));
+}
+
+/** interleaves the three 8-bit channels of 16 pixels **/
+SIMD_TARGET static SIMD_INLINE Void StoreRGB24_SSE2(U8* pDst, const __m128i* pColor)
+{
+    U8 a0[16], a1[16], a2[16];
+    size_t k;
 
-    /** bottom right corner, -pi/8 rotation => -pi/8 rotation **/
-    invOddOdd_OPT(p + 15, p + 14, p + 13, p + 12);
+    _mm_storeu_si128((__m128i*)a0, pColor[0]), _mm_storeu_si128((__m128i*)a1, pColor[1]), _mm_storeu_si128((__m128i*)a2, pColor[2]);
+    for (k = 0; k < 16; k++) {
+        pDst[3 * k + 0] = a0[k], pDst[3 * k + 1] = a1[k], pDst[3 * k + 2] = a2[k];
+    }
+}
+
+#include "strdec_x86_template.h"
+
+static Int outputMBRow_Gray8_SSE2(CWMImageStrCodec* pSC) { return outputMBRow_OPT(pSC, OF_GRAY8, outputLine_Gray8_SSE2); }
+static Int outputMBRow_Gray16_SSE2(CWMImageStrCodec* pSC) { return outputMBRow_OPT(pSC, OF_GRAY16, outputLine_Gray16_SSE2); }
+static Int outputMBRow_RGB24_SSE2(CWMImageStrCodec* pSC) { return outputMBRow_OPT(pSC, OF_RGB24, outputLine_RGB24_SSE2); }
+
+#undef SIMD_V
+#undef SIMD_LANES
+#undef SIMD_FN
+#undef SIMD_TARGET
+#undef SIMD_ADD
+#undef SIMD_SUB
+#undef SIMD_SRAI
+#undef SIMD_SRA
+#undef SIMD_SLL
+#undef SIMD_SET1
+#undef SIMD_ZERO
+
+//================================================================
+// AVX2 - eight blocks/windows per register, lanes 0..3 in the low half and lanes 4..7 in the high half
+//================================================================
+#define SIMD_V __m256i
+#define SIMD_LANES 8
+#define SIMD_FN(name) name##_AVX2
+#define SIMD_TARGET X86_TARGET_AVX2
+#define SIMD_ADD(a, b) _mm256_add_epi32(a, b)
+#define SIMD_SUB(a, b) _mm256_sub_epi32(a, b)
+#define SIMD_SRAI(a, n) _mm256_srai_epi32(a, n)
+#define SIMD_SRA(a, n) _mm256_sra_epi32(a, _mm_cvtsi32_si128(n))
+#define SIMD_SLL(a, n) _mm256_sll_epi32(a, _mm_cvtsi32_si128(n))
+#define SIMD_SET1(x) _mm256_set1_epi32(x)
+#define SIMD_ZERO _mm256_setzero_si256()
+
+#define TRANSPOSE4_AVX2(r0, r1, r2, r3) \
+{ \
+    const __m256i t0 = _mm256_unpacklo_epi32(r0, r1), t1 = _mm256_unpacklo_epi32(r2, r3); \
+    const __m256i t2 = _mm256_unpackhi_epi32(r0, r1), t3 = _mm256_unpackhi_epi32(r2, r3); \
+    r0 = _mm256_unpacklo_epi64(t0, t1), r1 = _mm256_unpackhi_epi64(t0, t1); \
+    r2 = _mm256_unpacklo_epi64(t2, t3), r3 = _mm256_unpackhi_epi64(t2, t3); \
 }
 
-FORCE_INLINE Void strIDCT4x4Stage1_OPT_H2(PixelI* p)
+SIMD_TARGET static SIMD_INLINE __m256i LoadRowPair_AVX2(PixelI* pLow, PixelI* pHigh)
 {
-    /** butterfly **/
-    strDCT2x2dn_SSE2_1(p);
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)pLow)), _mm_loadu_si128((const __m128i*)pHigh), 1);
 }
 
-Void strIDCT4x4Stage1_OPT5(PixelI* p0, PixelI* p1)
+SIMD_TARGET static SIMD_INLINE Void StoreRowPair_AVX2(PixelI* pLow, PixelI* pHigh, const __m256i* pr)
 {
-    _mm_prefetch((char*)(p0 - 96 + 256), _MM_HINT_T0);
-    strIDCT4x4Stage1_OPT_H1(p0 - 96);
-    strIDCT4x4Stage1_OPT_H1(p0 - 80);
-    strIDCT4x4Stage1_OPT_H1(p0 - 32);
-    strIDCT4x4Stage1_OPT_H1(p0 - 16);
-
-    _mm_prefetch((char*)(p0 - 32 + 256), _MM_HINT_T0);
-    strIDCT4x4Stage1_OPT_H1(p0 + 32);
-    strIDCT4x4Stage1_OPT_H1(p0 + 48);
-    strIDCT4x4Stage1_OPT_H1(p0 + 96);
-    strIDCT4x4Stage1_OPT_H1(p0 + 112);
-
-    _mm_prefetch((char*)(p0 + 32 + 256), _MM_HINT_T0);
-    strIDCT4x4Stage1_OPT_H1(p1 - 128);
-    strIDCT4x4Stage1_OPT_H1(p1 - 112);
-    strIDCT4x4Stage1_OPT_H1(p1 - 64);
-    strIDCT4x4Stage1_OPT_H1(p1 - 48);
-
-    _mm_prefetch((char*)(p0 + 96 + 256), _MM_HINT_T0);
-    strIDCT4x4Stage1_OPT_H1(p1 + 0);
-    strIDCT4x4Stage1_OPT_H1(p1 + 16);
-    strIDCT4x4Stage1_OPT_H1(p1 + 64);
-    strIDCT4x4Stage1_OPT_H1(p1 + 80);
-
-    strIDCT4x4Stage1_OPT_H2(p0 - 96);
-    strIDCT4x4Stage1_OPT_H2(p0 - 80);
-    strIDCT4x4Stage1_OPT_H2(p0 - 32);
-    strIDCT4x4Stage1_OPT_H2(p0 - 16);
-    strIDCT4x4Stage1_OPT_H2(p0 + 32);
-    strIDCT4x4Stage1_OPT_H2(p0 + 48);
-    strIDCT4x4Stage1_OPT_H2(p0 + 96);
-    strIDCT4x4Stage1_OPT_H2(p0 + 112);
-
-    strIDCT4x4Stage1_OPT_H2(p1 - 128);
-    strIDCT4x4Stage1_OPT_H2(p1 - 112);
-    strIDCT4x4Stage1_OPT_H2(p1 - 64);
-    strIDCT4x4Stage1_OPT_H2(p1 - 48);
-    strIDCT4x4Stage1_OPT_H2(p1 + 0);
-    strIDCT4x4Stage1_OPT_H2(p1 + 16);
-    strIDCT4x4Stage1_OPT_H2(p1 + 64);
-    strIDCT4x4Stage1_OPT_H2(p1 + 80);
+    _mm_storeu_si128((__m128i*)pLow, _mm256_castsi256_si128(*pr));
+    _mm_storeu_si128((__m128i*)pHigh, _mm256_extracti128_si256(*pr, 1));
 }
 
-//================================
-__declspec(naked) void __stdcall strPost4x4Stage1_alternate_ASM5(PixelI* p0, PixelI* p1)
+SIMD_TARGET static SIMD_INLINE Void LoadTransposed_AVX2(__m256i* v, PixelI* (*apRows)[4])
 {
-    UNREFERENCED_PARAMETER( p0 );
-    UNREFERENCED_PARAMETER( p1 );
-    __asm {
-        push ebp
-        push ebx
-        push esi
-        push edi
-
-        //================
-        // pointer array
-        mov eax, [esp + 20]     // $esi = p0
-        mov edx, [esp + 24]     // $edi = p1
-        mov ecx, 4 * 16
-        mov ebx, 4 * 48
-
-        prefetcht0 [eax + 512]
-        prefetcht0 [eax + 768]
-        prefetcht0 [eax + 1024]
-        prefetcht0 [eax + 1280]
-
-        add edx, ecx
-        add eax, ebx
-
-        push edx
-        sub edx, ecx
-        push edx
-        push edx
-        sub edx, ebx
-        push eax
-        push eax
-        sub eax, ecx
-        push eax
-        push eax
-        sub eax, ecx
-        push eax
-        sub eax, ecx
-
-        push edx
-        sub edx, ecx
-        push edx
-        sub eax, ecx
-        push edx
-        sub edx, ebx
-        push eax
-        push eax
-        sub eax, ecx
-        push eax
-        push eax
-        sub eax, ecx
-        push eax
-        sub eax, ecx
-        
-        push edx
-        sub edx, ecx
-        push edx
-        sub eax, ecx
-        push edx
-        sub edx, ebx
-        push eax
-        push eax
-        sub eax, ecx
-        push eax
-        push eax
-        sub eax, ecx
-        push eax
-        sub eax, ecx
-                
-        push edx
-        sub edx, ecx
-        push edx
-        sub eax, ecx
-        push edx
-        push eax
-        push eax
-        sub eax, ecx
-        push eax
-        push eax
-        sub eax, ecx
-        push eax
-
-        mov ebp, (4 + 4) * -16
-        push ebp
+    size_t q;
+
+    for (q = 0; q < 4; q++) {
+        __m256i r0 = LoadRowPair_AVX2(apRows[0][q], apRows[4][q]), r1 = LoadRowPair_AVX2(apRows[1][q], apRows[5][q]);
+        __m256i r2 = LoadRowPair_AVX2(apRows[2][q], apRows[6][q]), r3 = LoadRowPair_AVX2(apRows[3][q], apRows[7][q]);
+
+        TRANSPOSE4_AVX2(r0, r1, r2, r3);
+        v[4 * q + 0] = r0, v[4 * q + 1] = r1, v[4 * q + 2] = r2, v[4 * q + 3] = r3;
     }
-Loop0:        
-    __asm {
-        mov esi, [esp + (4 + 4) * 16 + 4 + ebp ]    // $esi = p0
-        mov edi, [esp + (4 + 4) * 16 + 4 + ebp + 4] // $edi = p1
-
-        //================
-        movdqa xmm2, [esi + 4 * 12] // a = xmm2
-        movdqa xmm1, [esi + 4 * 72] // b = xmm1
-        movdqa xmm6, [edi + 4 * 4]  // c = xmm6
-        movdqa xmm7, [edi + 4 * 64] // d = xmm7
-
-        //================
-        // buttefly
-        paddd xmm2, xmm7
-        psubd xmm1, xmm6
-
-        movdqa xmm0, xmm2           // a = xmm0
-        psubd xmm2, xmm1
-        psrad xmm2, 1
-        movdqa xmm3, xmm2
-
-        psubd xmm2, xmm7            // c = xmm2
-        psubd xmm3, xmm6            // d = xmm3
-        paddd xmm1, xmm2
-        psubd xmm0, xmm3
-
-        //================
-        // bottom right corner: -pi/8 rotation => -pi/8 rotation
-        pshufd xmm7, xmm3, 0x3
-        movd eax, xmm3
-        movd edx, xmm7
-        pshufd xmm7, xmm3, 0x1
-        movd ebx, xmm7
-        pshufd xmm7, xmm3, 0x2
-        movd ecx, xmm7
-
-        add edx, eax
-        sub ecx, ebx
-        mov esi, edx
-        sar esi, 1
-        mov edi, ecx
-        sar edi, 1
-        sub eax, esi
-        add ebx, edi
-
-        lea ebp, [ebx + ebx * 2 + 6]
-        sar ebp, 3
-        sub eax, ebp
-        lea ebp, [eax + eax * 2 + 2]
-        sar ebp, 2
-        add ebx, ebp
-        lea ebp, [ebx + ebx * 2 + 4]
-        sar ebp, 3
-        sub eax, ebp
-
-        mov ebp, [esp]
-
-        sub ebx, edi
-        add eax, esi
-        add ecx, ebx
-        sub edx, eax
-
-        mov esi, [esp + (4 + 4) * 16 + 4 + ebp ]    // $esi = p0
-        mov edi, [esp + (4 + 4) * 16 + 4 + ebp + 4] // $edi = p1
-
-        movd xmm3, eax
-        movd xmm4, ebx
-        movd xmm5, ecx
-        movd xmm6, edx
-        punpckldq xmm3, xmm4
-        punpckldq xmm5, xmm6
-        punpcklqdq xmm3, xmm5
-
-        //================
-        // anti diagonal corners: rotation by -pi/8
-        movdqa xmm5, g_const_d1
-        movdqa xmm6, g_const_d1
-
-        pshufd xmm2, xmm2, 0xd8 //  7,  5,  6,  4
-        movdqa xmm4, xmm1       // 75, 74, 73, 72
-        punpckhqdq xmm1, xmm2   //  7,  5, 75, 74
-        punpcklqdq xmm4, xmm2   //  6,  4, 73, 72
-
-        paddd xmm5, xmm1
-        psrad xmm5, 1
-        psubd xmm4, xmm5
-
-        paddd xmm6, xmm4
-        psrad xmm6, 1
-        paddd xmm1, xmm6
-
-        movdqa xmm2, xmm4       //  6,  4, 73, 72
-        punpckhqdq xmm4, xmm1   //  7,  5,  6,  4
-        punpcklqdq xmm2, xmm1   // 75, 74, 73, 72
-        pshufd xmm4, xmm4, 0xd8 //  7,  6,  5,  4
-
-        //================
-        // butterfly
-        // a = xmm0, b = xmm2, c = xmm4, d = xmm3
-        paddd xmm0, xmm3
-        movdqa xmm1, xmm0   // a = xmm1
-        psrad xmm0, 1
-        psubd xmm0, xmm3    // d = xmm0
-
-        movdqa xmm3, xmm0   // d = xmm3
-        paddd xmm0, xmm0
-        paddd xmm0, xmm3
-        psrad xmm0, 3
-        paddd xmm1, xmm0
-
-        movdqa xmm0, xmm1   // a = xmm0
-        paddd xmm1, xmm1
-        paddd xmm1, xmm0
-        psrad xmm1, 4
-        paddd xmm3, xmm1
-
-        movdqa xmm5, xmm0   // a
-        psrad xmm5, 7
-        paddd xmm3, xmm5    // d += (a >> 7)
-        psrad xmm5, 3
-        psubd xmm3, xmm5    // d -= (a >> 10)
-
-        movdqa xmm5, [g_const_d4]
-        movdqa xmm1, xmm3   // d = xmm1
-        psubd xmm2, xmm4
-        paddd xmm5, xmm3
-        paddd xmm3, xmm3
-        paddd xmm3, xmm5
-        psrad xmm3, 3
-        paddd xmm0, xmm3
-
-        movdqa xmm3, xmm2   // b = xmm3
-        psrad xmm2, 1
-        psubd xmm1, xmm2
-
-        movdqa xmm2, xmm0   // a = xmm2
-        psubd xmm0, xmm3
-        psrad xmm0, 1
-        psubd xmm0, xmm4    // c = xmm0
-
-        paddd xmm3, xmm1
-        psubd xmm2, xmm0
-
-        //================
-        movdqa [edi + 4 * 4], xmm1
-        movdqa [edi + 4 * 64], xmm0
-        movdqa [esi + 4 * 12], xmm2
-        movdqa [esi + 4 * 72], xmm3
-
-        add ebp, 8
-        mov [esp], ebp
-        jnz Loop0
-
-        //================
-        add esp, (4 + 4) * 16 + 4
-        pop edi
-        pop esi
-        pop ebx
-        pop ebp
-        ret 4 * 2
+}
+
+SIMD_TARGET static SIMD_INLINE Void StoreTransposed_AVX2(const __m256i* v, PixelI* (*apRows)[4])
+{
+    size_t q;
+
+    for (q = 0; q < 4; q++) {
+        __m256i r0 = v[4 * q + 0], r1 = v[4 * q + 1], r2 = v[4 * q + 2], r3 = v[4 * q + 3];
+
+        TRANSPOSE4_AVX2(r0, r1, r2, r3);
+        StoreRowPair_AVX2(apRows[0][q], apRows[4][q], &r0), StoreRowPair_AVX2(apRows[1][q], apRows[5][q], &r1);
+        StoreRowPair_AVX2(apRows[2][q], apRows[6][q], &r2), StoreRowPair_AVX2(apRows[3][q], apRows[7][q], &r3);
     }
 }
 
-Int invTransformMacroblock_YUV444_Center5(CWMImageStrCodec * pSC)
+/** v[0] = pixels 0..7, v[1] = pixels 8..15 of line iRow **/
+SIMD_TARGET static SIMD_INLINE Void LoadLine_AVX2(__m256i* v, const PixelI* pMB, size_t iRow)
 {
-    const OVERLAP olOverlap = pSC->WMISCP.olOverlap;
-    int i = 0;
+    v[0] = _mm256_inserti128_si256(_mm256_castsi128_si256(LoadQuad_SSE2(pMB, iRow, 0)), LoadQuad_SSE2(pMB, iRow, 1), 1);
+    v[1] = _mm256_inserti128_si256(_mm256_castsi128_si256(LoadQuad_SSE2(pMB, iRow, 2)), LoadQuad_SSE2(pMB, iRow, 3), 1);
+}
 
-    assert(0 < pSC->cRow && pSC->cRow < pSC->cmbHeight);
-    assert(0 < pSC->cColumn && pSC->cColumn < pSC->cmbWidth);
+SIMD_TARGET static SIMD_INLINE __m128i PackU8_AVX2(const __m256i* v)
+{
+    // packs operates per 128-bit half, so the pixel order has to be restored
+    const __m256i p = _mm256_permute4x64_epi64(_mm256_packs_epi32(v[0], v[1]), _MM_SHUFFLE(3, 1, 2, 0));
 
-    assert(0 == pSC->WMII.cPostProcStrength);
+    return _mm_packus_epi16(_mm256_castsi256_si128(p), _mm256_extracti128_si256(p, 1));
+}
 
-    assert(YUV_444 == pSC->m_param.cfColorFormat);
-    assert(3 == pSC->m_param.cNumChannels);
+SIMD_TARGET static SIMD_INLINE Void StoreU16_AVX2(U16* pDst, const __m256i* v)
+{
+    _mm256_storeu_si256((__m256i*)pDst, _mm256_permute4x64_epi64(_mm256_packus_epi32(v[0], v[1]), _MM_SHUFFLE(3, 1, 2, 0)));
+}
 
-    assert(pSC->m_Dparam->bDecodeFullWidth);
-    assert(1 == pSC->m_Dparam->cThumbnailScale);
+SIMD_TARGET static SIMD_INLINE Void StoreRGB24_AVX2(U8* pDst, const __m128i* pColor)
+{
+    const __m128i c0 = pColor[0], c1 = pColor[1], c2 = pColor[2];
+    const __m128i m00 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+    const __m128i m01 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+    const __m128i m02 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+    const __m128i m10 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+    const __m128i m11 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+    const __m128i m12 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+    const __m128i m20 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+    const __m128i m21 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+    const __m128i m22 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+
+    _mm_storeu_si128((__m128i*)(pDst + 0), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m00), _mm_shuffle_epi8(c1, m01)), _mm_shuffle_epi8(c2, m02)));
+    _mm_storeu_si128((__m128i*)(pDst + 16), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m10), _mm_shuffle_epi8(c1, m11)), _mm_shuffle_epi8(c2, m12)));
+    _mm_storeu_si128((__m128i*)(pDst + 32), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, m20), _mm_shuffle_epi8(c1, m21)), _mm_shuffle_epi8(c2, m22)));
+}
 
-    for (i = 0; i < 3; ++i)
-    {
-        PixelI* const p0 = pSC->p0MBbuffer[i];
-        PixelI* const p1 = pSC->p1MBbuffer[i];
-
-        //================================
-        // second level inverse transform
-        strIDCT4x4Stage2(p1);
-        if (pSC->m_param.bScaledArith) {
-            strNormalizeDec(p1, (i != 0));
-        }
+#include "strdec_x86_template.h"
 
-        //================================
-        // second level inverse overlap
-        if (OL_TWO <= olOverlap)
-        {
-            strPost4x4Stage2Split_alternate(p0, p1);
-        }
+static Int outputMBRow_Gray8_AVX2(CWMImageStrCodec* pSC) { return outputMBRow_OPT(pSC, OF_GRAY8, outputLine_Gray8_AVX2); }
+static Int outputMBRow_Gray16_AVX2(CWMImageStrCodec* pSC) { return outputMBRow_OPT(pSC, OF_GRAY16, outputLine_Gray16_AVX2); }
+static Int outputMBRow_RGB24_AVX2(CWMImageStrCodec* pSC) { return outputMBRow_OPT(pSC, OF_RGB24, outputLine_RGB24_AVX2); }
 
-        //================================
-        // first level inverse transform
-        strIDCT4x4Stage1_OPT5(p0, p1);
+#undef SIMD_V
+#undef SIMD_LANES
+#undef SIMD_FN
+#undef SIMD_TARGET
+#undef SIMD_ADD
+#undef SIMD_SUB
+#undef SIMD_SRAI
+#undef SIMD_SRA
+#undef SIMD_SLL
+#undef SIMD_SET1
+#undef SIMD_ZERO
 
-        //================================
-        // first level inverse overlap
-        if (OL_ONE <= olOverlap)
-        {
-            strPost4x4Stage1_alternate_ASM5(p0, p1);
+//================================================================
+// runtime selection
+//================================================================
+/** the highest instruction set supported by the processor (and the operating system) **/
+static SIMDLEVEL getSupportedSimdLevel(void)
+{
+#if defined(_MSC_VER)
+    int aInfo[4];
+
+    __cpuid(aInfo, 1);
+    if (0 == (aInfo[3] & (1 << 26)))
+        return SIMD_NONE;
+
+    // AVX2 requires OSXSAVE, AVX, the OS saving the YMM state, and the AVX2 bit of leaf 7
+    if ((aInfo[2] & (1 << 27)) && (aInfo[2] & (1 << 28)) && 6 == (_xgetbv(0) & 6)) {
+        __cpuid(aInfo, 0);
+        if (aInfo[0] >= 7) {
+            __cpuidex(aInfo, 7, 0);
+            if (aInfo[1] & (1 << 5))
+                return SIMD_AVX2;
         }
     }
 
-    return ICERR_OK;
-}
-#endif
+    return SIMD_SSE2;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SIMD_SSE2;
+    return SIMD_NONE;
 #endif
+}
+
+/** the color conversion is vectorized for Gray8, Gray16 and BGR24/RGB24 without alpha and orientation **/
+static Int getOutputFormat(const CWMImageStrCodec* pSC)
+{
+    const CWMImageInfo* pII = &pSC->WMII;
+
+    if (pSC->WMISCP.bYUVData || pSC->WMISCP.uAlphaMode > 0 || pSC->m_bUVResolutionChange || O_NONE != pII->oOrientation)
+        return -1;
+    if (BD_8 == pII->bdBitDepth && Y_ONLY == pII->cfColorFormat && Y_ONLY == pSC->m_param.cfColorFormat && 8 == pII->cBitsPerUnit)
+        return OF_GRAY8;
+    if (BD_16 == pII->bdBitDepth && Y_ONLY == pII->cfColorFormat && Y_ONLY == pSC->m_param.cfColorFormat && 16 == pII->cBitsPerUnit)
+        return OF_GRAY16;
+    if (BD_8 == pII->bdBitDepth && CF_RGB == pII->cfColorFormat && YUV_444 == pSC->m_param.cfColorFormat && 24 == pII->cBitsPerUnit)
+        return OF_RGB24;
+    return -1;
+}
+
+/** the center transform is vectorized for the (soft tiles) operators without post processing and with full resolution chroma **/
+static Bool canUseTransformCenter(const CWMImageStrCodec* pSC)
+{
+    const COLORFORMAT cf = pSC->m_param.cfColorFormat;
+
+    return pSC->m_param.cSubVersion == CODEC_SUBVERSION_NEWSCALING_SOFT_TILES &&
+        !pSC->WMISCP.bUseHardTileBoundaries &&
+        0 == pSC->WMII.cPostProcStrength &&
+        YUV_420 != cf && YUV_422 != cf;
+}
+#endif // WMP_OPT_CC_DEC || WMP_OPT_TRFM_DEC
 
 //================================================================
 void StrDecOpt(CWMImageStrCodec* pSC)
 {
-#if defined(WMP_OPT_SSE2)
-    if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
-    {
-        CWMImageInfo* pII = &pSC->WMII;
-        // CWMIStrCodecParam* pSCP = &pSC->WMISCP;
-
-        g_const_d0 = _mm_setzero_si128();
-        g_const_d3 = _mm_set1_epi32(3);
-        g_const_d1 = _mm_set_epi32(1, 1, 1, 1);
-        g_const_d4 = _mm_set_epi32(4, 4, 4, 4);
-
-        g_const_d0x80 = _mm_set_epi32(0x80, 0x80, 0x80, 0x80);
-        g_const_w0x80 = _mm_set_epi16(0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80);
-        g_const_b0x80 = _mm_set_epi8(0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80);
-
-        if (pSC->WMII.fPaddedUserBuffer &&
-            //pSC->m_Dparam->bDecodeFullFrame &&
-            //((pII->cWidth & 0xf) == 0) &&
-            //(((int) pSC->WMIBI.pv & 0xf) == 0) &&
-            BD_8 == pII->bdBitDepth &&
-            CF_RGB == pII->cfColorFormat &&
-            24 == pII->cBitsPerUnit &&
-            pII->bRGB &&
-            O_NONE == pII->oOrientation &&
-            YUV_444 == pSC->m_param.cfColorFormat &&
-            pSC->p1MBbuffer[1] - pSC->p1MBbuffer[0] == pSC->p1MBbuffer[2] - pSC->p1MBbuffer[1] &&
-            pSC->m_Dparam->bDecodeFullFrame &&
-            1)
-        {
+#if defined(WMP_OPT_CC_DEC) || defined(WMP_OPT_TRFM_DEC)
+    const SIMDLEVEL slSupported = getSupportedSimdLevel();
+    SIMDLEVEL sl = pSC->WMII.slSimdLevel;
+
+    if (SIMD_AUTO == sl || sl > slSupported)
+        sl = slSupported;
+    if (sl < SIMD_SSE2)
+        return;
+
 #if defined(WMP_OPT_CC_DEC)
-            if (pSC->m_param.bScaledArith || pSC->WMISCP.olOverlap != OL_NONE)
-            {
-                pSC->Load = outputMBRow_RGB24_Lossy_3;
-            }
-            else
-            {
-                pSC->Load = outputMBRow_RGB24_Lossless_1;
-            }
+    switch (getOutputFormat(pSC)) {
+    case OF_GRAY8:
+        pSC->Load = (SIMD_AVX2 == sl ? outputMBRow_Gray8_AVX2 : outputMBRow_Gray8_SSE2);
+        break;
+    case OF_GRAY16:
+        pSC->Load = (SIMD_AVX2 == sl ? outputMBRow_Gray16_AVX2 : outputMBRow_Gray16_SSE2);
+        break;
+    case OF_RGB24:
+        pSC->Load = (SIMD_AVX2 == sl ? outputMBRow_RGB24_AVX2 : outputMBRow_RGB24_SSE2);
+        break;
+    }
 #endif // WMP_OPT_CC_DEC
-        }
 
-        if (YUV_444 == pSC->m_param.cfColorFormat &&
-            pSC->p1MBbuffer[1] - pSC->p1MBbuffer[0] == pSC->p1MBbuffer[2] - pSC->p1MBbuffer[1] &&
-            pSC->m_Dparam->bDecodeFullWidth &&
-            pSC->m_param.cSubVersion == CODEC_SUBVERSION_NEWSCALING_SOFT_TILES &&
-            1 == pSC->m_Dparam->cThumbnailScale)
-        {
 #if defined(WMP_OPT_TRFM_DEC)
-            pSC->TransformCenter = invTransformMacroblock_YUV444_Center5;
-#endif
-        }
-
+    if (canUseTransformCenter(pSC)) {
+        pSC->TransformCenter = (SIMD_AVX2 == sl ? invTransformMacroblock_Center_AVX2 : invTransformMacroblock_Center_SSE2);
     }
+#endif // WMP_OPT_TRFM_DEC
 #else
     UNREFERENCED_PARAMETER( pSC );
-#endif    
+#endif
 }
-
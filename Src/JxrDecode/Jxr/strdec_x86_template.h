@@ -0,0 +1,348 @@
+//*@@@+++@@@@******************************************************************
+//
+// Copyright  Microsoft Corp.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//  Redistributions of source code must retain the above copyright notice,
+//   this list of conditions and the following disclaimer.
+//  Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//*@@@---@@@@******************************************************************
+
+/*************************************************************************
+  Vectorized decoder stages, included by strdec_x86.c once per instruction
+  set. The including file defines
+
+    SIMD_V               the vector type (SIMD_LANES x 32-bit integers)
+    SIMD_LANES           number of 32-bit lanes in SIMD_V
+    SIMD_FN(name)        decorates a function name with the instruction set
+    SIMD_TARGET          function attribute enabling the instruction set
+    SIMD_ADD/SUB         lane-wise 32-bit addition/subtraction
+    SIMD_SRAI            lane-wise arithmetic shift by an immediate count
+    SIMD_SRA/SLL         lane-wise shifts by a variable count
+    SIMD_INLINE          forces inlining
+    SIMD_SET1            broadcast a 32-bit value
+    SIMD_ZERO            all lanes zero
+
+  and the functions SIMD_FN(LoadTransposed), SIMD_FN(StoreTransposed),
+  SIMD_FN(LoadLine), SIMD_FN(PackU8), SIMD_FN(StoreU16) and
+  SIMD_FN(StoreRGB24) which deal with the register layout.
+
+  The arithmetic is a lane-parallel copy of the scalar operators in
+  strTransform.c / strInvTransform.c and of the color conversion in
+  strdec.c - each lane holds the same coefficient of a different block,
+  so the output is bit-exact with the scalar code.
+*************************************************************************/
+
+#define SIMD_MUL3(x) SIMD_ADD(SIMD_ADD(x, x), x)
+
+/** lanes per line of 16 pixels **/
+#define SIMD_LINE (16 / SIMD_LANES)
+
+//================================================================
+// 4x4 operators
+//================================================================
+/** strDCT2x2up (bUp == TRUE) and strDCT2x2dn (bUp == FALSE) **/
+SIMD_TARGET static SIMD_INLINE Void SIMD_FN(DCT2x2)(SIMD_V* pa, SIMD_V* pb, SIMD_V* pc, SIMD_V* pd, Bool bUp)
+{
+    const SIMD_V vRound = SIMD_SET1(bUp ? 1 : 0);
+    SIMD_V a = *pa, b = *pb, C = *pc, d = *pd, c, t;
+
+    a = SIMD_ADD(a, d);
+    b = SIMD_SUB(b, C);
+    t = SIMD_SRAI(SIMD_ADD(SIMD_SUB(a, b), vRound), 1);
+    c = SIMD_SUB(t, d);
+    d = SIMD_SUB(t, C);
+    a = SIMD_SUB(a, d);
+    b = SIMD_ADD(b, c);
+
+    *pa = a, *pb = b, *pc = c, *pd = d;
+}
+
+SIMD_TARGET static SIMD_INLINE Void SIMD_FN(IRotate2)(SIMD_V* pa, SIMD_V* pb)
+{
+    const SIMD_V v4 = SIMD_SET1(4);
+
+    *pa = SIMD_SUB(*pa, SIMD_SRAI(SIMD_ADD(SIMD_MUL3(*pb), v4), 3));
+    *pb = SIMD_ADD(*pb, SIMD_SRAI(SIMD_ADD(SIMD_MUL3(*pa), v4), 3));
+}
+
+SIMD_TARGET static SIMD_INLINE Void SIMD_FN(IRotate1)(SIMD_V* pa, SIMD_V* pb)
+{
+    const SIMD_V v1 = SIMD_SET1(1);
+
+    *pa = SIMD_SUB(*pa, SIMD_SRAI(SIMD_ADD(*pb, v1), 1));
+    *pb = SIMD_ADD(*pb, SIMD_SRAI(SIMD_ADD(*pa, v1), 1));
+}
+
+SIMD_TARGET static SIMD_INLINE Void SIMD_FN(InvOdd)(SIMD_V* pa, SIMD_V* pb, SIMD_V* pc, SIMD_V* pd)
+{
+    const SIMD_V v1 = SIMD_SET1(1);
+    SIMD_V a = *pa, b = *pb, c = *pc, d = *pd;
+
+    /** butterflies **/
+    b = SIMD_ADD(b, d);
+    a = SIMD_SUB(a, c);
+    d = SIMD_SUB(d, SIMD_SRAI(b, 1));
+    c = SIMD_ADD(c, SIMD_SRAI(SIMD_ADD(a, v1), 1));
+
+    /** rotate pi/8 **/
+    SIMD_FN(IRotate2)(&a, &b);
+    SIMD_FN(IRotate2)(&c, &d);
+
+    /** butterflies **/
+    c = SIMD_SUB(c, SIMD_SRAI(SIMD_ADD(b, v1), 1));
+    d = SIMD_SUB(SIMD_SRAI(SIMD_ADD(a, v1), 1), d);
+    b = SIMD_ADD(b, c);
+    a = SIMD_SUB(a, d);
+
+    *pa = a, *pb = b, *pc = c, *pd = d;
+}
+
+/** invOddOdd (bPost == FALSE) and invOddOddPost (bPost == TRUE) **/
+SIMD_TARGET static SIMD_INLINE Void SIMD_FN(InvOddOdd)(SIMD_V* pa, SIMD_V* pb, SIMD_V* pc, SIMD_V* pd, Bool bPost)
+{
+    const SIMD_V vRound1 = SIMD_SET1(bPost ? 6 : 3), vRound2 = SIMD_SET1(bPost ? 2 : 3), v4 = SIMD_SET1(4);
+    SIMD_V a = *pa, b = *pb, c = *pc, d = *pd, t1, t2;
+
+    /** butterflies **/
+    d = SIMD_ADD(d, a);
+    c = SIMD_SUB(c, b);
+    a = SIMD_SUB(a, t1 = SIMD_SRAI(d, 1));
+    b = SIMD_ADD(b, t2 = SIMD_SRAI(c, 1));
+
+    /** rotate pi/4 **/
+    a = SIMD_SUB(a, SIMD_SRAI(SIMD_ADD(SIMD_MUL3(b), vRound1), 3));
+    b = SIMD_ADD(b, SIMD_SRAI(SIMD_ADD(SIMD_MUL3(a), vRound2), 2));
+    a = SIMD_SUB(a, SIMD_SRAI(SIMD_ADD(SIMD_MUL3(b), v4), 3));
+
+    /** butterflies **/
+    b = SIMD_SUB(b, t2);
+    a = SIMD_ADD(a, t1);
+    c = SIMD_ADD(c, b);
+    d = SIMD_SUB(d, a);
+
+    if (bPost) {
+        *pa = a, *pb = b, *pc = c, *pd = d;
+    }
+    else {
+        /** sign flips **/
+        *pa = a, *pb = SIMD_SUB(SIMD_ZERO, b), *pc = SIMD_SUB(SIMD_ZERO, c), *pd = d;
+    }
+}
+
+SIMD_TARGET static SIMD_INLINE Void SIMD_FN(HSTdec1_alternate)(SIMD_V* pa, SIMD_V* pd)
+{
+    SIMD_V a = *pa, d = *pd;
+
+    a = SIMD_ADD(a, d);
+    d = SIMD_SUB(SIMD_SRAI(a, 1), d);
+    a = SIMD_ADD(a, SIMD_SRAI(SIMD_MUL3(d), 3));
+    d = SIMD_ADD(d, SIMD_SRAI(SIMD_MUL3(a), 4));
+    d = SIMD_ADD(d, SIMD_SRAI(a, 7));
+    d = SIMD_SUB(d, SIMD_SRAI(a, 10));
+
+    *pa = a, *pd = d;
+}
+
+SIMD_TARGET static SIMD_INLINE Void SIMD_FN(HSTdec)(SIMD_V* pa, SIMD_V* pb, SIMD_V* pc, SIMD_V* pd)
+{
+    SIMD_V a = *pa, b = *pb, c = *pc, d = *pd;
+
+    b = SIMD_SUB(b, c);
+    a = SIMD_ADD(a, SIMD_SRAI(SIMD_ADD(SIMD_MUL3(d), SIMD_SET1(4)), 3));
+    d = SIMD_SUB(d, SIMD_SRAI(b, 1));
+    c = SIMD_SUB(SIMD_SRAI(SIMD_SUB(a, b), 1), c);
+
+    *pc = d, *pd = c;
+    *pa = SIMD_SUB(a, c), *pb = SIMD_ADD(b, d);
+}
+
+/** strIDCT4x4Stage1, v[i] is coefficient i of the blocks **/
+SIMD_TARGET static SIMD_INLINE Void SIMD_FN(IDCT4x4Stage1)(SIMD_V* v)
+{
+    int i;
+
+    SIMD_FN(DCT2x2)(v + 0, v + 1, v + 2, v + 3, TRUE);
+    SIMD_FN(InvOdd)(v + 5, v + 4, v + 7, v + 6);
+    SIMD_FN(InvOdd)(v + 10, v + 8, v + 11, v + 9);
+    SIMD_FN(InvOddOdd)(v + 15, v + 14, v + 13, v + 12, FALSE);
+
+    for (i = 0; i < 4; i++) {
+        SIMD_FN(DCT2x2)(v + i, v + i + 4, v + i + 8, v + i + 12, FALSE);
+    }
+}
+
+/** strPost4x4Stage1Split_alternate, v[4 * r + k] is element k of window row r (p0 + 12, p0 + 72, p1 + 4, p1 + 64) **/
+SIMD_TARGET static SIMD_INLINE Void SIMD_FN(Post4x4Stage1)(SIMD_V* v)
+{
+    int i;
+
+    /** butterfly **/
+    for (i = 0; i < 4; i++) {
+        SIMD_FN(DCT2x2)(v + i, v + i + 4, v + i + 8, v + i + 12, FALSE);
+    }
+
+    /** bottom right corner: -pi/8 rotation => -pi/8 rotation **/
+    SIMD_FN(InvOddOdd)(v + 12, v + 13, v + 14, v + 15, TRUE);
+
+    /** anti diagonal corners: rotation by -pi/8 **/
+    SIMD_FN(IRotate1)(v + 10, v + 11);
+    SIMD_FN(IRotate1)(v + 8, v + 9);
+    SIMD_FN(IRotate1)(v + 5, v + 7);
+    SIMD_FN(IRotate1)(v + 4, v + 6);
+
+    /** butterfly **/
+    for (i = 0; i < 4; i++) {
+        SIMD_FN(HSTdec1_alternate)(v + i, v + i + 12);
+    }
+    for (i = 0; i < 4; i++) {
+        SIMD_FN(HSTdec)(v + i, v + i + 4, v + i + 8, v + i + 12);
+    }
+}
+
+/*************************************************************************
+  invTransformMacroblock_alteredOperators_hard for a macroblock in the
+  center of the image (no tile boundaries, no post processing)
+*************************************************************************/
+SIMD_TARGET static Int SIMD_FN(invTransformMacroblock_Center)(CWMImageStrCodec* pSC)
+{
+    const OVERLAP olOverlap = pSC->WMISCP.olOverlap;
+    const size_t tScale = pSC->m_Dparam->cThumbnailScale;
+    PixelI* apBlock[16][4];
+    PixelI* apWindow[16][4];
+    SIMD_V v[16];
+    size_t i, k;
+
+    assert(0 < pSC->cRow && pSC->cRow < pSC->cmbHeight);
+    assert(0 < pSC->cColumn && pSC->cColumn < pSC->cmbWidth);
+    assert(0 == pSC->WMII.cPostProcStrength && !pSC->WMISCP.bUseHardTileBoundaries);
+
+    pSC->bVertTileBoundary = pSC->bHoriTileBoundary = FALSE;
+    pSC->bOneMBLeftVertTB = pSC->bOneMBRightVertTB = FALSE;
+    pSC->mbX = pSC->cColumn, pSC->mbY = pSC->cRow;
+
+    for (i = 0; i < pSC->m_param.cNumChannels && tScale < 16; ++i)
+    {
+        PixelI* const p0 = pSC->p0MBbuffer[i];
+        PixelI* const p1 = pSC->p1MBbuffer[i];
+
+        //================================
+        // second level inverse transform
+        strIDCT4x4Stage2(p1);
+        if (pSC->m_param.bScaledArith) {
+            strNormalizeDec(p1, (i != 0));
+        }
+
+        //================================
+        // second level inverse overlap
+        if (OL_TWO == olOverlap) {
+            strPost4x4Stage2Split_alternate(p0, p1);
+        }
+
+        if (tScale >= 4) // bypass first level transform for 4:1 and smaller thumbnail
+            continue;
+
+        //================================
+        // first level inverse transform
+        getBlockRows(p0, p1, apBlock);
+        for (k = 0; k < 16; k += SIMD_LANES) {
+            SIMD_FN(LoadTransposed)(v, apBlock + k);
+            SIMD_FN(IDCT4x4Stage1)(v);
+            SIMD_FN(StoreTransposed)(v, apBlock + k);
+        }
+
+        //================================
+        // first level inverse overlap
+        if (OL_NONE != olOverlap) {
+            getOverlapRows(p0, p1, apWindow);
+            for (k = 0; k < 16; k += SIMD_LANES) {
+                SIMD_FN(LoadTransposed)(v, apWindow + k);
+                SIMD_FN(Post4x4Stage1)(v);
+                SIMD_FN(StoreTransposed)(v, apWindow + k);
+            }
+        }
+    }
+
+    return ICERR_OK;
+}
+
+//================================================================
+// color conversion of 16 pixels of a macroblock line
+//================================================================
+SIMD_TARGET static Void SIMD_FN(outputLine_Gray8)(const OUTPUTPARAMS* pParams, const PixelI* const* ppMB, size_t iRow, U8* pDst)
+{
+    const SIMD_V vBias = SIMD_SET1(pParams->iBias);
+    SIMD_V y[SIMD_LINE];
+    size_t k;
+
+    SIMD_FN(LoadLine)(y, ppMB[0], iRow);
+    for (k = 0; k < SIMD_LINE; k++) {
+        y[k] = SIMD_SRA(SIMD_ADD(y[k], vBias), pParams->iShift);
+    }
+
+    _mm_storeu_si128((__m128i*)pDst, SIMD_FN(PackU8)(y));
+}
+
+SIMD_TARGET static Void SIMD_FN(outputLine_Gray16)(const OUTPUTPARAMS* pParams, const PixelI* const* ppMB, size_t iRow, U8* pDst)
+{
+    const SIMD_V vBias = SIMD_SET1(pParams->iBias);
+    SIMD_V y[SIMD_LINE];
+    size_t k;
+
+    SIMD_FN(LoadLine)(y, ppMB[0], iRow);
+    for (k = 0; k < SIMD_LINE; k++) {
+        y[k] = SIMD_SLL(SIMD_SRA(SIMD_ADD(y[k], vBias), pParams->iShift), pParams->nLen);
+    }
+
+    SIMD_FN(StoreU16)((U16*)pDst, y);
+}
+
+SIMD_TARGET static Void SIMD_FN(outputLine_RGB24)(const OUTPUTPARAMS* pParams, const PixelI* const* ppMB, size_t iRow, U8* pDst)
+{
+    const SIMD_V vBias = SIMD_SET1(pParams->iBias), v1 = SIMD_SET1(1);
+    SIMD_V y[SIMD_LINE], u[SIMD_LINE], w[SIMD_LINE];
+    __m128i aColor[3];
+    size_t k;
+
+    SIMD_FN(LoadLine)(y, ppMB[0], iRow);
+    SIMD_FN(LoadLine)(u, ppMB[1], iRow);
+    SIMD_FN(LoadLine)(w, ppMB[2], iRow);
+    for (k = 0; k < SIMD_LINE; k++) {
+        SIMD_V g = SIMD_ADD(y[k], vBias), r = SIMD_SUB(SIMD_ZERO, u[k]), b = w[k];
+
+        /** _ICC(r, g, b) **/
+        g = SIMD_SUB(g, SIMD_SRAI(r, 1));
+        r = SIMD_SUB(r, SIMD_SUB(SIMD_SRAI(SIMD_ADD(b, v1), 1), g));
+        b = SIMD_ADD(b, r);
+
+        y[k] = SIMD_SRA(g, pParams->iShift);
+        u[k] = SIMD_SRA(r, pParams->iShift);
+        w[k] = SIMD_SRA(b, pParams->iShift);
+    }
+
+    aColor[pParams->bRGB ? 0 : 2] = SIMD_FN(PackU8)(u);
+    aColor[1] = SIMD_FN(PackU8)(y);
+    aColor[pParams->bRGB ? 2 : 0] = SIMD_FN(PackU8)(w);
+    SIMD_FN(StoreRGB24)(pDst, aColor);
+}
+
+#undef SIMD_LINE
+#undef SIMD_MUL3
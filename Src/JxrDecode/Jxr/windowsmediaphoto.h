@@ -181,6 +181,14 @@ typedef enum SUBBAND {
     /* add new SUBBAND here */ SB_MAX
 } SUBBAND;
 
+typedef enum SIMDLEVEL {
+    SIMD_AUTO = 0,      // best instruction set supported by the processor
+    SIMD_NONE,          // portable C code only
+    SIMD_SSE2,          // up to SSE2
+    SIMD_AVX2,          // up to AVX2
+    /* add new SIMDLEVEL here */ SIMD_MAX
+} SIMDLEVEL;
+
 enum { RAW = 0, BMP = 1, PPM = 2, TIF = 3, HDR = 4, IYUV = 5, YUV422 = 6, YUV444 = 7};
 
 typedef enum {ERROR_FAIL = -1, SUCCESS_DONE, PRE_READ_HDR, PRE_SETUP, PRE_DECODE, POST_READ_HDR } WMIDecoderStatus;
@@ -353,6 +361,9 @@ typedef struct tagCWMImageInfo {
 
     // user buffer is always padded to whole MB
     Bool fPaddedUserBuffer;
+
+    // highest instruction set the decoder may use for its optimized stages
+    SIMDLEVEL slSimdLevel;
 } CWMImageInfo;
 
 typedef struct tagCWMIStrCodecParam {
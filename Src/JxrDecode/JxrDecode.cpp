@@ -23,6 +23,7 @@
 #include <stdexcept> 
 #include <sstream>
 #include <memory>
+#include <algorithm>
 #include "JxrDecode.h"
 #include "Jxr/JXRTest.h"
 #include "Jxr/JXRTestWrapper.h"
@@ -165,10 +166,29 @@ static const PKPixelFormatGUID* PkPixelFormatFromPixelFormat(JxrDecode::PixelFor
 	throw std::invalid_argument("unknown pixfmt");
 }
 
+/// The state of a codec-handle. The factories are stateless, the intermediate buffer is kept in order to be
+/// re-used by subsequent calls - so a handle must not be used by more than one thread at a time.
 struct CodecHandle
 {
 	PKFactory* pFactory;
 	PKCodecFactory* pCodecFactory;
+	U8* pIntermediateBuffer;
+	size_t intermediateBufferSize;
+
+	/// Gets an (aligned) buffer of at least the specified size - the buffer is only re-allocated if it is too small.
+	U8* GetIntermediateBuffer(size_t size)
+	{
+		if (size > this->intermediateBufferSize)
+		{
+			PKFreeAligned((void**)&this->pIntermediateBuffer);
+			this->intermediateBufferSize = 0;
+			ERR err = PKAllocAligned((void**)&this->pIntermediateBuffer, size, 128);
+			if (Failed(err)) { ThrowError("PKAllocAligned failed", err); }
+			this->intermediateBufferSize = size;
+		}
+
+		return this->pIntermediateBuffer;
+	}
 };
 
 JxrDecode::codecHandle JxrDecode::Initialize()
@@ -182,7 +202,7 @@ JxrDecode::codecHandle JxrDecode::Initialize()
 	err = PKCreateCodecFactory(&pCodecFactory, WMP_SDK_VERSION);
 	if (Failed(err)) { ThrowError("PKCreateCodecFactory failed", err); }
 	std::unique_ptr<PKCodecFactory, void(*)(PKCodecFactory*)> upCodecFactory(pCodecFactory, [](PKCodecFactory* p)->void {p->Release(&p); });
-	CodecHandle* ch = new CodecHandle{ upFactory.release(), upCodecFactory.release() };
+	CodecHandle* ch = new CodecHandle{ upFactory.release(), upCodecFactory.release(), nullptr, 0 };
 	return reinterpret_cast<codecHandle*>(ch);
 }
 
@@ -191,6 +211,7 @@ void JxrDecode::Destroy(codecHandle h)
 	CodecHandle* ch = static_cast<CodecHandle*>(h);
 	ch->pFactory->Release(&ch->pFactory);
 	ch->pCodecFactory->Release(&ch->pCodecFactory);
+	PKFreeAligned((void**)&ch->pIntermediateBuffer);
 	delete ch;
 }
 
@@ -207,7 +228,14 @@ static void DeliverData(
 	deliver->operator()(PixelFormatFromPkPixelFormat(pixeltype), width, height, cLines, ptrData, stride);
 }
 
-void JxrDecode::Decode(codecHandle h, const WMPDECAPPARGS* decArgs, const void* ptrData, size_t size, std::function<JxrDecode::PixelFormat(const JxrDecode::PixelFormat)> selectDestPixFmt, std::function<void(PixelFormat pixFmt, std::uint32_t  width, std::uint32_t  height, std::uint32_t linesCount, const void* ptrData, std::uint32_t stride)>  deliverData)
+/// Sets up the decoder and the format-converter, and then calls "write" which has to retrieve the pixels from the format-converter.
+static void DecodeInternal(
+	codecHandle h,
+	const WMPDECAPPARGS* decArgs,
+	const void* ptrData,
+	size_t size,
+	const std::function<JxrDecode::PixelFormat(const JxrDecode::PixelFormat)>& selectDestPixFmt,
+	const std::function<void(PKImageDecode* pDecoder, PKFormatConverter* pConverter, const PKPixelFormatGUID& pixFmt, PKRect& rect)>& write)
 {
 	CodecHandle* ch = static_cast<CodecHandle*>(h);
 	WMPStream* pStream;
@@ -263,6 +291,12 @@ void JxrDecode::Decode(codecHandle h, const WMPDECAPPARGS* decArgs, const void*
 
 	PixelFormatLookup(&PI, LOOKUP_FORWARD);
 
+	if (decArgs->bBgr48 == true && IsEqualGUID(args_guidPixFormat, GUID_PKPixelFormat48bppRGB))
+	{
+		// the decoder writes the blue channel first if "bRGB" is false (which is otherwise only supported for 8 bits per channel)
+		upDecoder->WMP.wmiI.bRGB = 0;
+	}
+
 	std::uint8_t args_uAlphaMode = decArgs->uAlphaMode;
 	if (255 == args_uAlphaMode)//user didn't set
 	{
@@ -288,19 +322,23 @@ void JxrDecode::Decode(codecHandle h, const WMPDECAPPARGS* decArgs, const void*
 	upDecoder->WMP.wmiI.cThumbnailWidth = upDecoder->WMP.wmiI.cWidth;
 	upDecoder->WMP.wmiI.cThumbnailHeight = upDecoder->WMP.wmiI.cHeight;
 	upDecoder->WMP.wmiI.bSkipFlexbits = FALSE;
-	/*if (args.tThumbnailFactor > 0 && args.tThumbnailFactor != SKIPFLEXBITS) {
-		size_t tSize = ((size_t)1 << args.tThumbnailFactor);
+	if (decArgs->tThumbnailFactor > 0)
+	{
+		// the output is written in lines of 16/tSize pixels per macro-block row, so we cannot go beyond 16
+		if (decArgs->tThumbnailFactor > 4)
+		{
+			throw std::invalid_argument("The thumbnail factor must not be greater than 4.");
+		}
 
-		pDecoder->WMP.wmiI.cThumbnailWidth = (pDecoder->WMP.wmiI.cWidth + tSize - 1) / tSize;
-		pDecoder->WMP.wmiI.cThumbnailHeight = (pDecoder->WMP.wmiI.cHeight + tSize - 1) / tSize;
+		size_t tSize = ((size_t)1 << decArgs->tThumbnailFactor);
 
-		if (pDecoder->WMP.wmiI.cfColorFormat == YUV_420 || pDecoder->WMP.wmiI.cfColorFormat == YUV_422) { // unsupported thumbnail format
-			pDecoder->WMP.wmiI.cfColorFormat = YUV_444;
+		upDecoder->WMP.wmiI.cThumbnailWidth = (upDecoder->WMP.wmiI.cWidth + tSize - 1) / tSize;
+		upDecoder->WMP.wmiI.cThumbnailHeight = (upDecoder->WMP.wmiI.cHeight + tSize - 1) / tSize;
+
+		if (upDecoder->WMP.wmiI.cfColorFormat == YUV_420 || upDecoder->WMP.wmiI.cfColorFormat == YUV_422) { // unsupported thumbnail format
+			upDecoder->WMP.wmiI.cfColorFormat = YUV_444;
 		}
 	}
-	else if (args.tThumbnailFactor == SKIPFLEXBITS) {
-		pDecoder->WMP.wmiI.bSkipFlexbits = TRUE;
-	}*/
 
 	if (decArgs->rWidth == 0 || decArgs->rHeight == 0)
 	{ // no region decode
@@ -311,6 +349,11 @@ void JxrDecode::Decode(codecHandle h, const WMPDECAPPARGS* decArgs, const void*
 	}
 	else
 	{
+		if (decArgs->rLeftX + decArgs->rWidth > upDecoder->WMP.wmiI.cThumbnailWidth || decArgs->rTopY + decArgs->rHeight > upDecoder->WMP.wmiI.cThumbnailHeight)
+		{
+			throw std::invalid_argument("The region to decode must lie within the image.");
+		}
+
 		upDecoder->WMP.wmiI.cROILeftX = decArgs->rLeftX;
 		upDecoder->WMP.wmiI.cROITopY = decArgs->rTopY;
 		upDecoder->WMP.wmiI.cROIWidth = decArgs->rWidth;
@@ -321,6 +364,8 @@ void JxrDecode::Decode(codecHandle h, const WMPDECAPPARGS* decArgs, const void*
 
 	upDecoder->WMP.wmiI.cPostProcStrength = decArgs->cPostProcStrength;
 
+	upDecoder->WMP.wmiI.slSimdLevel = (SIMDLEVEL)(std::underlying_type<SimdLevel>::type)decArgs->simdLevel;
+
 	upDecoder->WMP.wmiSCP.bVerbose = 0;// args.bVerbose;
 
 	U32 cFrame;
@@ -331,7 +376,6 @@ void JxrDecode::Decode(codecHandle h, const WMPDECAPPARGS* decArgs, const void*
 		throw std::logic_error("Not expecting to find more than one image here.");
 	}
 
-	Float rX = 0, rY = 0;
 	PKRect rect = { 0, 0, 0, 0 };
 
 	//================================
@@ -343,21 +387,6 @@ void JxrDecode::Decode(codecHandle h, const WMPDECAPPARGS* decArgs, const void*
 	err = upConverter->Initialize(upConverter.get(), upDecoder.get(), nullptr/*pExt*/, args_guidPixFormat);
 	if (Failed(err)) { ThrowError("Initialize failed", err); }
 
-	PKImageEncode* pEncoder;
-	err = WmpDecAppCreateEncoderFromExt(ch->pCodecFactory, "wrapper", &pEncoder);
-	if (Failed(err)) { ThrowError("WmpDecAppCreateEncoderFromExt failed", err); }
-	std::unique_ptr<PKImageEncode, void(*)(PKImageEncode*)> upEncoder(pEncoder, [](PKImageEncode* p)->void {p->Release(&p); });
-
-	struct tagJxrTestWrapperInitializeInfo wrapperInfo;
-	wrapperInfo.userParamPutData = &deliverData;
-	wrapperInfo.pfnPutData = DeliverData;
-
-	err = upEncoder->Initialize(upEncoder.get(), nullptr, &wrapperInfo, sizeof(wrapperInfo));
-	if (Failed(err)) { ThrowError("Encoder::Initialize failed", err); }
-	err = upEncoder->SetPixelFormat(upEncoder.get(), args_guidPixFormat);
-	if (Failed(err)) { ThrowError("SetPixelFormat failed", err); }
-	upEncoder->WMP.wmiSCP.bBlackWhite = upDecoder->WMP.wmiSCP.bBlackWhite;
-
 	rect.Width = (I32)(upDecoder->WMP.wmiI.cROIWidth);
 	rect.Height = (I32)(upDecoder->WMP.wmiI.cROIHeight);
 
@@ -368,31 +397,106 @@ void JxrDecode::Decode(codecHandle h, const WMPDECAPPARGS* decArgs, const void*
 		rect.Height = bah;
 	}
 
-	err = upEncoder->SetSize(upEncoder.get(), rect.Width, rect.Height);
-	if (Failed(err)) { ThrowError("SetSize failed", err); }
-	err = upDecoder->GetResolution(upDecoder.get(), &rX, &rY);
-	if (Failed(err)) { ThrowError("GetResolution failed", err); }
+	write(upDecoder.get(), upConverter.get(), args_guidPixFormat, rect);
+
+	upDecoder->SelectFrame(upDecoder.get(), 1);
+	if (Failed(err)) { ThrowError("SelectFrame failed", err); }
+}
 
-	if ((std::underlying_type<Orientation>::type)decArgs->oOrientation > (std::underlying_type<Orientation>::type)O_FLIPVH)
+/// Gets the number of bytes of a line with the specified width in the specified pixel format.
+static U32 GetLineSize(const PKPixelFormatGUID& pixFmt, U32 width)
+{
+	PKPixelInfo pi;
+	pi.pGUIDPixFmt = &pixFmt;
+	PixelFormatLookup(&pi, LOOKUP_FORWARD);
+	U32 lineSize = (BD_1 == pi.bdBitDepth ? ((pi.cbitUnit * width + 7) >> 3) : (((pi.cbitUnit + 7) >> 3) * width));
+	if (IsEqualGUID(pixFmt, GUID_PKPixelFormat12bppYUV420) || IsEqualGUID(pixFmt, GUID_PKPixelFormat16bppYUV422))
 	{
-		upEncoder->SetResolution(upEncoder.get(), rY, rX);
+		lineSize >>= 1;
 	}
-	else
+
+	return lineSize;
+}
+
+void JxrDecode::Decode(codecHandle h, const WMPDECAPPARGS* decArgs, const void* ptrData, size_t size, std::function<JxrDecode::PixelFormat(const JxrDecode::PixelFormat)> selectDestPixFmt, std::function<void(PixelFormat pixFmt, std::uint32_t  width, std::uint32_t  height, std::uint32_t linesCount, const void* ptrData, std::uint32_t stride)>  deliverData)
+{
+	CodecHandle* ch = static_cast<CodecHandle*>(h);
+	DecodeInternal(h, decArgs, ptrData, size, selectDestPixFmt,
+		[&](PKImageDecode* pDecoder, PKFormatConverter* pConverter, const PKPixelFormatGUID& pixFmt, PKRect& rect)->void
 	{
-		upEncoder->SetResolution(upEncoder.get(), rX, rY);
-	}
+		Float rX = 0, rY = 0;
+		PKImageEncode* pEncoder;
+		ERR err = WmpDecAppCreateEncoderFromExt(ch->pCodecFactory, "wrapper", &pEncoder);
+		if (Failed(err)) { ThrowError("WmpDecAppCreateEncoderFromExt failed", err); }
+		std::unique_ptr<PKImageEncode, void(*)(PKImageEncode*)> upEncoder(pEncoder, [](PKImageEncode* p)->void {p->Release(&p); });
+
+		struct tagJxrTestWrapperInitializeInfo wrapperInfo;
+		wrapperInfo.userParamPutData = &deliverData;
+		wrapperInfo.pfnPutData = DeliverData;
+
+		err = upEncoder->Initialize(upEncoder.get(), nullptr, &wrapperInfo, sizeof(wrapperInfo));
+		if (Failed(err)) { ThrowError("Encoder::Initialize failed", err); }
+		err = upEncoder->SetPixelFormat(upEncoder.get(), pixFmt);
+		if (Failed(err)) { ThrowError("SetPixelFormat failed", err); }
+		upEncoder->WMP.wmiSCP.bBlackWhite = pDecoder->WMP.wmiSCP.bBlackWhite;
+
+		err = upEncoder->SetSize(upEncoder.get(), rect.Width, rect.Height);
+		if (Failed(err)) { ThrowError("SetSize failed", err); }
+		err = pDecoder->GetResolution(pDecoder, &rX, &rY);
+		if (Failed(err)) { ThrowError("GetResolution failed", err); }
+
+		if ((std::underlying_type<Orientation>::type)decArgs->oOrientation > (std::underlying_type<Orientation>::type)O_FLIPVH)
+		{
+			upEncoder->SetResolution(upEncoder.get(), rY, rX);
+		}
+		else
+		{
+			upEncoder->SetResolution(upEncoder.get(), rX, rY);
+		}
 
-	//================================
-	upEncoder->WriteSource = PKImageEncode_Transcode;
-	err = upEncoder->WriteSource(upEncoder.get(), upConverter.get(), &rect);
-	if (Failed(err)) { ThrowError("WriteSource failed", err); }
+		//================================
+		upEncoder->WriteSource = PKImageEncode_Transcode;
+		err = upEncoder->WriteSource(upEncoder.get(), pConverter, &rect);
+		if (Failed(err)) { ThrowError("WriteSource failed", err); }
 
-	//================================
-	err = upEncoder->Terminate(upEncoder.get());
-	if (Failed(err)) { ThrowError("Release (encoder) failed", err); }
+		//================================
+		err = upEncoder->Terminate(upEncoder.get());
+		if (Failed(err)) { ThrowError("Release (encoder) failed", err); }
+	});
+}
 
-	upDecoder->SelectFrame(upDecoder.get(), 1);
-	if (Failed(err)) { ThrowError("SelectFrame failed", err); }
+void JxrDecode::DecodeInto(codecHandle h, const WMPDECAPPARGS* decArgs, const void* ptrData, size_t size, std::function<PixelFormat(PixelFormat)> selectDestPixFmt, std::function<void(PixelFormat pixFmt, std::uint32_t width, std::uint32_t height, void** ptrDestination, std::uint32_t* stride)> getDestination)
+{
+	CodecHandle* ch = static_cast<CodecHandle*>(h);
+	DecodeInternal(h, decArgs, ptrData, size, selectDestPixFmt,
+		[&](PKImageDecode* /*pDecoder*/, PKFormatConverter* pConverter, const PKPixelFormatGUID& pixFmt, PKRect& rect)->void
+	{
+		void* ptrDestination = nullptr;
+		std::uint32_t stride = 0;
+		getDestination(PixelFormatFromPkPixelFormat(pixFmt), rect.Width, rect.Height, &ptrDestination, &stride);
+
+		// the format-conversion is done in-place, so the lines must be large enough for the source-format as well
+		PKPixelFormatGUID pixFmtSource;
+		pConverter->GetSourcePixelFormat(pConverter, &pixFmtSource);
+		const U32 lineSize = GetLineSize(pixFmt, rect.Width);
+		const U32 requiredStride = (std::max)(GetLineSize(pixFmtSource, rect.Width), lineSize);
+		ERR err;
+		if (stride >= requiredStride)
+		{
+			err = pConverter->Copy(pConverter, &rect, static_cast<U8*>(ptrDestination), stride);
+			if (Failed(err)) { ThrowError("Copy failed", err); }
+		}
+		else
+		{
+			U8* pb = ch->GetIntermediateBuffer((size_t)requiredStride * rect.Height);
+			err = pConverter->Copy(pConverter, &rect, pb, requiredStride);
+			if (Failed(err)) { ThrowError("Copy failed", err); }
+			for (I32 y = 0; y < rect.Height; ++y)
+			{
+				memcpy(static_cast<U8*>(ptrDestination) + (size_t)y * stride, pb + (size_t)y * requiredStride, lineSize);
+			}
+		}
+	});
 }
 
 const char* JxrDecode::PixelFormatAsInformalString(PixelFormat pfmt)
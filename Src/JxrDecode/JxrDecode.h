@@ -92,6 +92,15 @@ namespace JxrDecode
 		/* add new SUBBAND here */ SB_MAX
 	};
 
+	enum class SimdLevel : std::uint8_t
+	{
+		Automatic = 0,      // best instruction set supported by the processor
+		None,               // portable C code only
+		SSE2,               // up to SSE2
+		AVX2,               // up to AVX2
+		/* add new SIMDLEVEL here */ Max
+	};
+
 	struct WMPDECAPPARGS
 	{
 		JxrDecode::PixelFormat pixFormat;
@@ -105,10 +114,12 @@ namespace JxrDecode
 		std::uint8_t cPostProcStrength;
 		JxrDecode::Orientation  oOrientation;
 		JxrDecode::Subband sbSubband;
-		/*	// thumbnail
-			size_t tThumbnailFactor;
 
-			// orientation
+		// thumbnail - if >0, then the image is decoded with its size reduced by a factor of 2^tThumbnailFactor (in both
+		// directions, the size is rounded up), and the region given above refers to the reduced image
+		size_t tThumbnailFactor;
+
+		/*	// orientation
 			ORIENTATION oOrientation;
 
 			// post processing
@@ -125,22 +136,36 @@ namespace JxrDecode
 		Bool bIgnoreOverlap;*/
 		bool bIgnoreOverlap;
 
+		// if true, then 48bppRGB is delivered with the channels in the order blue-green-red
+		bool bBgr48;
+
+		// the highest instruction set (on x86) which the decoder may use for the inverse transform and the color
+		// conversion - the result is identical for all levels
+		JxrDecode::SimdLevel simdLevel;
+
 		void Clear()
 		{
 			memset(this, 0, sizeof(*this));
 			this->pixFormat = JxrDecode::PixelFormat::dontCare;
 			//args->bVerbose = FALSE;
-			//args->tThumbnailFactor = 0;
+			this->tThumbnailFactor = 0;
 			this->oOrientation = Orientation::O_NONE;
 			this->cPostProcStrength = 0;
 			this->uAlphaMode = 255;
 			this->sbSubband = JxrDecode::Subband::SB_ALL;
+			this->simdLevel = JxrDecode::SimdLevel::Automatic;
 		}
 	};
 
 
+	/// A handle to a decoder context. A context holds the (stateless) factories and the buffers which are re-used
+	/// between the calls. A context must not be used by more than one thread at a time - in order to decode
+	/// concurrently, use one context for each thread.
 	typedef void* codecHandle;
 
+	/// Creates a new decoder context, which must be destroyed with "Destroy".
+	///
+	/// \return The codec-handle.
 	codecHandle Initialize();
 
 	void Decode(
@@ -151,6 +176,25 @@ namespace JxrDecode
 		std::function<PixelFormat(PixelFormat)> selectDestPixFmt,
 		std::function<void(PixelFormat pixFmt, std::uint32_t  width, std::uint32_t  height, std::uint32_t linesCount, const void* ptrData, std::uint32_t stride)> deliverData);
 
+	/// Decodes the specified data directly into a buffer provided by the caller. As soon as the pixel format
+	/// and the size of the image are known, the functor "getDestination" is called, which must give the buffer
+	/// (which must be large enough for "height" lines with the specified stride). If the stride is sufficiently
+	/// large, the decoder writes directly into this buffer, otherwise an intermediate buffer is used.
+	///
+	/// \param h				 The codec-handle.
+	/// \param decArgs		 The decoder arguments.
+	/// \param ptrData		 The compressed data.
+	/// \param size			 The size of the compressed data.
+	/// \param selectDestPixFmt Functor which selects the pixel format of the decoded image.
+	/// \param getDestination	 Functor which gives the destination buffer and its stride.
+	void DecodeInto(
+		codecHandle h,
+		const WMPDECAPPARGS* decArgs,
+		const void* ptrData,
+		size_t size,
+		std::function<PixelFormat(PixelFormat)> selectDestPixFmt,
+		std::function<void(PixelFormat pixFmt, std::uint32_t width, std::uint32_t height, void** ptrDestination, std::uint32_t* stride)> getDestination);
+
 	void Destroy(codecHandle h);
 
 }
\ No newline at end of file
@@ -29,7 +29,11 @@
 #include "../libCZI/splines.h"
 
 #include "../libCZI/bitmapData.h"
+#include "../libCZI/CreateBitmap.h"
 #include "../libCZI/stdAllocator.h"
 #include "../libCZI/BitmapOperations.h"
+#include "../libCZI/NNResizePlanCache.h"
+#include "../libCZI/ThreadPool.h"
+#include "../libCZI/ParallelTileLoader.h"
 
 #include "../libCZI/CziSubBlockDirectory.h"
\ No newline at end of file
@@ -0,0 +1,323 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#include "stdafx.h"
+#include "testCziData.h"
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <cmath>
+#if !defined(_WIN32)
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+static void WriteInt32(std::vector<std::uint8_t>& data, size_t offset, std::int32_t v)
+{
+	memcpy(&data[offset], &v, sizeof(v));
+}
+
+static void WriteInt64(std::vector<std::uint8_t>& data, size_t offset, std::int64_t v)
+{
+	memcpy(&data[offset], &v, sizeof(v));
+}
+
+static void WriteSegmentHeader(std::vector<std::uint8_t>& data, size_t offset, const char* id, std::int64_t allocatedSize, std::int64_t usedSize)
+{
+	memset(&data[offset], 0, 16);
+	memcpy(&data[offset], id, strlen(id));
+	WriteInt64(data, offset + 16, allocatedSize);
+	WriteInt64(data, offset + 24, usedSize);
+}
+
+static size_t AlignTo32(size_t size)
+{
+	return (size + 31) & ~(size_t)31;
+}
+
+struct DimensionEntry
+{
+	const char* dimension;
+	int start;
+	int size;
+	int storedSize;
+};
+
+static void WriteDirectoryEntryDV(std::vector<std::uint8_t>& data, size_t offset, std::int64_t filePosition, const DimensionEntry* dimensions, int dimensionCount, std::int32_t pixelType = 0 /*Gray8*/, std::int32_t compression = 0 /*Uncompressed*/)
+{
+	data[offset] = 'D';
+	data[offset + 1] = 'V';
+	WriteInt32(data, offset + 2, pixelType);
+	WriteInt64(data, offset + 6, filePosition);
+	WriteInt32(data, offset + 14, 0);	// FilePart
+	WriteInt32(data, offset + 18, compression);
+	WriteInt32(data, offset + 28, dimensionCount);
+	for (int i = 0; i < dimensionCount; ++i)
+	{
+		size_t o = offset + 32 + i * 20;
+		memcpy(&data[o], dimensions[i].dimension, strlen(dimensions[i].dimension));
+		WriteInt32(data, o + 4, dimensions[i].start);
+		WriteInt32(data, o + 8, dimensions[i].size);
+		WriteInt32(data, o + 16, dimensions[i].storedSize);
+	}
+}
+
+/*static*/const std::uint8_t CTestCziData::JxrTestTile[] =
+{
+	0x49, 0x49, 0xbc, 0x01, 0x20, 0x00, 0x00, 0x00, 0x24, 0xc3, 0xdd, 0x6f, 0x03, 0x4e, 0xfe, 0x4b, 0xb1, 0x85, 0x3d, 0x77,
+	0x76, 0x8d, 0xc9, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x01, 0xbc, 0x01, 0x00, 0x10, 0x00,
+	0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x02, 0xbc, 0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0xbc,
+	0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x81, 0xbc, 0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x80, 0x00,
+	0x00, 0x00, 0x82, 0xbc, 0x0b, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x42, 0x83, 0xbc, 0x0b, 0x00, 0x01, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0xc0, 0x42, 0xc0, 0xbc, 0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x86, 0x00, 0x00, 0x00, 0xc1, 0xbc,
+	0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x7f, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x57, 0x4d, 0x50, 0x48, 0x4f, 0x54,
+	0x4f, 0x00, 0x11, 0x01, 0xc0, 0x71, 0x00, 0x7f, 0x00, 0x7f, 0x70, 0x00, 0xc5, 0x05, 0x05, 0x0c, 0x50, 0x50, 0x50, 0xc5,
+	0x05, 0x05, 0x00, 0x00, 0x04, 0x6f, 0xff, 0x00, 0x01, 0x00, 0x00, 0x01, 0x00, 0x8d, 0x05, 0x60, 0x7c, 0x38, 0xc1, 0x23,
+	0x00, 0x18, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x04, 0x00, 0x30, 0x00, 0x00, 0x00, 0x2e, 0x40, 0x27, 0x10, 0x00, 0x00, 0x01,
+	0xc0, 0x00, 0xac, 0x26, 0xaa, 0x59, 0x65, 0xc1, 0x23, 0xf3, 0x91, 0x00, 0xa3, 0x00, 0xc0, 0x04, 0x00, 0x90, 0x7c, 0x40,
+	0x00, 0x01, 0x00, 0x00, 0xbd, 0x33, 0x08, 0x01, 0x80, 0x14, 0x01, 0xa2, 0xc1, 0x8d, 0xc0, 0x3c, 0x8d, 0x80, 0x02, 0x00,
+	0x12, 0xc1, 0x00, 0x01, 0x00, 0x5e, 0x37, 0x02, 0x80, 0x01, 0xd5, 0x7d, 0xf7, 0xee, 0x80, 0x04, 0x34, 0x89, 0x90, 0x86,
+	0x29, 0xa1, 0x53, 0x18, 0x09, 0x6b, 0x3f, 0x90, 0x9c, 0xc4, 0x00, 0x03, 0xcf, 0x20, 0x14, 0x28, 0x84, 0x8c, 0x00, 0x89,
+	0xc8, 0xbe, 0x5c, 0x83, 0xb7, 0x13, 0xe5, 0x16, 0xbc, 0xaa, 0xc0, 0x44, 0x41, 0xb3, 0x22, 0x54, 0x11, 0x90, 0xbd, 0x71,
+	0x47, 0x4e, 0xbe, 0x7c, 0x6c, 0x63, 0x4d, 0x81, 0xa5, 0x4e, 0x11, 0x9c, 0x4e, 0x4f, 0xf1, 0xdb, 0xc9, 0xf0, 0x62, 0xde,
+	0x24, 0xda, 0x3a, 0xba, 0xb8, 0x51, 0x45, 0x16, 0x08, 0x2d, 0xdb, 0x42, 0x6b, 0xf8, 0x52, 0xc8, 0x88, 0x6b, 0xa8, 0xb5,
+	0x6c, 0x33, 0x39, 0x74, 0x3a, 0x62, 0x91, 0x35, 0x69, 0xeb, 0xe1, 0x02, 0x20, 0x8d, 0x3d, 0x53, 0x31, 0x2e, 0x61, 0x49,
+	0x25, 0x8d, 0x7e, 0x75, 0xf2, 0xc2, 0xa7, 0x56, 0x0d, 0x8b, 0x58, 0xa1, 0xbb, 0x16, 0x31, 0x88, 0xeb, 0xa0, 0x91, 0x60,
+	0xee, 0x67, 0x54, 0x21, 0xde, 0xc5, 0xb5, 0xbd, 0x60, 0x81, 0xd2, 0xc5, 0x96, 0xe9, 0x87, 0xb9, 0x73, 0x19, 0x63, 0xf4,
+	0x58, 0x30, 0x40, 0x4c, 0x26, 0x0b, 0x1f, 0x68, 0x0b, 0x5c, 0x51, 0xde, 0xf9, 0xa1, 0x3f, 0xd6, 0x25, 0x2d, 0x62, 0x90,
+	0x76, 0x10, 0x4a, 0xc6, 0xda, 0xf9, 0x88, 0x47, 0xd5, 0x86, 0x8f, 0x45, 0x47, 0x5b, 0x79, 0x93, 0x53, 0x4b, 0xed, 0x08,
+	0xbc, 0x97, 0x88, 0x5d, 0xd5, 0x08, 0xae, 0x40, 0xd4, 0xc9, 0x4c, 0x41, 0x16, 0x65, 0x6c, 0xb5, 0xe0, 0x60, 0xd5, 0x3d,
+	0x75, 0x3d, 0x0c, 0x51, 0x42, 0x55, 0xab, 0xaf, 0x10, 0x80, 0xb6, 0x8a, 0xf2, 0x28, 0x68, 0x71, 0x6a, 0x35, 0x22, 0xd6,
+	0x90, 0x42, 0x76, 0x38, 0xd3, 0x2e, 0xe8, 0xcd, 0xb1, 0xc5, 0x31, 0x3a, 0xe1, 0xab, 0x32, 0xf7, 0x75, 0x45, 0x2e, 0x51,
+	0x96, 0xfb, 0x9b, 0x7a, 0x80, 0xd1, 0xe2, 0x5b, 0xea, 0x35, 0x5c, 0xa3, 0x46, 0xbf, 0x4b, 0xd4, 0x25, 0x04, 0xd2, 0xa8,
+	0x31, 0xc9, 0x3c, 0x2c, 0x1e, 0x62, 0x17, 0xeb, 0x69, 0xcd, 0x8b, 0x55, 0xc3, 0x02, 0xd2, 0x48, 0x76, 0x23, 0x85, 0x92,
+	0x80, 0x5d, 0x76, 0x54, 0x6d, 0x61, 0x1a, 0xa1, 0xb2, 0xb2, 0xc2, 0x2f, 0xbf, 0x04, 0x32, 0x95, 0x17, 0xa9, 0x28, 0x88,
+	0x3a, 0x8a, 0xf8, 0x90, 0x20, 0x0d, 0x8b, 0xd8, 0x83, 0x5d, 0x48, 0x5b, 0xb5, 0xd9, 0xf3, 0xc0, 0x31, 0x62, 0xd3, 0x02,
+	0x59, 0xe3, 0x1d, 0x71, 0x8c, 0x59, 0xdb, 0x22, 0x27, 0x9a, 0xae, 0xa7, 0x52, 0xb0, 0xc4, 0xa4, 0x6c, 0x17, 0xa2, 0xcb,
+	0xf9, 0x74, 0xd3, 0x09, 0x86, 0xa8, 0xed, 0x84, 0x00, 0x82, 0x43, 0xdd, 0xb7, 0xa1, 0x12, 0x55, 0x05, 0xaf, 0xf3, 0xb0,
+	0x10, 0xf6, 0xa8, 0x2d, 0x2a, 0xf6, 0x08, 0xda, 0xb5, 0xe5, 0xf6, 0x68, 0x3d, 0x98, 0xa5, 0xba, 0xa9, 0x11, 0x18, 0x42,
+	0x96, 0xbd, 0x73, 0x45, 0x31, 0xa5, 0xda, 0x18, 0xd9, 0x15, 0x30, 0x4a, 0x19, 0x69, 0x4b, 0xef, 0x4b, 0xbc, 0x3d, 0xe7,
+	0x91, 0x5c, 0x98, 0xc1, 0x16, 0x4a, 0x64, 0xc2, 0x4c, 0x57, 0x80, 0x50, 0x2a, 0xb1, 0x07, 0xf1, 0x2a, 0x99, 0x8c, 0x93,
+	0xff, 0x3e, 0x78, 0xb4, 0x14, 0x90, 0xf2, 0xe0, 0xd6, 0x3d, 0x1e, 0xf9, 0x48, 0x69, 0xdf, 0xa5, 0x26, 0x67, 0xcd, 0x66,
+	0x80, 0x90, 0xa7, 0xde, 0x84, 0x60, 0xc0, 0x42, 0x24, 0xd8, 0x79, 0x4b, 0x27, 0x22, 0x43, 0x34, 0x03, 0xeb, 0x60, 0x20,
+	0x27, 0x1a, 0x85, 0xeb, 0x88, 0x95, 0x75, 0x40, 0xa3, 0x9c, 0x51, 0xdb, 0x66, 0x8a, 0xd3, 0x04, 0xb5, 0x6a, 0xed, 0xb1,
+	0x15, 0x6c, 0x45, 0x89, 0x27, 0xaf, 0x95, 0x83, 0xe8, 0x1e, 0x96, 0x55, 0x54, 0x54, 0x57, 0x51, 0x50, 0x62, 0x18, 0xf7,
+	0xa9, 0x1e, 0x2e, 0xf0, 0x18, 0x45, 0xe3, 0x09, 0xed, 0x91, 0x30, 0x63, 0x60, 0x5e, 0xa4, 0x06, 0x5c, 0xb5, 0xce, 0xaf,
+	0xbe, 0xa8, 0x5e, 0x36, 0x10, 0x54, 0x7d, 0x21, 0x29, 0x90, 0xa1, 0x26, 0x5c, 0x5f, 0xa0, 0x30, 0x55, 0x3a, 0x3f, 0x56,
+	0xad, 0x12, 0x14, 0x9d, 0x1c, 0xc4, 0xae, 0x5b, 0x16, 0x3f, 0xdf, 0xb2, 0x62, 0x10, 0x8b, 0x44, 0xe6, 0x80, 0x81, 0xe6,
+	0x53, 0xac, 0x13, 0xab, 0xab, 0xb6, 0xd8, 0x89, 0x9d, 0x36, 0xd8, 0xab, 0xf8, 0x1d, 0xc9, 0x23, 0xe5, 0xab, 0x66, 0xd9,
+	0x5a, 0x3a, 0xb2, 0x99, 0xce, 0xd4, 0x3d, 0x04, 0x08, 0xc2, 0x42, 0x97, 0xf2, 0x0e, 0xd6, 0x2d, 0x98, 0x73, 0x5d, 0x83,
+	0x17, 0x33, 0x52, 0xc0, 0xd8, 0x31, 0x67, 0x1a, 0x67, 0xe7, 0x21, 0x2f, 0x67, 0x7a, 0xcb, 0xa3, 0x0b, 0x20, 0x29, 0xbb,
+	0xfe, 0xb0, 0xbe, 0x10, 0x38, 0x9a, 0x7d, 0x59, 0x86, 0xc8, 0xc4, 0x72, 0xe9, 0x8b, 0xe1, 0x01, 0x20, 0x90, 0xe7, 0x56,
+	0x62, 0xb1, 0x0b, 0x24, 0x08, 0xdf, 0x42, 0xf9, 0x23, 0x27, 0xa8, 0x1d, 0x69, 0xe4, 0x18, 0x69, 0x15, 0x1c, 0xc4, 0xaf,
+	0x0a, 0xa5, 0x1f, 0x9d, 0x6d, 0xb6, 0x0a, 0xac, 0xd3, 0xa9, 0xb2, 0x75, 0x18, 0xb2, 0x3f, 0x15, 0xd9, 0x8f, 0xea, 0xa2,
+	0x56, 0x4a, 0x67, 0xfd, 0x70, 0xf4, 0x07, 0x1e, 0x8b, 0xfd, 0x0f, 0x1b, 0x25, 0xaa, 0x1e, 0x93, 0xe8, 0x53, 0x03, 0x91,
+	0x07, 0x8f, 0xaf, 0xaf, 0x5a, 0xd7, 0xc6, 0x1a, 0x3a, 0x61, 0xf3, 0x44, 0x63, 0xc5, 0x85, 0x8d, 0x91, 0xd0, 0xde, 0xa2,
+	0x61, 0xbc, 0xec, 0xa4, 0x2d, 0xec, 0x49, 0xf3, 0x16, 0x81, 0xb4, 0x44, 0x48, 0x65, 0xb6, 0xd0, 0xbe, 0x06, 0x1f, 0x4f,
+	0x02, 0xf7, 0xdc, 0xbc, 0x48, 0x91, 0x88, 0x2d, 0xa2, 0xf8, 0x84, 0x07, 0x33, 0x0b, 0x9f, 0x5f, 0x75, 0x51, 0x29, 0xa6,
+	0xe2, 0xe8, 0xd9, 0x50, 0xba, 0x42, 0x13, 0x32, 0xe0,
+};
+
+/*static*/const size_t CTestCziData::JxrTestTileDataSize = sizeof(CTestCziData::JxrTestTile);
+
+/*static*/std::uint8_t CTestCziData::GetJxrTestTilePixel(int x, int y, int channel)
+{
+	return (std::uint8_t)(128 + 90 * std::sin((x + 20 * channel) * 0.05) * std::cos((y - 15 * channel) * 0.04));
+}
+
+/*static*/std::uint8_t CTestCziData::GetPixelValue(int subBlockIndex, int x, int y)
+{
+	return (std::uint8_t)(subBlockIndex * 13 + x + y * 7);
+}
+
+/*static*/std::vector<std::uint8_t> CTestCziData::CreateMosaic(int countX, int countY, int tileSize, int channelCount, int metadataSize, int attachmentSize, int overlap)
+{
+	static const size_t SizeFileHeader = 32 + 512;
+	static const size_t SizeSubBlockHeader = 32 + 256;
+	static const int DimensionCount = 4;
+	static const size_t SizeDirectoryEntry = 32 + DimensionCount * 20;
+
+	const int subBlockCount = countX * countY * channelCount;
+	const size_t sizeOfSubBlockData = (size_t)tileSize * tileSize;
+	const size_t sizeOfSubBlockSegment = AlignTo32(SizeSubBlockHeader + metadataSize + sizeOfSubBlockData + attachmentSize);
+	const size_t directoryPosition = SizeFileHeader + subBlockCount * sizeOfSubBlockSegment;
+	const size_t sizeOfDirectoryData = 128 + subBlockCount * SizeDirectoryEntry;
+
+	// we add some padding at the end, because the parser reads the sub-block-header with its maximal size
+	std::vector<std::uint8_t> data(directoryPosition + AlignTo32(32 + sizeOfDirectoryData) + 1024, 0);
+
+	WriteSegmentHeader(data, 0, "ZISRAWFILE", 512, 512);
+	WriteInt32(data, 32, 1);	// Major
+	WriteInt32(data, 36, 0);	// Minor
+	WriteInt64(data, 32 + 52, directoryPosition);	// SubBlockDirectoryPosition
+
+	WriteSegmentHeader(data, directoryPosition, "ZISRAWDIRECTORY", sizeOfDirectoryData, sizeOfDirectoryData);
+	WriteInt32(data, directoryPosition + 32, subBlockCount);
+
+	int subBlockIndex = 0;
+	for (int c = 0; c < channelCount; ++c)
+	{
+		for (int m = 0; m < countX * countY; ++m, ++subBlockIndex)
+		{
+			const DimensionEntry dimensions[DimensionCount] =
+			{
+				{ "X", (m % countX) * (tileSize - overlap), tileSize, tileSize },
+				{ "Y", (m / countX) * (tileSize - overlap), tileSize, tileSize },
+				{ "C", c, 1, 1 },
+				{ "M", m, 1, 1 }
+			};
+
+			const size_t position = SizeFileHeader + subBlockIndex * sizeOfSubBlockSegment;
+			WriteSegmentHeader(data, position, "ZISRAWSUBBLOCK", sizeOfSubBlockSegment - 32, sizeOfSubBlockSegment - 32);
+			WriteInt32(data, position + 32, metadataSize);
+			WriteInt32(data, position + 36, attachmentSize);
+			WriteInt64(data, position + 40, sizeOfSubBlockData);
+			WriteDirectoryEntryDV(data, position + 48, position, dimensions, DimensionCount);
+			memset(&data[position + SizeSubBlockHeader], CTestCziData::MetadataValue, metadataSize);
+			for (int y = 0; y < tileSize; ++y)
+			{
+				for (int x = 0; x < tileSize; ++x)
+				{
+					data[position + SizeSubBlockHeader + metadataSize + y * tileSize + x] = CTestCziData::GetPixelValue(subBlockIndex, x, y);
+				}
+			}
+
+			memset(&data[position + SizeSubBlockHeader + metadataSize + sizeOfSubBlockData], CTestCziData::AttachmentValue, attachmentSize);
+
+			WriteDirectoryEntryDV(data, directoryPosition + 32 + 128 + subBlockIndex * SizeDirectoryEntry, position, dimensions, DimensionCount);
+		}
+	}
+
+	return data;
+}
+
+/*static*/std::vector<std::uint8_t> CTestCziData::CreateJxrMosaic(int countX, int countY)
+{
+	static const size_t SizeFileHeader = 32 + 512;
+	static const size_t SizeSubBlockHeader = 32 + 256;
+	static const int DimensionCount = 4;
+	static const size_t SizeDirectoryEntry = 32 + DimensionCount * 20;
+	static const std::int32_t PixelTypeBgr24 = 3;
+	static const std::int32_t CompressionJpgXr = 4;
+
+	const int subBlockCount = countX * countY;
+	const size_t sizeOfSubBlockSegment = AlignTo32(SizeSubBlockHeader + JxrTestTileDataSize);
+	const size_t directoryPosition = SizeFileHeader + subBlockCount * sizeOfSubBlockSegment;
+	const size_t sizeOfDirectoryData = 128 + subBlockCount * SizeDirectoryEntry;
+
+	// we add some padding at the end, because the parser reads the sub-block-header with its maximal size
+	std::vector<std::uint8_t> data(directoryPosition + AlignTo32(32 + sizeOfDirectoryData) + 1024, 0);
+
+	WriteSegmentHeader(data, 0, "ZISRAWFILE", 512, 512);
+	WriteInt32(data, 32, 1);	// Major
+	WriteInt32(data, 36, 0);	// Minor
+	WriteInt64(data, 32 + 52, directoryPosition);	// SubBlockDirectoryPosition
+
+	WriteSegmentHeader(data, directoryPosition, "ZISRAWDIRECTORY", sizeOfDirectoryData, sizeOfDirectoryData);
+	WriteInt32(data, directoryPosition + 32, subBlockCount);
+
+	for (int m = 0; m < subBlockCount; ++m)
+	{
+		const DimensionEntry dimensions[DimensionCount] =
+		{
+			{ "X", (m % countX) * JxrTestTileSize, JxrTestTileSize, JxrTestTileSize },
+			{ "Y", (m / countX) * JxrTestTileSize, JxrTestTileSize, JxrTestTileSize },
+			{ "C", 0, 1, 1 },
+			{ "M", m, 1, 1 }
+		};
+
+		const size_t position = SizeFileHeader + m * sizeOfSubBlockSegment;
+		WriteSegmentHeader(data, position, "ZISRAWSUBBLOCK", sizeOfSubBlockSegment - 32, sizeOfSubBlockSegment - 32);
+		WriteInt64(data, position + 40, JxrTestTileDataSize);
+		WriteDirectoryEntryDV(data, position + 48, position, dimensions, DimensionCount, PixelTypeBgr24, CompressionJpgXr);
+		memcpy(&data[position + SizeSubBlockHeader], JxrTestTile, JxrTestTileDataSize);
+		WriteDirectoryEntryDV(data, directoryPosition + 32 + 128 + m * SizeDirectoryEntry, position, dimensions, DimensionCount, PixelTypeBgr24, CompressionJpgXr);
+	}
+
+	return data;
+}
+
+/*static*/void CTestCziData::AddMetadataAndAttachmentDirectory(std::vector<std::uint8_t>& data, const std::string& xml, int attachmentCount)
+{
+	static const size_t SizeMetadataHeader = 32 + 256;
+	static const size_t SizeAttachmentDirectoryHeader = 32 + 256;
+	static const size_t SizeAttachmentEntry = 128;
+
+	const size_t metadataPosition = AlignTo32(data.size());
+	const size_t sizeOfMetadataData = 256 + xml.size();
+	const size_t attachmentDirectoryPosition = AlignTo32(metadataPosition + SizeMetadataHeader + xml.size());
+	const size_t sizeOfAttachmentDirectoryData = 256 + attachmentCount * SizeAttachmentEntry;
+	data.resize(attachmentDirectoryPosition + SizeAttachmentDirectoryHeader + attachmentCount * SizeAttachmentEntry, 0);
+
+	WriteInt64(data, 32 + 60, metadataPosition);				// MetadataPosition
+	WriteInt64(data, 32 + 72, attachmentDirectoryPosition);	// AttachmentDirectoryPosition
+
+	WriteSegmentHeader(data, metadataPosition, "ZISRAWMETADATA", sizeOfMetadataData, sizeOfMetadataData);
+	WriteInt32(data, metadataPosition + 32, (std::int32_t)xml.size());
+	if (!xml.empty())
+	{
+		memcpy(&data[metadataPosition + SizeMetadataHeader], xml.c_str(), xml.size());
+	}
+
+	WriteSegmentHeader(data, attachmentDirectoryPosition, "ZISRAWATTDIR", sizeOfAttachmentDirectoryData, sizeOfAttachmentDirectoryData);
+	WriteInt32(data, attachmentDirectoryPosition + 32, attachmentCount);
+	for (int i = 0; i < attachmentCount; ++i)
+	{
+		const size_t offset = attachmentDirectoryPosition + SizeAttachmentDirectoryHeader + i * SizeAttachmentEntry;
+		data[offset] = 'A';
+		data[offset + 1] = '1';
+		memcpy(&data[offset + 40], "BIN", 3);		// ContentFileType
+		std::string name = "Attachment" + std::to_string(i);
+		memcpy(&data[offset + 48], name.c_str(), name.size());
+	}
+}
+
+/*static*/std::wstring CTestCziData::WriteToTemporaryFile(const std::vector<std::uint8_t>& data)
+{
+#if defined(_WIN32)
+	wchar_t tempPath[MAX_PATH];
+	wchar_t fileName[MAX_PATH];
+	GetTempPathW(MAX_PATH, tempPath);
+	GetTempFileNameW(tempPath, L"czi", 0, fileName);
+	FILE* fp;
+	_wfopen_s(&fp, fileName, L"wb");
+	std::wstring filename(fileName);
+#else
+	char fileName[] = "/tmp/libCZI_testXXXXXX";
+	int fd = mkstemp(fileName);
+	if (fd < 0)
+	{
+		throw std::runtime_error("Error creating a temporary file");
+	}
+
+	FILE* fp = fdopen(fd, "wb");
+	std::wstring filename(fileName, fileName + strlen(fileName));
+#endif
+	if (fp == nullptr)
+	{
+		throw std::runtime_error("Error creating a temporary file");
+	}
+
+	fwrite(&data[0], 1, data.size(), fp);
+	fclose(fp);
+	return filename;
+}
@@ -0,0 +1,104 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+/// <summary>	Helper for creating (simple, but valid) CZI-files for testing purposes. </summary>
+class CTestCziData
+{
+public:
+	/// Creates a CZI-file (in memory) containing a mosaic of uncompressed Gray8 sub-blocks. The
+	/// sub-blocks are arranged in a grid of countX times countY tiles (for each channel), adjacent
+	/// tiles overlapping by the specified number of pixels. The M-index of the tiles is increasing
+	/// row by row. The pixels of a sub-block are filled with the values given by GetPixelValue.
+	///
+	/// \param countX		Number of tiles in x-direction.
+	/// \param countY		Number of tiles in y-direction.
+	/// \param tileSize		Width and height of a tile (in pixels).
+	/// \param channelCount Number of channels.
+	/// \param metadataSize	The size of the sub-block metadata (which is filled with the value MetadataValue).
+	/// \param attachmentSize The size of the sub-block attachment (which is filled with the value AttachmentValue).
+	/// \param overlap		The number of pixels by which adjacent tiles overlap.
+	///
+	/// \return The CZI-file.
+	static std::vector<std::uint8_t> CreateMosaic(int countX, int countY, int tileSize, int channelCount, int metadataSize = 0, int attachmentSize = 0, int overlap = 0);
+
+	/// Creates a CZI-file (in memory) containing a mosaic of countX times countY (non-overlapping) Bgr24 sub-blocks,
+	/// which are all compressed with JPG-XR and contain the tile JxrTestTile. The M-index of the tiles is increasing
+	/// row by row.
+	///
+	/// \param countX Number of tiles in x-direction.
+	/// \param countY Number of tiles in y-direction.
+	///
+	/// \return The CZI-file.
+	static std::vector<std::uint8_t> CreateJxrMosaic(int countX, int countY);
+
+	/// Appends a metadata segment and an attachment directory to a CZI-file created with CreateMosaic,
+	/// and updates the file header accordingly. The attachment directory contains the specified number
+	/// of entries (named "Attachment0", "Attachment1" and so on), which do not refer to actual attachments.
+	///
+	/// \param [in,out] data	  The CZI-file.
+	/// \param xml			  The XML-metadata.
+	/// \param attachmentCount The number of entries in the attachment directory.
+	static void AddMetadataAndAttachmentDirectory(std::vector<std::uint8_t>& data, const std::string& xml, int attachmentCount);
+
+	/// A JxrTestTileSize x JxrTestTileSize Bgr24 JPG-XR tile (lossy, with overlap), encoded from the image given by GetJxrTestTilePixel.
+	static const std::uint8_t JxrTestTile[];
+
+	/// The size (in bytes) of JxrTestTile.
+	static const size_t JxrTestTileDataSize;
+
+	/// The width and height of JxrTestTile.
+	static const int JxrTestTileSize = 128;
+
+	/// Gets the value of the (uncompressed) image which JxrTestTile was encoded from.
+	///
+	/// \param x		The x coordinate.
+	/// \param y		The y coordinate.
+	/// \param channel The channel (0 = blue, 1 = green, 2 = red).
+	///
+	/// \return The pixel value.
+	static std::uint8_t GetJxrTestTilePixel(int x, int y, int channel);
+
+	static const std::uint8_t MetadataValue = 0x4d;
+	static const std::uint8_t AttachmentValue = 0x41;
+
+	/// Gets the pixel value which is used for the specified sub-block.
+	///
+	/// \param subBlockIndex Index of the sub-block.
+	/// \param x			 The x coordinate (within the sub-block).
+	/// \param y			 The y coordinate (within the sub-block).
+	///
+	/// \return The pixel value.
+	static std::uint8_t GetPixelValue(int subBlockIndex, int x, int y);
+
+	/// Writes the specified data to a newly created temporary file.
+	///
+	/// \param data The data to write.
+	///
+	/// \return The filename of the temporary file.
+	static std::wstring WriteToTemporaryFile(const std::vector<std::uint8_t>& data);
+};
@@ -24,6 +24,7 @@
 #include "CppUnitTest.h"
 
 #include "inc_libCZI.h"
+#include <sstream>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace libCZI;
@@ -244,6 +245,440 @@ namespace UnitTest
 			//auto pyramidStatistics = subBlkDir.GetPyramidStatistics();
 		}
 
+		TEST_METHOD(TestMethod_CziSubBlockDirectoryEnumSubset)
+		{
+			// build a directory with two channels, each a 10x8 mosaic of overlapping tiles plus a layer of
+			// pyramid-tiles (minification factor 2) - we compare the result of EnumSubset against the same
+			// directory where adding has not been finished (so that all sub-blocks are examined)
+			CCziSubBlockDirectory subBlkDir, subBlkDirNotFinished;
+			for (int c = 0; c < 2; ++c)
+			{
+				for (int y = 0; y < 8; ++y)
+				{
+					for (int x = 0; x < 10; ++x)
+					{
+						SubBlockEntryData d = { c == 0 ? "C0" : "C1", y * 10 + x, x * 900 - 3000, y * 900 - 2000, 1000, 1000, 1000, 1000 };
+						auto entry = SubBlkEntryFromSubBlockEntryData(&d);
+						subBlkDir.AddSubBlock(entry);
+						subBlkDirNotFinished.AddSubBlock(entry);
+					}
+				}
+
+				for (int y = 0; y < 4; ++y)
+				{
+					for (int x = 0; x < 5; ++x)
+					{
+						SubBlockEntryData d = { c == 0 ? "C0" : "C1", (std::numeric_limits<int>::min)(), x * 1800 - 3000, y * 1800 - 2000, 2000, 2000, 1000, 1000 };
+						auto entry = SubBlkEntryFromSubBlockEntryData(&d);
+						subBlkDir.AddSubBlock(entry);
+						subBlkDirNotFinished.AddSubBlock(entry);
+					}
+				}
+			}
+
+			subBlkDir.AddingFinished();
+
+			const IntRect rois[] =
+			{
+				{ -3000, -2000, 1, 1 },
+				{ -100000, -100000, 200000, 200000 },
+				{ 0, 0, 1000, 1000 },
+				{ 899, 899, 2, 2 },
+				{ 5000, -5000, 100, 6000 },
+				{ 7100, 5300, 1, 1 },
+				{ 100000, 100000, 10, 10 },
+				{ 0, 0, 0, 0 }
+			};
+
+			const CDimCoordinate planeCoordinates[] = { CDimCoordinate::Parse("C0"), CDimCoordinate::Parse("C1"), CDimCoordinate::Parse("C2") };
+
+			auto enumSubset = [](CCziSubBlockDirectory& dir, const IDimCoordinate* planeCoordinate, const IntRect* roi, bool onlyLayer0)->std::vector<int>
+			{
+				std::vector<int> result;
+				dir.EnumSubset(planeCoordinate, roi, onlyLayer0, [&](int index, const CCziSubBlockDirectory::SubBlkEntry&)->bool {result.push_back(index); return true; });
+				return result;
+			};
+
+			int countNonEmpty = 0;
+			for (const auto& roi : rois)
+			{
+				for (const auto& planeCoordinate : planeCoordinates)
+				{
+					for (bool onlyLayer0 : { true, false })
+					{
+						auto result = enumSubset(subBlkDir, &planeCoordinate, &roi, onlyLayer0);
+						auto expected = enumSubset(subBlkDirNotFinished, &planeCoordinate, &roi, onlyLayer0);
+						Assert::IsTrue(result == expected, L"wrong result", LINE_INFO());
+						countNonEmpty += result.empty() ? 0 : 1;
+					}
+				}
+
+				auto result = enumSubset(subBlkDir, nullptr, &roi, false);
+				auto expected = enumSubset(subBlkDirNotFinished, nullptr, &roi, false);
+				Assert::IsTrue(result == expected, L"wrong result", LINE_INFO());
+			}
+
+			Assert::IsTrue(countNonEmpty > 0, L"wrong result", LINE_INFO());
+			Assert::IsTrue(enumSubset(subBlkDir, nullptr, nullptr, false).size() == 200, L"wrong result", LINE_INFO());
+			Assert::IsTrue(enumSubset(subBlkDir, &planeCoordinates[1], nullptr, true).size() == 80, L"wrong result", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_CziSubBlockDirectoryPlaneIndex)
+		{
+			// the sub-blocks are added in an order where the planes are interleaved
+			static const char* coordinates[] = { "C1Z2", "C0Z0", "C2Z3", "C1Z0", "C0Z2", "C2Z0", "C1Z2", "C0Z0" };
+			CCziSubBlockDirectory subBlkDir, subBlkDirNotFinished;
+			for (int i = 0; i < 64; ++i)
+			{
+				SubBlockEntryData d = { coordinates[i % (sizeof(coordinates) / sizeof(coordinates[0]))], i, (i % 4) * 100, (i / 4) * 100, 100, 100, 100, 100 };
+				auto entry = SubBlkEntryFromSubBlockEntryData(&d);
+				subBlkDir.AddSubBlock(entry);
+				subBlkDirNotFinished.AddSubBlock(entry);
+			}
+
+			subBlkDir.AddingFinished();
+
+			auto enumSubset = [](CCziSubBlockDirectory& dir, const IDimCoordinate* planeCoordinate, const IntRect* roi)->std::vector<int>
+			{
+				std::vector<int> result;
+				dir.EnumSubset(planeCoordinate, roi, false, [&](int index, const CCziSubBlockDirectory::SubBlkEntry&)->bool {result.push_back(index); return true; });
+				return result;
+			};
+
+			static const char* planeCoordinates[] = { "C1Z2", "C0Z0", "C2Z3", "C2Z2", "C1", "Z0", "C1Z2T0", "C5Z0", "C-1Z0" };
+			const IntRect roi{ 50, 50, 100, 500 };
+			for (const char* planeCoordinate : planeCoordinates)
+			{
+				auto coordinate = CDimCoordinate::Parse(planeCoordinate);
+				auto result = enumSubset(subBlkDir, &coordinate, nullptr);
+				auto expected = enumSubset(subBlkDirNotFinished, &coordinate, nullptr);
+				Assert::IsTrue(result == expected, L"wrong result", LINE_INFO());
+
+				result = enumSubset(subBlkDir, &coordinate, &roi);
+				expected = enumSubset(subBlkDirNotFinished, &coordinate, &roi);
+				Assert::IsTrue(result == expected, L"wrong result", LINE_INFO());
+			}
+
+			auto coordinate = CDimCoordinate::Parse("C1Z2");
+			Assert::IsTrue(enumSubset(subBlkDir, &coordinate, nullptr).size() == 16, L"wrong result", LINE_INFO());
+
+			for (int c = -1; c < 4; ++c)
+			{
+				int index = -1, indexExpected = -1;
+				bool b = subBlkDir.TryGetFirstSubBlockInChannel(c, &index);
+				bool bExpected = subBlkDirNotFinished.TryGetFirstSubBlockInChannel(c, &indexExpected);
+				Assert::IsTrue(b == bExpected && index == indexExpected, L"wrong result", LINE_INFO());
+				Assert::IsTrue(b == (c >= 0 && c <= 2), L"wrong result", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestMethod_CziSubBlockDirectoryManyPlanes)
+		{
+			// a time-lapse - every plane has only one or two tiles (so that no spatial index is built), except
+			// for the plane T0 which is a mosaic (and gets a spatial index)
+			CCziSubBlockDirectory subBlkDir, subBlkDirNotFinished;
+			for (int t = 0; t < 300; ++t)
+			{
+				const int tileCount = t == 0 ? 64 : 1 + t % 2;
+				for (int i = 0; i < tileCount; ++i)
+				{
+					const std::string coordinate = "C0T" + std::to_string(t);
+					SubBlockEntryData d = { coordinate.c_str(), i, (i % 8) * 100, (i / 8) * 100, 100, 100, 100, 100 };
+					auto entry = SubBlkEntryFromSubBlockEntryData(&d);
+					subBlkDir.AddSubBlock(entry);
+					subBlkDirNotFinished.AddSubBlock(entry);
+				}
+			}
+
+			subBlkDir.AddingFinished();
+
+			auto enumSubset = [](CCziSubBlockDirectory& dir, const IDimCoordinate* planeCoordinate, const IntRect* roi)->std::vector<int>
+			{
+				std::vector<int> result;
+				dir.EnumSubset(planeCoordinate, roi, false, [&](int index, const CCziSubBlockDirectory::SubBlkEntry&)->bool {result.push_back(index); return true; });
+				return result;
+			};
+
+			const IntRect rois[] = { { 50, 50, 100, 500 }, { 150, 0, 10, 10 }, { 1000, 1000, 10, 10 }, { 0, 0, 0, 0 } };
+			static const char* planeCoordinates[] = { "C0T0", "C0T1", "C0T2", "C0T299", "C0T300", "T7" };
+			for (const char* planeCoordinate : planeCoordinates)
+			{
+				auto coordinate = CDimCoordinate::Parse(planeCoordinate);
+				auto result = enumSubset(subBlkDir, &coordinate, nullptr);
+				auto expected = enumSubset(subBlkDirNotFinished, &coordinate, nullptr);
+				Assert::IsTrue(result == expected, L"wrong result", LINE_INFO());
+				for (const auto& roi : rois)
+				{
+					result = enumSubset(subBlkDir, &coordinate, &roi);
+					expected = enumSubset(subBlkDirNotFinished, &coordinate, &roi);
+					Assert::IsTrue(result == expected, L"wrong result", LINE_INFO());
+				}
+			}
+
+			auto coordinate = CDimCoordinate::Parse("C0T2");
+			Assert::IsTrue(enumSubset(subBlkDir, &coordinate, nullptr).size() == 1, L"wrong result", LINE_INFO());
+			coordinate = CDimCoordinate::Parse("C0T3");
+			Assert::IsTrue(enumSubset(subBlkDir, &coordinate, &rois[1]).size() == 1, L"wrong result", LINE_INFO());
+			Assert::IsTrue(enumSubset(subBlkDir, nullptr, &rois[0]).size() == enumSubset(subBlkDirNotFinished, nullptr, &rois[0]).size(), L"wrong result", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_CziSubBlockDirectoryCompact)
+		{
+			static const char* coordinates[] = { "C0Z0T0", "C1Z0T0", "C0Z1T0", "C1Z1T5", "C0", "B1C0Z0T0" };
+			CCziSubBlockDirectory subBlkDir, subBlkDirCompact(true);
+			for (int i = 0; i < 500; ++i)
+			{
+				SubBlockEntryData d = { coordinates[(i * 7) % (sizeof(coordinates) / sizeof(coordinates[0]))], (i % 5 == 0) ? (std::numeric_limits<int>::min)() : i - 100, (i % 13) * 1000 - 70000, (i % 17) * 1000 - 123, 1024, 1024, 1024, 1024 };
+				if (i % 5 == 0)
+				{
+					d.width = d.height = 2048;
+				}
+
+				auto entry = SubBlkEntryFromSubBlockEntryData(&d);
+				entry.FilePosition = 0x100000000ULL + 100000ULL * i;
+				entry.PixelType = (i % 3 == 0) ? (int)PixelType::Bgr24 : (int)PixelType::Gray16;
+				subBlkDir.AddSubBlock(entry);
+				subBlkDirCompact.AddSubBlock(entry);
+			}
+
+			subBlkDir.AddingFinished();
+			subBlkDirCompact.AddingFinished();
+
+			auto isEqual = [](const CCziSubBlockDirectory::SubBlkEntry& a, const CCziSubBlockDirectory::SubBlkEntry& b)->bool
+			{
+				return Utils::DimCoordinateToString(&a.coordinate) == Utils::DimCoordinateToString(&b.coordinate) &&
+					a.mIndex == b.mIndex && a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height &&
+					a.storedWidth == b.storedWidth && a.storedHeight == b.storedHeight && a.PixelType == b.PixelType &&
+					a.FilePosition == b.FilePosition && a.Compression == b.Compression;
+			};
+
+			Assert::IsTrue(subBlkDirCompact.GetSubBlockCount() == 500, L"wrong result", LINE_INFO());
+			int count = 0;
+			subBlkDirCompact.EnumSubBlocks(
+				[&](int index, const CCziSubBlockDirectory::SubBlkEntry& entry)->bool
+			{
+				CCziSubBlockDirectory::SubBlkEntry expected;
+				Assert::IsTrue(index == count++, L"wrong result", LINE_INFO());
+				Assert::IsTrue(subBlkDir.TryGetSubBlock(index, expected), L"wrong result", LINE_INFO());
+				Assert::IsTrue(isEqual(entry, expected), L"wrong result", LINE_INFO());
+				return true;
+			});
+
+			Assert::IsTrue(count == 500, L"wrong result", LINE_INFO());
+
+			CCziSubBlockDirectory::SubBlkEntry entry;
+			Assert::IsTrue(subBlkDirCompact.TryGetSubBlock(500, entry) == false, L"wrong result", LINE_INFO());
+
+			auto enumSubset = [](CCziSubBlockDirectory& dir, const IDimCoordinate* planeCoordinate, const IntRect* roi)->std::vector<int>
+			{
+				std::vector<int> result;
+				dir.EnumSubset(planeCoordinate, roi, true, [&](int index, const CCziSubBlockDirectory::SubBlkEntry&)->bool {result.push_back(index); return true; });
+				return result;
+			};
+
+			const IntRect roi{ -60000, 2000, 5000, 3000 };
+			for (const char* c : coordinates)
+			{
+				auto planeCoordinate = CDimCoordinate::Parse(c);
+				Assert::IsTrue(enumSubset(subBlkDirCompact, &planeCoordinate, &roi) == enumSubset(subBlkDir, &planeCoordinate, &roi), L"wrong result", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestMethod_CziSubBlockDirectoryCompactTimeLapse)
+		{
+			// a time-lapse where every sub-block has a distinct plane-coordinate, with more sub-blocks than fit into
+			// one chunk of the compact representation - the compact directories are built by adding the sub-blocks
+			// one by one, and by merging partial directories (whose chunks can be taken over if they are complete)
+			const int count = (int)(2 * CCziSubBlockDirectory::COMPACTCHUNKSIZE + 123);
+			std::vector<CCziSubBlockDirectory::SubBlkEntry> entries;
+			for (int i = 0; i < count; ++i)
+			{
+				const std::string coordinate = (i % 1000 == 999 ? "Z3T" : "C" + std::to_string(i % 2) + "T") + std::to_string(i / 2);
+				SubBlockEntryData d = { coordinate.c_str(), (i % 7 == 0) ? (std::numeric_limits<int>::min)() : -i, (i % 3) * 512 - 100000, (i % 5) * 512, 512, 512, 512, 512 };
+				if (i % 4 == 0)
+				{
+					d.storedWidth = d.storedHeight = 256;
+				}
+
+				auto entry = SubBlkEntryFromSubBlockEntryData(&d);
+				entry.FilePosition = 0x7ffffff000000000ULL + 0x12345ULL * i;
+				entry.Compression = i % 3;
+				entries.push_back(entry);
+			}
+
+			CCziSubBlockDirectory subBlkDir, subBlkDirCompact(true), subBlkDirCompactMerged(true), subBlkDirMixedMerged(true);
+			for (const auto& entry : entries)
+			{
+				subBlkDir.AddSubBlock(entry);
+				subBlkDirCompact.AddSubBlock(entry);
+			}
+
+			const size_t chunkSize = CCziSubBlockDirectory::COMPACTCHUNKSIZE;
+			for (size_t start : { (size_t)0, chunkSize, 2 * chunkSize })
+			{
+				CCziSubBlockDirectory partialDirectory(true);
+				for (size_t i = start; i < (std::min)(start + chunkSize, entries.size()); ++i)
+				{
+					partialDirectory.AddSubBlock(entries[i]);
+				}
+
+				subBlkDirCompactMerged.AddSubBlocks(std::move(partialDirectory));
+			}
+
+			for (size_t start : { (size_t)0, (size_t)100, chunkSize + 100 })
+			{
+				CCziSubBlockDirectory partialDirectory(start != 100);
+				for (size_t i = start; i < (start == 0 ? 100 : start == 100 ? chunkSize + 100 : entries.size()); ++i)
+				{
+					partialDirectory.AddSubBlock(entries[i]);
+				}
+
+				subBlkDirMixedMerged.AddSubBlocks(std::move(partialDirectory));
+			}
+
+			subBlkDir.AddingFinished();
+			subBlkDirCompact.AddingFinished();
+			subBlkDirCompactMerged.AddingFinished();
+			subBlkDirMixedMerged.AddingFinished();
+
+			auto isEqual = [](const CCziSubBlockDirectory::SubBlkEntry& a, const CCziSubBlockDirectory::SubBlkEntry& b)->bool
+			{
+				return Utils::DimCoordinateToString(&a.coordinate) == Utils::DimCoordinateToString(&b.coordinate) &&
+					a.mIndex == b.mIndex && a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height &&
+					a.storedWidth == b.storedWidth && a.storedHeight == b.storedHeight && a.PixelType == b.PixelType &&
+					a.FilePosition == b.FilePosition && a.Compression == b.Compression;
+			};
+
+			auto enumSubset = [](CCziSubBlockDirectory& dir, const IDimCoordinate* planeCoordinate, const IntRect* roi, bool onlyLayer0)->std::vector<int>
+			{
+				std::vector<int> result;
+				dir.EnumSubset(planeCoordinate, roi, onlyLayer0, [&](int index, const CCziSubBlockDirectory::SubBlkEntry&)->bool {result.push_back(index); return true; });
+				return result;
+			};
+
+			const IntRect roi{ -100000, 0, 600, 1500 };
+			static const char* planeCoordinates[] = { "C0T0", "C1T0", "C1T2048", "C0T4160", "Z3T499", "Z3T500", "T10", "C1", "C0T5000" };
+			for (CCziSubBlockDirectory* dir : { &subBlkDirCompact, &subBlkDirCompactMerged, &subBlkDirMixedMerged })
+			{
+				Assert::IsTrue(dir->GetSubBlockCount() == entries.size(), L"wrong result", LINE_INFO());
+				for (int i = 0; i < count; ++i)
+				{
+					CCziSubBlockDirectory::SubBlkEntry entry;
+					Assert::IsTrue(dir->TryGetSubBlock(i, entry), L"wrong result", LINE_INFO());
+					Assert::IsTrue(isEqual(entry, entries[i]), L"wrong result", LINE_INFO());
+				}
+
+				for (const char* c : planeCoordinates)
+				{
+					auto planeCoordinate = CDimCoordinate::Parse(c);
+					for (bool onlyLayer0 : { false, true })
+					{
+						Assert::IsTrue(enumSubset(*dir, &planeCoordinate, nullptr, onlyLayer0) == enumSubset(subBlkDir, &planeCoordinate, nullptr, onlyLayer0), L"wrong result", LINE_INFO());
+						Assert::IsTrue(enumSubset(*dir, &planeCoordinate, &roi, onlyLayer0) == enumSubset(subBlkDir, &planeCoordinate, &roi, onlyLayer0), L"wrong result", LINE_INFO());
+					}
+				}
+
+				Assert::IsTrue(enumSubset(*dir, nullptr, &roi, false) == enumSubset(subBlkDir, nullptr, &roi, false), L"wrong result", LINE_INFO());
+				int index = -1;
+				Assert::IsTrue(dir->TryGetFirstSubBlockInChannel(1, &index) && index == 1, L"wrong result", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestMethod_CziSubBlockDirectoryAddSubBlocks)
+		{
+			// adding the sub-blocks in chunks (to partial directories which are then merged) must give the
+			// same result as adding them one by one
+			static const char* coordinates[] = { "C0S0", "C1S0", "C0S1", "C1S1", "C0" };
+			std::vector<CCziSubBlockDirectory::SubBlkEntry> entries;
+			for (int i = 0; i < 300; ++i)
+			{
+				SubBlockEntryData d = { coordinates[(i / 7) % (sizeof(coordinates) / sizeof(coordinates[0]))], (i % 11 == 0) ? (std::numeric_limits<int>::min)() : i, (i % 23) * 100 - (i % 5) * 1000, (i % 19) * 100, 100, 100, 100, 100 };
+				if (i % 9 == 0)
+				{
+					// pyramid-tiles (with different minification factors)
+					d.width = d.height = (i % 2 == 0) ? 200 : 400;
+				}
+
+				entries.push_back(SubBlkEntryFromSubBlockEntryData(&d));
+			}
+
+			CCziSubBlockDirectory subBlkDir, subBlkDirMerged;
+			for (const auto& entry : entries)
+			{
+				subBlkDir.AddSubBlock(entry);
+			}
+
+			for (size_t start : { 0, 10, 11, 150, 299 })
+			{
+				CCziSubBlockDirectory partialDirectory;
+				size_t end = start == 0 ? 10 : start == 10 ? 11 : start == 11 ? 150 : start == 150 ? 299 : 300;
+				for (size_t i = start; i < end; ++i)
+				{
+					partialDirectory.AddSubBlock(entries[i]);
+				}
+
+				subBlkDirMerged.AddSubBlocks(std::move(partialDirectory));
+			}
+
+			subBlkDir.AddingFinished();
+			subBlkDirMerged.AddingFinished();
+
+			auto rectToString = [](const IntRect& r)->std::string
+			{
+				std::stringstream ss;
+				ss << r.x << ',' << r.y << ',' << r.w << ',' << r.h;
+				return ss.str();
+			};
+
+			auto statisticsToString = [&](const SubBlockStatistics& s)->std::string
+			{
+				std::stringstream ss;
+				ss << s.subBlockCount << ' ' << s.minMindex << ' ' << s.maxMindex << ' ' << rectToString(s.boundingBox) << ' ' << rectToString(s.boundingBoxLayer0Only);
+				for (auto dim : { DimensionIndex::C, DimensionIndex::S })
+				{
+					int start = -1, size = -1;
+					s.dimBounds.TryGetInterval(dim, &start, &size);
+					ss << ' ' << start << '/' << size;
+				}
+
+				for (const auto& sbb : s.sceneBoundingBoxes)
+				{
+					ss << ' ' << sbb.first << ':' << rectToString(sbb.second.boundingBox) << '/' << rectToString(sbb.second.boundingBoxLayer0);
+				}
+
+				return ss.str();
+			};
+
+			auto pyramidStatisticsToString = [](const PyramidStatistics& s)->std::string
+			{
+				std::stringstream ss;
+				for (const auto& sps : s.scenePyramidStatistics)
+				{
+					ss << sps.first << ':';
+					for (const auto& pls : sps.second)
+					{
+						ss << (int)pls.layerInfo.minificationFactor << '/' << (int)pls.layerInfo.pyramidLayerNo << '/' << pls.count << ' ';
+					}
+				}
+
+				return ss.str();
+			};
+
+			Assert::IsTrue(statisticsToString(subBlkDir.GetStatistics()) == statisticsToString(subBlkDirMerged.GetStatistics()), L"wrong result", LINE_INFO());
+			Assert::IsTrue(pyramidStatisticsToString(subBlkDir.GetPyramidStatistics()) == pyramidStatisticsToString(subBlkDirMerged.GetPyramidStatistics()), L"wrong result", LINE_INFO());
+
+			int count = 0;
+			subBlkDirMerged.EnumSubBlocks(
+				[&](int index, const CCziSubBlockDirectory::SubBlkEntry& entry)->bool
+			{
+				Assert::IsTrue(index == count && entry.x == entries[count].x && entry.y == entries[count].y && entry.mIndex == entries[count].mIndex, L"wrong result", LINE_INFO());
+				++count;
+				return true;
+			});
+
+			Assert::IsTrue(count == 300, L"wrong result", LINE_INFO());
+		}
+
 	private:
 		static CCziSubBlockDirectory::SubBlkEntry SubBlkEntryFromSubBlockEntryData(const SubBlockEntryData* ptrData)
 		{
@@ -24,6 +24,12 @@
 #include "CppUnitTest.h"
 
 #include "inc_libCZI.h"
+#include "testCziData.h"
+#include "../libCZI/CziParse.h"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <map>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace libCZI;
@@ -107,5 +113,383 @@ namespace UnitTest
 
 			Assert::IsTrue(bufferForRead[1] == 0 && bufferForRead[2] == 0, L"incorrect result", LINE_INFO());
 		}
+
+		TEST_METHOD(TestMethod_StreamInMemoryDirectAccess)
+		{
+			auto cziData = CTestCziData::CreateMosaic(2, 2, 16, 1);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto stream = CreateStreamFromMemory(spBuffer, cziData.size());
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(stream);
+
+			auto sbBlk = spReader->ReadSubBlock(3);
+			size_t size;
+			auto spData = sbBlk->GetRawData(ISubBlock::MemBlkType::Data, &size);
+			Assert::IsTrue(size == 16 * 16, L"incorrect size", LINE_INFO());
+			const std::uint8_t* ptr = static_cast<const std::uint8_t*>(spData.get());
+			Assert::IsTrue(ptr >= &cziData[0] && ptr + size <= &cziData[0] + cziData.size(), L"expected the data to point into the stream's memory", LINE_INFO());
+			Assert::IsTrue(ptr[0] == CTestCziData::GetPixelValue(3, 0, 0) && ptr[size - 1] == CTestCziData::GetPixelValue(3, 15, 15), L"incorrect result", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_StreamFromFileConcurrentReads)
+		{
+			static const int ThreadCount = 32;
+			static const int ReadsPerThread = 200;
+			auto cziData = CTestCziData::CreateMosaic(8, 8, 24, 2);
+			auto filename = CTestCziData::WriteToTemporaryFile(cziData);
+
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(CreateStreamFromFile(filename.c_str()));
+			const int subBlockCount = spReader->GetStatistics().subBlockCount;
+
+			std::atomic<int> errorCount{ 0 };
+			std::vector<std::thread> threads;
+			for (int t = 0; t < ThreadCount; ++t)
+			{
+				threads.emplace_back([&, t]()->void
+				{
+					try
+					{
+						for (int i = 0; i < ReadsPerThread; ++i)
+						{
+							int index = (t * 7 + i * 13) % subBlockCount;
+							auto sbBlk = spReader->ReadSubBlock(index);
+							const void* ptr; size_t size;
+							sbBlk->DangerousGetRawData(ISubBlock::MemBlkType::Data, ptr, size);
+							const std::uint8_t* p = static_cast<const std::uint8_t*>(ptr);
+							if (size != 24 * 24 || sbBlk->GetSubBlockInfo().mIndex != index % 64 ||
+								p[0] != CTestCziData::GetPixelValue(index, 0, 0) ||
+								p[24 * 24 - 1] != CTestCziData::GetPixelValue(index, 23, 23))
+							{
+								++errorCount;
+							}
+						}
+					}
+					catch (std::exception&)
+					{
+						++errorCount;
+					}
+				});
+			}
+
+			for (auto& th : threads)
+			{
+				th.join();
+			}
+
+			spReader->Close();
+#if defined(_WIN32)
+			_wremove(filename.c_str());
+#else
+			remove(std::string(filename.begin(), filename.end()).c_str());
+#endif
+			Assert::IsTrue(errorCount.load() == 0, L"incorrect result when reading concurrently", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_StreamFromFileReadBatch)
+		{
+			std::vector<std::uint8_t> data(1000);
+			for (size_t i = 0; i < data.size(); ++i)
+			{
+				data[i] = (std::uint8_t)(i * 3);
+			}
+
+			auto filename = CTestCziData::WriteToTemporaryFile(data);
+			auto stream = CreateStreamFromFile(filename.c_str());
+			auto streamBatch = std::dynamic_pointer_cast<libCZI::IStreamBatch>(stream);
+			if (streamBatch)
+			{
+				std::uint8_t buffer[7][100];
+				IStreamBatch::ReadRequest requests[7] =
+				{
+					{ 300, buffer[0], 100, 0 },
+					{ 100, buffer[1], 100, 0 },	// the first three requests are adjacent in the file
+					{ 200, buffer[2], 100, 0 },
+					{ 450, buffer[3], 50, 0 },	// this one is read together with the ones before, the gap is skipped
+					{ 470, buffer[4], 10, 0 },	// this one overlaps with the one before
+					{ 950, buffer[5], 100, 0 },	// this one reaches beyond the end of the file
+					{ 10, buffer[6], 20, 0 }
+				};
+
+				streamBatch->ReadBatch(requests, 7);
+				for (const auto& r : requests)
+				{
+					std::uint64_t expectedSize = (std::min)(r.size, data.size() - r.offset);
+					Assert::IsTrue(r.bytesRead == expectedSize, L"incorrect number of bytes read", LINE_INFO());
+					Assert::IsTrue(memcmp(r.pv, &data[(size_t)r.offset], (size_t)r.bytesRead) == 0, L"incorrect result", LINE_INFO());
+				}
+			}
+
+			stream.reset();
+			streamBatch.reset();
+#if defined(_WIN32)
+			_wremove(filename.c_str());
+#else
+			remove(std::string(filename.begin(), filename.end()).c_str());
+#endif
+		}
+
+		TEST_METHOD(TestMethod_ReadSubBlocksBatch)
+		{
+			// a stream which only implements IStream, so the reader has to fall back to individual reads
+			class CPlainStream : public libCZI::IStream
+			{
+			private:
+				std::shared_ptr<libCZI::IStream> stream;
+			public:
+				CPlainStream(std::shared_ptr<libCZI::IStream> stream) : stream(stream) {}
+				virtual void Read(std::uint64_t offset, void *pv, std::uint64_t size, std::uint64_t* ptrBytesRead) override
+				{
+					this->stream->Read(offset, pv, size, ptrBytesRead);
+				}
+			};
+
+			auto cziData = CTestCziData::CreateMosaic(4, 3, 20, 2);
+			auto filename = CTestCziData::WriteToTemporaryFile(cziData);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+
+			std::shared_ptr<libCZI::IStream> streams[] =
+			{
+				CreateStreamFromFile(filename.c_str()),
+				CreateStreamFromMemory(spBuffer, cziData.size()),
+				std::make_shared<CPlainStream>(CreateStreamFromMemory(spBuffer, cziData.size()))
+			};
+
+			const std::vector<int> indices = { 5, 0, 6, 7, 23, 1000, 12, 13 };
+			for (const auto& stream : streams)
+			{
+				auto spReader = libCZI::CreateCZIReader();
+				spReader->Open(stream);
+				auto subBlocks = spReader->ReadSubBlocks(indices);
+				Assert::IsTrue(subBlocks.size() == indices.size(), L"incorrect result", LINE_INFO());
+				for (size_t i = 0; i < indices.size(); ++i)
+				{
+					if (indices[i] >= 24)
+					{
+						Assert::IsTrue(!subBlocks[i], L"expected an empty result for an invalid index", LINE_INFO());
+						continue;
+					}
+
+					const void* ptr; size_t size;
+					subBlocks[i]->DangerousGetRawData(ISubBlock::MemBlkType::Data, ptr, size);
+					const void* ptrExpected; size_t sizeExpected;
+					auto expected = spReader->ReadSubBlock(indices[i]);
+					expected->DangerousGetRawData(ISubBlock::MemBlkType::Data, ptrExpected, sizeExpected);
+					Assert::IsTrue(size == sizeExpected && memcmp(ptr, ptrExpected, size) == 0, L"incorrect result", LINE_INFO());
+					Assert::IsTrue(subBlocks[i]->GetSubBlockInfo().mIndex == indices[i] % 12, L"incorrect result", LINE_INFO());
+				}
+			}
+
+#if defined(_WIN32)
+			_wremove(filename.c_str());
+#else
+			remove(std::string(filename.begin(), filename.end()).c_str());
+#endif
+		}
+
+		TEST_METHOD(TestMethod_ReadSubBlocksDefaultImplementation)
+		{
+			// a repository which does not implement ReadSubBlocks, so the default implementation (calling ReadSubBlock
+			//  for each index) is used
+			class CRepository : public libCZI::ISubBlockRepository
+			{
+			private:
+				std::shared_ptr<libCZI::ICZIReader> reader;
+			public:
+				int readCount;
+
+				CRepository(std::shared_ptr<libCZI::ICZIReader> reader) : reader(reader), readCount(0) {}
+				virtual void EnumerateSubBlocks(std::function<bool(int index, const SubBlockInfo& info)> funcEnum) override { this->reader->EnumerateSubBlocks(funcEnum); }
+				virtual void EnumSubset(const IDimCoordinate* planeCoordinate, const IntRect* roi, bool onlyLayer0, std::function<bool(int index, const SubBlockInfo& info)> funcEnum) override { this->reader->EnumSubset(planeCoordinate, roi, onlyLayer0, funcEnum); }
+				virtual std::shared_ptr<ISubBlock> ReadSubBlock(int index) override { ++this->readCount; return this->reader->ReadSubBlock(index); }
+				virtual bool TryGetSubBlockInfoOfArbitrarySubBlockInChannel(int channelIndex, SubBlockInfo& info) override { return this->reader->TryGetSubBlockInfoOfArbitrarySubBlockInChannel(channelIndex, info); }
+				virtual SubBlockStatistics GetStatistics() override { return this->reader->GetStatistics(); }
+				virtual PyramidStatistics GetPyramidStatistics() override { return this->reader->GetPyramidStatistics(); }
+			};
+
+			auto cziData = CTestCziData::CreateMosaic(3, 2, 20, 1);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+			CRepository repository(spReader);
+
+			const std::vector<int> indices = { 4, 1, 100, 0 };
+			auto subBlocks = repository.ReadSubBlocks(indices);
+			Assert::IsTrue(subBlocks.size() == indices.size() && repository.readCount == (int)indices.size(), L"incorrect result", LINE_INFO());
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				if (indices[i] >= 6)
+				{
+					Assert::IsTrue(!subBlocks[i], L"expected an empty result for an invalid index", LINE_INFO());
+					continue;
+				}
+
+				Assert::IsTrue(subBlocks[i] && subBlocks[i]->GetSubBlockInfo().mIndex == indices[i], L"incorrect result", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestMethod_ReadSubBlocksFileOrder)
+		{
+			// a stream which records the reads
+			class CRecordingStream : public libCZI::IStream
+			{
+			private:
+				std::shared_ptr<libCZI::IStream> stream;
+			public:
+				std::vector<std::uint64_t> offsets;
+
+				CRecordingStream(std::shared_ptr<libCZI::IStream> stream) : stream(stream) {}
+
+				virtual void Read(std::uint64_t offset, void *pv, std::uint64_t size, std::uint64_t* ptrBytesRead) override
+				{
+					this->offsets.push_back(offset);
+					this->stream->Read(offset, pv, size, ptrBytesRead);
+				}
+			};
+
+			// the sub-blocks are requested in reverse order - they are read in the order of their position in the file, and
+			//  adjacent ones are read together: small sub-blocks with a single read, large ones with one read for each
+			//  segment-header and one read for all the payloads
+			for (int tileSize : { 20, 600 })
+			{
+				auto cziData = CTestCziData::CreateMosaic(3, 3, tileSize, 1);
+				std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+				auto stream = std::make_shared<CRecordingStream>(CreateStreamFromMemory(spBuffer, cziData.size()));
+				auto spReader = libCZI::CreateCZIReader();
+				spReader->Open(stream);
+
+				const std::vector<int> indices = { 8, 7, 6, 5, 4, 3, 2, 1, 0 };
+				stream->offsets.clear();
+				auto subBlocks = spReader->ReadSubBlocks(indices);
+				const std::vector<std::uint64_t> offsets = stream->offsets;
+				Assert::IsTrue(offsets.size() == (tileSize == 20 ? 1 : 10), L"unexpected number of reads", LINE_INFO());
+				Assert::IsTrue(std::is_sorted(offsets.begin(), offsets.end() - 1), L"expected the reads to be in file order", LINE_INFO());
+
+				for (size_t i = 0; i < indices.size(); ++i)
+				{
+					const void* ptr; size_t size;
+					subBlocks[i]->DangerousGetRawData(ISubBlock::MemBlkType::Data, ptr, size);
+					const void* ptrExpected; size_t sizeExpected;
+					auto expected = spReader->ReadSubBlock(indices[i]);
+					expected->DangerousGetRawData(ISubBlock::MemBlkType::Data, ptrExpected, sizeExpected);
+					Assert::IsTrue(size == sizeExpected && memcmp(ptr, ptrExpected, size) == 0, L"incorrect result", LINE_INFO());
+					Assert::IsTrue(subBlocks[i]->GetSubBlockInfo().mIndex == indices[i], L"incorrect result", LINE_INFO());
+				}
+			}
+		}
+
+		TEST_METHOD(TestMethod_ReadSubBlocksCoalescedPayloadNotShared)
+		{
+			// An allocator which keeps track of the memory in use.
+			std::map<void*, size_t> allocations;
+			size_t bytesAllocated = 0;
+			CCZIParse::SubBlockStorageAllocate allocateInfo
+			{
+				[&](size_t size)->void* { void* ptr = malloc(size); allocations[ptr] = size; bytesAllocated += size; return ptr; },
+				[&](void* ptr)->void { bytesAllocated -= allocations[ptr]; allocations.erase(ptr); free(ptr); }
+			};
+
+			// The uncompressed sub-blocks are read together (small ones with a single read, large ones with one read for all
+			//  the payloads) - if only one of them is kept (e. g. because the bitmap referring to its data is kept in the
+			//  sub-block cache), it must not keep the complete read alive, but only its own payload.
+			for (int tileSize : { 20, 600 })
+			{
+				auto cziData = CTestCziData::CreateMosaic(3, 3, tileSize, 1);
+				std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+				auto spStream = CreateStreamFromMemory(spBuffer, cziData.size());
+
+				// a stream which only implements IStream (so that we do not get a view of the data)
+				class CPlainStream : public libCZI::IStream
+				{
+				private:
+					libCZI::IStream* stream;
+				public:
+					CPlainStream(libCZI::IStream* stream) : stream(stream) {}
+					virtual void Read(std::uint64_t offset, void *pv, std::uint64_t size, std::uint64_t* ptrBytesRead) override
+					{
+						this->stream->Read(offset, pv, size, ptrBytesRead);
+					}
+				} stream(spStream.get());
+
+				auto fileHeader = CCZIParse::ReadFileHeaderSegment(&stream);
+				auto subBlockDirectory = CCZIParse::ReadSubBlockDirectory(&stream, fileHeader.GetSubBlockDirectoryPosition());
+				std::vector<std::uint64_t> offsets;
+				subBlockDirectory.EnumSubBlocks([&](int index, const CCziSubBlockDirectory::SubBlkEntry& entry)->bool { offsets.push_back(entry.FilePosition); return true; });
+
+				auto subBlocks = CCZIParse::ReadSubBlocks(&stream, offsets, allocateInfo);
+				Assert::IsTrue(subBlocks.size() == 9, L"incorrect result", LINE_INFO());
+				CCZIParse::SubBlockData subBlock = subBlocks[4];
+				subBlocks.clear();
+
+				Assert::IsTrue(subBlock.dataSize == (std::uint64_t)tileSize * tileSize, L"incorrect result", LINE_INFO());
+				Assert::IsTrue(bytesAllocated == subBlock.dataSize + subBlock.metaDataSize + subBlock.attachmentSize, L"the sub-block keeps more memory alive than its payload", LINE_INFO());
+				const std::uint8_t* p = static_cast<const std::uint8_t*>(subBlock.ptrData);
+				Assert::IsTrue(p[0] == CTestCziData::GetPixelValue(4, 0, 0) && p[tileSize * tileSize - 1] == CTestCziData::GetPixelValue(4, tileSize - 1, tileSize - 1), L"incorrect result", LINE_INFO());
+
+				subBlock.spPayload.reset();
+				Assert::IsTrue(bytesAllocated == 0, L"memory was not released", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestMethod_StreamMemoryMapped)
+		{
+			auto cziData = CTestCziData::CreateMosaic(3, 2, 32, 2);
+			auto filename = CTestCziData::WriteToTemporaryFile(cziData);
+
+			std::shared_ptr<const void> spData;
+			{
+				auto spReader = libCZI::CreateCZIReader();
+				spReader->Open(CreateStreamFromFileMapped(filename.c_str()));
+				auto sbBlk = spReader->ReadSubBlock(7);
+				spData = sbBlk->GetRawData(ISubBlock::MemBlkType::Data, nullptr);
+				{
+					// for reading (as done by the accessors), the bitmap uses the sub-block's data directly
+					auto bitmap = CreateBitmapFromSubBlockForReading(sbBlk.get(), nullptr);
+					ScopedBitmapLockerSP lck{ bitmap };
+					Assert::IsTrue(lck.ptrDataRoi == spData.get(), L"expected the bitmap to use the sub-block's data without a copy", LINE_INFO());
+				}
+
+				{
+					// otherwise, the mapping is read-only, so the bitmap is a copy which can be written to
+					auto bitmap = sbBlk->CreateBitmap();
+					ScopedBitmapLockerSP lck{ bitmap };
+					Assert::IsTrue(lck.ptrDataRoi != spData.get(), L"expected the bitmap to be a copy of the sub-block's data", LINE_INFO());
+					Assert::IsTrue(static_cast<const std::uint8_t*>(lck.ptrDataRoi)[31 * lck.stride + 31] == CTestCziData::GetPixelValue(7, 31, 31), L"incorrect result", LINE_INFO());
+					memset(lck.ptrDataRoi, 0, lck.stride * 32);
+				}
+
+				{
+					auto bitmap = libCZI::CreateBitmapFromSubBlock(sbBlk.get(), IntRect{ 3, 5, 10, 7 });
+					ScopedBitmapLockerSP lck{ bitmap };
+					Assert::IsTrue(bitmap->GetWidth() == 10 && bitmap->GetHeight() == 7, L"incorrect size", LINE_INFO());
+					Assert::IsTrue(static_cast<const std::uint8_t*>(lck.ptrDataRoi)[6 * lck.stride + 9] == CTestCziData::GetPixelValue(7, 12, 11), L"incorrect result", LINE_INFO());
+					memset(lck.ptrDataRoi, 0, lck.stride * 7);
+				}
+
+				spReader->Close();
+			}
+
+			// the data must still be accessible after the reader and the stream have been destroyed
+			const std::uint8_t* ptr = static_cast<const std::uint8_t*>(spData.get());
+			bool correct = true;
+			for (int y = 0; y < 32; ++y)
+			{
+				for (int x = 0; x < 32; ++x)
+				{
+					if (ptr[y * 32 + x] != CTestCziData::GetPixelValue(7, x, y))
+					{
+						correct = false;
+					}
+				}
+			}
+
+			Assert::IsTrue(correct, L"incorrect result", LINE_INFO());
+			spData.reset();
+#if defined(_WIN32)
+			_wremove(filename.c_str());
+#else
+			remove(std::string(filename.begin(), filename.end()).c_str());
+#endif
+		}
 	};
 }
\ No newline at end of file
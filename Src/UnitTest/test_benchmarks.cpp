@@ -0,0 +1,619 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+
+#include "inc_libCZI.h"
+#include "testCziData.h"
+#include "../JxrDecode/JxrDecode.h"
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace libCZI;
+using namespace std;
+
+namespace UnitTest
+{
+	/// A stream (on a memory-block) which counts the calls to Read and which adds a fixed latency to each
+	/// call - in order to simulate e.g. a network file system.
+	class CTestLatencyStream : public libCZI::IStream
+	{
+	private:
+		std::shared_ptr<libCZI::IStream> stream;
+		std::chrono::microseconds latency;
+		std::atomic<int> readCount;
+	public:
+		CTestLatencyStream(std::shared_ptr<const void> ptr, size_t size, std::chrono::microseconds latency)
+			: stream(CreateStreamFromMemory(ptr, size)), latency(latency), readCount(0)
+		{}
+
+		int GetReadCount() const { return this->readCount.load(); }
+
+		virtual void Read(std::uint64_t offset, void *pv, std::uint64_t size, std::uint64_t* ptrBytesRead) override
+		{
+			++this->readCount;
+			if (this->latency.count() > 0)
+			{
+				std::this_thread::sleep_for(this->latency);
+			}
+
+			this->stream->Read(offset, pv, size, ptrBytesRead);
+		}
+	};
+
+	TEST_CLASS(UnitTest_Benchmarks)
+	{
+	public:
+		TEST_METHOD(Benchmark_ReadSubBlock)
+		{
+			static const int MetadataSize = 2000;
+			static const int AttachmentSize = 500;
+			static const int Latency = 500;	// in microseconds
+
+			// Sub-blocks with metadata and attachment required up to four reads each (header, metadata, data and
+			//  attachment). Now the segment is read with a single read if it fits into the speculative read, and
+			//  with two reads otherwise.
+			for (int tileSize : { 64, 512 })
+			{
+				auto cziData = CTestCziData::CreateMosaic(4, 4, tileSize, 1, MetadataSize, AttachmentSize);
+				std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+				auto stream = std::make_shared<CTestLatencyStream>(spBuffer, cziData.size(), std::chrono::microseconds(Latency));
+				auto spReader = libCZI::CreateCZIReader();
+				spReader->Open(stream);
+				int readCountAfterOpen = stream->GetReadCount();
+
+				auto start = std::chrono::high_resolution_clock::now();
+				for (int i = 0; i < 16; ++i)
+				{
+					auto sbBlk = spReader->ReadSubBlock(i);
+					const void* ptr; size_t size;
+					sbBlk->DangerousGetRawData(ISubBlock::MemBlkType::Metadata, ptr, size);
+					Assert::IsTrue(size == MetadataSize && static_cast<const std::uint8_t*>(ptr)[size - 1] == CTestCziData::MetadataValue, L"incorrect metadata", LINE_INFO());
+					sbBlk->DangerousGetRawData(ISubBlock::MemBlkType::Data, ptr, size);
+					Assert::IsTrue(size == (size_t)tileSize * tileSize && static_cast<const std::uint8_t*>(ptr)[0] == CTestCziData::GetPixelValue(i, 0, 0), L"incorrect data", LINE_INFO());
+					sbBlk->DangerousGetRawData(ISubBlock::MemBlkType::Attachment, ptr, size);
+					Assert::IsTrue(size == AttachmentSize && static_cast<const std::uint8_t*>(ptr)[0] == CTestCziData::AttachmentValue, L"incorrect attachment", LINE_INFO());
+				}
+
+				auto end = std::chrono::high_resolution_clock::now();
+				int readsPerSubBlock = (stream->GetReadCount() - readCountAfterOpen) / 16;
+				Assert::IsTrue(readsPerSubBlock <= 2, L"expected at most two reads per sub-block", LINE_INFO());
+
+				std::stringstream ss;
+				ss << "ReadSubBlock (tile size " << tileSize << "x" << tileSize << ", " << Latency << "us latency per read): " << readsPerSubBlock << " read(s) per sub-block (instead of 4), "
+					<< std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 16 << "us per sub-block" << endl;
+				Logger::WriteMessage(ss.str().c_str());
+			}
+		}
+
+		TEST_METHOD(Benchmark_OpenLargeSubBlockDirectory)
+		{
+			static const int CountX = 250;
+			static const int CountY = 200;
+			static const int ChannelCount = 2;
+			static const int SubBlockCount = CountX * CountY * ChannelCount;
+
+			// The directory is large enough to be parsed on multiple threads (on a machine with more than one core).
+			auto cziData = CTestCziData::CreateMosaic(CountX, CountY, 1, ChannelCount);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+
+			long long bestTime = (std::numeric_limits<long long>::max)();
+			for (int i = 0; i < 3; ++i)
+			{
+				auto spReader = libCZI::CreateCZIReader();
+				auto start = std::chrono::high_resolution_clock::now();
+				spReader->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+				auto end = std::chrono::high_resolution_clock::now();
+				bestTime = (std::min)(bestTime, (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+
+				auto statistics = spReader->GetStatistics();
+				Assert::IsTrue(statistics.subBlockCount == SubBlockCount, L"incorrect statistics", LINE_INFO());
+				Assert::IsTrue(statistics.boundingBox.x == 0 && statistics.boundingBox.y == 0 && statistics.boundingBox.w == CountX && statistics.boundingBox.h == CountY, L"incorrect statistics", LINE_INFO());
+				Assert::IsTrue(statistics.minMindex == 0 && statistics.maxMindex == CountX * CountY - 1, L"incorrect statistics", LINE_INFO());
+				int startC, sizeC;
+				Assert::IsTrue(statistics.dimBounds.TryGetInterval(DimensionIndex::C, &startC, &sizeC) && startC == 0 && sizeC == ChannelCount, L"incorrect statistics", LINE_INFO());
+				auto pyramidStatistics = spReader->GetPyramidStatistics();
+				Assert::IsTrue(pyramidStatistics.scenePyramidStatistics.size() == 1 && pyramidStatistics.scenePyramidStatistics.begin()->second.size() == 1 &&
+					pyramidStatistics.scenePyramidStatistics.begin()->second[0].count == SubBlockCount, L"incorrect statistics", LINE_INFO());
+
+				int count = 0;
+				bool orderCorrect = true;
+				spReader->EnumerateSubBlocks(
+					[&](int index, const SubBlockInfo& info)->bool
+				{
+					int c;
+					info.coordinate.TryGetPosition(DimensionIndex::C, &c);
+					orderCorrect &= (index == count && info.mIndex == count % (CountX * CountY) && c == count / (CountX * CountY));
+					++count;
+					return true;
+				});
+
+				Assert::IsTrue(count == SubBlockCount && orderCorrect, L"incorrect enumeration", LINE_INFO());
+			}
+
+			std::stringstream ss;
+			ss << "Open (" << SubBlockCount << " sub-blocks, " << std::thread::hardware_concurrency() << " hardware threads): " << bestTime / 1000.0 << "ms, "
+				<< (bestTime > 0 ? (SubBlockCount * 1000000LL) / bestTime : 0) << " entries per second" << endl;
+			Logger::WriteMessage(ss.str().c_str());
+		}
+
+		TEST_METHOD(Benchmark_AccessorPrefetch)
+		{
+			static const int Count = 6;
+			static const int TileSize = 256;
+			static const int Latency = 1000;	// in microseconds
+
+			// With a prefetch-depth, the sub-blocks are read on a separate I/O-thread ahead of the decoding (here: the
+			//  conversion to Bgr48), so the latency of the reads overlaps with the decoding. With a read-batch-size, the
+			//  sub-blocks of a batch are read in file order, with adjacent ones combined into one read - the result is identical.
+			auto cziData = CTestCziData::CreateMosaic(Count, Count, TileSize, 1);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto stream = std::make_shared<CTestLatencyStream>(spBuffer, cziData.size(), std::chrono::microseconds(Latency));
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(stream);
+			auto accessor = spReader->CreateSingleChannelTileAccessor();
+			const IntRect roi{ 0, 0, Count * TileSize, Count * TileSize };
+			auto planeCoordinate = CDimCoordinate::Parse("C0");
+
+			std::vector<std::uint8_t> reference;
+			std::stringstream ss;
+			ss << "Tile accessor (" << Count * Count << " sub-blocks, " << Latency << "us latency per read):";
+			static const struct { int prefetchDepth; int readBatchSize; } Configurations[] = { { 0, 1 }, { 1, 1 }, { 4, 1 }, { 0, 6 }, { 6, 6 } };
+			for (const auto& configuration : Configurations)
+			{
+				ISingleChannelTileAccessor::Options options; options.Clear();
+				options.prefetchDepth = configuration.prefetchDepth;
+				options.readBatchSize = configuration.readBatchSize;
+				auto start = std::chrono::high_resolution_clock::now();
+				auto bitmap = accessor->Get(PixelType::Bgr48, roi, &planeCoordinate, &options);
+				auto end = std::chrono::high_resolution_clock::now();
+
+				std::vector<std::uint8_t> pixels((size_t)roi.w * roi.h * 6);
+				{
+					ScopedBitmapLockerSP lck{ bitmap };
+					for (int y = 0; y < roi.h; ++y)
+					{
+						memcpy(&pixels[(size_t)y * roi.w * 6], static_cast<const std::uint8_t*>(lck.ptrDataRoi) + y * lck.stride, (size_t)roi.w * 6);
+					}
+				}
+
+				if (reference.empty())
+				{
+					reference = std::move(pixels);
+				}
+				else
+				{
+					Assert::IsTrue(pixels == reference, L"result differs with prefetching or batched reads", LINE_INFO());
+				}
+
+				ss << " prefetch-depth " << configuration.prefetchDepth << "/batch-size " << configuration.readBatchSize << ": " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0 << "ms";
+			}
+
+			ss << endl;
+			Logger::WriteMessage(ss.str().c_str());
+		}
+
+		TEST_METHOD(Benchmark_ConvertPixels)
+		{
+			static const int Width = 1024;
+			static const int Height = 1024;
+			static const struct { PixelType src; PixelType dst; const char* name; } conversions[] =
+			{
+				{ PixelType::Gray8, PixelType::Gray16, "Gray8->Gray16" },
+				{ PixelType::Gray8, PixelType::Gray32Float, "Gray8->Gray32Float" },
+				{ PixelType::Gray8, PixelType::Bgr24, "Gray8->Bgr24" },
+				{ PixelType::Gray8, PixelType::Bgr48, "Gray8->Bgr48" },
+				{ PixelType::Bgr24, PixelType::Gray8, "Bgr24->Gray8" },
+				{ PixelType::Bgr24, PixelType::Gray16, "Bgr24->Gray16" },
+				{ PixelType::Bgr24, PixelType::Gray32Float, "Bgr24->Gray32Float" },
+				{ PixelType::Bgr24, PixelType::Bgr48, "Bgr24->Bgr48" },
+				{ PixelType::Gray16, PixelType::Gray8, "Gray16->Gray8" },
+				{ PixelType::Gray16, PixelType::Gray32Float, "Gray16->Gray32Float" },
+				{ PixelType::Gray32Float, PixelType::Gray8, "Gray32Float->Gray8" },
+				{ PixelType::Gray32Float, PixelType::Gray16, "Gray32Float->Gray16" },
+				{ PixelType::Bgr48, PixelType::Bgr24, "Bgr48->Bgr24" },
+				{ PixelType::Bgr24, PixelType::Bgra32, "Bgr24->Bgra32" },
+				{ PixelType::Bgra32, PixelType::Bgr24, "Bgra32->Bgr24" }
+			};
+
+			std::vector<std::uint8_t> src(Width * Height * 6);
+			for (size_t i = 0; i < src.size(); ++i)
+			{
+				src[i] = (std::uint8_t)((i * 7919) >> 3);
+			}
+
+			std::vector<std::uint8_t> srcFloat(Width * Height * sizeof(float));
+			for (size_t i = 0; i < Width * Height; ++i)
+			{
+				const float v = (float)((i * 7919) % 70000) / 3;
+				memcpy(&srcFloat[i * sizeof(float)], &v, sizeof(float));
+			}
+
+			for (const auto& c : conversions)
+			{
+				const int srcStride = Width * CziUtils::GetBytesPerPel(c.src);
+				const int dstStride = Width * CziUtils::GetBytesPerPel(c.dst);
+				std::vector<std::uint8_t> reference;
+				std::stringstream ss;
+				ss << "Convert " << c.name << " (" << Width << "x" << Height << "):";
+				for (CBitmapOperations::SimdLevel simdLevel : { CBitmapOperations::SimdLevel::None, CBitmapOperations::SimdLevel::SSE41, CBitmapOperations::SimdLevel::AVX2 })
+				{
+					auto convertLine = CBitmapOperations::GetConvertLineFunction(c.src, c.dst, simdLevel);
+					std::vector<std::uint8_t> dst(dstStride * Height);
+					long long bestTime = (std::numeric_limits<long long>::max)();
+					for (int i = 0; i < 10; ++i)
+					{
+						auto start = std::chrono::high_resolution_clock::now();
+						for (int y = 0; y < Height; ++y)
+						{
+							convertLine(&(c.src == PixelType::Gray32Float ? srcFloat : src)[y * srcStride], &dst[y * dstStride], Width);
+						}
+
+						auto end = std::chrono::high_resolution_clock::now();
+						bestTime = (std::min)(bestTime, (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+					}
+
+					if (reference.empty())
+					{
+						reference = dst;
+					}
+					else
+					{
+						Assert::IsTrue(dst == reference, L"result differs between instruction sets", LINE_INFO());
+					}
+
+					static const char* const names[] = { "none", "SSE4.1", "AVX2" };
+					ss << " " << names[(int)simdLevel] << " " << bestTime << "us";
+				}
+
+				ss << " (supported: " << (int)CBitmapOperations::GetSupportedSimdLevel() << ")" << endl;
+				Logger::WriteMessage(ss.str().c_str());
+			}
+		}
+
+		TEST_METHOD(Benchmark_NNResize)
+		{
+			static const int SrcSize = 2048;
+			static const int Repeat = 5;
+			for (PixelType pixelType : { PixelType::Gray8, PixelType::Gray16, PixelType::Bgr24, PixelType::Bgr48 })
+			{
+				for (int dstSize : { 1000, 3000 })
+				{
+					const int bytesPerPel = CziUtils::GetBytesPerPel(pixelType);
+					std::vector<std::uint8_t> src(SrcSize * SrcSize * bytesPerPel);
+					for (size_t i = 0; i < src.size(); ++i)
+					{
+						src[i] = (std::uint8_t)((i * 7919) >> 3);
+					}
+
+					std::vector<std::uint8_t> dst(dstSize * dstSize * bytesPerPel);
+					CBitmapOperations::NNResizeInfo2Dbl resizeInfo;
+					resizeInfo.srcPtr = &src[0];
+					resizeInfo.srcStride = SrcSize * bytesPerPel;
+					resizeInfo.srcWidth = resizeInfo.srcHeight = SrcSize;
+					resizeInfo.srcOffsetX = resizeInfo.srcOffsetY = 0;
+					resizeInfo.srcRoiX = resizeInfo.srcRoiY = 0.3;
+					resizeInfo.srcRoiW = resizeInfo.srcRoiH = SrcSize - 1;
+					resizeInfo.dstPtr = &dst[0];
+					resizeInfo.dstStride = dstSize * bytesPerPel;
+					resizeInfo.dstWidth = resizeInfo.dstHeight = dstSize;
+					resizeInfo.dstRoiX = resizeInfo.dstRoiY = 0;
+					resizeInfo.dstRoiW = resizeInfo.dstRoiH = dstSize;
+
+					auto measure = [&](const std::function<void()>& func)->long long
+					{
+						long long bestTime = (std::numeric_limits<long long>::max)();
+						for (int i = 0; i < Repeat; ++i)
+						{
+							auto start = std::chrono::high_resolution_clock::now();
+							func();
+							auto end = std::chrono::high_resolution_clock::now();
+							bestTime = (std::min)(bestTime, (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+						}
+
+						return bestTime;
+					};
+
+					// the complete resize (creating the plan each time, or taking it from the cache), and only gathering the
+					//  pixels of the lines (without and with AVX2)
+					CNNResizePlanCache planCache(1);
+					const long long timeWithPlan = measure([&]()->void { CBitmapOperations::NNSCale2(pixelType, pixelType, resizeInfo); });
+					const long long timeWithCachedPlan = measure([&]()->void { CBitmapOperations::NNSCale2(pixelType, pixelType, resizeInfo, *planCache.GetOrCreate(resizeInfo)); });
+					const auto plan = planCache.GetOrCreate(resizeInfo);
+					std::vector<std::uint8_t> reference;
+					std::stringstream ss;
+					ss << "NNResize " << Utils::PixelTypeToInformalString(pixelType) << " (" << SrcSize << "x" << SrcSize << " -> " << dstSize << "x" << dstSize << "): "
+						<< timeWithPlan << "us, with cached plan " << timeWithCachedPlan << "us, gathering the lines:";
+					for (CBitmapOperations::SimdLevel simdLevel : { CBitmapOperations::SimdLevel::None, CBitmapOperations::SimdLevel::AVX2 })
+					{
+						auto gatherLine = CBitmapOperations::GetGatherLineFunction(bytesPerPel, simdLevel);
+						const long long time = measure([&]()->void
+						{
+							for (size_t y = 0; y < plan->srcY.size(); ++y)
+							{
+								gatherLine(&src[plan->srcY[y] * resizeInfo.srcStride], SrcSize, &plan->srcX[0], &dst[(plan->dstYStart + y) * resizeInfo.dstStride + plan->dstXStart * bytesPerPel], (int)plan->srcX.size());
+							}
+						});
+
+						if (reference.empty())
+						{
+							reference = dst;
+						}
+						else
+						{
+							Assert::IsTrue(dst == reference, L"result differs between instruction sets", LINE_INFO());
+						}
+
+						ss << " " << (simdLevel == CBitmapOperations::SimdLevel::None ? "none " : "AVX2 ") << time << "us";
+					}
+
+					ss << endl;
+					Logger::WriteMessage(ss.str().c_str());
+				}
+			}
+		}
+
+		TEST_METHOD(Benchmark_BoxResize)
+		{
+			static const int SrcSize = 2048;
+			static const int Repeat = 5;
+			for (PixelType pixelType : { PixelType::Gray8, PixelType::Gray16, PixelType::Bgr24, PixelType::Bgr48 })
+			{
+				for (int dstSize : { 512, 1000 })
+				{
+					const int bytesPerPel = CziUtils::GetBytesPerPel(pixelType);
+					std::vector<std::uint8_t> src(SrcSize * SrcSize * bytesPerPel);
+					for (size_t i = 0; i < src.size(); ++i)
+					{
+						src[i] = (std::uint8_t)((i * 7919) >> 3);
+					}
+
+					std::vector<std::uint8_t> dst(dstSize * dstSize * bytesPerPel);
+					CBitmapOperations::NNResizeInfo2Dbl resizeInfo;
+					resizeInfo.srcPtr = &src[0];
+					resizeInfo.srcStride = SrcSize * bytesPerPel;
+					resizeInfo.srcWidth = resizeInfo.srcHeight = SrcSize;
+					resizeInfo.srcOffsetX = resizeInfo.srcOffsetY = 0;
+					resizeInfo.srcRoiX = resizeInfo.srcRoiY = 0;
+					resizeInfo.srcRoiW = resizeInfo.srcRoiH = SrcSize;
+					resizeInfo.dstPtr = &dst[0];
+					resizeInfo.dstStride = dstSize * bytesPerPel;
+					resizeInfo.dstWidth = resizeInfo.dstHeight = dstSize;
+					resizeInfo.dstRoiX = resizeInfo.dstRoiY = 0;
+					resizeInfo.dstRoiW = resizeInfo.dstRoiH = dstSize;
+
+					auto measure = [&](const std::function<void()>& func)->long long
+					{
+						long long bestTime = (std::numeric_limits<long long>::max)();
+						for (int i = 0; i < Repeat; ++i)
+						{
+							auto start = std::chrono::high_resolution_clock::now();
+							func();
+							auto end = std::chrono::high_resolution_clock::now();
+							bestTime = (std::min)(bestTime, (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+						}
+
+						return bestTime;
+					};
+
+					// the nearest-neighbor resize for comparison, the complete area-averaging resize, and only accumulating
+					//  all source lines (which is the bulk of the work) without and with SIMD
+					CBitmapOperations::BoxResizePlan plan;
+					CBitmapOperations::CreateBoxResizePlan(resizeInfo, plan);
+					const long long timeNN = measure([&]()->void { CBitmapOperations::NNSCale2(pixelType, pixelType, resizeInfo); });
+					const long long timeBox = measure([&]()->void { CBitmapOperations::BoxScale2(pixelType, pixelType, resizeInfo, plan); });
+					std::stringstream ss;
+					ss << "BoxResize " << Utils::PixelTypeToInformalString(pixelType) << " (" << SrcSize << "x" << SrcSize << " -> " << dstSize << "x" << dstSize << "): "
+						<< timeBox << "us (nearest-neighbor " << timeNN << "us), accumulating the lines:";
+					std::vector<float> accumulated(SrcSize * bytesPerPel);
+					for (CBitmapOperations::SimdLevel simdLevel : { CBitmapOperations::SimdLevel::None, CBitmapOperations::SimdLevel::SSE41, CBitmapOperations::SimdLevel::AVX2 })
+					{
+						auto accumulateLine = CBitmapOperations::GetAccumulateLineFunction(pixelType, simdLevel);
+						const int elementCount = SrcSize * (pixelType == PixelType::Gray8 || pixelType == PixelType::Gray16 ? 1 : 3);
+						const long long time = measure([&]()->void
+						{
+							for (int y = 0; y < SrcSize; ++y)
+							{
+								accumulateLine(&src[y * resizeInfo.srcStride], 0.5f, &accumulated[0], elementCount);
+							}
+						});
+
+						ss << " " << (simdLevel == CBitmapOperations::SimdLevel::None ? "none " : simdLevel == CBitmapOperations::SimdLevel::SSE41 ? "SSE4.1 " : "AVX2 ") << time << "us";
+					}
+
+					ss << endl;
+					Logger::WriteMessage(ss.str().c_str());
+				}
+			}
+		}
+
+		TEST_METHOD(Benchmark_DecodeJxr)
+		{
+			static const int Repeat = 200;
+
+			// The inverse transform and the color conversion of the JPG-XR decoder are vectorized (SSE2 and AVX2, selected
+			//  at runtime) - the result must be identical for all instruction sets, and it is compared to the original image.
+			std::vector<std::uint8_t> reference;
+			std::stringstream ss;
+			ss << "Decode JPG-XR (" << CTestCziData::JxrTestTileSize << "x" << CTestCziData::JxrTestTileSize << " Bgr24):";
+			for (JxrDecode::SimdLevel simdLevel : { JxrDecode::SimdLevel::None, JxrDecode::SimdLevel::SSE2, JxrDecode::SimdLevel::AVX2, JxrDecode::SimdLevel::Automatic })
+			{
+				JxrDecode::WMPDECAPPARGS args;
+				args.Clear();
+				args.uAlphaMode = 0;
+				args.simdLevel = simdLevel;
+
+				std::vector<std::uint8_t> decoded(CTestCziData::JxrTestTileSize * CTestCziData::JxrTestTileSize * 3);
+				auto codec = JxrDecode::Initialize();
+				long long bestTime = (std::numeric_limits<long long>::max)();
+				for (int i = 0; i < Repeat; ++i)
+				{
+					auto start = std::chrono::high_resolution_clock::now();
+					JxrDecode::DecodeInto(
+						codec,
+						&args,
+						CTestCziData::JxrTestTile,
+						CTestCziData::JxrTestTileDataSize,
+						[](JxrDecode::PixelFormat pixFmt)->JxrDecode::PixelFormat {return pixFmt; },
+						[&](JxrDecode::PixelFormat pixFmt, std::uint32_t width, std::uint32_t height, void** ptrDestination, std::uint32_t* stride)->void
+					{
+						Assert::IsTrue(pixFmt == JxrDecode::PixelFormat::_24bppBGR && width == (std::uint32_t)CTestCziData::JxrTestTileSize && height == (std::uint32_t)CTestCziData::JxrTestTileSize, L"unexpected format", LINE_INFO());
+						*ptrDestination = &decoded[0];
+						*stride = CTestCziData::JxrTestTileSize * 3;
+					});
+					auto end = std::chrono::high_resolution_clock::now();
+					bestTime = (std::min)(bestTime, (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+				}
+
+				JxrDecode::Destroy(codec);
+
+				if (reference.empty())
+				{
+					int maxError = 0;
+					for (int y = 0; y < CTestCziData::JxrTestTileSize; ++y)
+					{
+						for (int x = 0; x < CTestCziData::JxrTestTileSize; ++x)
+						{
+							for (int c = 0; c < 3; ++c)
+							{
+								maxError = (std::max)(maxError, std::abs(CTestCziData::GetJxrTestTilePixel(x, y, c) - decoded[(y * CTestCziData::JxrTestTileSize + x) * 3 + c]));
+							}
+						}
+					}
+
+					Assert::IsTrue(maxError <= 8, L"decoded image differs from the original", LINE_INFO());
+					reference = decoded;
+				}
+				else
+				{
+					Assert::IsTrue(decoded == reference, L"result differs between instruction sets", LINE_INFO());
+				}
+
+				static const char* const names[] = { "automatic", "none", "SSE2", "AVX2" };
+				ss << " " << names[(int)simdLevel] << " " << bestTime << "us";
+			}
+
+			ss << endl;
+			Logger::WriteMessage(ss.str().c_str());
+		}
+
+		TEST_METHOD(Benchmark_ParallelBitmapOperations)
+		{
+			static const int SrcWidth = 4096;
+			static const int SrcHeight = 3072;
+			static const int Repeat = 3;
+
+			// the operations on large bitmaps (as they are done when composing a large scaled image) with the rows
+			//  processed in bands on 1 to 64 threads - the results must be the same as with one thread
+			struct ResetThreadCount { ~ResetThreadCount() { libCZI::SetBitmapOperationsThreadCount(1); } } resetThreadCount;
+			auto src = CBitmapData<CHeapAllocator>::Create(PixelType::Bgr24, SrcWidth, SrcHeight);
+			{
+				ScopedBitmapLockerSP lck{ src };
+				for (int y = 0; y < SrcHeight; ++y)
+				{
+					std::uint8_t* p = static_cast<std::uint8_t*>(lck.ptrDataRoi) + y * lck.stride;
+					for (int x = 0; x < SrcWidth * 3; ++x)
+					{
+						p[x] = (std::uint8_t)(((y * SrcWidth * 3 + x) * 7919) >> 3);
+					}
+				}
+			}
+
+			auto filled = CBitmapData<CHeapAllocator>::Create(PixelType::Bgr24, SrcWidth, SrcHeight);
+			auto scaledDown = CBitmapData<CHeapAllocator>::Create(PixelType::Bgr24, SrcWidth / 2, SrcHeight / 2);
+			auto scaledUp = CBitmapData<CHeapAllocator>::Create(PixelType::Bgr24, SrcWidth * 5 / 4, SrcHeight * 5 / 4);
+			auto boxScaled = CBitmapData<CHeapAllocator>::Create(PixelType::Bgr24, SrcWidth / 4, SrcHeight / 4);
+			auto copied = CBitmapData<CHeapAllocator>::Create(PixelType::Bgr24, SrcWidth, SrcHeight);
+			const DblRect roiSrc{ 0, 0, (double)SrcWidth, (double)SrcHeight };
+
+			auto measure = [&](const std::function<void()>& func)->long long
+			{
+				long long bestTime = (std::numeric_limits<long long>::max)();
+				for (int i = 0; i < Repeat; ++i)
+				{
+					auto start = std::chrono::high_resolution_clock::now();
+					func();
+					auto end = std::chrono::high_resolution_clock::now();
+					bestTime = (std::min)(bestTime, (long long)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+				}
+
+				return bestTime;
+			};
+
+			auto hash = [](const std::shared_ptr<IBitmapData>& bm)->std::vector<std::uint8_t>
+			{
+				std::vector<std::uint8_t> hash(16);
+				CBitmapOperations::CalcMd5Sum(bm.get(), &hash[0], (int)hash.size());
+				return hash;
+			};
+
+			std::vector<std::vector<std::uint8_t>> reference;
+			for (int threadCount : { 1, 2, 4, 8, 16, 32, 64 })
+			{
+				libCZI::SetBitmapOperationsThreadCount(threadCount);
+				const long long timeFill = measure([&]()->void { CBitmapOperations::Fill(filled.get(), RgbFloatColor{ 0.25f, 0.5f, 0.75f }); });
+				const long long timeNNDown = measure([&]()->void { CBitmapOperations::NNResize(src.get(), 0, 0, scaledDown.get(), roiSrc, DblRect{ 0, 0, SrcWidth / 2., SrcHeight / 2. }); });
+				const long long timeNNUp = measure([&]()->void { CBitmapOperations::NNResize(src.get(), 0, 0, scaledUp.get(), roiSrc, DblRect{ 0, 0, SrcWidth * 5 / 4., SrcHeight * 5 / 4. }); });
+				const long long timeBox = measure([&]()->void { CBitmapOperations::BoxResize(src.get(), 0, 0, boxScaled.get(), roiSrc, DblRect{ 0, 0, SrcWidth / 4., SrcHeight / 4. }); });
+				const long long timeCopy = measure([&]()->void
+				{
+					ScopedBitmapLockerSP lckSrc{ src };
+					ScopedBitmapLockerSP lckDst{ copied };
+					CBitmapOperations::CopyOffsetedInfo info;
+					info.xOffset = info.yOffset = 0;
+					info.srcPixelType = info.dstPixelType = PixelType::Bgr24;
+					info.srcPtr = lckSrc.ptrDataRoi;
+					info.srcStride = lckSrc.stride;
+					info.srcWidth = info.dstWidth = SrcWidth;
+					info.srcHeight = info.dstHeight = SrcHeight;
+					info.dstPtr = lckDst.ptrDataRoi;
+					info.dstStride = lckDst.stride;
+					info.drawTileBorder = false;
+					CBitmapOperations::CopyOffseted(info);
+				});
+
+				std::vector<std::uint8_t> treeHash(16);
+				const long long timeTreeHash = measure([&]()->void { CBitmapOperations::CalcMd5TreeSum(src.get(), &treeHash[0], (int)treeHash.size()); });
+
+				std::vector<std::vector<std::uint8_t>> results{ hash(filled), hash(scaledDown), hash(scaledUp), hash(boxScaled), hash(copied), treeHash };
+				if (reference.empty())
+				{
+					reference = results;
+				}
+
+				Assert::IsTrue(results == reference, L"result differs from the single-threaded one", LINE_INFO());
+
+				std::stringstream ss;
+				ss << "Bitmap operations bgr24 " << SrcWidth << "x" << SrcHeight << " (" << threadCount << " thread(s), " << std::thread::hardware_concurrency() << " hardware threads): "
+					<< "fill " << timeFill << "us, NNResize 1:2 " << timeNNDown << "us, NNResize 5:4 " << timeNNUp << "us, BoxResize 1:4 " << timeBox << "us, "
+					<< "copy " << timeCopy << "us, MD5 tree-hash " << timeTreeHash << "us" << endl;
+				Logger::WriteMessage(ss.str().c_str());
+			}
+		}
+	};
+}
@@ -23,6 +23,8 @@
 #include "stdafx.h"
 #include "CppUnitTest.h"
 #include "testImage.h"
+#include <random>
+#include <chrono>
 
 #include "inc_libCZI.h"
 
@@ -47,7 +49,788 @@ namespace UnitTest
 			Assert::IsTrue(c==0, L"Incorrect result", LINE_INFO());
 		}
 
+		TEST_METHOD(TestMethod_ConvertLineSimd)
+		{
+			// the vectorized kernels must give the same result as the scalar reference, for all widths (so that
+			//  the remainder at the end of a line is covered as well)
+			static const struct { PixelType src; PixelType dst; } conversions[] =
+			{
+				{ PixelType::Gray8, PixelType::Gray16 },
+				{ PixelType::Gray8, PixelType::Gray32Float },
+				{ PixelType::Gray8, PixelType::Bgr24 },
+				{ PixelType::Gray8, PixelType::Bgr48 },
+				{ PixelType::Bgr24, PixelType::Gray8 },
+				{ PixelType::Bgr24, PixelType::Gray16 },
+				{ PixelType::Bgr24, PixelType::Gray32Float },
+				{ PixelType::Bgr24, PixelType::Bgr48 },
+				{ PixelType::Gray8, PixelType::Bgra32 },
+				{ PixelType::Gray16, PixelType::Gray8 },
+				{ PixelType::Gray16, PixelType::Gray32Float },
+				{ PixelType::Gray32Float, PixelType::Gray8 },
+				{ PixelType::Gray32Float, PixelType::Gray16 },
+				{ PixelType::Bgr24, PixelType::Bgra32 },
+				{ PixelType::Bgr48, PixelType::Bgr24 },
+				{ PixelType::Bgra32, PixelType::Bgr24 }
+			};
+
+			static const int MaxWidth = 100;
+			std::mt19937 rng(42);
+			std::vector<std::uint8_t> src(MaxWidth * 6);
+			for (auto& v : src)
+			{
+				v = (std::uint8_t)rng();
+			}
+
+			// the extreme values are of special interest for the arithmetic in the kernels
+			src[0] = src[1] = src[2] = 255;
+			src[3] = src[4] = src[5] = 0;
+
+			// for floating-point source pixels, the values cover the range to be clamped and the rounding
+			std::vector<float> srcFloat(MaxWidth);
+			std::uniform_real_distribution<float> distribution(-1000.f, 70000.f);
+			for (int i = 0; i < MaxWidth; ++i)
+			{
+				srcFloat[i] = (i % 4 == 0) ? distribution(rng) : (i % 4 == 1) ? distribution(rng) / 256 : (i % 4 == 2) ? (float)(i / 2) + .5f : -(float)i;
+			}
+
+			for (const auto& c : conversions)
+			{
+				const void* srcPtr = c.src == PixelType::Gray32Float ? (const void*)&srcFloat[0] : (const void*)&src[0];
+				const int dstBytesPerPel = CziUtils::GetBytesPerPel(c.dst);
+				auto reference = CBitmapOperations::GetConvertLineFunction(c.src, c.dst, CBitmapOperations::SimdLevel::None);
+				Assert::IsTrue(reference != nullptr, L"no reference implementation", LINE_INFO());
+				for (CBitmapOperations::SimdLevel simdLevel : { CBitmapOperations::SimdLevel::SSE41, CBitmapOperations::SimdLevel::AVX2 })
+				{
+					auto kernel = CBitmapOperations::GetConvertLineFunction(c.src, c.dst, simdLevel);
+					Assert::IsTrue(kernel != nullptr, L"no kernel", LINE_INFO());
+					for (int width = 0; width <= MaxWidth; ++width)
+					{
+						std::vector<std::uint8_t> expected(MaxWidth * dstBytesPerPel + 1, 0xcd);
+						std::vector<std::uint8_t> result(MaxWidth * dstBytesPerPel + 1, 0xcd);
+						reference(srcPtr, &expected[0], width);
+						kernel(srcPtr, &result[0], width);
+						Assert::IsTrue(expected == result, L"result differs from the reference", LINE_INFO());
+					}
+				}
+			}
+
+			// Bgr24 -> Bgr48 widens each channel
+			std::uint16_t bgr48[3];
+			const std::uint8_t bgr24[3] = { 1, 2, 255 };
+			CBitmapOperations::GetConvertLineFunction(PixelType::Bgr24, PixelType::Bgr48, CBitmapOperations::SimdLevel::None)(bgr24, bgr48, 1);
+			Assert::IsTrue(bgr48[0] == 1 && bgr48[1] == 2 && bgr48[2] == 255, L"incorrect result", LINE_INFO());
+
+			Assert::IsTrue(CBitmapOperations::GetConvertLineFunction(PixelType::Gray16, PixelType::Bgr48, CBitmapOperations::SimdLevel::AVX2) == nullptr, L"unexpected kernel", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_CopyAllPixelTypes)
+		{
+			static const PixelType pixelTypes[] = { PixelType::Gray8, PixelType::Gray16, PixelType::Gray32Float, PixelType::Bgr24, PixelType::Bgr48, PixelType::Bgra32, PixelType::Bgr96Float };
+
+			// White is converted to white, where 8-bit values are not scaled when converted into a type with a larger
+			//  range, and the value range of the floating-point types is that of the integer type they are converted from.
+			for (PixelType srcPixelType : pixelTypes)
+			{
+				const bool src16Bit = srcPixelType == PixelType::Gray16 || srcPixelType == PixelType::Bgr48;
+				const bool srcFloat = srcPixelType == PixelType::Gray32Float || srcPixelType == PixelType::Bgr96Float;
+				std::uint8_t src[12];
+				memset(src, 0xff, sizeof(src));
+				if (srcFloat)
+				{
+					const float v[3] = { 255, 255, 255 };
+					memcpy(src, v, sizeof(v));
+				}
+
+				for (PixelType dstPixelType : pixelTypes)
+				{
+					std::uint8_t dst[12];
+					CBitmapOperations::Copy(srcPixelType, src, sizeof(src), dstPixelType, dst, sizeof(dst), 1, 1, false);
+
+					std::uint8_t expected[12];
+					for (int i = 0; i < 4; ++i)
+					{
+						switch (dstPixelType)
+						{
+						case PixelType::Gray8:
+						case PixelType::Bgr24:
+						case PixelType::Bgra32:
+							expected[i] = 0xff;
+							break;
+						case PixelType::Gray16:
+						case PixelType::Bgr48:
+						{
+							const std::uint16_t v = src16Bit ? 0xffff : 0xff;
+							memcpy(expected + 2 * i, &v, sizeof(v));
+							break;
+						}
+						default:
+						{
+							const float v = src16Bit ? 65535.f : 255.f;
+							memcpy(expected + 4 * i, &v, sizeof(v));
+							break;
+						}
+						}
+					}
+
+					Assert::IsTrue(memcmp(expected, dst, CziUtils::GetBytesPerPel(dstPixelType)) == 0, L"incorrect result", LINE_INFO());
+				}
+			}
+
+			// floating-point values are clamped and rounded
+			const float gray32FloatValues[4] = { -3.f, 12.5f, 254.4f, 300.f };
+			std::uint8_t gray8Values[4];
+			CBitmapOperations::Copy(PixelType::Gray32Float, gray32FloatValues, sizeof(gray32FloatValues), PixelType::Gray8, gray8Values, sizeof(gray8Values), 4, 1, false);
+			Assert::IsTrue(gray8Values[0] == 0 && gray8Values[1] == 13 && gray8Values[2] == 254 && gray8Values[3] == 255, L"incorrect result", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_NNResizePlan)
+		{
+			// the planned resize must give the same result as determining the source pixel for each destination pixel
+			std::mt19937 rng(7);
+			std::uniform_real_distribution<double> distribution(0, 1);
+			static const struct { PixelType src; PixelType dst; } pixelTypes[] =
+			{
+				{ PixelType::Gray8, PixelType::Gray8 },
+				{ PixelType::Gray16, PixelType::Gray16 },
+				{ PixelType::Bgr24, PixelType::Bgr24 },
+				{ PixelType::Bgr48, PixelType::Bgr48 },
+				{ PixelType::Gray32Float, PixelType::Gray32Float },
+				{ PixelType::Bgr96Float, PixelType::Bgr96Float },
+				{ PixelType::Bgr24, PixelType::Gray8 }
+			};
+
+			for (int i = 0; i < 200; ++i)
+			{
+				const auto& types = pixelTypes[i % (sizeof(pixelTypes) / sizeof(pixelTypes[0]))];
+				const int bytesPerPelSrc = CziUtils::GetBytesPerPel(types.src);
+				const int bytesPerPelDst = CziUtils::GetBytesPerPel(types.dst);
+				CBitmapOperations::NNResizeInfo2Dbl resizeInfo;
+				resizeInfo.srcWidth = 1 + (int)(distribution(rng) * 60);
+				resizeInfo.srcHeight = 1 + (int)(distribution(rng) * 60);
+				resizeInfo.srcOffsetX = (int)(distribution(rng) * 10);
+				resizeInfo.srcOffsetY = (int)(distribution(rng) * 10);
+				resizeInfo.srcRoiX = distribution(rng) * 20;
+				resizeInfo.srcRoiY = distribution(rng) * 20;
+				resizeInfo.srcRoiW = 1 + distribution(rng) * 70;
+				resizeInfo.srcRoiH = 1 + distribution(rng) * 70;
+				resizeInfo.dstWidth = 1 + (int)(distribution(rng) * 100);
+				resizeInfo.dstHeight = 1 + (int)(distribution(rng) * 100);
+				resizeInfo.dstRoiX = distribution(rng) * 30 - 10;
+				resizeInfo.dstRoiY = distribution(rng) * 30 - 10;
+				resizeInfo.dstRoiW = 1 + distribution(rng) * 120;
+				resizeInfo.dstRoiH = 1 + distribution(rng) * 120;
+				resizeInfo.srcStride = resizeInfo.srcWidth * bytesPerPelSrc + 3;
+				resizeInfo.dstStride = resizeInfo.dstWidth * bytesPerPelDst + 5;
+
+				std::vector<std::uint8_t> src(resizeInfo.srcStride * resizeInfo.srcHeight);
+				for (auto& v : src)
+				{
+					v = (std::uint8_t)rng();
+				}
+
+				if (types.src == PixelType::Gray32Float || types.src == PixelType::Bgr96Float)
+				{
+					// avoid NaNs, which would not compare equal
+					for (size_t n = 0; n + 4 <= src.size(); n += 4)
+					{
+						const float f = (float)(n % 1000);
+						memcpy(&src[n], &f, sizeof(f));
+					}
+				}
+
+				std::vector<std::uint8_t> expected(resizeInfo.dstStride * resizeInfo.dstHeight, 0);
+				std::vector<std::uint8_t> result(expected.size(), 0);
+				resizeInfo.srcPtr = &src[0];
+				resizeInfo.dstPtr = &expected[0];
+				ReferenceNNResize(types.src, types.dst, resizeInfo);
+
+				resizeInfo.dstPtr = &result[0];
+				CBitmapOperations::NNSCale2(types.src, types.dst, resizeInfo);
+				Assert::IsTrue(expected == result, L"result differs from the reference", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestMethod_GatherLineSimd)
+		{
+			std::mt19937 rng(3);
+			static const int SrcWidth = 50;
+			std::vector<std::uint8_t> src(SrcWidth * 6);
+			for (auto& v : src)
+			{
+				v = (std::uint8_t)rng();
+			}
+
+			for (int bytesPerPel : { 1, 2, 3, 6 })
+			{
+				auto reference = CBitmapOperations::GetGatherLineFunction(bytesPerPel, CBitmapOperations::SimdLevel::None);
+				auto kernel = CBitmapOperations::GetGatherLineFunction(bytesPerPel, CBitmapOperations::SimdLevel::AVX2);
+				for (int count = 0; count <= 80; ++count)
+				{
+					// the columns are increasing (as for a resize), and they include the last column of the source
+					std::vector<int> srcX(count);
+					for (int i = 0; i < count; ++i)
+					{
+						srcX[i] = (int)(((long long)i * SrcWidth) / (std::max)(count, 1));
+					}
+
+					if (count > 0)
+					{
+						srcX[count - 1] = SrcWidth - 1;
+					}
+
+					std::vector<std::uint8_t> expected(count * bytesPerPel + 1, 0xcd);
+					std::vector<std::uint8_t> result(expected.size(), 0xcd);
+					reference(&src[0], SrcWidth, srcX.empty() ? nullptr : &srcX[0], &expected[0], count);
+					kernel(&src[0], SrcWidth, srcX.empty() ? nullptr : &srcX[0], &result[0], count);
+					Assert::IsTrue(expected == result, L"result differs from the reference", LINE_INFO());
+				}
+			}
+		}
+
+		TEST_METHOD(TestMethod_NNResizePlanCache)
+		{
+			CNNResizePlanCache cache(2);
+			CBitmapOperations::NNResizeInfo2Dbl resizeInfo;
+			resizeInfo.srcPtr = nullptr;
+			resizeInfo.srcStride = 0;
+			resizeInfo.srcWidth = resizeInfo.srcHeight = 10;
+			resizeInfo.srcOffsetX = resizeInfo.srcOffsetY = 0;
+			resizeInfo.srcRoiX = resizeInfo.srcRoiY = 0;
+			resizeInfo.srcRoiW = resizeInfo.srcRoiH = 10;
+			resizeInfo.dstPtr = nullptr;
+			resizeInfo.dstStride = 0;
+			resizeInfo.dstWidth = resizeInfo.dstHeight = 5;
+			resizeInfo.dstRoiX = resizeInfo.dstRoiY = 0;
+			resizeInfo.dstRoiW = resizeInfo.dstRoiH = 5;
+
+			auto plan1 = cache.GetOrCreate(resizeInfo);
+			Assert::IsTrue(plan1->dstXStart == 0 && plan1->dstXEnd == 4 && plan1->srcX.size() == 5 && plan1->srcX[1] == 2, L"unexpected plan", LINE_INFO());
+
+			// the pointers and strides are not part of the geometry
+			resizeInfo.srcStride = 100;
+			Assert::IsTrue(cache.GetOrCreate(resizeInfo) == plan1, L"expected the cached plan", LINE_INFO());
+
+			resizeInfo.dstRoiW = 4;
+			auto plan2 = cache.GetOrCreate(resizeInfo);
+			Assert::IsTrue(plan2 != plan1, L"expected a different plan", LINE_INFO());
+			resizeInfo.dstRoiW = 3;
+			cache.GetOrCreate(resizeInfo);
+			Assert::IsTrue(cache.GetCount() == 2, L"unexpected number of plans", LINE_INFO());
+
+			// the least recently used plan (which is plan1) has been removed
+			resizeInfo.dstRoiW = 5;
+			Assert::IsTrue(cache.GetOrCreate(resizeInfo) != plan1, L"expected a new plan", LINE_INFO());
+		}
+
+		static bool IsSamePlan(const CBitmapOperations::NNResizePlan& a, const CBitmapOperations::NNResizePlan& b)
+		{
+			return a.dstXStart == b.dstXStart && a.dstXEnd == b.dstXEnd && a.dstYStart == b.dstYStart && a.dstYEnd == b.dstYEnd && a.srcX == b.srcX && a.srcY == b.srcY;
+		}
+
+		TEST_METHOD(TestMethod_NNResizePlanCacheTranslation)
+		{
+			// tiles of a mosaic differ only in the (integral) position of their destination-ROI - they share one plan
+			CNNResizePlanCache cache(4);
+			CBitmapOperations::NNResizeInfo2Dbl resizeInfo;
+			resizeInfo.srcPtr = nullptr;
+			resizeInfo.srcStride = 0;
+			resizeInfo.srcWidth = resizeInfo.srcHeight = 10;
+			resizeInfo.srcOffsetX = resizeInfo.srcOffsetY = 0;
+			resizeInfo.srcRoiX = resizeInfo.srcRoiY = 0;
+			resizeInfo.srcRoiW = resizeInfo.srcRoiH = 10;
+			resizeInfo.dstPtr = nullptr;
+			resizeInfo.dstStride = 0;
+			resizeInfo.dstWidth = resizeInfo.dstHeight = 100;
+			resizeInfo.dstRoiX = 10.25;
+			resizeInfo.dstRoiY = 20.5;
+			resizeInfo.dstRoiW = resizeInfo.dstRoiH = 4.5;
+
+			auto plan1 = cache.GetOrCreate(resizeInfo);
+			CBitmapOperations::NNResizePlan plan;
+			CBitmapOperations::CreateNNResizePlan(resizeInfo, plan);
+			Assert::IsTrue(IsSamePlan(plan, *plan1), L"the cached plan differs from the computed one", LINE_INFO());
+
+			resizeInfo.dstRoiX += 31;
+			resizeInfo.dstRoiY += 7;
+			Assert::IsTrue(cache.GetOrCreate(resizeInfo) == plan1, L"expected the cached plan", LINE_INFO());
+
+			resizeInfo.dstRoiX += 0.5;
+			auto plan2 = cache.GetOrCreate(resizeInfo);
+			Assert::IsTrue(plan2 != plan1, L"expected a different plan", LINE_INFO());
+			CBitmapOperations::CreateNNResizePlan(resizeInfo, plan);
+			Assert::IsTrue(IsSamePlan(plan, *plan2), L"the cached plan differs from the computed one", LINE_INFO());
+
+			// when the destination-ROI is clipped, the plan is different
+			resizeInfo.dstRoiX = 98.25;
+			Assert::IsTrue(cache.GetOrCreate(resizeInfo) != plan1, L"expected a different plan", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_BoxResizeIntegerRatio)
+		{
+			// with an integer ratio, every destination pixel is the (rounded) average of a block of source pixels
+			std::mt19937 rng(5);
+			static const int FactorX = 3, FactorY = 2;
+			static const int DstWidth = 7, DstHeight = 5;
+			for (PixelType pixelType : { PixelType::Gray8, PixelType::Bgr24, PixelType::Gray16, PixelType::Bgr48 })
+			{
+				const bool is16Bit = pixelType == PixelType::Gray16 || pixelType == PixelType::Bgr48;
+				const int channelCount = pixelType == PixelType::Gray8 || pixelType == PixelType::Gray16 ? 1 : 3;
+				auto src = CBitmapData<CHeapAllocator>::Create(pixelType, DstWidth * FactorX, DstHeight * FactorY);
+				auto dst = CBitmapData<CHeapAllocator>::Create(pixelType, DstWidth, DstHeight);
+				auto getValue = [&](const BitmapLockInfo& lck, int x, int y, int c)->int
+				{
+					const char* p = static_cast<const char*>(lck.ptrDataRoi) + y * lck.stride;
+					return is16Bit ? reinterpret_cast<const std::uint16_t*>(p)[x * channelCount + c] : reinterpret_cast<const std::uint8_t*>(p)[x * channelCount + c];
+				};
+
+				{
+					ScopedBitmapLockerSP lck{ src };
+					for (std::uint32_t y = 0; y < src->GetHeight(); ++y)
+					{
+						char* p = static_cast<char*>(lck.ptrDataRoi) + y * lck.stride;
+						for (std::uint32_t i = 0; i < src->GetWidth() * channelCount; ++i)
+						{
+							if (is16Bit)
+							{
+								reinterpret_cast<std::uint16_t*>(p)[i] = (std::uint16_t)rng();
+							}
+							else
+							{
+								reinterpret_cast<std::uint8_t*>(p)[i] = (std::uint8_t)rng();
+							}
+						}
+					}
+				}
+
+				CBitmapOperations::BoxResize(src.get(), 0, 0, dst.get(), DblRect{ 0, 0, DstWidth * FactorX, DstHeight * FactorY }, DblRect{ 0, 0, DstWidth, DstHeight });
+
+				ScopedBitmapLockerSP lckSrc{ src };
+				ScopedBitmapLockerSP lckDst{ dst };
+				for (int y = 0; y < DstHeight; ++y)
+				{
+					for (int x = 0; x < DstWidth; ++x)
+					{
+						for (int c = 0; c < channelCount; ++c)
+						{
+							int sum = 0;
+							for (int i = 0; i < FactorX * FactorY; ++i)
+							{
+								sum += getValue(lckSrc, x * FactorX + i % FactorX, y * FactorY + i / FactorX, c);
+							}
+
+							const int expected = (2 * sum + FactorX * FactorY) / (2 * FactorX * FactorY);
+							Assert::IsTrue(getValue(lckDst, x, y, c) == expected, L"incorrect average", LINE_INFO());
+						}
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(TestMethod_BoxResizeGeneralRatio)
+		{
+			static const PixelType pixelTypes[] = { PixelType::Gray8, PixelType::Gray16, PixelType::Gray32Float, PixelType::Bgr24, PixelType::Bgr48, PixelType::Bgra32, PixelType::Bgr96Float };
+
+			// the average of a constant image is this constant - so for a constant image, the result must be identical to a
+			//  nearest-neighbor resize (for integer destination types, as an average calculated with floats is subject to
+			//  rounding errors), except for the pixels at the border which cover a part of the source but whose top-left
+			//  corner is outside of it (which are drawn only by the area-averaging resize)
+			static const float value[3] = { 100, 100, 100 };
+			for (PixelType srcPixelType : pixelTypes)
+			{
+				auto src = CBitmapData<CHeapAllocator>::Create(srcPixelType, 37, 29);
+				{
+					ScopedBitmapLockerSP lck{ src };
+					for (std::uint32_t y = 0; y < src->GetHeight(); ++y)
+					{
+						char* p = static_cast<char*>(lck.ptrDataRoi) + y * lck.stride;
+						for (std::uint32_t x = 0; x < src->GetWidth(); ++x)
+						{
+							CBitmapOperations::Copy(PixelType::Bgr96Float, value, 0, srcPixelType, p + x * CziUtils::GetBytesPerPel(srcPixelType), 0, 1, 1, false);
+						}
+					}
+				}
+
+				for (PixelType dstPixelType : { PixelType::Gray8, PixelType::Bgr48 })
+				{
+					const int bytesPerPel = CziUtils::GetBytesPerPel(dstPixelType);
+					std::uint8_t srcConstant[12], constant[6], zero[6] = {};
+					CBitmapOperations::Copy(PixelType::Bgr96Float, value, 0, srcPixelType, srcConstant, 0, 1, 1, false);
+					CBitmapOperations::Copy(srcPixelType, srcConstant, 0, dstPixelType, constant, 0, 1, 1, false);
+
+					auto expected = CBitmapData<CHeapAllocator>::Create(dstPixelType, 30, 25);
+					auto result = CBitmapData<CHeapAllocator>::Create(dstPixelType, 30, 25);
+					{
+						ScopedBitmapLockerSP lckExpected{ expected };
+						ScopedBitmapLockerSP lckResult{ result };
+						memset(lckExpected.ptrDataRoi, 0, (size_t)lckExpected.size);
+						memset(lckResult.ptrDataRoi, 0, (size_t)lckResult.size);
+					}
+
+					const DblRect roiSrc{ 2.4, 1.7, 33.1, 26.5 };
+					const DblRect roiDst{ 3.6, 2.2, 19.3, 17.8 };
+					CBitmapOperations::NNResize(src.get(), 1, 0, expected.get(), roiSrc, roiDst);
+					CBitmapOperations::BoxResize(src.get(), 1, 0, result.get(), roiSrc, roiDst);
+
+					ScopedBitmapLockerSP lckExpected{ expected };
+					ScopedBitmapLockerSP lckResult{ result };
+					int drawnCount = 0;
+					for (std::uint32_t y = 0; y < expected->GetHeight(); ++y)
+					{
+						for (std::uint32_t x = 0; x < expected->GetWidth(); ++x)
+						{
+							const std::uint8_t* pExpected = static_cast<const std::uint8_t*>(lckExpected.ptrDataRoi) + y * lckExpected.stride + x * bytesPerPel;
+							const std::uint8_t* pResult = static_cast<const std::uint8_t*>(lckResult.ptrDataRoi) + y * lckResult.stride + x * bytesPerPel;
+							const bool isDrawn = memcmp(pResult, constant, bytesPerPel) == 0;
+							Assert::IsTrue(isDrawn || memcmp(pResult, zero, bytesPerPel) == 0, L"incorrect result", LINE_INFO());
+							Assert::IsTrue(isDrawn || memcmp(pExpected, zero, bytesPerPel) == 0, L"expected the pixel to be drawn", LINE_INFO());
+							drawnCount += isDrawn ? 1 : 0;
+						}
+					}
+
+					// (a 16-bit value of 100 is zero in an 8-bit type, so the drawn pixels cannot be distinguished then)
+					Assert::IsTrue(drawnCount == 20 * 19 || memcmp(constant, zero, bytesPerPel) == 0, L"unexpected number of drawn pixels", LINE_INFO());
+				}
+			}
+
+			// a pixel which covers half of one source pixel and all of another gets their mean, weighted with the
+			//  covered area
+			const std::uint8_t srcValues[4] = { 0, 100, 200, 40 };
+			std::uint8_t dstValues[2] = { 0, 0 };
+			CBitmapOperations::NNResizeInfo2Dbl resizeInfo;
+			resizeInfo.srcPtr = srcValues;
+			resizeInfo.srcStride = sizeof(srcValues);
+			resizeInfo.srcWidth = 4;
+			resizeInfo.srcHeight = 1;
+			resizeInfo.srcOffsetX = resizeInfo.srcOffsetY = 0;
+			resizeInfo.srcRoiX = 0.5;
+			resizeInfo.srcRoiY = 0;
+			resizeInfo.srcRoiW = 3;
+			resizeInfo.srcRoiH = 1;
+			resizeInfo.dstPtr = dstValues;
+			resizeInfo.dstStride = sizeof(dstValues);
+			resizeInfo.dstWidth = 2;
+			resizeInfo.dstHeight = 1;
+			resizeInfo.dstRoiX = resizeInfo.dstRoiY = 0;
+			resizeInfo.dstRoiW = 2;
+			resizeInfo.dstRoiH = 1;
+			CBitmapOperations::BoxResizePlan plan;
+			CBitmapOperations::CreateBoxResizePlan(resizeInfo, plan);
+			Assert::IsTrue(plan.x.weights == std::vector<float>({ 0.5f, 1, 1, 0.5f }) && plan.y.weights == std::vector<float>({ 1 }), L"unexpected plan", LINE_INFO());
+			CBitmapOperations::BoxScale2(PixelType::Gray8, PixelType::Gray8, resizeInfo, plan);
+
+			// the first pixel covers [0.5, 2) - i. e. 0.5 * 0 + 1 * 100 + 0 * 200, the second one [2, 3.5)
+			Assert::IsTrue(dstValues[0] == 67 && dstValues[1] == 147, L"incorrect result", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_AccumulateLineSimd)
+		{
+			std::mt19937 rng(7);
+			static const int MaxCount = 70;
+			std::vector<std::uint8_t> src(MaxCount * sizeof(float));
+			for (auto& v : src)
+			{
+				v = (std::uint8_t)rng();
+			}
+
+			// for the float-type, we use values which are not NaN
+			std::vector<float> srcFloat(MaxCount);
+			for (auto& v : srcFloat)
+			{
+				v = (float)(rng() % 100000) / 7;
+			}
+
+			for (PixelType pixelType : { PixelType::Gray8, PixelType::Gray16, PixelType::Gray32Float })
+			{
+				const void* srcPtr = pixelType == PixelType::Gray32Float ? (const void*)&srcFloat[0] : (const void*)&src[0];
+				auto reference = CBitmapOperations::GetAccumulateLineFunction(pixelType, CBitmapOperations::SimdLevel::None);
+				for (CBitmapOperations::SimdLevel simdLevel : { CBitmapOperations::SimdLevel::SSE41, CBitmapOperations::SimdLevel::AVX2 })
+				{
+					auto kernel = CBitmapOperations::GetAccumulateLineFunction(pixelType, simdLevel);
+					for (int count = 0; count <= MaxCount; ++count)
+					{
+						std::vector<float> expected(MaxCount + 1, 1.5f);
+						std::vector<float> result(expected);
+						reference(srcPtr, 0.37f, &expected[0], count);
+						kernel(srcPtr, 0.37f, &result[0], count);
+						Assert::IsTrue(expected == result, L"result differs from the reference", LINE_INFO());
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(TestMethod_ThreadPool)
+		{
+			CThreadPool pool(4);
+			Assert::IsTrue(pool.GetThreadCount() == 4, L"unexpected number of threads", LINE_INFO());
+
+			// every index is executed exactly once - also when the pool is used repeatedly
+			for (int count : { 0, 1, 7, 1000 })
+			{
+				std::vector<int> executed(count, 0);
+				pool.ParallelFor(count, [&](int index)->void { ++executed[index]; });
+				Assert::IsTrue(std::all_of(executed.cbegin(), executed.cend(), [](int i)->bool { return i == 1; }), L"not every index executed exactly once", LINE_INFO());
+			}
+
+			// an exception thrown by an iteration is re-thrown by ParallelFor, and the pool is usable afterwards
+			bool exceptionCaught = false;
+			try
+			{
+				pool.ParallelFor(100, [](int index)->void { if (index == 42) { throw std::runtime_error("test"); } });
+			}
+			catch (std::runtime_error&)
+			{
+				exceptionCaught = true;
+			}
+
+			Assert::IsTrue(exceptionCaught, L"the exception was not re-thrown", LINE_INFO());
+
+			// a nested loop is executed (sequentially) on the thread executing the iteration
+			std::vector<int> executed(10 * 10, 0);
+			pool.ParallelFor(10, [&](int i)->void
+			{
+				pool.ParallelFor(10, [&](int j)->void { ++executed[i * 10 + j]; });
+			});
+
+			Assert::IsTrue(std::all_of(executed.cbegin(), executed.cend(), [](int i)->bool { return i == 1; }), L"not every index executed exactly once", LINE_INFO());
+
+			// a pool with one thread executes the loop on the calling thread
+			CThreadPool singleThreadPool(1);
+			const std::thread::id callingThread = std::this_thread::get_id();
+			bool onCallingThread = true;
+			singleThreadPool.ParallelFor(5, [&](int)->void { onCallingThread &= std::this_thread::get_id() == callingThread; });
+			Assert::IsTrue(singleThreadPool.GetThreadCount() == 1 && onCallingThread, L"the loop was not executed on the calling thread", LINE_INFO());
+
+			// tasks are started immediately (also if there are more of them than threads in the loop pool), so they may wait for
+			// each other - up to the maximum number of task threads, a task beyond it is refused
+			static const int TaskCount = 8;
+			std::mutex mutex;
+			std::condition_variable allStarted, allFinished;
+			int started = 0, finished = 0;
+			bool release = false;
+			std::atomic<int> reusedCount(0);
+			CThreadPool taskPool(1, TaskCount);	// declared last, so that the threads are joined before the objects they use are destroyed
+			for (int i = 0; i < TaskCount; ++i)
+			{
+				const bool executed = taskPool.TryExecute([&]()->void
+				{
+					std::unique_lock<std::mutex> lck(mutex);
+					++started;
+					allStarted.notify_all();
+					allStarted.wait(lck, [&]()->bool { return release; });
+					++finished;
+					allFinished.notify_all();
+				});
+				Assert::IsTrue(executed, L"the task was not executed", LINE_INFO());
+			}
+
+			{
+				std::unique_lock<std::mutex> lck(mutex);
+				const bool tasksStarted = allStarted.wait_for(lck, std::chrono::seconds(10), [&]()->bool { return started == TaskCount; });
+				Assert::IsTrue(tasksStarted, L"the tasks were not started", LINE_INFO());
+			}
+
+			bool extraTaskExecuted = false;
+			Assert::IsFalse(taskPool.TryExecute([&]()->void { extraTaskExecuted = true; }), L"expected the task to be refused", LINE_INFO());
+			Assert::IsFalse(singleThreadPool.TryExecute([&]()->void { extraTaskExecuted = true; }), L"expected the task to be refused", LINE_INFO());
+
+			{
+				std::unique_lock<std::mutex> lck(mutex);
+				release = true;
+				allStarted.notify_all();
+				const bool tasksFinished = allFinished.wait_for(lck, std::chrono::seconds(10), [&]()->bool { return finished == TaskCount; });
+				Assert::IsTrue(tasksFinished, L"the tasks did not finish", LINE_INFO());
+			}
+
+			// the threads are re-used once their tasks are finished
+			for (int i = 0; i < TaskCount; ++i)
+			{
+				while (!taskPool.TryExecute([&]()->void { ++reusedCount; }))
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			while (reusedCount.load() < TaskCount)
+			{
+				std::this_thread::yield();
+			}
+
+			Assert::IsFalse(extraTaskExecuted, L"a refused task was executed", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_MultithreadedBitmapOperations)
+		{
+			// the operations must give the same result with any number of threads (the bitmaps are large enough to be
+			//  split into several bands of rows)
+			struct ResetThreadCount { ~ResetThreadCount() { libCZI::SetBitmapOperationsThreadCount(1); } } resetThreadCount;
+
+			auto src = CBitmapData<CHeapAllocator>::Create(PixelType::Bgr24, 1000, 700);
+			{
+				ScopedBitmapLockerSP lck{ src };
+				std::mt19937 rng(4711);
+				for (std::uint32_t y = 0; y < src->GetHeight(); ++y)
+				{
+					std::uint8_t* p = static_cast<std::uint8_t*>(lck.ptrDataRoi) + y * lck.stride;
+					for (std::uint32_t x = 0; x < src->GetWidth() * 3; ++x)
+					{
+						p[x] = (std::uint8_t)rng();
+					}
+				}
+			}
+
+			auto calcHashes = [&]()->std::vector<std::vector<std::uint8_t>>
+			{
+				std::vector<std::vector<std::uint8_t>> hashes;
+				auto addHash = [&](const std::shared_ptr<IBitmapData>& bm)->void
+				{
+					std::vector<std::uint8_t> hash(16);
+					CBitmapOperations::CalcMd5Sum(bm.get(), &hash[0], (int)hash.size());
+					hashes.push_back(hash);
+				};
+
+				for (PixelType pixelType : { PixelType::Gray8, PixelType::Gray16, PixelType::Gray32Float, PixelType::Bgr24, PixelType::Bgr48 })
+				{
+					auto bm = CBitmapData<CHeapAllocator>::Create(pixelType, 1100, 900);
+					CBitmapOperations::Fill(bm.get(), RgbFloatColor{ 0.25f, 0.5f, 0.75f });
+					addHash(bm);
+				}
+
+				for (PixelType dstPixelType : { PixelType::Bgr24, PixelType::Gray16 })
+				{
+					for (const IntSize& dstSize : { IntSize{ 1500, 1100 }, IntSize{ 400, 300 } })
+					{
+						auto dst = CBitmapData<CHeapAllocator>::Create(dstPixelType, dstSize.w, dstSize.h);
+						CBitmapOperations::Fill(dst.get(), RgbFloatColor{ 0, 0, 0 });
+						const DblRect roiSrc{ 0, 0, (double)src->GetWidth(), (double)src->GetHeight() };
+						const DblRect roiDst{ 0, 0, (double)dstSize.w, (double)dstSize.h };
+						CBitmapOperations::NNResize(src.get(), 0, 0, dst.get(), roiSrc, roiDst);
+						addHash(dst);
+						CBitmapOperations::BoxResize(src.get(), 0, 0, dst.get(), roiSrc, roiDst);
+						addHash(dst);
+					}
+				}
+
+				for (bool drawTileBorder : { false, true })
+				{
+					auto dst = CBitmapData<CHeapAllocator>::Create(PixelType::Bgr48, 1200, 800);
+					CBitmapOperations::Fill(dst.get(), RgbFloatColor{ 0, 0, 0 });
+					ScopedBitmapLockerSP lckSrc{ src };
+					ScopedBitmapLockerSP lckDst{ dst };
+					CBitmapOperations::CopyOffsetedInfo info;
+					info.xOffset = 150;
+					info.yOffset = -30;
+					info.srcPixelType = src->GetPixelType();
+					info.srcPtr = lckSrc.ptrDataRoi;
+					info.srcStride = lckSrc.stride;
+					info.srcWidth = src->GetWidth();
+					info.srcHeight = src->GetHeight();
+					info.dstPixelType = dst->GetPixelType();
+					info.dstPtr = lckDst.ptrDataRoi;
+					info.dstStride = lckDst.stride;
+					info.dstWidth = dst->GetWidth();
+					info.dstHeight = dst->GetHeight();
+					info.drawTileBorder = drawTileBorder;
+					CBitmapOperations::CopyOffseted(info);
+					addHash(dst);
+				}
+
+				return hashes;
+			};
+
+			const auto expected = calcHashes();
+			for (int threadCount : { 2, 3, 8 })
+			{
+				libCZI::SetBitmapOperationsThreadCount(threadCount);
+				Assert::IsTrue(CBitmapOperations::GetThreadPool() && CBitmapOperations::GetThreadPool()->GetThreadCount() == threadCount, L"thread pool not set", LINE_INFO());
+				Assert::IsTrue(calcHashes() == expected, L"the result differs from the single-threaded one", LINE_INFO());
+			}
+
+			libCZI::SetBitmapOperationsThreadCount(1);
+			Assert::IsTrue(!CBitmapOperations::GetThreadPool(), L"thread pool not reset", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_Md5TreeSum)
+		{
+			struct ResetThreadCount { ~ResetThreadCount() { libCZI::SetBitmapOperationsThreadCount(1); } } resetThreadCount;
+
+			// the height is not a multiple of the rows per leaf, so the last leaf is smaller
+			auto bm = CBitmapData<CHeapAllocator>::Create(PixelType::Bgr24, 2000, 1000);
+			ScopedBitmapLockerSP lck{ bm };
+			std::mt19937 rng(1234);
+			const size_t lineLength = bm->GetWidth() * 3;
+			for (std::uint32_t y = 0; y < bm->GetHeight(); ++y)
+			{
+				std::uint8_t* p = static_cast<std::uint8_t*>(lck.ptrDataRoi) + y * lck.stride;
+				for (size_t x = 0; x < lineLength; ++x)
+				{
+					p[x] = (std::uint8_t)rng();
+				}
+			}
+
+			// calculate the tree-hash as it is defined - the hash of the concatenated hashes of the bands of rows
+			std::vector<std::uint8_t> leafHashes;
+			for (std::uint32_t yStart = 0; yStart < bm->GetHeight(); yStart += CBitmapOperations::Md5TreeSumRowsPerLeaf)
+			{
+				const std::uint32_t yEnd = (std::min)(yStart + CBitmapOperations::Md5TreeSumRowsPerLeaf, bm->GetHeight());
+				std::vector<std::uint8_t> rows;
+				for (std::uint32_t y = yStart; y < yEnd; ++y)
+				{
+					const std::uint8_t* p = static_cast<const std::uint8_t*>(lck.ptrDataRoi) + y * lck.stride;
+					rows.insert(rows.end(), p, p + lineLength);
+				}
+
+				std::uint8_t hash[16];
+				Utils::CalcMd5SumHash(&rows[0], rows.size(), hash, sizeof(hash));
+				leafHashes.insert(leafHashes.end(), hash, hash + sizeof(hash));
+			}
+
+			std::uint8_t expected[16];
+			Utils::CalcMd5SumHash(&leafHashes[0], leafHashes.size(), expected, sizeof(expected));
+
+			for (int threadCount : { 1, 2, 5, 16 })
+			{
+				libCZI::SetBitmapOperationsThreadCount(threadCount);
+				std::uint8_t hash[16];
+				Assert::IsTrue(Utils::CalcMd5SumTreeHash(bm.get(), hash, sizeof(hash)) == 16, L"unexpected size of the hash", LINE_INFO());
+				Assert::IsTrue(memcmp(hash, expected, sizeof(hash)) == 0, L"incorrect tree-hash", LINE_INFO());
+			}
+		}
+
 	private:
+		/// Nearest-neighbor resize determining the source pixel for each destination pixel (as it was done before the
+		/// resize was based on a plan).
+		static void ReferenceNNResize(PixelType srcPixelType, PixelType dstPixelType, const CBitmapOperations::NNResizeInfo2Dbl& resizeInfo)
+		{
+			const int bytesPerPelSrc = CziUtils::GetBytesPerPel(srcPixelType);
+			const int bytesPerPelDst = CziUtils::GetBytesPerPel(dstPixelType);
+			int dstXStart = (std::max)((int)resizeInfo.dstRoiX, 0);
+			int dstXEnd = (std::min)((int)(resizeInfo.dstRoiX + resizeInfo.dstRoiW), resizeInfo.dstWidth - 1);
+			int dstYStart = (std::max)((int)resizeInfo.dstRoiY, 0);
+			int dstYEnd = (std::min)((int)(resizeInfo.dstRoiY + resizeInfo.dstRoiH), resizeInfo.dstHeight - 1);
+			auto yMin = ((resizeInfo.srcOffsetY - resizeInfo.srcRoiY)*resizeInfo.dstRoiH) / (resizeInfo.srcRoiH) + resizeInfo.dstRoiY;
+			auto yMax = ((resizeInfo.srcOffsetY + resizeInfo.srcHeight - 1 - resizeInfo.srcRoiY)*(resizeInfo.dstRoiH)) / resizeInfo.srcRoiH + resizeInfo.dstRoiY;
+			auto xMin = ((resizeInfo.srcOffsetX - resizeInfo.srcRoiX)*resizeInfo.dstRoiW) / (resizeInfo.srcRoiW) + resizeInfo.dstRoiX;
+			auto xMax = ((resizeInfo.srcOffsetX + resizeInfo.srcWidth - 1 - resizeInfo.srcRoiX)*(resizeInfo.dstRoiW)) / resizeInfo.srcRoiW + resizeInfo.dstRoiX;
+			int dstXStartClipped = (std::max)((int)std::ceil(xMin), dstXStart);
+			int dstXEndClipped = (std::min)((int)std::ceil(xMax), dstXEnd);
+			int dstYStartClipped = (std::max)((int)std::ceil(yMin), dstYStart);
+			int dstYEndClipped = (std::min)((int)std::ceil(yMax), dstYEnd);
+			for (int y = dstYStartClipped; y <= dstYEndClipped; ++y)
+			{
+				double srcY = ((y - resizeInfo.dstRoiY) / resizeInfo.dstRoiH)*resizeInfo.srcRoiH + resizeInfo.srcRoiY;
+				int srcYInt = (std::min)((std::max)((int)srcY - resizeInfo.srcOffsetY, 0), resizeInfo.srcHeight - 1);
+				for (int x = dstXStartClipped; x <= dstXEndClipped; ++x)
+				{
+					double srcX = ((x - resizeInfo.dstRoiX) / resizeInfo.dstRoiW)*resizeInfo.srcRoiW + resizeInfo.srcRoiX;
+					int srcXInt = (std::min)((std::max)((int)srcX - resizeInfo.srcOffsetX, 0), resizeInfo.srcWidth - 1);
+					CBitmapOperations::Copy(
+						srcPixelType, static_cast<const char*>(resizeInfo.srcPtr) + srcYInt * resizeInfo.srcStride + srcXInt * bytesPerPelSrc, 0,
+						dstPixelType, static_cast<char*>(resizeInfo.dstPtr) + y * resizeInfo.dstStride + x * bytesPerPelDst, 0,
+						1, 1, false);
+				}
+			}
+		}
+
 		static std::shared_ptr<IBitmapData> CreateTestImage()
 		{
 			auto bm = CBitmapData<CHeapAllocator>::Create(PixelType::Bgr24, CTestImage::BGR24TESTIMAGE_WIDTH, CTestImage::BGR24TESTIMAGE_HEIGHT);
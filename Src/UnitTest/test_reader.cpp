@@ -24,6 +24,10 @@
 #include "CppUnitTest.h"
 
 #include "inc_libCZI.h"
+#include "testCziData.h"
+#include <sstream>
+#include <thread>
+#include <atomic>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace libCZI;
@@ -136,5 +140,843 @@ namespace UnitTest
 
 			Assert::IsTrue(expectedExceptionCaught == true, L"Incorrect behavior", LINE_INFO());
 		}
+
+		TEST_METHOD(TestMethod_ReaderCompactSubBlockDirectory)
+		{
+			auto cziData = CTestCziData::CreateMosaic(5, 4, 16, 2);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+			auto spReaderCompact = libCZI::CreateCZIReader();
+			ICZIReader::OpenOptions options;
+			options.Clear();
+			options.useCompactSubBlockDirectory = true;
+			spReaderCompact->Open(CreateStreamFromMemory(spBuffer, cziData.size()), &options);
+
+			std::vector<std::string> subBlocks, subBlocksCompact;
+			auto toString = [](const SubBlockInfo& info)->std::string
+			{
+				std::stringstream ss;
+				ss << Utils::DimCoordinateToString(&info.coordinate) << ' ' << info.mIndex << ' ' << info.logicalRect.x << ',' << info.logicalRect.y << ',' << info.logicalRect.w << ',' << info.logicalRect.h
+					<< ' ' << info.physicalSize.w << 'x' << info.physicalSize.h << ' ' << (int)info.pixelType << ' ' << (int)info.mode;
+				return ss.str();
+			};
+
+			spReader->EnumerateSubBlocks([&](int index, const SubBlockInfo& info)->bool {subBlocks.push_back(toString(info)); return true; });
+			spReaderCompact->EnumerateSubBlocks([&](int index, const SubBlockInfo& info)->bool {subBlocksCompact.push_back(toString(info)); return true; });
+			Assert::IsTrue(subBlocks.size() == 40 && subBlocks == subBlocksCompact, L"Incorrect result", LINE_INFO());
+
+			SubBlockInfo info;
+			Assert::IsTrue(spReaderCompact->TryGetSubBlockInfoOfArbitrarySubBlockInChannel(1, info) == true && info.mIndex == 0, L"Incorrect result", LINE_INFO());
+
+			const IntRect roi{ 5, 7, 60, 50 };
+			auto planeCoordinate = CDimCoordinate::Parse("C1");
+			auto bitmap = spReader->CreateSingleChannelTileAccessor()->Get(roi, &planeCoordinate, nullptr);
+			auto bitmapCompact = spReaderCompact->CreateSingleChannelTileAccessor()->Get(roi, &planeCoordinate, nullptr);
+			ScopedBitmapLockerSP lck{ bitmap };
+			ScopedBitmapLockerSP lckCompact{ bitmapCompact };
+			for (int y = 0; y < roi.h; ++y)
+			{
+				const std::uint8_t* p = static_cast<const std::uint8_t*>(lck.ptrDataRoi) + y * lck.stride;
+				const std::uint8_t* pCompact = static_cast<const std::uint8_t*>(lckCompact.ptrDataRoi) + y * lckCompact.stride;
+				Assert::IsTrue(memcmp(p, pCompact, roi.w) == 0, L"Incorrect result", LINE_INFO());
+				Assert::IsTrue(p[0] == CTestCziData::GetPixelValue(20 + ((7 + y) / 16) * 5, 5, (7 + y) % 16), L"Incorrect result", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestMethod_ReaderOpenWithOptionsDefaultImplementation)
+		{
+			// an implementation of ICZIReader which was written before the options were added (so it only implements
+			//  Open(stream)) - Open with options must fall back to it
+			class CReader : public libCZI::ICZIReader
+			{
+			private:
+				std::shared_ptr<libCZI::ICZIReader> reader;
+			public:
+				int openCount;
+
+				CReader() : reader(libCZI::CreateCZIReader()), openCount(0) {}
+				virtual void EnumerateSubBlocks(std::function<bool(int index, const SubBlockInfo& info)> funcEnum) override { this->reader->EnumerateSubBlocks(funcEnum); }
+				virtual void EnumSubset(const IDimCoordinate* planeCoordinate, const IntRect* roi, bool onlyLayer0, std::function<bool(int index, const SubBlockInfo& info)> funcEnum) override { this->reader->EnumSubset(planeCoordinate, roi, onlyLayer0, funcEnum); }
+				virtual std::shared_ptr<ISubBlock> ReadSubBlock(int index) override { return this->reader->ReadSubBlock(index); }
+				virtual bool TryGetSubBlockInfoOfArbitrarySubBlockInChannel(int channelIndex, SubBlockInfo& info) override { return this->reader->TryGetSubBlockInfoOfArbitrarySubBlockInChannel(channelIndex, info); }
+				virtual SubBlockStatistics GetStatistics() override { return this->reader->GetStatistics(); }
+				virtual PyramidStatistics GetPyramidStatistics() override { return this->reader->GetPyramidStatistics(); }
+				virtual void EnumerateAttachments(std::function<bool(int index, const AttachmentInfo& info)> funcEnum) override { this->reader->EnumerateAttachments(funcEnum); }
+				virtual void EnumerateSubset(const char* contentFileType, const char* name, std::function<bool(int index, const AttachmentInfo& infi)> funcEnum) override { this->reader->EnumerateSubset(contentFileType, name, funcEnum); }
+				virtual std::shared_ptr<IAttachment> ReadAttachment(int index) override { return this->reader->ReadAttachment(index); }
+				virtual void Open(std::shared_ptr<IStream> stream) override { ++this->openCount; this->reader->Open(stream); }
+				virtual std::shared_ptr<IMetadataSegment> ReadMetadataSegment() override { return this->reader->ReadMetadataSegment(); }
+				virtual std::shared_ptr<IAccessor> CreateAccessor(AccessorType accessorType) override { return this->reader->CreateAccessor(accessorType); }
+				virtual void Close() override { this->reader->Close(); }
+			};
+
+			auto cziData = CTestCziData::CreateMosaic(3, 2, 16, 1);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			CReader reader;
+			libCZI::ICZIReader* pReader = &reader;
+			ICZIReader::OpenOptions options;
+			options.Clear();
+			options.useCompactSubBlockDirectory = true;
+			pReader->Open(CreateStreamFromMemory(spBuffer, cziData.size()), &options);
+			Assert::IsTrue(reader.openCount == 1, L"Incorrect behavior", LINE_INFO());
+			Assert::IsTrue(pReader->GetStatistics().subBlockCount == 6, L"Incorrect result", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_ReaderTileAccessorOcclusion)
+		{
+			static const int Count = 4;
+			static const int TileSize = 32;
+			static const int Step = 20;
+			auto cziData = CTestCziData::CreateMosaic(Count, Count, TileSize, 1, 0, 0, TileSize - Step);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+
+			// with "sortByM", a pixel shows the tile with the highest M-index containing it - which is the one in the
+			//  highest row and column
+			auto getExpectedPixel = [](int x, int y)->std::uint8_t
+			{
+				const int column = (std::min)(x / Step, Count - 1);
+				const int row = (std::min)(y / Step, Count - 1);
+				return CTestCziData::GetPixelValue(row * Count + column, x - column * Step, y - row * Step);
+			};
+
+			auto planeCoordinate = CDimCoordinate::Parse("C0");
+			auto accessor = spReader->CreateSingleChannelTileAccessor();
+			for (const IntRect& roi : { IntRect{ 0, 0, 92, 92 }, IntRect{ 3, 7, 50, 61 }, IntRect{ 20, 20, 20, 20 }, IntRect{ 50, 10, 60, 50 } })
+			{
+				auto cache = libCZI::CreateSubBlockCache(100 * TileSize * TileSize);
+				ISingleChannelTileAccessor::Options options; options.Clear();
+				options.backGroundColor = RgbFloatColor{ 1, 1, 1 };
+				options.subBlockCache = cache;
+				auto bitmap = accessor->Get(roi, &planeCoordinate, &options);
+				ScopedBitmapLockerSP lck{ bitmap };
+				bool isCorrect = true;
+				for (int y = 0; y < roi.h; ++y)
+				{
+					for (int x = 0; x < roi.w; ++x)
+					{
+						const std::uint8_t expected = (roi.x + x < 92 && roi.y + y < 92) ? getExpectedPixel(roi.x + x, roi.y + y) : 0xff;
+						isCorrect &= static_cast<const std::uint8_t*>(lck.ptrDataRoi)[y * lck.stride + x] == expected;
+					}
+				}
+
+				Assert::IsTrue(isCorrect, L"Incorrect result", LINE_INFO());
+
+				// within this ROI, only the tile in the second row and column is visible - the ones below it are not read
+				if (roi.x == 20 && roi.y == 20)
+				{
+					Assert::IsTrue(cache->GetStatistics().misses == 1, L"expected the hidden tiles not to be read", LINE_INFO());
+				}
+			}
+		}
+
+		TEST_METHOD(TestMethod_ReaderSubBlockCache)
+		{
+			static const int TileSize = 16;
+			auto cziData = CTestCziData::CreateMosaic(5, 4, TileSize, 1);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+
+			auto isEqual = [](const std::shared_ptr<IBitmapData>& bm1, const std::shared_ptr<IBitmapData>& bm2)->bool
+			{
+				ScopedBitmapLockerSP lck1{ bm1 };
+				ScopedBitmapLockerSP lck2{ bm2 };
+				for (std::uint32_t y = 0; y < bm1->GetHeight(); ++y)
+				{
+					if (memcmp(static_cast<const std::uint8_t*>(lck1.ptrDataRoi) + y * lck1.stride, static_cast<const std::uint8_t*>(lck2.ptrDataRoi) + y * lck2.stride, bm1->GetWidth()) != 0)
+					{
+						return false;
+					}
+				}
+
+				return true;
+			};
+
+			// the ROI intersects with 3x2 tiles
+			const IntRect roi{ 5, 7, 40, 20 };
+			auto planeCoordinate = CDimCoordinate::Parse("C0");
+			auto cache = libCZI::CreateSubBlockCache(100 * TileSize * TileSize);
+			auto accessor = spReader->CreateSingleChannelTileAccessor();
+			ISingleChannelTileAccessor::Options options; options.Clear();
+			options.subBlockCache = cache;
+			auto bitmap = accessor->Get(roi, &planeCoordinate, nullptr);
+			Assert::IsTrue(isEqual(bitmap, accessor->Get(roi, &planeCoordinate, &options)), L"Incorrect result", LINE_INFO());
+			auto statistics = cache->GetStatistics();
+			Assert::IsTrue(statistics.hits == 0 && statistics.misses == 6 && statistics.elementsCount == 6 && statistics.memoryUsage == 6 * TileSize * TileSize, L"Incorrect statistics", LINE_INFO());
+			Assert::IsTrue(isEqual(bitmap, accessor->Get(roi, &planeCoordinate, &options)), L"Incorrect result", LINE_INFO());
+			statistics = cache->GetStatistics();
+			Assert::IsTrue(statistics.hits == 6 && statistics.misses == 6 && statistics.evictions == 0, L"Incorrect statistics", LINE_INFO());
+
+			// the cache is shared with the scaling accessor
+			auto scalingAccessor = spReader->CreateSingleChannelScalingTileAccessor();
+			ISingleChannelScalingTileAccessor::Options scalingOptions; scalingOptions.Clear();
+			scalingOptions.subBlockCache = cache;
+			auto scaledBitmap = scalingAccessor->Get(roi, &planeCoordinate, 0.5f, nullptr);
+			Assert::IsTrue(isEqual(scaledBitmap, scalingAccessor->Get(roi, &planeCoordinate, 0.5f, &scalingOptions)), L"Incorrect result", LINE_INFO());
+			statistics = cache->GetStatistics();
+			Assert::IsTrue(statistics.hits == 12 && statistics.misses == 6, L"Incorrect statistics", LINE_INFO());
+
+			// with a budget of three tiles, the least recently used tiles are evicted
+			auto smallCache = libCZI::CreateSubBlockCache(3 * TileSize * TileSize);
+			options.subBlockCache = smallCache;
+			Assert::IsTrue(isEqual(bitmap, accessor->Get(roi, &planeCoordinate, &options)), L"Incorrect result", LINE_INFO());
+			statistics = smallCache->GetStatistics();
+			Assert::IsTrue(statistics.misses == 6 && statistics.evictions == 3 && statistics.elementsCount == 3 && statistics.memoryUsage == 3 * TileSize * TileSize, L"Incorrect statistics", LINE_INFO());
+
+			// an entry is not mistaken for one of a different repository
+			auto spReader2 = libCZI::CreateCZIReader();
+			spReader2->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+			Assert::IsTrue(!cache->Get(spReader2, 0) && cache->Get(spReader, 0), L"Incorrect result", LINE_INFO());
+			cache->Clear();
+			statistics = cache->GetStatistics();
+			Assert::IsTrue(statistics.elementsCount == 0 && statistics.memoryUsage == 0, L"Incorrect statistics", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_ReaderScalingAccessorAreaAverage)
+		{
+			static const int TileSize = 16;
+			auto cziData = CTestCziData::CreateMosaic(5, 4, TileSize, 1);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+
+			// with a zoom of 1/4, every destination pixel covers 4x4 pixels of a single tile, so the result is the
+			// average of these pixels in the composite
+			const IntRect roi{ 0, 0, 5 * TileSize, 4 * TileSize };
+			auto planeCoordinate = CDimCoordinate::Parse("C0");
+			auto composite = spReader->CreateSingleChannelTileAccessor()->Get(roi, &planeCoordinate, nullptr);
+			auto scalingAccessor = spReader->CreateSingleChannelScalingTileAccessor();
+			ISingleChannelScalingTileAccessor::Options options; options.Clear();
+			Assert::IsTrue(options.resamplingMode == ISingleChannelScalingTileAccessor::ResamplingMode::NearestNeighbor, L"expected nearest-neighbor to be the default", LINE_INFO());
+			options.resamplingMode = ISingleChannelScalingTileAccessor::ResamplingMode::AreaAverage;
+			auto bitmap = scalingAccessor->Get(roi, &planeCoordinate, 0.25f, &options);
+			Assert::IsTrue(bitmap->GetWidth() == roi.w / 4 && bitmap->GetHeight() == roi.h / 4, L"unexpected size", LINE_INFO());
+
+			ScopedBitmapLockerSP lckComposite{ composite };
+			ScopedBitmapLockerSP lckBitmap{ bitmap };
+			for (std::uint32_t y = 0; y < bitmap->GetHeight(); ++y)
+			{
+				for (std::uint32_t x = 0; x < bitmap->GetWidth(); ++x)
+				{
+					int sum = 0;
+					for (int i = 0; i < 16; ++i)
+					{
+						sum += static_cast<const std::uint8_t*>(lckComposite.ptrDataRoi)[(y * 4 + i / 4) * lckComposite.stride + x * 4 + i % 4];
+					}
+
+					const int value = static_cast<const std::uint8_t*>(lckBitmap.ptrDataRoi)[y * lckBitmap.stride + x];
+					Assert::IsTrue(value == (sum + 8) / 16, L"incorrect average", LINE_INFO());
+				}
+			}
+		}
+
+		TEST_METHOD(TestMethod_ReaderScalingAccessorReducedResolutionJxr)
+		{
+			static const int TileSize = CTestCziData::JxrTestTileSize;
+			auto cziData = CTestCziData::CreateJxrMosaic(2, 2);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+			auto scalingAccessor = spReader->CreateSingleChannelScalingTileAccessor();
+			auto planeCoordinate = CDimCoordinate::Parse("C0");
+
+			// the reference images - the tile decoded completely, and decoded with a reduced resolution (by the
+			// factors 2, 4 and 8)
+			auto decoder = libCZI::GetDefaultSiteObject(libCZI::SiteObjectType::WithJxrDecoder)->GetDecoder(libCZI::ImageDecoderType::JPXR_JxrLib, nullptr);
+			std::shared_ptr<IBitmapData> references[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				references[i] = i == 0 ? decoder->Decode(CTestCziData::JxrTestTile, CTestCziData::JxrTestTileDataSize) : decoder->DecodeReduced(CTestCziData::JxrTestTile, CTestCziData::JxrTestTileDataSize, 1 << i, nullptr);
+				Assert::IsTrue(references[i]->GetWidth() == (std::uint32_t)(TileSize >> i) && references[i]->GetHeight() == (std::uint32_t)(TileSize >> i), L"unexpected size", LINE_INFO());
+			}
+
+			ISingleChannelScalingTileAccessor::Options options; options.Clear();
+			Assert::IsTrue(!options.decodeReducedResolution, L"expected decoding with full resolution to be the default", LINE_INFO());
+			options.backGroundColor = RgbFloatColor{ 0, 0, 0 };
+
+			// Every pixel of the result must be one of the pixels of the reference image (which is the complete tile, or
+			// the tile with the resolution reduced by the expected factor) - we check that it is a pixel within the area
+			// covered by the destination pixel (plus one pixel of the reference for the rounding).
+			auto checkResult = [&](const IntRect& roi, int reductionExponent, const std::shared_ptr<IBitmapData>& bitmap)->void
+			{
+				const int reductionFactor = 1 << reductionExponent;
+				ScopedBitmapLockerSP lckBitmap{ bitmap };
+				ScopedBitmapLockerSP lckReference{ references[reductionExponent] };
+				for (std::uint32_t y = 0; y < bitmap->GetHeight(); ++y)
+				{
+					for (std::uint32_t x = 0; x < bitmap->GetWidth(); ++x)
+					{
+						const int logicalX1 = roi.x + (int)(x * (double)roi.w / bitmap->GetWidth());
+						const int logicalY1 = roi.y + (int)(y * (double)roi.h / bitmap->GetHeight());
+						const int logicalX2 = roi.x + (int)((x + 1) * (double)roi.w / bitmap->GetWidth());
+						const int logicalY2 = roi.y + (int)((y + 1) * (double)roi.h / bitmap->GetHeight());
+						const std::uint8_t* ptrPixel = static_cast<const std::uint8_t*>(lckBitmap.ptrDataRoi) + y * lckBitmap.stride + x * 3;
+						bool found = false;
+						for (int logicalY = (std::max)(logicalY1 - reductionFactor, 0); logicalY <= (std::min)(logicalY2 + reductionFactor, 2 * TileSize - 1) && !found; ++logicalY)
+						{
+							for (int logicalX = (std::max)(logicalX1 - reductionFactor, 0); logicalX <= (std::min)(logicalX2 + reductionFactor, 2 * TileSize - 1) && !found; ++logicalX)
+							{
+								const int xr = (logicalX % TileSize) / reductionFactor;
+								const int yr = (logicalY % TileSize) / reductionFactor;
+								found = memcmp(ptrPixel, static_cast<const std::uint8_t*>(lckReference.ptrDataRoi) + yr * lckReference.stride + xr * 3, 3) == 0;
+							}
+						}
+
+						Assert::IsTrue(found, L"incorrect result", LINE_INFO());
+					}
+				}
+			};
+
+			const IntRect rois[] = { IntRect{ 0, 0, 2 * TileSize, 2 * TileSize }, IntRect{ 40, 30, 200, 150 } };
+			const float zooms[] = { 0.5f, 0.25f, 0.125f };
+			for (const auto& roi : rois)
+			{
+				for (int i = 0; i < 3; ++i)
+				{
+					options.decodeReducedResolution = false;
+					auto bitmapFull = scalingAccessor->Get(PixelType::Bgr24, roi, &planeCoordinate, zooms[i], &options);
+					checkResult(roi, 0, bitmapFull);
+
+					options.decodeReducedResolution = true;
+					auto bitmapReduced = scalingAccessor->Get(PixelType::Bgr24, roi, &planeCoordinate, zooms[i], &options);
+					checkResult(roi, i + 1, bitmapReduced);
+
+					// the reduced image is not simply a subsampled version of the complete image, so the results differ
+					ScopedBitmapLockerSP lckFull{ bitmapFull };
+					ScopedBitmapLockerSP lckReduced{ bitmapReduced };
+					bool differs = false;
+					for (std::uint32_t y = 0; y < bitmapFull->GetHeight() && !differs; ++y)
+					{
+						differs = memcmp(static_cast<const std::uint8_t*>(lckFull.ptrDataRoi) + y * lckFull.stride, static_cast<const std::uint8_t*>(lckReduced.ptrDataRoi) + y * lckReduced.stride, bitmapFull->GetWidth() * 3) != 0;
+					}
+
+					Assert::IsTrue(differs, L"expected the results to differ", LINE_INFO());
+				}
+			}
+		}
+
+		TEST_METHOD(TestMethod_DecodeJxrConcurrently)
+		{
+			static const int ThreadCount = 4;
+			static const int Repeat = 25;
+
+			// The decoder (of the default site) is shared - it keeps a decoder context for each concurrent caller, so
+			//  the threads must not interfere with each other (with the complete and the reduced-resolution decode mixed).
+			auto decoder = libCZI::GetDefaultSiteObject(libCZI::SiteObjectType::WithJxrDecoder)->GetDecoder(libCZI::ImageDecoderType::JPXR_JxrLib, nullptr);
+			auto getPixels = [](const std::shared_ptr<libCZI::IBitmapData>& bm)->std::vector<std::uint8_t>
+			{
+				std::vector<std::uint8_t> pixels(bm->GetWidth() * bm->GetHeight() * 3);
+				ScopedBitmapLockerSP lck{ bm };
+				for (std::uint32_t y = 0; y < bm->GetHeight(); ++y)
+				{
+					memcpy(&pixels[y * bm->GetWidth() * 3], static_cast<const std::uint8_t*>(lck.ptrDataRoi) + y * lck.stride, bm->GetWidth() * 3);
+				}
+
+				return pixels;
+			};
+
+			const std::vector<std::uint8_t> reference = getPixels(decoder->Decode(CTestCziData::JxrTestTile, CTestCziData::JxrTestTileDataSize));
+			const std::vector<std::uint8_t> referenceReduced = getPixels(decoder->DecodeReduced(CTestCziData::JxrTestTile, CTestCziData::JxrTestTileDataSize, 2, nullptr));
+
+			std::atomic<int> errorCount(0);
+			std::vector<std::thread> threads;
+			for (int t = 0; t < ThreadCount; ++t)
+			{
+				threads.emplace_back(
+					[&, t]()->void
+				{
+					try
+					{
+						for (int i = 0; i < Repeat; ++i)
+						{
+							if ((i + t) % 2 == 0)
+							{
+								auto bm = decoder->Decode(CTestCziData::JxrTestTile, CTestCziData::JxrTestTileDataSize);
+								if (bm->GetPixelType() != PixelType::Bgr24 || getPixels(bm) != reference)
+								{
+									++errorCount;
+								}
+							}
+							else
+							{
+								auto bm = decoder->DecodeReduced(CTestCziData::JxrTestTile, CTestCziData::JxrTestTileDataSize, 2, nullptr);
+								if (bm->GetPixelType() != PixelType::Bgr24 || getPixels(bm) != referenceReduced)
+								{
+									++errorCount;
+								}
+							}
+						}
+					}
+					catch (std::exception&)
+					{
+						++errorCount;
+					}
+				});
+			}
+
+			for (auto& th : threads)
+			{
+				th.join();
+			}
+
+			Assert::IsTrue(errorCount.load() == 0, L"result differs when decoding concurrently", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_ReaderAccessorsMultiThreaded)
+		{
+			auto cziData = CTestCziData::CreateMosaic(8, 6, 16, 2);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+
+			auto isEqual = [](const std::shared_ptr<IBitmapData>& bm1, const std::shared_ptr<IBitmapData>& bm2)->bool
+			{
+				ScopedBitmapLockerSP lck1{ bm1 };
+				ScopedBitmapLockerSP lck2{ bm2 };
+				for (std::uint32_t y = 0; y < bm1->GetHeight(); ++y)
+				{
+					if (memcmp(static_cast<const std::uint8_t*>(lck1.ptrDataRoi) + y * lck1.stride, static_cast<const std::uint8_t*>(lck2.ptrDataRoi) + y * lck2.stride, bm1->GetWidth()) != 0)
+					{
+						return false;
+					}
+				}
+
+				return true;
+			};
+
+			// the tiles are read on multiple threads (and possibly ahead of decoding or in batches), but they are composed in the same
+			//  order - so the result is identical
+			const IntRect roi{ 3, 9, 110, 70 };
+			auto planeCoordinate = CDimCoordinate::Parse("C1");
+			ISingleChannelTileAccessor::Options options; options.Clear();
+			ISingleChannelScalingTileAccessor::Options scalingOptions; scalingOptions.Clear();
+			ISingleChannelPyramidLayerTileAccessor::Options pyramidOptions; pyramidOptions.Clear();
+			ISingleChannelPyramidLayerTileAccessor::PyramidLayerInfo pyramidLayerInfo{ 2, 0 };
+			auto tileAccessor = spReader->CreateSingleChannelTileAccessor();
+			auto scalingAccessor = spReader->CreateSingleChannelScalingTileAccessor();
+			auto pyramidAccessor = spReader->CreateSingleChannelPyramidLayerTileAccessor();
+			auto bitmap = tileAccessor->Get(roi, &planeCoordinate, &options);
+			auto scaledBitmap = scalingAccessor->Get(roi, &planeCoordinate, 0.7f, &scalingOptions);
+			auto pyramidBitmap = pyramidAccessor->Get(roi, &planeCoordinate, pyramidLayerInfo, &pyramidOptions);
+			for (int readBatchSize : { 1, 5 })
+			{
+				for (int prefetchDepth : { 0, 1, 3 })
+				{
+					for (int maxThreads : { 1, 2, 4, 64 })
+					{
+						options.maxThreads = scalingOptions.maxThreads = pyramidOptions.maxThreads = maxThreads;
+						options.prefetchDepth = scalingOptions.prefetchDepth = pyramidOptions.prefetchDepth = prefetchDepth;
+						options.readBatchSize = scalingOptions.readBatchSize = pyramidOptions.readBatchSize = readBatchSize;
+						Assert::IsTrue(isEqual(bitmap, tileAccessor->Get(roi, &planeCoordinate, &options)), L"Incorrect result", LINE_INFO());
+						Assert::IsTrue(isEqual(scaledBitmap, scalingAccessor->Get(roi, &planeCoordinate, 0.7f, &scalingOptions)), L"Incorrect result", LINE_INFO());
+						Assert::IsTrue(isEqual(pyramidBitmap, pyramidAccessor->Get(roi, &planeCoordinate, pyramidLayerInfo, &pyramidOptions)), L"Incorrect result", LINE_INFO());
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(TestMethod_ParallelTileLoader)
+		{
+			static const int Count = 100;
+			static const int MaxThreads = 4;
+			static const int PrefetchDepth = 2;
+
+			CThreadPool threadPool(1, MaxThreads + 1);
+
+			// The workers must not decode further ahead of the tile the consumer waits for than the number of threads plus
+			// the prefetch-depth - also if the consumer is slow.
+			for (int prefetchDepth : { 0, PrefetchDepth })
+			{
+				std::atomic<int> consumerIndex(0);
+				std::atomic<bool> tooFarAhead(false);
+				std::vector<int> readCount(Count, 0), decodeCount(Count, 0);
+				{
+					CParallelTileLoader loader(threadPool, Count, MaxThreads, prefetchDepth,
+						[&](int index)->void { ++readCount[index]; },
+						[&](int index)->void
+					{
+						++decodeCount[index];
+						if (index >= consumerIndex.load() + MaxThreads + prefetchDepth)
+						{
+							tooFarAhead = true;
+						}
+					});
+
+					for (int i = 0; i < Count; ++i)
+					{
+						consumerIndex = i;
+						loader.WaitFor(i);
+						Assert::IsTrue(readCount[i] == 1 && decodeCount[i] == 1, L"the tile was not loaded exactly once", LINE_INFO());
+						std::this_thread::sleep_for(std::chrono::microseconds(200));
+					}
+				}
+
+				Assert::IsFalse(tooFarAhead.load(), L"a tile was decoded too far ahead of the consumer", LINE_INFO());
+			}
+
+			// if the loader is destroyed before all tiles are consumed, it stops loading (within the window ahead of the last
+			// tile the consumer waited for)
+			std::atomic<int> decoded(0);
+			{
+				CParallelTileLoader loader(threadPool, Count, MaxThreads, PrefetchDepth, [](int)->void {}, [&](int)->void { ++decoded; });
+				for (int i = 0; i < 10; ++i)
+				{
+					loader.WaitFor(i);
+				}
+			}
+
+			Assert::IsTrue(decoded.load() <= 10 + MaxThreads + PrefetchDepth, L"too many tiles were decoded", LINE_INFO());
+
+			// an exception thrown while loading a tile is re-thrown when waiting for it, and does not affect the other tiles
+			{
+				CParallelTileLoader loader(threadPool, Count, MaxThreads, PrefetchDepth,
+					[](int index)->void { if (index == 5) { throw std::runtime_error("read"); } },
+					[](int index)->void { if (index == 7) { throw std::runtime_error("decode"); } });
+				for (int i = 0; i < Count; ++i)
+				{
+					bool exceptionCaught = false;
+					try
+					{
+						loader.WaitFor(i);
+					}
+					catch (std::runtime_error&)
+					{
+						exceptionCaught = true;
+					}
+
+					Assert::IsTrue(exceptionCaught == (i == 5 || i == 7), L"unexpected exception", LINE_INFO());
+				}
+			}
+
+			// if the pool has fewer threads available than requested (here: none or only one, as the others are used by
+			// a concurrent loader), the loader makes do with them - the tiles are loaded all the same
+			for (int availableThreads : { 0, 1 })
+			{
+				std::mutex mutex;
+				std::condition_variable released;
+				bool release = false;
+				CThreadPool smallThreadPool(1, 2);	// declared last, so that the threads are joined before the objects they use are destroyed
+				for (int i = availableThreads; i < 2; ++i)
+				{
+					smallThreadPool.TryExecute([&]()->void
+					{
+						std::unique_lock<std::mutex> lck(mutex);
+						released.wait(lck, [&]()->bool { return release; });
+					});
+				}
+
+				std::vector<int> loadCount(Count, 0);
+				{
+					CParallelTileLoader loader(smallThreadPool, Count, MaxThreads, PrefetchDepth, [&](int index)->void { ++loadCount[index]; }, [&](int index)->void { ++loadCount[index]; });
+					for (int i = 0; i < Count; ++i)
+					{
+						loader.WaitFor(i);
+						Assert::IsTrue(loadCount[i] == 2, L"the tile was not loaded", LINE_INFO());
+					}
+				}
+
+				{
+					std::lock_guard<std::mutex> lck(mutex);
+					release = true;
+				}
+
+				released.notify_all();
+			}
+		}
+
+		TEST_METHOD(TestMethod_ReaderLazyLoadDirectories)
+		{
+			// a stream which records the positions which are read
+			class CRecordingStream : public libCZI::IStream
+			{
+			private:
+				std::shared_ptr<libCZI::IStream> stream;
+			public:
+				std::vector<std::uint64_t> offsets;
+
+				CRecordingStream(std::shared_ptr<libCZI::IStream> stream) : stream(stream) {}
+
+				virtual void Read(std::uint64_t offset, void *pv, std::uint64_t size, std::uint64_t* ptrBytesRead) override
+				{
+					this->offsets.push_back(offset);
+					this->stream->Read(offset, pv, size, ptrBytesRead);
+				}
+			};
+
+			auto cziData = CTestCziData::CreateMosaic(5, 4, 16, 2);
+			CTestCziData::AddMetadataAndAttachmentDirectory(cziData, std::string(200, 'x'), 3);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto stream = std::make_shared<CRecordingStream>(CreateStreamFromMemory(spBuffer, cziData.size()));
+			auto spReader = libCZI::CreateCZIReader();
+			ICZIReader::OpenOptions options;
+			options.Clear();
+			options.lazyLoadDirectories = true;
+			spReader->Open(stream, &options);
+			Assert::IsTrue(stream->offsets.size() == 1 && stream->offsets[0] == 0, L"Only the file-header is expected to be read", LINE_INFO());
+
+			// reading the metadata must not load any of the directories
+			auto metadataSegment = spReader->ReadMetadataSegment();
+			size_t metadataSize;
+			metadataSegment->GetRawData(IMetadataSegment::MemBlkType::XmlMetadata, &metadataSize);
+			Assert::IsTrue(metadataSize == 200, L"Incorrect result", LINE_INFO());
+			const size_t readCountAfterMetadata = stream->offsets.size();
+
+			auto spReference = libCZI::CreateCZIReader();
+			spReference->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+			auto statistics = spReader->GetStatistics();
+			Assert::IsTrue(stream->offsets.size() > readCountAfterMetadata, L"The sub-block directory is expected to be read", LINE_INFO());
+			Assert::IsTrue(statistics.subBlockCount == 40 && statistics.subBlockCount == spReference->GetStatistics().subBlockCount, L"Incorrect result", LINE_INFO());
+
+			int attachmentCount = 0;
+			spReader->EnumerateAttachments([&](int index, const AttachmentInfo& info)->bool {++attachmentCount; return true; });
+			int referenceAttachmentCount = 0;
+			spReference->EnumerateAttachments([&](int index, const AttachmentInfo& info)->bool {++referenceAttachmentCount; return true; });
+			Assert::IsTrue(attachmentCount == 3 && attachmentCount == referenceAttachmentCount, L"Incorrect result", LINE_INFO());
+
+			auto subBlock = spReader->ReadSubBlock(21);
+			Assert::IsTrue(subBlock->GetSubBlockInfo().mIndex == 1, L"Incorrect result", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_ReaderCreateBitmapFromSubBlockRoi)
+		{
+			auto cziData = CTestCziData::CreateMosaic(2, 2, 16, 1);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto spReader = libCZI::CreateCZIReader();
+			spReader->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+			auto subBlock = spReader->ReadSubBlock(3);
+
+			const IntRect roi{ 3, 5, 7, 2 };
+			auto bitmap = libCZI::CreateBitmapFromSubBlock(subBlock.get(), roi);
+			Assert::IsTrue(bitmap->GetWidth() == 7 && bitmap->GetHeight() == 2, L"Incorrect result", LINE_INFO());
+			{
+				ScopedBitmapLockerSP lck{ bitmap };
+				for (int y = 0; y < roi.h; ++y)
+				{
+					for (int x = 0; x < roi.w; ++x)
+					{
+						std::uint8_t v = static_cast<const std::uint8_t*>(lck.ptrDataRoi)[y * lck.stride + x];
+						Assert::IsTrue(v == CTestCziData::GetPixelValue(3, roi.x + x, roi.y + y), L"Incorrect result", LINE_INFO());
+					}
+				}
+			}
+
+			bool exceptionCaught = false;
+			try
+			{
+				libCZI::CreateBitmapFromSubBlock(subBlock.get(), IntRect{ 10, 0, 7, 1 });
+			}
+			catch (std::invalid_argument&)
+			{
+				exceptionCaught = true;
+			}
+
+			Assert::IsTrue(exceptionCaught, L"An exception was expected for a ROI outside the sub-block", LINE_INFO());
+
+			// a decoder which does not implement decoding of a region, so that the default implementation is used
+			class CDecoder : public libCZI::IDecoder
+			{
+			private:
+				std::shared_ptr<libCZI::IBitmapData> bitmap;
+			public:
+				CDecoder(std::shared_ptr<libCZI::IBitmapData> bitmap) : bitmap(bitmap) {}
+
+				virtual std::shared_ptr<libCZI::IBitmapData> Decode(const void* ptrData, size_t size) override
+				{
+					return this->bitmap;
+				}
+			};
+
+			CDecoder decoder(subBlock->CreateBitmap());
+			auto bitmapDecoded = static_cast<libCZI::IDecoder&>(decoder).Decode(nullptr, 0, roi);
+			ScopedBitmapLockerSP lck{ bitmap };
+			ScopedBitmapLockerSP lckDecoded{ bitmapDecoded };
+			Assert::IsTrue(bitmapDecoded->GetWidth() == 7 && bitmapDecoded->GetHeight() == 2, L"Incorrect result", LINE_INFO());
+			for (int y = 0; y < roi.h; ++y)
+			{
+				Assert::IsTrue(memcmp(static_cast<const std::uint8_t*>(lck.ptrDataRoi) + y * lck.stride, static_cast<const std::uint8_t*>(lckDecoded.ptrDataRoi) + y * lckDecoded.stride, roi.w) == 0, L"Incorrect result", LINE_INFO());
+			}
+
+			// with the resolution reduced by 4, the image has a size of 4x4
+			const IntRect roiReduced{ 1, 2, 3, 2 };
+			auto bitmapReduced = static_cast<libCZI::IDecoder&>(decoder).DecodeReduced(nullptr, 0, 4, &roiReduced);
+			Assert::IsTrue(bitmapReduced->GetWidth() == 3 && bitmapReduced->GetHeight() == 2, L"Incorrect result", LINE_INFO());
+			ScopedBitmapLockerSP lckReduced{ bitmapReduced };
+			for (int y = 0; y < roiReduced.h; ++y)
+			{
+				for (int x = 0; x < roiReduced.w; ++x)
+				{
+					std::uint8_t v = static_cast<const std::uint8_t*>(lckReduced.ptrDataRoi)[y * lckReduced.stride + x];
+					Assert::IsTrue(v == CTestCziData::GetPixelValue(3, (roiReduced.x + x) * 4, (roiReduced.y + y) * 4), L"Incorrect result", LINE_INFO());
+				}
+			}
+
+			exceptionCaught = false;
+			try
+			{
+				const IntRect roiOutside{ 1, 2, 3, 3 };
+				static_cast<libCZI::IDecoder&>(decoder).DecodeReduced(nullptr, 0, 4, &roiOutside);
+			}
+			catch (std::invalid_argument&)
+			{
+				exceptionCaught = true;
+			}
+
+			Assert::IsTrue(exceptionCaught, L"An exception was expected for a ROI outside the reduced image", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMethod_ReaderSidecarIndex)
+		{
+			// a stream which reports a (settable) modification time and counts the read operations
+			class CFileInfoStream : public libCZI::IStream, public libCZI::IStreamFileInfo
+			{
+			private:
+				std::shared_ptr<libCZI::IStream> stream;
+				std::uint64_t size;
+			public:
+				std::int64_t modificationTime;
+				int readCount;
+
+				CFileInfoStream(std::shared_ptr<libCZI::IStream> stream, std::uint64_t size) : stream(stream), size(size), modificationTime(1), readCount(0) {}
+
+				virtual void Read(std::uint64_t offset, void *pv, std::uint64_t size, std::uint64_t* ptrBytesRead) override
+				{
+					++this->readCount;
+					this->stream->Read(offset, pv, size, ptrBytesRead);
+				}
+
+				virtual bool TryGetFileInfo(std::uint64_t* fileSize, std::int64_t* modificationTime) override
+				{
+					if (fileSize != nullptr) { *fileSize = this->size; }
+					if (modificationTime != nullptr) { *modificationTime = this->modificationTime; }
+					return true;
+				}
+			};
+
+			auto cziData = CTestCziData::CreateMosaic(5, 4, 16, 2);
+			CTestCziData::AddMetadataAndAttachmentDirectory(cziData, "<ImageDocument />", 3);
+			std::shared_ptr<const void> spBuffer(&cziData[0], [](const void*)->void {});
+			auto cziFilename = CTestCziData::WriteToTemporaryFile(cziData);
+			auto sidecarFilename = cziFilename + L".idx";
+
+			auto getState = [](ICZIReader* reader)->std::string
+			{
+				std::stringstream ss;
+				reader->EnumerateSubBlocks([&](int index, const SubBlockInfo& info)->bool
+				{
+					ss << index << ':' << Utils::DimCoordinateToString(&info.coordinate) << ' ' << info.mIndex << ' ' << info.logicalRect.x << ',' << info.logicalRect.y << ';';
+					return true;
+				});
+
+				auto statistics = reader->GetStatistics();
+				ss << statistics.subBlockCount << ' ' << statistics.minMindex << ' ' << statistics.maxMindex << ' ' << statistics.boundingBox.w << 'x' << statistics.boundingBox.h << ';';
+				reader->EnumerateAttachments([&](int index, const AttachmentInfo& info)->bool {ss << index << ':' << info.name << ';'; return true; });
+				SubBlockInfo info;
+				ss << reader->TryGetSubBlockInfoOfArbitrarySubBlockInChannel(1, info) << ' ' << info.mIndex << ';';
+				const IntRect roi{ 5, 7, 30, 20 };
+				auto planeCoordinate = CDimCoordinate::Parse("C1");
+				reader->EnumSubset(&planeCoordinate, &roi, true, [&](int index, const SubBlockInfo& info)->bool {ss << index << ','; return true; });
+				return ss.str();
+			};
+
+			auto open = [&](CFileInfoStream* stream, bool compact)->std::shared_ptr<ICZIReader>
+			{
+				auto spReader = libCZI::CreateCZIReader();
+				ICZIReader::OpenOptions options;
+				options.Clear();
+				options.useCompactSubBlockDirectory = compact;
+				options.sidecarIndexFilename = sidecarFilename;
+				spReader->Open(std::shared_ptr<IStream>(stream, [](IStream*)->void {}), &options);
+				return spReader;
+			};
+
+			auto spReference = libCZI::CreateCZIReader();
+			spReference->Open(CreateStreamFromMemory(spBuffer, cziData.size()));
+			const std::string expected = getState(spReference.get());
+
+			// the first time, the sidecar-index is created
+			CFileInfoStream stream(CreateStreamFromMemory(spBuffer, cziData.size()), cziData.size());
+			Assert::IsTrue(getState(open(&stream, false).get()) == expected, L"Incorrect result", LINE_INFO());
+			const int readCountWithoutSidecarIndex = stream.readCount;
+
+			// now, only the file-header is read from the document
+			stream.readCount = 0;
+			Assert::IsTrue(getState(open(&stream, false).get()) == expected, L"Incorrect result", LINE_INFO());
+			Assert::IsTrue(stream.readCount == 1 && readCountWithoutSidecarIndex > 1, L"The sidecar-index was not used", LINE_INFO());
+			stream.readCount = 0;
+			Assert::IsTrue(getState(open(&stream, true).get()) == expected, L"Incorrect result", LINE_INFO());
+			Assert::IsTrue(stream.readCount == 1, L"The sidecar-index was not used", LINE_INFO());
+
+			// if the document has been modified, the sidecar-index is not used (and re-created)
+			stream.modificationTime = 2;
+			stream.readCount = 0;
+			Assert::IsTrue(getState(open(&stream, false).get()) == expected, L"Incorrect result", LINE_INFO());
+			Assert::IsTrue(stream.readCount == readCountWithoutSidecarIndex, L"The stale sidecar-index was used", LINE_INFO());
+			stream.readCount = 0;
+			open(&stream, false);
+			Assert::IsTrue(stream.readCount == 1, L"The sidecar-index was not re-created", LINE_INFO());
+
+			// a corrupted sidecar-index is detected
+#if defined(_WIN32)
+			FILE* fp;
+			_wfopen_s(&fp, sidecarFilename.c_str(), L"r+b");
+#else
+			FILE* fp = fopen(std::string(sidecarFilename.begin(), sidecarFilename.end()).c_str(), "r+b");
+#endif
+			Assert::IsTrue(fp != nullptr, L"The sidecar-index was not found", LINE_INFO());
+			fseek(fp, -10, SEEK_END);
+			int c = fgetc(fp);
+			fseek(fp, -10, SEEK_END);
+			fputc(c ^ 0x5a, fp);
+			fclose(fp);
+			stream.readCount = 0;
+			Assert::IsTrue(getState(open(&stream, false).get()) == expected, L"Incorrect result", LINE_INFO());
+			Assert::IsTrue(stream.readCount == readCountWithoutSidecarIndex, L"The corrupted sidecar-index was used", LINE_INFO());
+
+			// the sidecar-index is (re-)written concurrently by several threads of this process - afterwards, it is intact
+			const int ThreadCount = 8;
+			const std::int64_t modificationTime = 3;
+			std::vector<std::unique_ptr<CFileInfoStream>> streams;
+			std::vector<std::thread> threads;
+			std::atomic<bool> resultsCorrect(true);
+			for (int t = 0; t < ThreadCount; ++t)
+			{
+				streams.emplace_back(new CFileInfoStream(CreateStreamFromMemory(spBuffer, cziData.size()), cziData.size()));
+				streams.back()->modificationTime = modificationTime;
+				CFileInfoStream* threadStream = streams.back().get();
+				threads.emplace_back([&, threadStream]()->void
+				{
+					for (int i = 0; i < 5; ++i)
+					{
+						if (getState(open(threadStream, false).get()) != expected)
+						{
+							resultsCorrect = false;
+						}
+					}
+				});
+			}
+
+			for (auto& t : threads)
+			{
+				t.join();
+			}
+
+			Assert::IsTrue(resultsCorrect.load(), L"Incorrect result", LINE_INFO());
+			stream.modificationTime = modificationTime;
+			stream.readCount = 0;
+			Assert::IsTrue(getState(open(&stream, false).get()) == expected, L"Incorrect result", LINE_INFO());
+			Assert::IsTrue(stream.readCount == 1, L"The sidecar-index is not intact", LINE_INFO());
+
+#if defined(_WIN32)
+			_wremove(sidecarFilename.c_str());
+			_wremove(cziFilename.c_str());
+#else
+			remove(std::string(sidecarFilename.begin(), sidecarFilename.end()).c_str());
+			remove(std::string(cziFilename.begin(), cziFilename.end()).c_str());
+#endif
+		}
 	};
 }
\ No newline at end of file
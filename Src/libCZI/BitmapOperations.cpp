@@ -22,7 +22,9 @@
 
 #include "stdafx.h"
 #include "BitmapOperations.h"
+#include "NNResizePlanCache.h"
 #include "MD5Sum.h"
+#include "ThreadPool.h"
 #include "utilities.h"
 #include "libCZI.h"
 
@@ -52,8 +54,122 @@ using namespace std;
 	return 16;
 }
 
+/*static*/int CBitmapOperations::CalcMd5TreeSum(libCZI::IBitmapData* bm, std::uint8_t* ptrHash, int hashSize)
+{
+	if (ptrHash == nullptr) { return 16; }
+	if (hashSize < 16)
+	{
+		throw invalid_argument("argument 'hashsize' must be >= 16");
+	}
+
+	ScopedBitmapLockerP lck{ bm };
+
+	const size_t lineLength = bm->GetWidth() * CziUtils::GetBytesPerPel(bm->GetPixelType());
+	const int height = bm->GetHeight();
+	const int leafCount = (height + Md5TreeSumRowsPerLeaf - 1) / Md5TreeSumRowsPerLeaf;
+	std::vector<char> leafHashes((size_t)leafCount * 16);
+	ForEachRowBand(0, leafCount, lineLength * Md5TreeSumRowsPerLeaf,
+		[&](int leafStart, int leafEnd)->void
+	{
+		for (int leaf = leafStart; leaf < leafEnd; ++leaf)
+		{
+			CMd5Sum md5sum;
+			const int yEnd = (std::min)((leaf + 1) * Md5TreeSumRowsPerLeaf, height);
+			for (int y = leaf * Md5TreeSumRowsPerLeaf; y < yEnd; ++y)
+			{
+				const std::uint8_t* ptr = ((const std::uint8_t*)lck.ptrDataRoi) + y*((ptrdiff_t)lck.stride);
+				md5sum.update(ptr, lineLength);
+			}
+
+			md5sum.complete();
+			md5sum.getHash(leafHashes.data() + (size_t)leaf * 16);
+		}
+	});
+
+	CMd5Sum md5sum;
+	md5sum.update(leafHashes.data(), leafHashes.size());
+	md5sum.complete();
+	md5sum.getHash((char*)ptrHash);
+	return 16;
+}
+
+namespace
+{
+	std::mutex threadPoolMutex;
+	std::shared_ptr<CThreadPool> threadPool;
+}
+
+/*static*/void CBitmapOperations::SetThreadPool(std::shared_ptr<CThreadPool> threadPool)
+{
+	std::lock_guard<std::mutex> lck(threadPoolMutex);
+	::threadPool = std::move(threadPool);
+}
+
+/*static*/std::shared_ptr<CThreadPool> CBitmapOperations::GetThreadPool()
+{
+	std::lock_guard<std::mutex> lck(threadPoolMutex);
+	return ::threadPool;
+}
+
+/*static*/void CBitmapOperations::ForEachRowBand(int yStart, int yEnd, size_t bytesPerRow, const std::function<void(int yStart, int yEnd)>& func)
+{
+	// a band should be large enough so that the overhead of distributing it is negligible, and there should be some more
+	// bands than threads so that the load is balanced
+	const size_t MinBytesPerBand = 256 * 1024;
+	const int BandsPerThread = 4;
+
+	const int rowCount = yEnd - yStart;
+	if (rowCount <= 0)
+	{
+		return;
+	}
+
+	const std::shared_ptr<CThreadPool> pool = GetThreadPool();
+	int bandCount = 1;
+	if (pool && pool->GetThreadCount() > 1)
+	{
+		const size_t maxBandCount = (std::min)(rowCount * bytesPerRow / MinBytesPerBand, (size_t)rowCount);
+		bandCount = (int)(std::min)(maxBandCount, (size_t)pool->GetThreadCount() * BandsPerThread);
+	}
+
+	if (bandCount <= 1)
+	{
+		func(yStart, yEnd);
+		return;
+	}
+
+	pool->ParallelFor(bandCount,
+		[&](int band)->void
+	{
+		const int bandStart = yStart + (int)((std::int64_t)rowCount * band / bandCount);
+		const int bandEnd = yStart + (int)((std::int64_t)rowCount * (band + 1) / bandCount);
+		func(bandStart, bandEnd);
+	});
+}
+
 /*static*/void CBitmapOperations::Copy(libCZI::PixelType srcPixelType, const void* srcPtr, int srcStride, libCZI::PixelType dstPixelType, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
 {
+	if (srcPixelType != dstPixelType)
+	{
+		static const SimdLevel simdLevel = GetSupportedSimdLevel();
+		if (simdLevel != SimdLevel::None)
+		{
+			const ConvertLineFunction convertLine = GetConvertLineFunction(srcPixelType, dstPixelType, simdLevel);
+			if (convertLine != nullptr)
+			{
+				for (int y = 0; y < height; ++y)
+				{
+					convertLine(
+						((const char*)srcPtr) + y*((std::ptrdiff_t)srcStride),
+						((char*)dstPtr) + y*((std::ptrdiff_t)dstStride),
+						width);
+				}
+
+				return;
+			}
+		}
+	}
+
 	switch (srcPixelType)
 	{
 	case PixelType::Gray8:
@@ -74,6 +190,12 @@ using namespace std;
 		case PixelType::Bgr48:
 			Copy<PixelType::Gray8, PixelType::Bgr48>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
 			return;
+		case PixelType::Bgra32:
+			Copy<PixelType::Gray8, PixelType::Bgra32>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr96Float:
+			Copy<PixelType::Gray8, PixelType::Bgr96Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
 		default:break;
 		}
 		break;
@@ -81,13 +203,27 @@ using namespace std;
 	case PixelType::Gray16:
 		switch (dstPixelType)
 		{
-		case PixelType::Gray8:break;
+		case PixelType::Gray8:
+			Copy<PixelType::Gray16, PixelType::Gray8>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
 		case PixelType::Gray16:
 			Copy<PixelType::Gray16, PixelType::Gray16>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
 			return;
-		case PixelType::Gray32Float:break;
-		case PixelType::Bgr24:break;
-		case PixelType::Bgr48:break;
+		case PixelType::Gray32Float:
+			Copy<PixelType::Gray16, PixelType::Gray32Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr24:
+			Copy<PixelType::Gray16, PixelType::Bgr24>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr48:
+			Copy<PixelType::Gray16, PixelType::Bgr48>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgra32:
+			Copy<PixelType::Gray16, PixelType::Bgra32>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr96Float:
+			Copy<PixelType::Gray16, PixelType::Bgr96Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
 		default:break;
 		}
 		break;
@@ -95,13 +231,27 @@ using namespace std;
 	case PixelType::Gray32Float:
 		switch (dstPixelType)
 		{
-		case PixelType::Gray8:break;
-		case PixelType::Gray16:break;
+		case PixelType::Gray8:
+			Copy<PixelType::Gray32Float, PixelType::Gray8>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Gray16:
+			Copy<PixelType::Gray32Float, PixelType::Gray16>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
 		case PixelType::Gray32Float:
 			Copy<PixelType::Gray32Float, PixelType::Gray32Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
 			return;
-		case PixelType::Bgr24:break;
-		case PixelType::Bgr48:break;
+		case PixelType::Bgr24:
+			Copy<PixelType::Gray32Float, PixelType::Bgr24>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr48:
+			Copy<PixelType::Gray32Float, PixelType::Bgr48>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgra32:
+			Copy<PixelType::Gray32Float, PixelType::Bgra32>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr96Float:
+			Copy<PixelType::Gray32Float, PixelType::Bgr96Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
 		default:break;
 		}
 		break;
@@ -124,6 +274,12 @@ using namespace std;
 		case PixelType::Bgr48:
 			Copy<PixelType::Bgr24, PixelType::Bgr48>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
 			return;
+		case PixelType::Bgra32:
+			Copy<PixelType::Bgr24, PixelType::Bgra32>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr96Float:
+			Copy<PixelType::Bgr24, PixelType::Bgr96Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
 		default:break;
 		}
 		break;
@@ -131,13 +287,83 @@ using namespace std;
 	case PixelType::Bgr48:
 		switch (dstPixelType)
 		{
-		case PixelType::Gray8:break;
-		case PixelType::Gray16:break;
-		case PixelType::Gray32Float:break;
-		case PixelType::Bgr24:break;
+		case PixelType::Gray8:
+			Copy<PixelType::Bgr48, PixelType::Gray8>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Gray16:
+			Copy<PixelType::Bgr48, PixelType::Gray16>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Gray32Float:
+			Copy<PixelType::Bgr48, PixelType::Gray32Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr24:
+			Copy<PixelType::Bgr48, PixelType::Bgr24>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
 		case PixelType::Bgr48:
 			Copy<PixelType::Bgr48, PixelType::Bgr48>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
 			return;
+		case PixelType::Bgra32:
+			Copy<PixelType::Bgr48, PixelType::Bgra32>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr96Float:
+			Copy<PixelType::Bgr48, PixelType::Bgr96Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		default:break;
+		}
+		break;
+
+	case PixelType::Bgra32:
+		switch (dstPixelType)
+		{
+		case PixelType::Gray8:
+			Copy<PixelType::Bgra32, PixelType::Gray8>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Gray16:
+			Copy<PixelType::Bgra32, PixelType::Gray16>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Gray32Float:
+			Copy<PixelType::Bgra32, PixelType::Gray32Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr24:
+			Copy<PixelType::Bgra32, PixelType::Bgr24>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr48:
+			Copy<PixelType::Bgra32, PixelType::Bgr48>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgra32:
+			Copy<PixelType::Bgra32, PixelType::Bgra32>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr96Float:
+			Copy<PixelType::Bgra32, PixelType::Bgr96Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		default:break;
+		}
+		break;
+
+	case PixelType::Bgr96Float:
+		switch (dstPixelType)
+		{
+		case PixelType::Gray8:
+			Copy<PixelType::Bgr96Float, PixelType::Gray8>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Gray16:
+			Copy<PixelType::Bgr96Float, PixelType::Gray16>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Gray32Float:
+			Copy<PixelType::Bgr96Float, PixelType::Gray32Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr24:
+			Copy<PixelType::Bgr96Float, PixelType::Bgr24>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr48:
+			Copy<PixelType::Bgr96Float, PixelType::Bgr48>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgra32:
+			Copy<PixelType::Bgr96Float, PixelType::Bgra32>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
+		case PixelType::Bgr96Float:
+			Copy<PixelType::Bgr96Float, PixelType::Bgr96Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+			return;
 		default:break;
 		}
 		break;
@@ -145,7 +371,7 @@ using namespace std;
 	default:break;
 	}
 
-	throw std::logic_error("It seems that this conversion is not implemented...");
+	ThrowUnsupportedConversion(srcPixelType, dstPixelType);
 }
 
 /*static*/void CBitmapOperations::CopyOffseted(const CopyOffsetedInfo& info)
@@ -162,36 +388,254 @@ using namespace std;
 	void*  ptrDestination = ((char*)info.dstPtr) + intersection.y * ((ptrdiff_t)info.dstStride) + intersection.x * CziUtils::GetBytesPerPel(info.dstPixelType);
 	const void* ptrSource = ((const char*)info.srcPtr) + (std::max)(-info.yOffset, 0) * ((ptrdiff_t)info.srcStride) + (std::max)(-info.xOffset, 0) * CziUtils::GetBytesPerPel(info.srcPixelType);
 
-	Copy(
-		info.srcPixelType, ptrSource, info.srcStride,
-		info.dstPixelType, ptrDestination, info.dstStride,
-		intersection.w, intersection.h,
-		info.drawTileBorder);
+	if (info.drawTileBorder)
+	{
+		// the border is drawn at the first and the last row of the copied rectangle, so it cannot be split into bands
+		Copy(
+			info.srcPixelType, ptrSource, info.srcStride,
+			info.dstPixelType, ptrDestination, info.dstStride,
+			intersection.w, intersection.h,
+			true);
+		return;
+	}
+
+	ForEachRowBand(0, intersection.h, (size_t)intersection.w * CziUtils::GetBytesPerPel(info.dstPixelType),
+		[&](int yStart, int yEnd)->void
+	{
+		Copy(
+			info.srcPixelType, ((const char*)ptrSource) + yStart * ((ptrdiff_t)info.srcStride), info.srcStride,
+			info.dstPixelType, ((char*)ptrDestination) + yStart * ((ptrdiff_t)info.dstStride), info.dstStride,
+			intersection.w, yEnd - yStart,
+			false);
+	});
 }
 
 /*static*/void CBitmapOperations::NNResize(libCZI::IBitmapData* bmSrc, libCZI::IBitmapData* bmDest, const DblRect& roiSrc, const DblRect& roiDst)
+{
+	NNResize(bmSrc, 0, 0, bmDest, roiSrc, roiDst);
+}
+
+/*static*/void CBitmapOperations::NNResize(libCZI::IBitmapData* bmSrc, int srcOffsetX, int srcOffsetY, libCZI::IBitmapData* bmDest, const DblRect& roiSrc, const DblRect& roiDst)
+{
+	NNResize(bmSrc, srcOffsetX, srcOffsetY, bmDest, roiSrc, roiDst, nullptr);
+}
+
+namespace
+{
+	CBitmapOperations::NNResizeInfo2Dbl CreateResizeInfo(libCZI::IBitmapData* bmSrc, const BitmapLockInfo& lckSrc, int srcOffsetX, int srcOffsetY, libCZI::IBitmapData* bmDest, const BitmapLockInfo& lckDst, const DblRect& roiSrc, const DblRect& roiDst)
+	{
+		CBitmapOperations::NNResizeInfo2Dbl resizeInfo;
+		resizeInfo.srcPtr = lckSrc.ptrDataRoi;
+		resizeInfo.srcStride = lckSrc.stride;
+		resizeInfo.srcRoiX = roiSrc.x;
+		resizeInfo.srcRoiY = roiSrc.y;
+		resizeInfo.srcRoiW = roiSrc.w;
+		resizeInfo.srcRoiH = roiSrc.h;
+		resizeInfo.srcWidth = bmSrc->GetWidth();
+		resizeInfo.srcHeight = bmSrc->GetHeight();
+		resizeInfo.srcOffsetX = srcOffsetX;
+		resizeInfo.srcOffsetY = srcOffsetY;
+		resizeInfo.dstPtr = lckDst.ptrDataRoi;
+		resizeInfo.dstStride = lckDst.stride;
+		resizeInfo.dstRoiX = roiDst.x;
+		resizeInfo.dstRoiY = roiDst.y;
+		resizeInfo.dstRoiW = roiDst.w;
+		resizeInfo.dstRoiH = roiDst.h;
+		resizeInfo.dstWidth = bmDest->GetWidth();
+		resizeInfo.dstHeight = bmDest->GetHeight();
+		return resizeInfo;
+	}
+
+	/// Calculates the averages of a line of an area-averaging resize from the (weighted) sum of the covered lines of the
+	/// source, where "accumulated" starts with the column "srcXFirst" of the source.
+	template <int tChannelCount>
+	void SumUpColumns(const float* accumulated, int srcXFirst, const CBitmapOperations::BoxResizeTaps& taps, float areaY, float* averages, int count)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			const float* pAccumulated = accumulated + (taps.srcStart[i] - srcXFirst) * tChannelCount;
+			const float* pWeights = &taps.weights[taps.tapsStart[i]];
+			const int tapCount = taps.tapsStart[i + 1] - taps.tapsStart[i];
+			float sum[tChannelCount] = {};
+			for (int t = 0; t < tapCount; ++t)
+			{
+				for (int c = 0; c < tChannelCount; ++c)
+				{
+					sum[c] += pWeights[t] * pAccumulated[t * tChannelCount + c];
+				}
+			}
+
+			const float area = taps.area[i] * areaY;
+			for (int c = 0; c < tChannelCount; ++c)
+			{
+				averages[i * tChannelCount + c] = sum[c] / area;
+			}
+		}
+	}
+
+	/// Gets the number of channels of the specified pixel type, or zero if it is not supported by the area-averaging resize.
+	int GetChannelCount(libCZI::PixelType pixelType)
+	{
+		switch (pixelType)
+		{
+		case PixelType::Gray8:
+		case PixelType::Gray16:
+		case PixelType::Gray32Float:
+			return 1;
+		case PixelType::Bgr24:
+		case PixelType::Bgr48:
+		case PixelType::Bgr96Float:
+			return 3;
+		case PixelType::Bgra32:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+}
+
+/*static*/void CBitmapOperations::NNResize(libCZI::IBitmapData* bmSrc, int srcOffsetX, int srcOffsetY, libCZI::IBitmapData* bmDest, const DblRect& roiSrc, const DblRect& roiDst, CNNResizePlanCache* planCache)
 {
 	ScopedBitmapLockerP lckSrc{ bmSrc };
 	ScopedBitmapLockerP lckDst{ bmDest };
 
-	NNResizeInfo2Dbl resizeInfo;
-	resizeInfo.srcPtr = lckSrc.ptrDataRoi;
-	resizeInfo.srcStride = lckSrc.stride;
-	resizeInfo.srcRoiX = roiSrc.x;
-	resizeInfo.srcRoiY = roiSrc.y;
-	resizeInfo.srcRoiW = roiSrc.w;
-	resizeInfo.srcRoiH = roiSrc.h;
-	resizeInfo.srcWidth = bmSrc->GetWidth();
-	resizeInfo.srcHeight = bmSrc->GetHeight();
-	resizeInfo.dstPtr = lckDst.ptrDataRoi;
-	resizeInfo.dstStride = lckDst.stride;
-	resizeInfo.dstRoiX = roiDst.x;
-	resizeInfo.dstRoiY = roiDst.y;
-	resizeInfo.dstRoiW = roiDst.w;
-	resizeInfo.dstRoiH = roiDst.h;
-	resizeInfo.dstWidth = bmDest->GetWidth();
-	resizeInfo.dstHeight = bmDest->GetHeight();
-	NNSCale2(bmSrc->GetPixelType(), bmDest->GetPixelType(), resizeInfo);
+	const NNResizeInfo2Dbl resizeInfo = CreateResizeInfo(bmSrc, lckSrc, srcOffsetX, srcOffsetY, bmDest, lckDst, roiSrc, roiDst);
+	if (planCache != nullptr)
+	{
+		NNSCale2(bmSrc->GetPixelType(), bmDest->GetPixelType(), resizeInfo, *planCache->GetOrCreate(resizeInfo));
+	}
+	else
+	{
+		NNSCale2(bmSrc->GetPixelType(), bmDest->GetPixelType(), resizeInfo);
+	}
+}
+
+/*static*/void CBitmapOperations::BoxResize(libCZI::IBitmapData* bmSrc, int srcOffsetX, int srcOffsetY, libCZI::IBitmapData* bmDest, const DblRect& roiSrc, const DblRect& roiDst)
+{
+	ScopedBitmapLockerP lckSrc{ bmSrc };
+	ScopedBitmapLockerP lckDst{ bmDest };
+
+	const NNResizeInfo2Dbl resizeInfo = CreateResizeInfo(bmSrc, lckSrc, srcOffsetX, srcOffsetY, bmDest, lckDst, roiSrc, roiDst);
+	BoxResizePlan plan;
+	CreateBoxResizePlan(resizeInfo, plan);
+	BoxScale2(bmSrc->GetPixelType(), bmDest->GetPixelType(), resizeInfo, plan);
+}
+
+/*static*/void CBitmapOperations::BoxScale2(libCZI::PixelType srcPixelType, libCZI::PixelType dstPixelType, const NNResizeInfo2Dbl& resizeInfo, const BoxResizePlan& plan)
+{
+	const int channelCount = GetChannelCount(srcPixelType);
+	const SimdLevel simdLevel = GetSupportedSimdLevel();
+	const AccumulateLineFunction accumulateLine = GetAccumulateLineFunction(srcPixelType, simdLevel);
+	if (channelCount == 0 || accumulateLine == nullptr)
+	{
+		ThrowUnsupportedConversion(srcPixelType, dstPixelType);
+	}
+
+	if (plan.IsEmpty())
+	{
+		return;
+	}
+
+	const int bytesPerPelSrc = CziUtils::GetBytesPerPel(srcPixelType);
+	const int bytesPerPelDest = CziUtils::GetBytesPerPel(dstPixelType);
+	const int count = plan.dstXEnd - plan.dstXStart + 1;
+
+	// the averages are calculated as floats, and then rounded to the type of the channels of the source pixel type
+	// (with the same rounding as the conversion from a float pixel type) - floats are taken as they are
+	ConvertLineFunction storeLine = nullptr;
+	switch (bytesPerPelSrc / channelCount)
+	{
+	case 1:
+		storeLine = GetConvertLineFunction(PixelType::Gray32Float, PixelType::Gray8, simdLevel);
+		break;
+	case 2:
+		storeLine = GetConvertLineFunction(PixelType::Gray32Float, PixelType::Gray16, simdLevel);
+		break;
+	default:
+		break;
+	}
+
+	// the columns of the source which are covered by the drawn destination pixels
+	int srcXFirst = (std::numeric_limits<int>::max)(), srcXEnd = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		srcXFirst = (std::min)(srcXFirst, plan.x.srcStart[i]);
+		srcXEnd = (std::max)(srcXEnd, plan.x.srcStart[i] + plan.x.tapsStart[i + 1] - plan.x.tapsStart[i]);
+	}
+
+	const int accumulatedCount = (srcXEnd - srcXFirst) * channelCount;
+
+	auto isSameRow = [&](int i1, int i2)->bool
+	{
+		const int tapCount = plan.y.tapsStart[i1 + 1] - plan.y.tapsStart[i1];
+		return plan.y.srcStart[i1] == plan.y.srcStart[i2] &&
+			tapCount == plan.y.tapsStart[i2 + 1] - plan.y.tapsStart[i2] &&
+			std::equal(plan.y.weights.cbegin() + plan.y.tapsStart[i1], plan.y.weights.cbegin() + plan.y.tapsStart[i1] + tapCount, plan.y.weights.cbegin() + plan.y.tapsStart[i2]);
+	};
+
+	// the bands of rows are calculated independently, each with its own buffers
+	ForEachRowBand(plan.dstYStart, plan.dstYEnd + 1, (size_t)count * bytesPerPelDest,
+		[&](int yStart, int yEnd)->void
+	{
+		std::vector<float> accumulated(accumulatedCount);
+		std::vector<float> averages((size_t)count * channelCount);
+		std::vector<std::uint8_t> line(srcPixelType != dstPixelType ? (size_t)count * bytesPerPelSrc : 0);
+
+		const char* pPrevDstLine = nullptr;
+		for (int y = yStart; y < yEnd; ++y)
+		{
+			const int iy = y - plan.dstYStart;
+			char* pDstLine = ((char*)resizeInfo.dstPtr) + y * ((std::ptrdiff_t)resizeInfo.dstStride) + plan.dstXStart * bytesPerPelDest;
+
+			// when enlarging, consecutive destination lines are calculated from the same source line
+			if (pPrevDstLine != nullptr && isSameRow(iy - 1, iy))
+			{
+				memcpy(pDstLine, pPrevDstLine, (size_t)count * bytesPerPelDest);
+				continue;
+			}
+
+			// first, the covered source lines are summed up (with their weights)...
+			std::fill(accumulated.begin(), accumulated.end(), 0.f);
+			for (int t = plan.y.tapsStart[iy]; t < plan.y.tapsStart[iy + 1]; ++t)
+			{
+				const int srcY = plan.y.srcStart[iy] + t - plan.y.tapsStart[iy];
+				const char* pSrcLine = ((const char*)resizeInfo.srcPtr) + srcY * ((std::ptrdiff_t)resizeInfo.srcStride) + srcXFirst * bytesPerPelSrc;
+				accumulateLine(pSrcLine, plan.y.weights[t], accumulated.data(), accumulatedCount);
+			}
+
+			// ...then the covered columns of this sum, and the result is divided by the covered area (with an integer ratio,
+			// all weights are one, so the division gives the exact average)
+			switch (channelCount)
+			{
+			case 1:
+				SumUpColumns<1>(accumulated.data(), srcXFirst, plan.x, plan.y.area[iy], averages.data(), count);
+				break;
+			case 3:
+				SumUpColumns<3>(accumulated.data(), srcXFirst, plan.x, plan.y.area[iy], averages.data(), count);
+				break;
+			default:
+				SumUpColumns<4>(accumulated.data(), srcXFirst, plan.x, plan.y.area[iy], averages.data(), count);
+				break;
+			}
+
+			void* pLine = srcPixelType == dstPixelType ? (void*)pDstLine : (void*)line.data();
+			if (storeLine != nullptr)
+			{
+				storeLine(averages.data(), pLine, count * channelCount);
+			}
+			else
+			{
+				memcpy(pLine, averages.data(), averages.size() * sizeof(float));
+			}
+
+			if (srcPixelType != dstPixelType)
+			{
+				Copy(srcPixelType, line.data(), count * bytesPerPelSrc, dstPixelType, pDstLine, count * bytesPerPelDest, count, 1, false);
+			}
+
+			pPrevDstLine = pDstLine;
+		}
+	});
 }
 
 /*static*/void CBitmapOperations::NNResize(libCZI::IBitmapData* bmSrc, libCZI::IBitmapData* bmDst)
@@ -213,6 +657,7 @@ using namespace std;
 	resizeInfo.srcRoiH = bmSrc->GetHeight();
 	resizeInfo.srcWidth = bmSrc->GetWidth();
 	resizeInfo.srcHeight = bmSrc->GetHeight();
+	resizeInfo.srcOffsetX = resizeInfo.srcOffsetY = 0;
 	resizeInfo.dstPtr = lckDst.ptrDataRoi;
 	resizeInfo.dstStride = lckDst.stride;
 	resizeInfo.dstRoiX = 0;
@@ -228,27 +673,48 @@ using namespace std;
 /*static*/void CBitmapOperations::Fill(libCZI::IBitmapData* bm, const libCZI::RgbFloatColor& floatColor)
 {
 	ScopedBitmapLockerP lck{ bm };
+	const int width = bm->GetWidth();
 
+	// the rows from "yStart" to "yEnd" (exclusive) are filled with the function for the pixel type
+	std::function<void(int yStart, int yEnd)> fillRows;
+	auto ptrRow = [&](int y)->void* { return ((char*)lck.ptrDataRoi) + y * ((ptrdiff_t)lck.stride); };
 	switch (bm->GetPixelType())
 	{
 	case PixelType::Gray8:
-		Fill_Gray8(bm->GetWidth(), bm->GetHeight(), lck.ptrDataRoi, lck.stride, Utilities::clampToByte((255 * (floatColor.r + floatColor.g + floatColor.b)) / 3));
+		{
+			const std::uint8_t v = Utilities::clampToByte((255 * (floatColor.r + floatColor.g + floatColor.b)) / 3);
+			fillRows = [&, v](int yStart, int yEnd)->void {Fill_Gray8(width, yEnd - yStart, ptrRow(yStart), lck.stride, v); };
+		}
 		break;
 	case PixelType::Gray16:
-		Fill_Gray16(bm->GetWidth(), bm->GetHeight(), lck.ptrDataRoi, lck.stride, Utilities::clampToUShort((65535 * (floatColor.r + floatColor.g + floatColor.b)) / 3));
+		{
+			const std::uint16_t v = Utilities::clampToUShort((65535 * (floatColor.r + floatColor.g + floatColor.b)) / 3);
+			fillRows = [&, v](int yStart, int yEnd)->void {Fill_Gray16(width, yEnd - yStart, ptrRow(yStart), lck.stride, v); };
+		}
 		break;
 	case PixelType::Gray32Float:
-		Fill_GrayFloat(bm->GetWidth(), bm->GetHeight(), lck.ptrDataRoi, lck.stride, (floatColor.r + floatColor.g + floatColor.b) / 3);
+		{
+			const float v = (floatColor.r + floatColor.g + floatColor.b) / 3;
+			fillRows = [&, v](int yStart, int yEnd)->void {Fill_GrayFloat(width, yEnd - yStart, ptrRow(yStart), lck.stride, v); };
+		}
 		break;
 	case PixelType::Bgr24:
-		Fill_Bgr24(bm->GetWidth(), bm->GetHeight(), lck.ptrDataRoi, lck.stride, Utilities::clampToByte(255 * floatColor.b), Utilities::clampToByte(255 * floatColor.g), Utilities::clampToByte(255 * floatColor.r));
+		{
+			const std::uint8_t b = Utilities::clampToByte(255 * floatColor.b), g = Utilities::clampToByte(255 * floatColor.g), r = Utilities::clampToByte(255 * floatColor.r);
+			fillRows = [&, b, g, r](int yStart, int yEnd)->void {Fill_Bgr24(width, yEnd - yStart, ptrRow(yStart), lck.stride, b, g, r); };
+		}
 		break;
 	case PixelType::Bgr48:
-		Fill_Bgr48(bm->GetWidth(), bm->GetHeight(), lck.ptrDataRoi, lck.stride, Utilities::clampToUShort(65535 * floatColor.b), Utilities::clampToUShort(65535 * floatColor.g), Utilities::clampToUShort(65535 * floatColor.r));
+		{
+			const std::uint16_t b = Utilities::clampToUShort(65535 * floatColor.b), g = Utilities::clampToUShort(65535 * floatColor.g), r = Utilities::clampToUShort(65535 * floatColor.r);
+			fillRows = [&, b, g, r](int yStart, int yEnd)->void {Fill_Bgr48(width, yEnd - yStart, ptrRow(yStart), lck.stride, b, g, r); };
+		}
 		break;
 	default:
 		throw runtime_error("Sorry, this pixeltype isn't implemented yet.");
 	}
+
+	ForEachRowBand(0, bm->GetHeight(), (size_t)width * CziUtils::GetBytesPerPel(bm->GetPixelType()), fillRows);
 }
 
 /*static*/void CBitmapOperations::Fill_Gray8(int w, int h, void* ptr, int stride, std::uint8_t val)
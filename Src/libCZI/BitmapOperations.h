@@ -23,23 +23,69 @@
 #pragma once
 
 #include <algorithm>
+#include <vector>
+#include <memory>
+#include <functional>
 #include "libCZI_Pixels.h"
+#include "utilities.h"
+
+class CNNResizePlanCache;
+class CThreadPool;
 
 class CBitmapOperations
 {
 public:
 	static int CalcMd5Sum(libCZI::IBitmapData* bm, std::uint8_t* ptrHash, int hashSize);
 
+	/// The number of rows which are hashed into one leaf of the tree-hash (see CalcMd5TreeSum).
+	static const int Md5TreeSumRowsPerLeaf = 64;
+
+	/// Calculates a tree-hash of the pixels of the bitmap, which (other than the streaming hash calculated by CalcMd5Sum)
+	/// can be calculated in parallel. The bitmap is divided into bands of Md5TreeSumRowsPerLeaf rows (the last band may
+	/// be smaller), and for every band the MD5-hash of its rows (without the padding at the end of a row) is calculated.
+	/// The result is the MD5-hash of the concatenation of the (16 bytes) hashes of the bands, in the order of the bands.
+	/// So, the result does not depend on the number of threads used.
+	///
+	/// \param bm		The bitmap.
+	/// \param ptrHash  Pointer to the hash-code result. May be null.
+	/// \param hashSize Size of the hash-code result (should be at least 16).
+	///
+	/// \return The number of bytes of the hash-code (which is 16).
+	static int CalcMd5TreeSum(libCZI::IBitmapData* bm, std::uint8_t* ptrHash, int hashSize);
+
+	/// Sets the thread pool which is used by the operations on large bitmaps (Fill, NNResize, BoxResize, CopyOffseted
+	/// and CalcMd5TreeSum) - they then process bands of rows in parallel. The result does not depend on the number of
+	/// threads.
+	///
+	/// \param threadPool The thread pool. If null (which is the default), the operations are executed on the calling thread.
+	static void SetThreadPool(std::shared_ptr<CThreadPool> threadPool);
+
+	/// Gets the thread pool which is used by the operations on large bitmaps.
+	///
+	/// \return The thread pool, or null if the operations are executed on the calling thread.
+	static std::shared_ptr<CThreadPool> GetThreadPool();
+
 	static void NNResize(libCZI::IBitmapData* bmSrc, libCZI::IBitmapData* bmDest);
 
 	static void NNResize(libCZI::IBitmapData* bmSrc, libCZI::IBitmapData* bmDest,const libCZI::DblRect& roiSrc,const libCZI::DblRect& roiDst);
 
+	/// Nearest-neighbor resize where the source bitmap only contains a part of the source image - the pixel (0,0) of
+	/// the source bitmap is at the position (srcOffsetX, srcOffsetY) in the coordinate system of "roiSrc".
+	static void NNResize(libCZI::IBitmapData* bmSrc, int srcOffsetX, int srcOffsetY, libCZI::IBitmapData* bmDest, const libCZI::DblRect& roiSrc, const libCZI::DblRect& roiDst);
+
+	/// Nearest-neighbor resize as above, where the plan (i. e. which source pixel goes to which destination pixel) is
+	/// taken from the specified cache if it contains a plan for this geometry.
+	///
+	/// \param planCache The cache for the plans (may be null).
+	static void NNResize(libCZI::IBitmapData* bmSrc, int srcOffsetX, int srcOffsetY, libCZI::IBitmapData* bmDest, const libCZI::DblRect& roiSrc, const libCZI::DblRect& roiDst, CNNResizePlanCache* planCache);
+
 	template <typename tFlt>
 	struct NNResizeInfo2
 	{
 		const void* srcPtr;
 		int srcStride;
 		int srcWidth, srcHeight;
+		int srcOffsetX, srcOffsetY;		///< The position of the source bitmap in the coordinate system of the source-ROI.
 		tFlt srcRoiX, srcRoiY, srcRoiW, srcRoiH;
 		void* dstPtr;
 		int dstStride;
@@ -50,9 +96,75 @@ public:
 	typedef NNResizeInfo2<float> NNResizeInfo2Flt;
 	typedef NNResizeInfo2<double> NNResizeInfo2Dbl;
 
+	/// The source pixel for each destination pixel of a nearest-neighbor resize. It only depends on the geometry (i. e.
+	/// not on the pixel type or the bitmaps' content), so it is determined once and can be used for all lines or be
+	/// re-used for another bitmap with the same geometry. The columns and rows are given relative to the origin (the
+	/// integral part of the position of the destination-ROI, see GetNNResizeOrigin) - moving the destination-ROI by an
+	/// integral number of pixels does not change the source pixels, so the plan can be re-used for all tiles of a mosaic
+	/// which are scaled in the same way (as long as the same part of them lies within the destination bitmap).
+	struct NNResizePlan
+	{
+		int dstXStart, dstXEnd;		///< The range of columns which are drawn (inclusive, relative to the origin).
+		int dstYStart, dstYEnd;		///< The range of rows which are drawn (inclusive, relative to the origin).
+		std::vector<int> srcX;		///< The column in the source bitmap for each column from dstXStart to dstXEnd.
+		std::vector<int> srcY;		///< The row in the source bitmap for each row from dstYStart to dstYEnd.
+
+		bool IsEmpty() const { return this->dstXStart > this->dstXEnd || this->dstYStart > this->dstYEnd; }
+	};
+
+	/// Gets the origin of the plan of a nearest-neighbor resize - the integral part of the position of the destination-ROI
+	/// (i. e. the position truncated towards zero).
+	template <typename tFlt>
+	static void GetNNResizeOrigin(const NNResizeInfo2<tFlt>& resizeInfo, int& originX, int& originY);
+
+	/// Calculates the range of columns and rows which are drawn by a nearest-neighbor resize (relative to the origin, and
+	/// clipped to the destination bitmap), i. e. the members "dstXStart" to "dstYEnd" of its plan.
+	template <typename tFlt>
+	static void CalcNNResizeRange(const NNResizeInfo2<tFlt>& resizeInfo, NNResizePlan& plan);
+
+	template <typename tFlt>
+	static void CreateNNResizePlan(const NNResizeInfo2<tFlt>& resizeInfo, NNResizePlan& plan);
+
 	template <typename tFlt>
 	static void NNSCale2(libCZI::PixelType tSrcPixelType, libCZI::PixelType tDstPixelType, const NNResizeInfo2<tFlt>& resizeInfo);
 
+	/// Nearest-neighbor resize with a plan created (by CreateNNResizePlan) for the geometry given by "resizeInfo".
+	template <typename tFlt>
+	static void NNSCale2(libCZI::PixelType tSrcPixelType, libCZI::PixelType tDstPixelType, const NNResizeInfo2<tFlt>& resizeInfo, const NNResizePlan& plan);
+
+	/// Area-averaging ("box") resize: every destination pixel is the average of the source pixels it covers, weighted
+	/// with the covered area - so when scaling down, all source pixels contribute (instead of only every n-th pixel as
+	/// with nearest-neighbor). The geometry is the same as with NNResize.
+	static void BoxResize(libCZI::IBitmapData* bmSrc, int srcOffsetX, int srcOffsetY, libCZI::IBitmapData* bmDest, const libCZI::DblRect& roiSrc, const libCZI::DblRect& roiDst);
+
+	/// The source pixels (in one direction) which are covered by the destination pixels of an area-averaging resize.
+	struct BoxResizeTaps
+	{
+		std::vector<int> srcStart;		///< The first source pixel covered by each destination pixel.
+		std::vector<int> tapsStart;		///< The index (into "weights") of the first weight of each destination pixel, plus the end of the last one.
+		std::vector<float> weights;		///< The part of each covered source pixel which is covered by the destination pixel.
+		std::vector<float> area;		///< The sum of the weights of each destination pixel.
+	};
+
+	/// The source pixels and their weights for each destination pixel of an area-averaging resize. The weights are separable,
+	/// i. e. the weight of a source pixel is the product of the weights for its column and its row.
+	struct BoxResizePlan
+	{
+		int dstXStart, dstXEnd;		///< The range of columns in the destination bitmap which are drawn (inclusive).
+		int dstYStart, dstYEnd;		///< The range of rows in the destination bitmap which are drawn (inclusive).
+		BoxResizeTaps x;			///< The taps for each column from dstXStart to dstXEnd.
+		BoxResizeTaps y;			///< The taps for each row from dstYStart to dstYEnd.
+
+		bool IsEmpty() const { return this->dstXStart > this->dstXEnd || this->dstYStart > this->dstYEnd; }
+	};
+
+	template <typename tFlt>
+	static void CreateBoxResizePlan(const NNResizeInfo2<tFlt>& resizeInfo, BoxResizePlan& plan);
+
+	/// Area-averaging resize with a plan created (by CreateBoxResizePlan) for the geometry given by "resizeInfo". The
+	/// average is calculated in the source pixel type and then converted into the destination pixel type.
+	static void BoxScale2(libCZI::PixelType srcPixelType, libCZI::PixelType dstPixelType, const NNResizeInfo2Dbl& resizeInfo, const BoxResizePlan& plan);
+
 	struct CopyOffsetedInfo
 	{
 		int xOffset;
@@ -72,6 +184,58 @@ public:
 	};
 
 	static void CopyOffseted(const CopyOffsetedInfo& info);
+
+	/// The instruction sets for which vectorized pixel-conversion kernels are available.
+	enum class SimdLevel
+	{
+		None,		///< Only the scalar (per-pixel) conversion is used.
+		SSE41,		///< SSE4.1 kernels are used.
+		AVX2		///< AVX2 kernels are used (or SSE4.1 kernels for conversions without an AVX2 kernel).
+	};
+
+	/// Function converting "width" pixels from "srcPtr" to "dstPtr".
+	typedef void(*ConvertLineFunction)(const void* srcPtr, void* dstPtr, int width);
+
+	/// Gets the highest instruction set supported by the CPU (the detection is done only once).
+	///
+	/// \return The supported SIMD level.
+	static SimdLevel GetSupportedSimdLevel();
+
+	/// Gets a function which converts a line of pixels from the source pixel type into the destination pixel type.
+	/// The result is bit-exact with the per-pixel converters, irrespective of the SIMD level used.
+	///
+	/// \param srcPixelType The source pixel type.
+	/// \param dstPixelType The destination pixel type.
+	/// \param maxSimdLevel The highest instruction set to use (it is limited to what the CPU supports). With SimdLevel::None,
+	/// 					the scalar reference implementation is returned.
+	///
+	/// \return The conversion function, or nullptr if there is no kernel for this conversion.
+	static ConvertLineFunction GetConvertLineFunction(libCZI::PixelType srcPixelType, libCZI::PixelType dstPixelType, SimdLevel maxSimdLevel);
+
+	/// Function copying the pixels with the columns "srcX[0]" to "srcX[count-1]" from the line "srcLine" (which is
+	/// "srcWidth" pixels wide) to "dstPtr".
+	typedef void(*GatherLineFunction)(const void* srcLine, int srcWidth, const int* srcX, void* dstPtr, int count);
+
+	/// Gets a function which gathers the pixels of a line for a nearest-neighbor resize.
+	///
+	/// \param bytesPerPel  The number of bytes per pixel.
+	/// \param maxSimdLevel The highest instruction set to use (it is limited to what the CPU supports).
+	///
+	/// \return The function, or nullptr if pixels of this size are not supported.
+	static GatherLineFunction GetGatherLineFunction(int bytesPerPel, SimdLevel maxSimdLevel);
+
+	/// Function adding "weight" times each of the "count" elements at "srcPtr" to "acc".
+	typedef void(*AccumulateLineFunction)(const void* srcPtr, float weight, float* acc, int count);
+
+	/// Gets a function which accumulates (the channels of) a line of pixels for an area-averaging resize. The result is
+	/// bit-exact with the scalar implementation, irrespective of the SIMD level used.
+	///
+	/// \param pixelType    The pixel type (which determines the type of the elements).
+	/// \param maxSimdLevel The highest instruction set to use (it is limited to what the CPU supports).
+	///
+	/// \return The function, or nullptr if the pixel type is not supported.
+	static AccumulateLineFunction GetAccumulateLineFunction(libCZI::PixelType pixelType, SimdLevel maxSimdLevel);
+
 	static void Copy(libCZI::PixelType srcPixelType, const void* srcPtr, int srcStride, libCZI::PixelType dstPixelType, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder);
 
 	template <libCZI::PixelType tSrcPixelType, libCZI::PixelType tDstPixelType>
@@ -94,15 +258,31 @@ public:
 private:
 	
 	template <libCZI::PixelType tSrcPixelType, libCZI::PixelType tDstPixelType, typename tPixelConverter, typename tFlt>
-	static void InternalNNScale2(const tPixelConverter& conv, const NNResizeInfo2<tFlt>& resizeInfo);
+	static void InternalNNScale2(const tPixelConverter& conv, const NNResizeInfo2<tFlt>& resizeInfo, const NNResizePlan& plan, int yFirst, int yLast);
 
 	template <libCZI::PixelType tSrcPixelType, libCZI::PixelType tDstPixelType, typename tPixelConverter, typename tFlt>
-	static void InternalNNScale2(const NNResizeInfo2<tFlt>& resizeInfo)
+	static void InternalNNScale2(const NNResizeInfo2<tFlt>& resizeInfo, const NNResizePlan& plan, int yFirst, int yLast)
 	{
 		tPixelConverter conv;
-		InternalNNScale2<tSrcPixelType, tDstPixelType, tPixelConverter>(conv, resizeInfo);
+		InternalNNScale2<tSrcPixelType, tDstPixelType, tPixelConverter>(conv, resizeInfo, plan, yFirst, yLast);
 	}
 
+	/// Nearest-neighbor resize of the destination rows from "yFirst" to "yLast" (inclusive).
+	template <typename tFlt>
+	static void NNSCale2Rows(libCZI::PixelType srcPixelType, libCZI::PixelType dstPixelType, const NNResizeInfo2<tFlt>& resizeInfo, const NNResizePlan& plan, int yFirst, int yLast);
+
+	/// Calls the specified functor for bands of rows which cover the rows from "yStart" to "yEnd" (exclusive) - in parallel
+	/// on the thread pool (if one is set and the rows are large enough to be worth it), otherwise once for all rows.
+	///
+	/// \param yStart	   The first row.
+	/// \param yEnd		   The end of the rows (exclusive).
+	/// \param bytesPerRow The number of bytes written per row (which determines the size of the bands).
+	/// \param func		   The functor which processes the rows from its first argument to its second argument (exclusive).
+	static void ForEachRowBand(int yStart, int yEnd, size_t bytesPerRow, const std::function<void(int yStart, int yEnd)>& func);
+
+	template <typename tFlt>
+	static void CreateBoxResizeTaps(int& dstStart, int& dstEnd, tFlt dstRoiPos, tFlt dstRoiSize, tFlt srcRoiPos, tFlt srcRoiSize, int srcOffset, int srcSize, BoxResizeTaps& taps);
+
 	static void ThrowUnsupportedConversion(libCZI::PixelType srcPixelType, libCZI::PixelType dstPixelType);
 };
 
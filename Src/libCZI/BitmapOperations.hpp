@@ -80,11 +80,11 @@ struct CConvBgr24ToBgr48
 {
 	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
 	{
-		const std::uint16_t* src = (const std::uint16_t*)ptrSrc;
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
 		std::uint16_t* dst = (std::uint16_t*)ptrDest;
-		*dst = *src;
-		*(dst + 1) = *(src + 1);
-		*(dst + 2) = *(src + 2);
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
 	}
 };
 
@@ -277,6 +277,322 @@ struct CConvGray32FloatToGray32Float
 	}
 };
 
+struct CConvGray8ToBgra32
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		dst[0] = dst[1] = dst[2] = *src;
+		dst[3] = 0xff;
+	}
+};
+
+struct CConvGray8ToBgr96Float
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		float* dst = (float*)ptrDest;
+		dst[0] = dst[1] = dst[2] = *src;
+	}
+};
+
+struct CConvGray16ToBgra32
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint16_t* src = (const std::uint16_t*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		dst[0] = dst[1] = dst[2] = (std::uint8_t)((*src) >> 8);
+		dst[3] = 0xff;
+	}
+};
+
+struct CConvGray16ToBgr96Float
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint16_t* src = (const std::uint16_t*)ptrSrc;
+		float* dst = (float*)ptrDest;
+		dst[0] = dst[1] = dst[2] = *src;
+	}
+};
+
+struct CConvGray32FloatToGray8
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		*dst = Utilities::clampToByte(*src);
+	}
+};
+
+struct CConvGray32FloatToGray16
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		std::uint16_t* dst = (std::uint16_t*)ptrDest;
+		*dst = Utilities::clampToUShort(*src);
+	}
+};
+
+struct CConvGray32FloatToBgr24
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		dst[0] = dst[1] = dst[2] = Utilities::clampToByte(*src);
+	}
+};
+
+struct CConvGray32FloatToBgr48
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		std::uint16_t* dst = (std::uint16_t*)ptrDest;
+		dst[0] = dst[1] = dst[2] = Utilities::clampToUShort(*src);
+	}
+};
+
+struct CConvGray32FloatToBgra32
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		dst[0] = dst[1] = dst[2] = Utilities::clampToByte(*src);
+		dst[3] = 0xff;
+	}
+};
+
+struct CConvGray32FloatToBgr96Float
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		float* dst = (float*)ptrDest;
+		dst[0] = dst[1] = dst[2] = *src;
+	}
+};
+
+struct CConvBgr24ToBgra32
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = 0xff;
+	}
+};
+
+struct CConvBgr24ToBgr96Float
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		float* dst = (float*)ptrDest;
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+	}
+};
+
+struct CConvBgr48ToBgra32
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint16_t* src = (const std::uint16_t*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		dst[0] = (std::uint8_t)(src[0] >> 8);
+		dst[1] = (std::uint8_t)(src[1] >> 8);
+		dst[2] = (std::uint8_t)(src[2] >> 8);
+		dst[3] = 0xff;
+	}
+};
+
+struct CConvBgr48ToBgr96Float
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint16_t* src = (const std::uint16_t*)ptrSrc;
+		float* dst = (float*)ptrDest;
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+	}
+};
+
+struct CConvBgra32ToGray8
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		*dst = (std::uint8_t)((((int)src[0]) + ((int)src[1]) + ((int)src[2]) + 1) / 3);
+	}
+};
+
+struct CConvBgra32ToGray16
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		std::uint16_t* dst = (std::uint16_t*)ptrDest;
+		*dst = (std::uint16_t)((((int)src[0]) + ((int)src[1]) + ((int)src[2]) + 1) / 3);
+	}
+};
+
+struct CConvBgra32ToGray32Float
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		float* dst = (float*)ptrDest;
+		float p = (float)(src[0] + src[1] + src[2]);
+		p /= 3;
+		*dst = p;
+	}
+};
+
+struct CConvBgra32ToBgr24
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+	}
+};
+
+struct CConvBgra32ToBgr48
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		std::uint16_t* dst = (std::uint16_t*)ptrDest;
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+	}
+};
+
+struct CConvBgra32ToBgra32
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = src[3];
+	}
+};
+
+struct CConvBgra32ToBgr96Float
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const std::uint8_t* src = (const std::uint8_t*)ptrSrc;
+		float* dst = (float*)ptrDest;
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+	}
+};
+
+struct CConvBgr96FloatToGray8
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		const float p = (src[0] + src[1] + src[2]) / 3;
+		*dst = Utilities::clampToByte(p);
+	}
+};
+
+struct CConvBgr96FloatToGray16
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		std::uint16_t* dst = (std::uint16_t*)ptrDest;
+		const float p = (src[0] + src[1] + src[2]) / 3;
+		*dst = Utilities::clampToUShort(p);
+	}
+};
+
+struct CConvBgr96FloatToGray32Float
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		float* dst = (float*)ptrDest;
+		const float p = (src[0] + src[1] + src[2]) / 3;
+		*dst = p;
+	}
+};
+
+struct CConvBgr96FloatToBgr24
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		dst[0] = Utilities::clampToByte(src[0]);
+		dst[1] = Utilities::clampToByte(src[1]);
+		dst[2] = Utilities::clampToByte(src[2]);
+	}
+};
+
+struct CConvBgr96FloatToBgr48
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		std::uint16_t* dst = (std::uint16_t*)ptrDest;
+		dst[0] = Utilities::clampToUShort(src[0]);
+		dst[1] = Utilities::clampToUShort(src[1]);
+		dst[2] = Utilities::clampToUShort(src[2]);
+	}
+};
+
+struct CConvBgr96FloatToBgra32
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		std::uint8_t* dst = (std::uint8_t*)ptrDest;
+		dst[0] = Utilities::clampToByte(src[0]);
+		dst[1] = Utilities::clampToByte(src[1]);
+		dst[2] = Utilities::clampToByte(src[2]);
+		dst[3] = 0xff;
+	}
+};
+
+struct CConvBgr96FloatToBgr96Float
+{
+	void ConvertPixel(void* ptrDest, const void* ptrSrc) const
+	{
+		const float* src = (const float*)ptrSrc;
+		float* dst = (float*)ptrDest;
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+	}
+};
+
 template <>
 inline void CBitmapOperations::Copy<libCZI::PixelType::Gray8, libCZI::PixelType::Gray8>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
 {
@@ -303,8 +619,7 @@ inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr48, libCZI::PixelType:
 	CopySamePixelType<libCZI::PixelType::Bgr48>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
 }
 
-// TODO: -implement the missing conversions
-//       -can we make IPP an option?
+// TODO: -can we make IPP an option?
 template <>
 inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr24, libCZI::PixelType::Gray8>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
 {
@@ -345,70 +660,395 @@ inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr24, libCZI::PixelType:
 {
 	Copy<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgr48, CConvBgr24ToBgr48>(CConvBgr24ToBgr48(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
 }
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray8, libCZI::PixelType::Bgra32>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray8, libCZI::PixelType::Bgra32, CConvGray8ToBgra32>(CConvGray8ToBgra32(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray8, libCZI::PixelType::Bgr96Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray8, libCZI::PixelType::Bgr96Float, CConvGray8ToBgr96Float>(CConvGray8ToBgr96Float(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Gray8>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Gray8, CConvGray16ToGray8>(CConvGray16ToGray8(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Gray32Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Gray32Float, CConvGray16ToGray32Float>(CConvGray16ToGray32Float(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr24>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr24, CConvGray16ToBgr24>(CConvGray16ToBgr24(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr48>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr48, CConvGray16ToBgr48>(CConvGray16ToBgr48(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Bgra32>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Bgra32, CConvGray16ToBgra32>(CConvGray16ToBgra32(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr96Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr96Float, CConvGray16ToBgr96Float>(CConvGray16ToBgr96Float(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Gray8>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Gray8, CConvGray32FloatToGray8>(CConvGray32FloatToGray8(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Gray16>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Gray16, CConvGray32FloatToGray16>(CConvGray32FloatToGray16(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgr24>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgr24, CConvGray32FloatToBgr24>(CConvGray32FloatToBgr24(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgr48>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgr48, CConvGray32FloatToBgr48>(CConvGray32FloatToBgr48(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgra32>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgra32, CConvGray32FloatToBgra32>(CConvGray32FloatToBgra32(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgr96Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgr96Float, CConvGray32FloatToBgr96Float>(CConvGray32FloatToBgr96Float(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgra32>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgra32, CConvBgr24ToBgra32>(CConvBgr24ToBgra32(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgr96Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgr96Float, CConvBgr24ToBgr96Float>(CConvBgr24ToBgr96Float(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray8>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray8, CConvBgr48ToGray8>(CConvBgr48ToGray8(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray16>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray16, CConvBgr48ToGray16>(CConvBgr48ToGray16(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray32Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray32Float, CConvBgr48ToGray32Float>(CConvBgr48ToGray32Float(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgr24>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgr24, CConvBgr48ToBgr24>(CConvBgr48ToBgr24(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgra32>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgra32, CConvBgr48ToBgra32>(CConvBgr48ToBgra32(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgr96Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgr96Float, CConvBgr48ToBgr96Float>(CConvBgr48ToBgr96Float(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Gray8>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Gray8, CConvBgra32ToGray8>(CConvBgra32ToGray8(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Gray16>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Gray16, CConvBgra32ToGray16>(CConvBgra32ToGray16(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Gray32Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Gray32Float, CConvBgra32ToGray32Float>(CConvBgra32ToGray32Float(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgr24>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgr24, CConvBgra32ToBgr24>(CConvBgra32ToBgr24(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgr48>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgr48, CConvBgra32ToBgr48>(CConvBgra32ToBgr48(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgra32>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	CopySamePixelType<libCZI::PixelType::Bgra32>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgr96Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgr96Float, CConvBgra32ToBgr96Float>(CConvBgra32ToBgr96Float(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Gray8>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Gray8, CConvBgr96FloatToGray8>(CConvBgr96FloatToGray8(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Gray16>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Gray16, CConvBgr96FloatToGray16>(CConvBgr96FloatToGray16(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Gray32Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Gray32Float, CConvBgr96FloatToGray32Float>(CConvBgr96FloatToGray32Float(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgr24>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgr24, CConvBgr96FloatToBgr24>(CConvBgr96FloatToBgr24(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgr48>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgr48, CConvBgr96FloatToBgr48>(CConvBgr96FloatToBgr48(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgra32>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgra32, CConvBgr96FloatToBgra32>(CConvBgr96FloatToBgra32(), srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
+template <>
+inline void CBitmapOperations::Copy<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgr96Float>(const void* srcPtr, int srcStride, void* dstPtr, int dstStride, int width, int height, bool drawTileBorder)
+{
+	CopySamePixelType<libCZI::PixelType::Bgr96Float>(srcPtr, srcStride, dstPtr, dstStride, width, height, drawTileBorder);
+}
 
 
 //------------------------------------------------------------------------------------------------------------
 
-template <libCZI::PixelType tSrcPixelType, libCZI::PixelType tDstPixelType, typename tPixelConverter, typename tFlt>
-inline void CBitmapOperations::InternalNNScale2(const tPixelConverter& conv, const NNResizeInfo2<tFlt>& resizeInfo)
+template <typename tFlt>
+inline void CBitmapOperations::GetNNResizeOrigin(const NNResizeInfo2<tFlt>& resizeInfo, int& originX, int& originY)
 {
-	auto bytesPerPelSrc = CziUtils::BytesPerPel<tSrcPixelType>();
-	auto bytesPerPelDest = CziUtils::BytesPerPel<tDstPixelType>();
+	// truncating (instead of rounding down) makes sure that subtracting the origin from the position is exact (which it
+	// would not be for a position in (-1,0))
+	originX = (int)resizeInfo.dstRoiX;
+	originY = (int)resizeInfo.dstRoiY;
+}
 
+template <typename tFlt>
+inline void CBitmapOperations::CalcNNResizeRange(const NNResizeInfo2<tFlt>& resizeInfo, NNResizePlan& plan)
+{
 	int dstXStart = (std::max)((int)resizeInfo.dstRoiX, 0);
 	int dstXEnd = (std::min)((int)(resizeInfo.dstRoiX + resizeInfo.dstRoiW), resizeInfo.dstWidth - 1);
 
 	int dstYStart = (std::max)((int)resizeInfo.dstRoiY, 0);
 	int dstYEnd = (std::min)((int)(resizeInfo.dstRoiY + resizeInfo.dstRoiH), resizeInfo.dstHeight - 1);
 
-	auto yMin = ((0 - resizeInfo.srcRoiY)*resizeInfo.dstRoiH) / (resizeInfo.srcRoiH) + resizeInfo.dstRoiY;
-	auto yMax = ((resizeInfo.srcHeight - 1 - resizeInfo.srcRoiY)*(resizeInfo.dstRoiH)) / resizeInfo.srcRoiH + resizeInfo.dstRoiY;
-	auto xMin = ((0 - resizeInfo.srcRoiX)*resizeInfo.dstRoiW) / (resizeInfo.srcRoiW) + resizeInfo.dstRoiX;
-	auto xMax = ((resizeInfo.srcWidth - 1 - resizeInfo.srcRoiX)*(resizeInfo.dstRoiW)) / resizeInfo.srcRoiW + resizeInfo.dstRoiX;
+	auto yMin = ((resizeInfo.srcOffsetY - resizeInfo.srcRoiY)*resizeInfo.dstRoiH) / (resizeInfo.srcRoiH) + resizeInfo.dstRoiY;
+	auto yMax = ((resizeInfo.srcOffsetY + resizeInfo.srcHeight - 1 - resizeInfo.srcRoiY)*(resizeInfo.dstRoiH)) / resizeInfo.srcRoiH + resizeInfo.dstRoiY;
+	auto xMin = ((resizeInfo.srcOffsetX - resizeInfo.srcRoiX)*resizeInfo.dstRoiW) / (resizeInfo.srcRoiW) + resizeInfo.dstRoiX;
+	auto xMax = ((resizeInfo.srcOffsetX + resizeInfo.srcWidth - 1 - resizeInfo.srcRoiX)*(resizeInfo.dstRoiW)) / resizeInfo.srcRoiW + resizeInfo.dstRoiX;
 
-	int dstXStartClipped = (std::max)((int)std::ceil(xMin), dstXStart);
-	int dstXEndClipped = (std::min)((int)std::ceil(xMax), dstXEnd);
-	int dstYStartClipped = (std::max)((int)std::ceil(yMin), dstYStart);
-	int dstYEndClipped = (std::min)((int)std::ceil(yMax), dstYEnd);
+	int originX, originY;
+	GetNNResizeOrigin(resizeInfo, originX, originY);
+	plan.dstXStart = (std::max)((int)std::ceil(xMin), dstXStart) - originX;
+	plan.dstXEnd = (std::min)((int)std::ceil(xMax), dstXEnd) - originX;
+	plan.dstYStart = (std::max)((int)std::ceil(yMin), dstYStart) - originY;
+	plan.dstYEnd = (std::min)((int)std::ceil(yMax), dstYEnd) - originY;
+}
 
-	for (int y = dstYStartClipped; y <= dstYEndClipped; ++y)
+template <typename tFlt>
+inline void CBitmapOperations::CreateNNResizePlan(const NNResizeInfo2<tFlt>& resizeInfo, NNResizePlan& plan)
+{
+	CalcNNResizeRange(resizeInfo, plan);
+	plan.srcX.clear();
+	plan.srcY.clear();
+	if (plan.IsEmpty())
 	{
-		tFlt srcY = ((y - resizeInfo.dstRoiY) / resizeInfo.dstRoiH)*resizeInfo.srcRoiH + resizeInfo.srcRoiY;
-		int srcYInt = (int)srcY;
-		if (srcYInt < 0)
+		return;
+	}
+
+	// the difference of a (relative) destination pixel and the (relative) position of the destination-ROI is exactly the
+	// same as with absolute coordinates, so the source pixels do not depend on the origin
+	int originX, originY;
+	GetNNResizeOrigin(resizeInfo, originX, originY);
+	const tFlt dstRoiX = resizeInfo.dstRoiX - originX;
+	const tFlt dstRoiY = resizeInfo.dstRoiY - originY;
+
+	plan.srcY.reserve(plan.dstYEnd - plan.dstYStart + 1);
+	for (int y = plan.dstYStart; y <= plan.dstYEnd; ++y)
+	{
+		tFlt srcY = ((y - dstRoiY) / resizeInfo.dstRoiH)*resizeInfo.srcRoiH + resizeInfo.srcRoiY;
+		int srcYInt = (int)srcY - resizeInfo.srcOffsetY;
+		plan.srcY.push_back((std::min)((std::max)(srcYInt, 0), resizeInfo.srcHeight - 1));
+	}
+
+	plan.srcX.reserve(plan.dstXEnd - plan.dstXStart + 1);
+	for (int x = plan.dstXStart; x <= plan.dstXEnd; ++x)
+	{
+		// now transform this pixel into the source-ROI
+		tFlt srcX = ((x - dstRoiX) / resizeInfo.dstRoiW)*resizeInfo.srcRoiW + resizeInfo.srcRoiX;
+		int srcXInt = (int)srcX - resizeInfo.srcOffsetX;
+		plan.srcX.push_back((std::min)((std::max)(srcXInt, 0), resizeInfo.srcWidth - 1));
+	}
+}
+
+template <typename tFlt>
+inline void CBitmapOperations::CreateBoxResizeTaps(int& dstStart, int& dstEnd, tFlt dstRoiPos, tFlt dstRoiSize, tFlt srcRoiPos, tFlt srcRoiSize, int srcOffset, int srcSize, BoxResizeTaps& taps)
+{
+	// a position which is (almost) integral is rounded, so that with an integer ratio the weights are exactly one
+	// (instead of having an additional tap with a tiny weight due to rounding errors)
+	auto toSource = [&](int d)->double
+	{
+		double pos = double(((d - dstRoiPos) / dstRoiSize)*srcRoiSize + srcRoiPos) - srcOffset;
+		double rounded = std::floor(pos + 0.5);
+		return std::abs(pos - rounded) < 1e-6 ? rounded : pos;
+	};
+
+	// the destination pixels which do not cover any part of the source bitmap are not drawn
+	while (dstStart <= dstEnd && toSource(dstStart + 1) <= 0)
+	{
+		++dstStart;
+	}
+
+	while (dstStart <= dstEnd && toSource(dstEnd) >= srcSize)
+	{
+		--dstEnd;
+	}
+
+	taps.srcStart.clear();
+	taps.tapsStart.clear();
+	taps.weights.clear();
+	taps.area.clear();
+	double start = toSource(dstStart);
+	for (int d = dstStart; d <= dstEnd; ++d)
+	{
+		// the destination pixel covers [start, end) in the source, clipped to the source bitmap
+		const double end = toSource(d + 1);
+		const int first = (std::max)((int)std::floor(start), 0);
+		const int last = (std::min)((int)std::ceil(end) - 1, srcSize - 1);
+		taps.srcStart.push_back(first);
+		taps.tapsStart.push_back((int)taps.weights.size());
+		float area = 0;
+		for (int s = first; s <= last; ++s)
 		{
-			srcYInt = 0;
+			const float w = (float)((std::min)(double(s + 1), end) - (std::max)(double(s), start));
+			taps.weights.push_back(w);
+			area += w;
 		}
-		else if (srcYInt >= resizeInfo.srcHeight)
+
+		taps.area.push_back(area);
+		start = end;
+	}
+
+	taps.tapsStart.push_back((int)taps.weights.size());
+}
+
+template <typename tFlt>
+inline void CBitmapOperations::CreateBoxResizePlan(const NNResizeInfo2<tFlt>& resizeInfo, BoxResizePlan& plan)
+{
+	// unlike with nearest-neighbor (where the position of the top-left corner of a destination pixel determines whether
+	// it is drawn), all pixels of the destination-ROI are drawn which cover a part of the source bitmap - so at the border
+	// between two tiles, the destination pixels are drawn with the tile they (mostly) belong to
+	plan.dstXStart = (std::max)((int)resizeInfo.dstRoiX, 0);
+	plan.dstXEnd = (std::min)((int)(resizeInfo.dstRoiX + resizeInfo.dstRoiW), resizeInfo.dstWidth - 1);
+	plan.dstYStart = (std::max)((int)resizeInfo.dstRoiY, 0);
+	plan.dstYEnd = (std::min)((int)(resizeInfo.dstRoiY + resizeInfo.dstRoiH), resizeInfo.dstHeight - 1);
+	CreateBoxResizeTaps(plan.dstXStart, plan.dstXEnd, resizeInfo.dstRoiX, resizeInfo.dstRoiW, resizeInfo.srcRoiX, resizeInfo.srcRoiW, resizeInfo.srcOffsetX, resizeInfo.srcWidth, plan.x);
+	CreateBoxResizeTaps(plan.dstYStart, plan.dstYEnd, resizeInfo.dstRoiY, resizeInfo.dstRoiH, resizeInfo.srcRoiY, resizeInfo.srcRoiH, resizeInfo.srcOffsetY, resizeInfo.srcHeight, plan.y);
+}
+
+template <libCZI::PixelType tSrcPixelType, libCZI::PixelType tDstPixelType, typename tPixelConverter, typename tFlt>
+inline void CBitmapOperations::InternalNNScale2(const tPixelConverter& conv, const NNResizeInfo2<tFlt>& resizeInfo, const NNResizePlan& plan, int yFirst, int yLast)
+{
+	auto bytesPerPelSrc = CziUtils::BytesPerPel<tSrcPixelType>();
+	auto bytesPerPelDest = CziUtils::BytesPerPel<tDstPixelType>();
+	const int count = plan.dstXEnd - plan.dstXStart + 1;
+	int originX, originY;
+	GetNNResizeOrigin(resizeInfo, originX, originY);
+
+	// without a conversion, the pixels are gathered with a (possibly vectorized) function for this pixel size
+	const GatherLineFunction gatherLine = tSrcPixelType == tDstPixelType ? GetGatherLineFunction(bytesPerPelSrc, GetSupportedSimdLevel()) : nullptr;
+
+	const char* pPrevDstLine = nullptr;
+	int prevSrcY = -1;
+	for (int y = yFirst; y <= yLast; ++y)
+	{
+		const int srcY = plan.srcY[y - originY - plan.dstYStart];
+		char* pDstLine = ((char*)resizeInfo.dstPtr) + y * ((std::ptrdiff_t)resizeInfo.dstStride) + (originX + plan.dstXStart) * bytesPerPelDest;
+
+		// when enlarging, consecutive destination lines are taken from the same source line
+		if (srcY == prevSrcY)
 		{
-			srcYInt = resizeInfo.srcHeight - 1;
+			memcpy(pDstLine, pPrevDstLine, count * bytesPerPelDest);
+			continue;
 		}
 
-		const char* pSrcLine = (((const char*)resizeInfo.srcPtr) + srcYInt * ((std::ptrdiff_t)resizeInfo.srcStride));
-		char* pDstLine = ((char*)resizeInfo.dstPtr) + y * ((std::ptrdiff_t)resizeInfo.dstStride);
-		for (int x = dstXStartClipped; x <= dstXEndClipped; ++x)
+		const char* pSrcLine = (((const char*)resizeInfo.srcPtr) + srcY * ((std::ptrdiff_t)resizeInfo.srcStride));
+		if (gatherLine != nullptr)
 		{
-			// now transform this pixel into the source-ROI
-			tFlt srcX = ((x - resizeInfo.dstRoiX) / resizeInfo.dstRoiW)*resizeInfo.srcRoiW + resizeInfo.srcRoiX;
-			int srcXInt = (int)srcX;
-			if (srcXInt < 0)
-			{
-				srcXInt = 0;
-			}
-			else if (srcXInt >= resizeInfo.srcWidth)
+			gatherLine(pSrcLine, resizeInfo.srcWidth, &plan.srcX[0], pDstLine, count);
+		}
+		else
+		{
+			const int* srcX = &plan.srcX[0];
+			for (int x = 0; x < count; ++x)
 			{
-				srcXInt = resizeInfo.srcWidth - 1;
+				conv.ConvertPixel(pDstLine + x * bytesPerPelDest, pSrcLine + srcX[x] * bytesPerPelSrc);
 			}
-
-			const char* pSrc = pSrcLine + srcXInt * bytesPerPelSrc;
-			char* pDst = pDstLine + x * bytesPerPelDest;
-			conv.ConvertPixel(pDst, pSrc);
 		}
+
+		pPrevDstLine = pDstLine;
+		prevSrcY = srcY;
 	}
 }
 
 template <typename tFlt>
 inline void CBitmapOperations::NNSCale2(libCZI::PixelType srcPixelType, libCZI::PixelType dstPixelType, const NNResizeInfo2<tFlt>& resizeInfo)
+{
+	NNResizePlan plan;
+	CreateNNResizePlan(resizeInfo, plan);
+	NNSCale2(srcPixelType, dstPixelType, resizeInfo, plan);
+}
+
+template <typename tFlt>
+inline void CBitmapOperations::NNSCale2(libCZI::PixelType srcPixelType, libCZI::PixelType dstPixelType, const NNResizeInfo2<tFlt>& resizeInfo, const NNResizePlan& plan)
+{
+	if (plan.IsEmpty())
+	{
+		return;
+	}
+
+	int originX, originY;
+	GetNNResizeOrigin(resizeInfo, originX, originY);
+	const size_t bytesPerRow = (size_t)(plan.dstXEnd - plan.dstXStart + 1) * CziUtils::GetBytesPerPel(dstPixelType);
+	ForEachRowBand(originY + plan.dstYStart, originY + plan.dstYEnd + 1, bytesPerRow,
+		[&](int yStart, int yEnd)->void
+	{
+		NNSCale2Rows(srcPixelType, dstPixelType, resizeInfo, plan, yStart, yEnd - 1);
+	});
+}
+
+template <typename tFlt>
+inline void CBitmapOperations::NNSCale2Rows(libCZI::PixelType srcPixelType, libCZI::PixelType dstPixelType, const NNResizeInfo2<tFlt>& resizeInfo, const NNResizePlan& plan, int yFirst, int yLast)
 {
 	switch (srcPixelType)
 	{
@@ -416,19 +1056,83 @@ inline void CBitmapOperations::NNSCale2(libCZI::PixelType srcPixelType, libCZI::
 		switch (dstPixelType)
 		{
 		case libCZI::PixelType::Gray8:
-			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Gray8, CConvGray8ToGray8>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Gray8, CConvGray8ToGray8>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Gray16:
+			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Gray16, CConvGray8ToGray16>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Gray32Float:
+			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Gray32Float, CConvGray8ToGray32Float>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr24:
+			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Bgr24, CConvGray8ToBgr24>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr48:
+			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Bgr48, CConvGray8ToBgr48>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgra32:
+			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Bgra32, CConvGray8ToBgra32>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr96Float:
+			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Bgr96Float, CConvGray8ToBgr96Float>(resizeInfo, plan, yFirst, yLast);
+			break;
+		default:
+			ThrowUnsupportedConversion(srcPixelType, dstPixelType);
+		}
+
+		break;
+	case libCZI::PixelType::Gray16:
+		switch (dstPixelType)
+		{
+		case libCZI::PixelType::Gray8:
+			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Gray8, CConvGray16ToGray8>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Gray16:
-			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Gray16, CConvGray8ToGray16>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Gray16, CConvGray16ToGray16>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Gray32Float:
+			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Gray32Float, CConvGray16ToGray32Float>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Bgr24:
-			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Bgr24, CConvGray8ToBgr24>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr24, CConvGray16ToBgr24>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Bgr48:
-			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Bgr48, CConvGray8ToBgr48>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr48, CConvGray16ToBgr48>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgra32:
+			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Bgra32, CConvGray16ToBgra32>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr96Float:
+			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr96Float, CConvGray16ToBgr96Float>(resizeInfo, plan, yFirst, yLast);
+			break;
+		default:
+			ThrowUnsupportedConversion(srcPixelType, dstPixelType);
+		}
+
+		break;
+	case libCZI::PixelType::Gray32Float:
+		switch (dstPixelType)
+		{
+		case libCZI::PixelType::Gray8:
+			InternalNNScale2<libCZI::PixelType::Gray32Float, libCZI::PixelType::Gray8, CConvGray32FloatToGray8>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Gray16:
+			InternalNNScale2<libCZI::PixelType::Gray32Float, libCZI::PixelType::Gray16, CConvGray32FloatToGray16>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Gray32Float:
-			InternalNNScale2<libCZI::PixelType::Gray8, libCZI::PixelType::Gray32Float, CConvGray8ToGray32Float>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Gray32Float, libCZI::PixelType::Gray32Float, CConvGray32FloatToGray32Float>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr24:
+			InternalNNScale2<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgr24, CConvGray32FloatToBgr24>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr48:
+			InternalNNScale2<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgr48, CConvGray32FloatToBgr48>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgra32:
+			InternalNNScale2<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgra32, CConvGray32FloatToBgra32>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr96Float:
+			InternalNNScale2<libCZI::PixelType::Gray32Float, libCZI::PixelType::Bgr96Float, CConvGray32FloatToBgr96Float>(resizeInfo, plan, yFirst, yLast);
 			break;
 		default:
 			ThrowUnsupportedConversion(srcPixelType, dstPixelType);
@@ -439,80 +1143,118 @@ inline void CBitmapOperations::NNSCale2(libCZI::PixelType srcPixelType, libCZI::
 		switch (dstPixelType)
 		{
 		case libCZI::PixelType::Gray8:
-			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Gray8, CConvBgr24ToGray8>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Gray8, CConvBgr24ToGray8>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Gray16:
-			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Gray16, CConvBgr24ToGray16>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Gray16, CConvBgr24ToGray16>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Gray32Float:
-			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Gray32Float, CConvBgr24ToGray32Float>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Gray32Float, CConvBgr24ToGray32Float>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Bgr24:
-			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgr24, CConvBgr24ToBgr24>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgr24, CConvBgr24ToBgr24>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Bgr48:
-			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgr48, CConvBgr24ToBgr48>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgr48, CConvBgr24ToBgr48>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgra32:
+			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgra32, CConvBgr24ToBgra32>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr96Float:
+			InternalNNScale2<libCZI::PixelType::Bgr24, libCZI::PixelType::Bgr96Float, CConvBgr24ToBgr96Float>(resizeInfo, plan, yFirst, yLast);
 			break;
 		default:
 			ThrowUnsupportedConversion(srcPixelType, dstPixelType);
 		}
 
 		break;
-	case libCZI::PixelType::Gray16:
+	case libCZI::PixelType::Bgr48:
 		switch (dstPixelType)
 		{
 		case libCZI::PixelType::Gray8:
-			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Gray8, CConvGray16ToGray8>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray8, CConvBgr48ToGray8>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Gray16:
-			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Gray16, CConvGray16ToGray16>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray16, CConvBgr48ToGray16>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Gray32Float:
-			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Gray32Float, CConvGray16ToGray32Float>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray32Float, CConvBgr48ToGray32Float>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Bgr24:
-			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr24, CConvGray16ToBgr24>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgr24, CConvBgr48ToBgr24>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Bgr48:
-			InternalNNScale2<libCZI::PixelType::Gray16, libCZI::PixelType::Bgr48, CConvGray16ToBgr48>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgr48, CConvBgr48ToBgr48>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgra32:
+			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgra32, CConvBgr48ToBgra32>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr96Float:
+			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgr96Float, CConvBgr48ToBgr96Float>(resizeInfo, plan, yFirst, yLast);
 			break;
 		default:
 			ThrowUnsupportedConversion(srcPixelType, dstPixelType);
 		}
 
 		break;
-	case libCZI::PixelType::Bgr48:
+	case libCZI::PixelType::Bgra32:
 		switch (dstPixelType)
 		{
 		case libCZI::PixelType::Gray8:
-			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray8, CConvBgr48ToGray8>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgra32, libCZI::PixelType::Gray8, CConvBgra32ToGray8>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Gray16:
-			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray16, CConvBgr48ToGray16>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgra32, libCZI::PixelType::Gray16, CConvBgra32ToGray16>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Gray32Float:
-			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Gray32Float, CConvBgr48ToGray32Float>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgra32, libCZI::PixelType::Gray32Float, CConvBgra32ToGray32Float>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Bgr24:
-			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgr24, CConvBgr48ToBgr24>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgr24, CConvBgra32ToBgr24>(resizeInfo, plan, yFirst, yLast);
 			break;
 		case libCZI::PixelType::Bgr48:
-			InternalNNScale2<libCZI::PixelType::Bgr48, libCZI::PixelType::Bgr48, CConvBgr48ToBgr48>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgr48, CConvBgra32ToBgr48>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgra32:
+			InternalNNScale2<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgra32, CConvBgra32ToBgra32>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr96Float:
+			InternalNNScale2<libCZI::PixelType::Bgra32, libCZI::PixelType::Bgr96Float, CConvBgra32ToBgr96Float>(resizeInfo, plan, yFirst, yLast);
 			break;
 		default:
 			ThrowUnsupportedConversion(srcPixelType, dstPixelType);
 		}
 
 		break;
-	case libCZI::PixelType::Gray32Float:
+	case libCZI::PixelType::Bgr96Float:
 		switch (dstPixelType)
 		{
+		case libCZI::PixelType::Gray8:
+			InternalNNScale2<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Gray8, CConvBgr96FloatToGray8>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Gray16:
+			InternalNNScale2<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Gray16, CConvBgr96FloatToGray16>(resizeInfo, plan, yFirst, yLast);
+			break;
 		case libCZI::PixelType::Gray32Float:
-			InternalNNScale2<libCZI::PixelType::Gray32Float, libCZI::PixelType::Gray32Float, CConvGray32FloatToGray32Float>(resizeInfo);
+			InternalNNScale2<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Gray32Float, CConvBgr96FloatToGray32Float>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr24:
+			InternalNNScale2<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgr24, CConvBgr96FloatToBgr24>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr48:
+			InternalNNScale2<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgr48, CConvBgr96FloatToBgr48>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgra32:
+			InternalNNScale2<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgra32, CConvBgr96FloatToBgra32>(resizeInfo, plan, yFirst, yLast);
+			break;
+		case libCZI::PixelType::Bgr96Float:
+			InternalNNScale2<libCZI::PixelType::Bgr96Float, libCZI::PixelType::Bgr96Float, CConvBgr96FloatToBgr96Float>(resizeInfo, plan, yFirst, yLast);
 			break;
 		default:
 			ThrowUnsupportedConversion(srcPixelType, dstPixelType);
 		}
+
+		break;
 	default:
 		ThrowUnsupportedConversion(srcPixelType, dstPixelType);
 	}
@@ -0,0 +1,1098 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#include "stdafx.h"
+#include "BitmapOperations.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BITMAPOPERATIONS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+using namespace libCZI;
+
+// Vectorized kernels for the pixel conversions done by CBitmapOperations::Copy. They are bit-exact with the per-pixel
+//  converters in BitmapOperations.hpp (which serve as the reference, and which are used for the pixels at the end of a
+//  line not filling a whole vector). The instruction set is chosen at runtime, the kernels are compiled with a function
+//  attribute, so the library does not need to be built for SSE4.1 or AVX2.
+
+namespace
+{
+	template <libCZI::PixelType tSrcPixelType, libCZI::PixelType tDstPixelType, typename tPixelConverter>
+	void ConvertLineScalar(const void* srcPtr, void* dstPtr, int width)
+	{
+		const tPixelConverter conv;
+		const char* src = static_cast<const char*>(srcPtr);
+		char* dst = static_cast<char*>(dstPtr);
+		for (int x = 0; x < width; ++x)
+		{
+			conv.ConvertPixel(dst, src);
+			src += CziUtils::BytesPerPel<tSrcPixelType>();
+			dst += CziUtils::BytesPerPel<tDstPixelType>();
+		}
+	}
+
+	template <libCZI::PixelType tSrcPixelType, libCZI::PixelType tDstPixelType, typename tPixelConverter>
+	void ConvertLineTail(const void* srcPtr, void* dstPtr, int start, int width)
+	{
+		ConvertLineScalar<tSrcPixelType, tDstPixelType, tPixelConverter>(
+			static_cast<const char*>(srcPtr) + start * CziUtils::BytesPerPel<tSrcPixelType>(),
+			static_cast<char*>(dstPtr) + start * CziUtils::BytesPerPel<tDstPixelType>(),
+			width - start);
+	}
+
+	template <int tBytesPerPel>
+	void GatherLineScalar(const void* srcLine, int /*srcWidth*/, const int* srcX, void* dstPtr, int count)
+	{
+		const char* src = static_cast<const char*>(srcLine);
+		char* dst = static_cast<char*>(dstPtr);
+		for (int i = 0; i < count; ++i)
+		{
+			memcpy(dst + i * tBytesPerPel, src + srcX[i] * tBytesPerPel, tBytesPerPel);
+		}
+	}
+
+	template <int tBytesPerPel>
+	void GatherLineTail(const void* srcLine, int srcWidth, const int* srcX, void* dstPtr, int start, int count)
+	{
+		GatherLineScalar<tBytesPerPel>(srcLine, srcWidth, srcX + start, static_cast<char*>(dstPtr) + start * tBytesPerPel, count - start);
+	}
+
+	template <typename tElement>
+	void AccumulateLineScalar(const void* srcPtr, float weight, float* acc, int count)
+	{
+		const tElement* src = static_cast<const tElement*>(srcPtr);
+		for (int i = 0; i < count; ++i)
+		{
+			acc[i] += weight * static_cast<float>(src[i]);
+		}
+	}
+
+	template <typename tElement>
+	void AccumulateLineTail(const void* srcPtr, float weight, float* acc, int start, int count)
+	{
+		AccumulateLineScalar<tElement>(static_cast<const tElement*>(srcPtr) + start, weight, acc + start, count - start);
+	}
+}
+
+#if defined(BITMAPOPERATIONS_X86)
+
+#if defined(_MSC_VER)
+#define X86_TARGET_SSE41
+#define X86_TARGET_AVX2
+#else
+#define X86_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define X86_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace
+{
+	/// Gets the shuffle-mask which replicates 16 bytes three times for the specified part (0, 1 or 2) of the 48 bytes
+	/// of output, where "elementSize" is the size of the elements (1 or 2) to be replicated.
+	__m128i X86_TARGET_SSE41 GetInterleaveMask(int part, int elementSize)
+	{
+		alignas(16) std::int8_t mask[16];
+		for (int i = 0; i < 16; ++i)
+		{
+			const int element = (16 * part + i) / elementSize;
+			mask[i] = (std::int8_t)((element / 3) * elementSize + (16 * part + i) % elementSize);
+		}
+
+		return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+	}
+
+	/// The shuffle-masks for separating the channels of 16 Bgr24-pixels - the mask m[channel][reg] gathers the bytes of the
+	/// specified channel contained in the register with index "reg" (of the three registers holding the pixels).
+	struct DeinterleaveMasks
+	{
+		alignas(16) std::int8_t m[3][3][16];
+
+		DeinterleaveMasks()
+		{
+			for (int channel = 0; channel < 3; ++channel)
+			{
+				for (int reg = 0; reg < 3; ++reg)
+				{
+					for (int i = 0; i < 16; ++i)
+					{
+						const int byte = 3 * i + channel - 16 * reg;
+						this->m[channel][reg][i] = (byte >= 0 && byte < 16) ? (std::int8_t)byte : (std::int8_t)-1;
+					}
+				}
+			}
+		}
+	};
+
+	const DeinterleaveMasks deinterleaveMasks;
+
+	// The helpers for the SSE4.1- and the AVX2-kernels are separate functions, so that they are compiled for the
+	//  respective instruction set and can be inlined (mixing legacy SSE- and VEX-encoded instructions is expensive).
+
+	/// Load 16 Bgr24-pixels and separate the channels.
+	inline void X86_TARGET_SSE41 LoadBgr24_SSE41(const std::uint8_t* src, const __m128i (&masks)[3][3], __m128i& b, __m128i& g, __m128i& r)
+	{
+		const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+		const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+		b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, masks[0][0]), _mm_shuffle_epi8(v1, masks[0][1])), _mm_shuffle_epi8(v2, masks[0][2]));
+		g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, masks[1][0]), _mm_shuffle_epi8(v1, masks[1][1])), _mm_shuffle_epi8(v2, masks[1][2]));
+		r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, masks[2][0]), _mm_shuffle_epi8(v1, masks[2][1])), _mm_shuffle_epi8(v2, masks[2][2]));
+	}
+
+	inline void X86_TARGET_SSE41 LoadDeinterleaveMasks_SSE41(__m128i (&masks)[3][3])
+	{
+		for (int channel = 0; channel < 3; ++channel)
+		{
+			for (int reg = 0; reg < 3; ++reg)
+			{
+				masks[channel][reg] = _mm_load_si128(reinterpret_cast<const __m128i*>(deinterleaveMasks.m[channel][reg]));
+			}
+		}
+	}
+
+	/// Calculate (b+g+r+1)/3 for eight 16-bit values - the division is done as a multiplication with 2^16/3 (rounded up),
+	/// which gives the exact result for values less than 32768.
+	inline __m128i X86_TARGET_SSE41 AverageOf3(__m128i b, __m128i g, __m128i r)
+	{
+		const __m128i sum = _mm_add_epi16(_mm_add_epi16(b, g), _mm_add_epi16(r, _mm_set1_epi16(1)));
+		return _mm_mulhi_epu16(sum, _mm_set1_epi16(21846));
+	}
+
+	void X86_TARGET_SSE41 ConvertGray8ToGray16_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint16_t* dst = static_cast<std::uint16_t*>(dstPtr);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_cvtepu8_epi16(v));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 8), _mm_cvtepu8_epi16(_mm_srli_si128(v, 8)));
+		}
+
+		ConvertLineTail<PixelType::Gray8, PixelType::Gray16, CConvGray8ToGray16>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertGray8ToGray32Float_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		float* dst = static_cast<float*>(dstPtr);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			_mm_storeu_ps(dst + x, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)));
+			_mm_storeu_ps(dst + x + 4, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4))));
+			_mm_storeu_ps(dst + x + 8, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8))));
+			_mm_storeu_ps(dst + x + 12, _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12))));
+		}
+
+		ConvertLineTail<PixelType::Gray8, PixelType::Gray32Float, CConvGray8ToGray32Float>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertGray8ToBgr24_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		const __m128i m0 = GetInterleaveMask(0, 1), m1 = GetInterleaveMask(1, 1), m2 = GetInterleaveMask(2, 1);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x), _mm_shuffle_epi8(v, m0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x + 16), _mm_shuffle_epi8(v, m1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x + 32), _mm_shuffle_epi8(v, m2));
+		}
+
+		ConvertLineTail<PixelType::Gray8, PixelType::Bgr24, CConvGray8ToBgr24>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertGray8ToBgr48_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint16_t* dst = static_cast<std::uint16_t*>(dstPtr);
+		const __m128i m0 = GetInterleaveMask(0, 2), m1 = GetInterleaveMask(1, 2), m2 = GetInterleaveMask(2, 2);
+		int x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			const __m128i v = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + x)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x), _mm_shuffle_epi8(v, m0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x + 8), _mm_shuffle_epi8(v, m1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x + 16), _mm_shuffle_epi8(v, m2));
+		}
+
+		ConvertLineTail<PixelType::Gray8, PixelType::Bgr48, CConvGray8ToBgr48>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertBgr24ToBgr48_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		// every byte is zero-extended, independent of the channel
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint16_t* dst = static_cast<std::uint16_t*>(dstPtr);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x + 16 * i));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x + 16 * i), _mm_cvtepu8_epi16(v));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x + 16 * i + 8), _mm_cvtepu8_epi16(_mm_srli_si128(v, 8)));
+			}
+		}
+
+		ConvertLineTail<PixelType::Bgr24, PixelType::Bgr48, CConvBgr24ToBgr48>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertBgr24ToGray8_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		__m128i masks[3][3];
+		LoadDeinterleaveMasks_SSE41(masks);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i b, g, r;
+			LoadBgr24_SSE41(src + 3 * x, masks, b, g, r);
+			const __m128i lo = AverageOf3(_mm_cvtepu8_epi16(b), _mm_cvtepu8_epi16(g), _mm_cvtepu8_epi16(r));
+			const __m128i hi = AverageOf3(_mm_cvtepu8_epi16(_mm_srli_si128(b, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(g, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(r, 8)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(lo, hi));
+		}
+
+		ConvertLineTail<PixelType::Bgr24, PixelType::Gray8, CConvBgr24ToGray8>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertBgr24ToGray16_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint16_t* dst = static_cast<std::uint16_t*>(dstPtr);
+		__m128i masks[3][3];
+		LoadDeinterleaveMasks_SSE41(masks);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i b, g, r;
+			LoadBgr24_SSE41(src + 3 * x, masks, b, g, r);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), AverageOf3(_mm_cvtepu8_epi16(b), _mm_cvtepu8_epi16(g), _mm_cvtepu8_epi16(r)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 8), AverageOf3(_mm_cvtepu8_epi16(_mm_srli_si128(b, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(g, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(r, 8))));
+		}
+
+		ConvertLineTail<PixelType::Bgr24, PixelType::Gray16, CConvBgr24ToGray16>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertBgr24ToGray32Float_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		float* dst = static_cast<float*>(dstPtr);
+		__m128i masks[3][3];
+		LoadDeinterleaveMasks_SSE41(masks);
+		const __m128 three = _mm_set1_ps(3);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i b, g, r;
+			LoadBgr24_SSE41(src + 3 * x, masks, b, g, r);
+			const __m128i sumLo = _mm_add_epi16(_mm_add_epi16(_mm_cvtepu8_epi16(b), _mm_cvtepu8_epi16(g)), _mm_cvtepu8_epi16(r));
+			const __m128i sumHi = _mm_add_epi16(_mm_add_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(b, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(g, 8))), _mm_cvtepu8_epi16(_mm_srli_si128(r, 8)));
+			_mm_storeu_ps(dst + x, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(sumLo)), three));
+			_mm_storeu_ps(dst + x + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(sumLo, 8))), three));
+			_mm_storeu_ps(dst + x + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(sumHi)), three));
+			_mm_storeu_ps(dst + x + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(sumHi, 8))), three));
+		}
+
+		ConvertLineTail<PixelType::Bgr24, PixelType::Gray32Float, CConvBgr24ToGray32Float>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertGray16ToGray8_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint16_t* src = static_cast<const std::uint16_t*>(srcPtr);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i lo = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)), 8);
+			const __m128i hi = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 8)), 8);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(lo, hi));
+		}
+
+		ConvertLineTail<PixelType::Gray16, PixelType::Gray8, CConvGray16ToGray8>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertGray16ToGray32Float_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint16_t* src = static_cast<const std::uint16_t*>(srcPtr);
+		float* dst = static_cast<float*>(dstPtr);
+		int x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			_mm_storeu_ps(dst + x, _mm_cvtepi32_ps(_mm_cvtepu16_epi32(v)));
+			_mm_storeu_ps(dst + x + 4, _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8))));
+		}
+
+		ConvertLineTail<PixelType::Gray16, PixelType::Gray32Float, CConvGray16ToGray32Float>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertBgr48ToBgr24_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		// every channel is converted in the same way, so the interleaving does not matter here
+		const std::uint16_t* src = static_cast<const std::uint16_t*>(srcPtr);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				const __m128i lo = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x + 16 * i)), 8);
+				const __m128i hi = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x + 16 * i + 8)), 8);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x + 16 * i), _mm_packus_epi16(lo, hi));
+			}
+		}
+
+		ConvertLineTail<PixelType::Bgr48, PixelType::Bgr24, CConvBgr48ToBgr24>(srcPtr, dstPtr, x, width);
+	}
+
+	/// Round four floats to integers in the same way as Utilities::clampToByte/clampToUShort does - the values are
+	/// clamped to [0, maxValue], then 0.5 is added and the result is truncated.
+	inline __m128i X86_TARGET_SSE41 ClampAndRound(__m128 v, __m128 maxValue)
+	{
+		v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), maxValue);
+		return _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(.5f)));
+	}
+
+	void X86_TARGET_SSE41 ConvertGray32FloatToGray8_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const float* src = static_cast<const float*>(srcPtr);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		const __m128 maxValue = _mm_set1_ps(255);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i v0 = ClampAndRound(_mm_loadu_ps(src + x), maxValue);
+			const __m128i v1 = ClampAndRound(_mm_loadu_ps(src + x + 4), maxValue);
+			const __m128i v2 = ClampAndRound(_mm_loadu_ps(src + x + 8), maxValue);
+			const __m128i v3 = ClampAndRound(_mm_loadu_ps(src + x + 12), maxValue);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(_mm_packus_epi32(v0, v1), _mm_packus_epi32(v2, v3)));
+		}
+
+		ConvertLineTail<PixelType::Gray32Float, PixelType::Gray8, CConvGray32FloatToGray8>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertGray32FloatToGray16_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const float* src = static_cast<const float*>(srcPtr);
+		std::uint16_t* dst = static_cast<std::uint16_t*>(dstPtr);
+		const __m128 maxValue = _mm_set1_ps(65535);
+		int x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			const __m128i v0 = ClampAndRound(_mm_loadu_ps(src + x), maxValue);
+			const __m128i v1 = ClampAndRound(_mm_loadu_ps(src + x + 4), maxValue);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi32(v0, v1));
+		}
+
+		ConvertLineTail<PixelType::Gray32Float, PixelType::Gray16, CConvGray32FloatToGray16>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertBgr24ToBgra32_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		// expands four 3-byte pixels (in the lower 12 bytes) into 4-byte pixels, with zero in the alpha byte
+		const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x));
+			const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x + 16));
+			const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x + 32));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x), _mm_or_si128(_mm_shuffle_epi8(v0, mask), alpha));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x + 16), _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(v1, v0, 12), mask), alpha));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x + 32), _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(v2, v1, 8), mask), alpha));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x + 48), _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(v2, 4), mask), alpha));
+		}
+
+		ConvertLineTail<PixelType::Bgr24, PixelType::Bgra32, CConvBgr24ToBgra32>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertBgra32ToBgr24_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		const __m128i mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i c0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * x)), mask);
+			const __m128i c1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * x + 16)), mask);
+			const __m128i c2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * x + 32)), mask);
+			const __m128i c3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * x + 48)), mask);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x), _mm_or_si128(c0, _mm_slli_si128(c1, 12)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x + 16), _mm_or_si128(_mm_srli_si128(c1, 4), _mm_slli_si128(c2, 8)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x + 32), _mm_or_si128(_mm_srli_si128(c2, 8), _mm_slli_si128(c3, 4)));
+		}
+
+		ConvertLineTail<PixelType::Bgra32, PixelType::Bgr24, CConvBgra32ToBgr24>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_SSE41 ConvertGray8ToBgra32_SSE41(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		__m128i masks[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			// the mask with index i replicates the bytes 4*i..4*i+3 into the B, G and R bytes of four pixels
+			alignas(16) std::int8_t mask[16];
+			for (int n = 0; n < 16; ++n)
+			{
+				mask[n] = (n % 4 < 3) ? (std::int8_t)(4 * i + n / 4) : (std::int8_t)-1;
+			}
+
+			masks[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+		}
+
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			for (int i = 0; i < 4; ++i)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x + 16 * i), _mm_or_si128(_mm_shuffle_epi8(v, masks[i]), alpha));
+			}
+		}
+
+		ConvertLineTail<PixelType::Gray8, PixelType::Bgra32, CConvGray8ToBgra32>(srcPtr, dstPtr, x, width);
+	}
+
+	// For the AVX2-kernels, the channels of the Bgr24-pixels are still separated with 128-bit shuffles (as they do not
+	//  cross the 128-bit lanes), the arithmetic is done on 16 pixels at once.
+
+	void X86_TARGET_AVX2 ConvertGray8ToGray16_AVX2(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint16_t* dst = static_cast<std::uint16_t*>(dstPtr);
+		int x = 0;
+		for (; x + 32 <= width; x += 32)
+		{
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+		}
+
+		ConvertLineTail<PixelType::Gray8, PixelType::Gray16, CConvGray8ToGray16>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_AVX2 ConvertGray8ToGray32Float_AVX2(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		float* dst = static_cast<float*>(dstPtr);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			_mm256_storeu_ps(dst + x, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)));
+			_mm256_storeu_ps(dst + x + 8, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8))));
+		}
+
+		ConvertLineTail<PixelType::Gray8, PixelType::Gray32Float, CConvGray8ToGray32Float>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_AVX2 ConvertBgr24ToBgr48_AVX2(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint16_t* dst = static_cast<std::uint16_t*>(dstPtr);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x + 16 * i));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 3 * x + 16 * i), _mm256_cvtepu8_epi16(v));
+			}
+		}
+
+		ConvertLineTail<PixelType::Bgr24, PixelType::Bgr48, CConvBgr24ToBgr48>(srcPtr, dstPtr, x, width);
+	}
+
+	inline void X86_TARGET_AVX2 LoadBgr24_AVX2(const std::uint8_t* src, const __m128i (&masks)[3][3], __m128i& b, __m128i& g, __m128i& r)
+	{
+		const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+		const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+		b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, masks[0][0]), _mm_shuffle_epi8(v1, masks[0][1])), _mm_shuffle_epi8(v2, masks[0][2]));
+		g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, masks[1][0]), _mm_shuffle_epi8(v1, masks[1][1])), _mm_shuffle_epi8(v2, masks[1][2]));
+		r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, masks[2][0]), _mm_shuffle_epi8(v1, masks[2][1])), _mm_shuffle_epi8(v2, masks[2][2]));
+	}
+
+	inline void X86_TARGET_AVX2 LoadDeinterleaveMasks_AVX2(__m128i (&masks)[3][3])
+	{
+		for (int channel = 0; channel < 3; ++channel)
+		{
+			for (int reg = 0; reg < 3; ++reg)
+			{
+				masks[channel][reg] = _mm_load_si128(reinterpret_cast<const __m128i*>(deinterleaveMasks.m[channel][reg]));
+			}
+		}
+	}
+
+	inline __m256i X86_TARGET_AVX2 AverageOf3_AVX2(__m128i b, __m128i g, __m128i r)
+	{
+		const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(b), _mm256_cvtepu8_epi16(g)), _mm256_add_epi16(_mm256_cvtepu8_epi16(r), _mm256_set1_epi16(1)));
+		return _mm256_mulhi_epu16(sum, _mm256_set1_epi16(21846));
+	}
+
+	void X86_TARGET_AVX2 ConvertBgr24ToGray8_AVX2(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		__m128i masks[3][3];
+		LoadDeinterleaveMasks_AVX2(masks);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i b, g, r;
+			LoadBgr24_AVX2(src + 3 * x, masks, b, g, r);
+			const __m256i avg = AverageOf3_AVX2(b, g, r);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(_mm256_castsi256_si128(avg), _mm256_extracti128_si256(avg, 1)));
+		}
+
+		ConvertLineTail<PixelType::Bgr24, PixelType::Gray8, CConvBgr24ToGray8>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_AVX2 ConvertBgr24ToGray16_AVX2(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		std::uint16_t* dst = static_cast<std::uint16_t*>(dstPtr);
+		__m128i masks[3][3];
+		LoadDeinterleaveMasks_AVX2(masks);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i b, g, r;
+			LoadBgr24_AVX2(src + 3 * x, masks, b, g, r);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), AverageOf3_AVX2(b, g, r));
+		}
+
+		ConvertLineTail<PixelType::Bgr24, PixelType::Gray16, CConvBgr24ToGray16>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_AVX2 ConvertBgr24ToGray32Float_AVX2(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		float* dst = static_cast<float*>(dstPtr);
+		__m128i masks[3][3];
+		LoadDeinterleaveMasks_AVX2(masks);
+		const __m256 three = _mm256_set1_ps(3);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i b, g, r;
+			LoadBgr24_AVX2(src + 3 * x, masks, b, g, r);
+			const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(b), _mm256_cvtepu8_epi16(g)), _mm256_cvtepu8_epi16(r));
+			_mm256_storeu_ps(dst + x, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(sum))), three));
+			_mm256_storeu_ps(dst + x + 8, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(sum, 1))), three));
+		}
+
+		ConvertLineTail<PixelType::Bgr24, PixelType::Gray32Float, CConvBgr24ToGray32Float>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_AVX2 ConvertGray16ToGray32Float_AVX2(const void* srcPtr, void* dstPtr, int width)
+	{
+		const std::uint16_t* src = static_cast<const std::uint16_t*>(srcPtr);
+		float* dst = static_cast<float*>(dstPtr);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			_mm256_storeu_ps(dst + x, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)))));
+			_mm256_storeu_ps(dst + x + 8, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 8)))));
+		}
+
+		ConvertLineTail<PixelType::Gray16, PixelType::Gray32Float, CConvGray16ToGray32Float>(srcPtr, dstPtr, x, width);
+	}
+
+	inline __m256i X86_TARGET_AVX2 ClampAndRound_AVX2(__m256 v, __m256 maxValue)
+	{
+		v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), maxValue);
+		return _mm256_cvttps_epi32(_mm256_add_ps(v, _mm256_set1_ps(.5f)));
+	}
+
+	void X86_TARGET_AVX2 ConvertGray32FloatToGray8_AVX2(const void* srcPtr, void* dstPtr, int width)
+	{
+		const float* src = static_cast<const float*>(srcPtr);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		const __m256 maxValue = _mm256_set1_ps(255);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			// the packing operates within the 128-bit lanes, so the order has to be restored afterwards
+			const __m256i v = _mm256_permute4x64_epi64(
+				_mm256_packus_epi32(ClampAndRound_AVX2(_mm256_loadu_ps(src + x), maxValue), ClampAndRound_AVX2(_mm256_loadu_ps(src + x + 8), maxValue)),
+				_MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+		}
+
+		ConvertLineTail<PixelType::Gray32Float, PixelType::Gray8, CConvGray32FloatToGray8>(srcPtr, dstPtr, x, width);
+	}
+
+	void X86_TARGET_AVX2 ConvertGray32FloatToGray16_AVX2(const void* srcPtr, void* dstPtr, int width)
+	{
+		const float* src = static_cast<const float*>(srcPtr);
+		std::uint16_t* dst = static_cast<std::uint16_t*>(dstPtr);
+		const __m256 maxValue = _mm256_set1_ps(65535);
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m256i v = _mm256_permute4x64_epi64(
+				_mm256_packus_epi32(ClampAndRound_AVX2(_mm256_loadu_ps(src + x), maxValue), ClampAndRound_AVX2(_mm256_loadu_ps(src + x + 8), maxValue)),
+				_MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), v);
+		}
+
+		ConvertLineTail<PixelType::Gray32Float, PixelType::Gray16, CConvGray32FloatToGray16>(srcPtr, dstPtr, x, width);
+	}
+
+	// The gather-kernels load 4 (or 8) bytes for each pixel, so the vector loop stops at the first pixel where this
+	//  would read beyond the end of the source line (the remaining pixels are then copied by the scalar code).
+
+	/// Check whether all eight indices are less than or equal to the specified maximum.
+	inline bool X86_TARGET_AVX2 AreIndicesLessOrEqual(__m256i indices, __m256i maxIndex)
+	{
+		return _mm256_testz_si256(_mm256_cmpgt_epi32(indices, maxIndex), _mm256_set1_epi32(-1)) != 0;
+	}
+
+	void X86_TARGET_AVX2 GatherLine1_AVX2(const void* srcLine, int srcWidth, const int* srcX, void* dstPtr, int count)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcLine);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		const __m256i maxIndex = _mm256_set1_epi32(srcWidth - 4);
+		const __m256i shuffle = _mm256_setr_epi8(
+			0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+		const __m256i permute = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(srcX + i));
+			if (!AreIndicesLessOrEqual(indices, maxIndex))
+			{
+				break;
+			}
+
+			const __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src), indices, 1);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuffle), permute)));
+		}
+
+		GatherLineTail<1>(srcLine, srcWidth, srcX, dstPtr, i, count);
+	}
+
+	void X86_TARGET_AVX2 GatherLine2_AVX2(const void* srcLine, int srcWidth, const int* srcX, void* dstPtr, int count)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcLine);
+		std::uint16_t* dst = static_cast<std::uint16_t*>(dstPtr);
+		const __m256i maxIndex = _mm256_set1_epi32(srcWidth - 2);
+		const __m256i shuffle = _mm256_setr_epi8(
+			0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+			0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+		const __m256i permute = _mm256_setr_epi32(0, 1, 4, 5, 2, 2, 2, 2);
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(srcX + i));
+			if (!AreIndicesLessOrEqual(indices, maxIndex))
+			{
+				break;
+			}
+
+			const __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src), indices, 2);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuffle), permute)));
+		}
+
+		GatherLineTail<2>(srcLine, srcWidth, srcX, dstPtr, i, count);
+	}
+
+	void X86_TARGET_AVX2 GatherLine3_AVX2(const void* srcLine, int srcWidth, const int* srcX, void* dstPtr, int count)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcLine);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		const __m256i maxIndex = _mm256_set1_epi32(srcWidth - 2);
+		const __m256i shuffle = _mm256_setr_epi8(
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		int i = 0;
+
+		// the two halves are stored with 16 bytes each (of which 12 are valid), so the last store writes 4 bytes beyond
+		// the eight pixels - which is fine as long as at least two more pixels follow (which are written later on)
+		for (; i + 8 + 2 <= count; i += 8)
+		{
+			const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(srcX + i));
+			if (!AreIndicesLessOrEqual(indices, maxIndex))
+			{
+				break;
+			}
+
+			const __m256i v = _mm256_shuffle_epi8(_mm256_i32gather_epi32(reinterpret_cast<const int*>(src), _mm256_add_epi32(indices, _mm256_add_epi32(indices, indices)), 1), shuffle);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * i), _mm256_castsi256_si128(v));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * i + 12), _mm256_extracti128_si256(v, 1));
+		}
+
+		GatherLineTail<3>(srcLine, srcWidth, srcX, dstPtr, i, count);
+	}
+
+	void X86_TARGET_AVX2 GatherLine6_AVX2(const void* srcLine, int srcWidth, const int* srcX, void* dstPtr, int count)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcLine);
+		std::uint8_t* dst = static_cast<std::uint8_t*>(dstPtr);
+		const __m128i maxIndex = _mm_set1_epi32(srcWidth - 2);
+		const __m256i shuffle = _mm256_setr_epi8(
+			0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1,
+			0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+		int i = 0;
+
+		// as above, the last store writes 4 bytes beyond the four pixels, so at least one more pixel must follow
+		for (; i + 4 + 1 <= count; i += 4)
+		{
+			const __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcX + i));
+			if (!_mm_testz_si128(_mm_cmpgt_epi32(indices, maxIndex), _mm_set1_epi32(-1)))
+			{
+				break;
+			}
+
+			const __m256i v = _mm256_shuffle_epi8(_mm256_i32gather_epi64(reinterpret_cast<const long long*>(src), _mm_add_epi32(indices, _mm_add_epi32(indices, indices)), 2), shuffle);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 6 * i), _mm256_castsi256_si128(v));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 6 * i + 12), _mm256_extracti128_si256(v, 1));
+		}
+
+		GatherLineTail<6>(srcLine, srcWidth, srcX, dstPtr, i, count);
+	}
+
+	// The accumulate-kernels multiply and add separately (i. e. there is no fused multiply-add), so that the result
+	//  is the same as with the scalar code.
+
+	inline __m128 X86_TARGET_SSE41 MultiplyAdd_SSE41(__m128i v, __m128 weight, const float* acc)
+	{
+		return _mm_add_ps(_mm_loadu_ps(acc), _mm_mul_ps(weight, _mm_cvtepi32_ps(v)));
+	}
+
+	void X86_TARGET_SSE41 AccumulateLineUInt8_SSE41(const void* srcPtr, float weight, float* acc, int count)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		const __m128 w = _mm_set1_ps(weight);
+		int i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			_mm_storeu_ps(acc + i, MultiplyAdd_SSE41(_mm_cvtepu8_epi32(v), w, acc + i));
+			_mm_storeu_ps(acc + i + 4, MultiplyAdd_SSE41(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4)), w, acc + i + 4));
+			_mm_storeu_ps(acc + i + 8, MultiplyAdd_SSE41(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8)), w, acc + i + 8));
+			_mm_storeu_ps(acc + i + 12, MultiplyAdd_SSE41(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12)), w, acc + i + 12));
+		}
+
+		AccumulateLineTail<std::uint8_t>(srcPtr, weight, acc, i, count);
+	}
+
+	void X86_TARGET_SSE41 AccumulateLineUInt16_SSE41(const void* srcPtr, float weight, float* acc, int count)
+	{
+		const std::uint16_t* src = static_cast<const std::uint16_t*>(srcPtr);
+		const __m128 w = _mm_set1_ps(weight);
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			_mm_storeu_ps(acc + i, MultiplyAdd_SSE41(_mm_cvtepu16_epi32(v), w, acc + i));
+			_mm_storeu_ps(acc + i + 4, MultiplyAdd_SSE41(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8)), w, acc + i + 4));
+		}
+
+		AccumulateLineTail<std::uint16_t>(srcPtr, weight, acc, i, count);
+	}
+
+	void X86_TARGET_SSE41 AccumulateLineFloat_SSE41(const void* srcPtr, float weight, float* acc, int count)
+	{
+		const float* src = static_cast<const float*>(srcPtr);
+		const __m128 w = _mm_set1_ps(weight);
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+			_mm_storeu_ps(acc + i + 4, _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(w, _mm_loadu_ps(src + i + 4))));
+		}
+
+		AccumulateLineTail<float>(srcPtr, weight, acc, i, count);
+	}
+
+	inline __m256 X86_TARGET_AVX2 MultiplyAdd_AVX2(__m256i v, __m256 weight, const float* acc)
+	{
+		return _mm256_add_ps(_mm256_loadu_ps(acc), _mm256_mul_ps(weight, _mm256_cvtepi32_ps(v)));
+	}
+
+	void X86_TARGET_AVX2 AccumulateLineUInt8_AVX2(const void* srcPtr, float weight, float* acc, int count)
+	{
+		const std::uint8_t* src = static_cast<const std::uint8_t*>(srcPtr);
+		const __m256 w = _mm256_set1_ps(weight);
+		int i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			_mm256_storeu_ps(acc + i, MultiplyAdd_AVX2(_mm256_cvtepu8_epi32(v), w, acc + i));
+			_mm256_storeu_ps(acc + i + 8, MultiplyAdd_AVX2(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)), w, acc + i + 8));
+		}
+
+		AccumulateLineTail<std::uint8_t>(srcPtr, weight, acc, i, count);
+	}
+
+	void X86_TARGET_AVX2 AccumulateLineUInt16_AVX2(const void* srcPtr, float weight, float* acc, int count)
+	{
+		const std::uint16_t* src = static_cast<const std::uint16_t*>(srcPtr);
+		const __m256 w = _mm256_set1_ps(weight);
+		int i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			_mm256_storeu_ps(acc + i, MultiplyAdd_AVX2(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))), w, acc + i));
+			_mm256_storeu_ps(acc + i + 8, MultiplyAdd_AVX2(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8))), w, acc + i + 8));
+		}
+
+		AccumulateLineTail<std::uint16_t>(srcPtr, weight, acc, i, count);
+	}
+
+	void X86_TARGET_AVX2 AccumulateLineFloat_AVX2(const void* srcPtr, float weight, float* acc, int count)
+	{
+		const float* src = static_cast<const float*>(srcPtr);
+		const __m256 w = _mm256_set1_ps(weight);
+		int i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			_mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_mul_ps(w, _mm256_loadu_ps(src + i))));
+			_mm256_storeu_ps(acc + i + 8, _mm256_add_ps(_mm256_loadu_ps(acc + i + 8), _mm256_mul_ps(w, _mm256_loadu_ps(src + i + 8))));
+		}
+
+		AccumulateLineTail<float>(srcPtr, weight, acc, i, count);
+	}
+
+	CBitmapOperations::SimdLevel DetermineSupportedSimdLevel()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 19)) == 0)
+		{
+			return CBitmapOperations::SimdLevel::None;
+		}
+
+		// AVX2 requires OSXSAVE, AVX, the OS saving the YMM state, and the AVX2 bit of leaf 7
+		if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6)
+		{
+			__cpuid(info, 0);
+			if (info[0] >= 7)
+			{
+				__cpuidex(info, 7, 0);
+				if (info[1] & (1 << 5))
+				{
+					return CBitmapOperations::SimdLevel::AVX2;
+				}
+			}
+		}
+
+		return CBitmapOperations::SimdLevel::SSE41;
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			return CBitmapOperations::SimdLevel::AVX2;
+		}
+
+		if (__builtin_cpu_supports("sse4.1"))
+		{
+			return CBitmapOperations::SimdLevel::SSE41;
+		}
+
+		return CBitmapOperations::SimdLevel::None;
+#endif
+	}
+}
+
+#endif
+
+/*static*/CBitmapOperations::SimdLevel CBitmapOperations::GetSupportedSimdLevel()
+{
+#if defined(BITMAPOPERATIONS_X86)
+	static const SimdLevel supportedSimdLevel = DetermineSupportedSimdLevel();
+	return supportedSimdLevel;
+#else
+	return SimdLevel::None;
+#endif
+}
+
+/*static*/CBitmapOperations::ConvertLineFunction CBitmapOperations::GetConvertLineFunction(libCZI::PixelType srcPixelType, libCZI::PixelType dstPixelType, SimdLevel maxSimdLevel)
+{
+	struct Kernels
+	{
+		PixelType srcPixelType;
+		PixelType dstPixelType;
+		ConvertLineFunction scalar;
+		ConvertLineFunction sse41;
+		ConvertLineFunction avx2;
+	};
+
+#if defined(BITMAPOPERATIONS_X86)
+#define BITMAPOPERATIONS_KERNELS(sse41, avx2) sse41, avx2
+#else
+#define BITMAPOPERATIONS_KERNELS(sse41, avx2) nullptr, nullptr
+#endif
+
+	// if there is no AVX2-kernel for a conversion, the SSE4.1-kernel is used instead
+	static const Kernels kernels[] =
+	{
+		{ PixelType::Gray8, PixelType::Gray16, ConvertLineScalar<PixelType::Gray8, PixelType::Gray16, CConvGray8ToGray16>, BITMAPOPERATIONS_KERNELS(ConvertGray8ToGray16_SSE41, ConvertGray8ToGray16_AVX2) },
+		{ PixelType::Gray8, PixelType::Gray32Float, ConvertLineScalar<PixelType::Gray8, PixelType::Gray32Float, CConvGray8ToGray32Float>, BITMAPOPERATIONS_KERNELS(ConvertGray8ToGray32Float_SSE41, ConvertGray8ToGray32Float_AVX2) },
+		{ PixelType::Gray8, PixelType::Bgr24, ConvertLineScalar<PixelType::Gray8, PixelType::Bgr24, CConvGray8ToBgr24>, BITMAPOPERATIONS_KERNELS(ConvertGray8ToBgr24_SSE41, ConvertGray8ToBgr24_SSE41) },
+		{ PixelType::Gray8, PixelType::Bgr48, ConvertLineScalar<PixelType::Gray8, PixelType::Bgr48, CConvGray8ToBgr48>, BITMAPOPERATIONS_KERNELS(ConvertGray8ToBgr48_SSE41, ConvertGray8ToBgr48_SSE41) },
+		{ PixelType::Bgr24, PixelType::Gray8, ConvertLineScalar<PixelType::Bgr24, PixelType::Gray8, CConvBgr24ToGray8>, BITMAPOPERATIONS_KERNELS(ConvertBgr24ToGray8_SSE41, ConvertBgr24ToGray8_AVX2) },
+		{ PixelType::Bgr24, PixelType::Gray16, ConvertLineScalar<PixelType::Bgr24, PixelType::Gray16, CConvBgr24ToGray16>, BITMAPOPERATIONS_KERNELS(ConvertBgr24ToGray16_SSE41, ConvertBgr24ToGray16_AVX2) },
+		{ PixelType::Bgr24, PixelType::Gray32Float, ConvertLineScalar<PixelType::Bgr24, PixelType::Gray32Float, CConvBgr24ToGray32Float>, BITMAPOPERATIONS_KERNELS(ConvertBgr24ToGray32Float_SSE41, ConvertBgr24ToGray32Float_AVX2) },
+		{ PixelType::Bgr24, PixelType::Bgr48, ConvertLineScalar<PixelType::Bgr24, PixelType::Bgr48, CConvBgr24ToBgr48>, BITMAPOPERATIONS_KERNELS(ConvertBgr24ToBgr48_SSE41, ConvertBgr24ToBgr48_AVX2) },
+		{ PixelType::Gray8, PixelType::Bgra32, ConvertLineScalar<PixelType::Gray8, PixelType::Bgra32, CConvGray8ToBgra32>, BITMAPOPERATIONS_KERNELS(ConvertGray8ToBgra32_SSE41, ConvertGray8ToBgra32_SSE41) },
+		{ PixelType::Gray16, PixelType::Gray8, ConvertLineScalar<PixelType::Gray16, PixelType::Gray8, CConvGray16ToGray8>, BITMAPOPERATIONS_KERNELS(ConvertGray16ToGray8_SSE41, ConvertGray16ToGray8_SSE41) },
+		{ PixelType::Gray16, PixelType::Gray32Float, ConvertLineScalar<PixelType::Gray16, PixelType::Gray32Float, CConvGray16ToGray32Float>, BITMAPOPERATIONS_KERNELS(ConvertGray16ToGray32Float_SSE41, ConvertGray16ToGray32Float_AVX2) },
+		{ PixelType::Gray32Float, PixelType::Gray8, ConvertLineScalar<PixelType::Gray32Float, PixelType::Gray8, CConvGray32FloatToGray8>, BITMAPOPERATIONS_KERNELS(ConvertGray32FloatToGray8_SSE41, ConvertGray32FloatToGray8_AVX2) },
+		{ PixelType::Gray32Float, PixelType::Gray16, ConvertLineScalar<PixelType::Gray32Float, PixelType::Gray16, CConvGray32FloatToGray16>, BITMAPOPERATIONS_KERNELS(ConvertGray32FloatToGray16_SSE41, ConvertGray32FloatToGray16_AVX2) },
+		{ PixelType::Bgr24, PixelType::Bgra32, ConvertLineScalar<PixelType::Bgr24, PixelType::Bgra32, CConvBgr24ToBgra32>, BITMAPOPERATIONS_KERNELS(ConvertBgr24ToBgra32_SSE41, ConvertBgr24ToBgra32_SSE41) },
+		{ PixelType::Bgr48, PixelType::Bgr24, ConvertLineScalar<PixelType::Bgr48, PixelType::Bgr24, CConvBgr48ToBgr24>, BITMAPOPERATIONS_KERNELS(ConvertBgr48ToBgr24_SSE41, ConvertBgr48ToBgr24_SSE41) },
+		{ PixelType::Bgra32, PixelType::Bgr24, ConvertLineScalar<PixelType::Bgra32, PixelType::Bgr24, CConvBgra32ToBgr24>, BITMAPOPERATIONS_KERNELS(ConvertBgra32ToBgr24_SSE41, ConvertBgra32ToBgr24_SSE41) },
+	};
+
+#undef BITMAPOPERATIONS_KERNELS
+
+	const SimdLevel simdLevel = (std::min)(maxSimdLevel, GetSupportedSimdLevel());
+	for (const auto& k : kernels)
+	{
+		if (k.srcPixelType == srcPixelType && k.dstPixelType == dstPixelType)
+		{
+			switch (simdLevel)
+			{
+			case SimdLevel::AVX2:
+				return k.avx2;
+			case SimdLevel::SSE41:
+				return k.sse41;
+			default:
+				return k.scalar;
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+/*static*/CBitmapOperations::GatherLineFunction CBitmapOperations::GetGatherLineFunction(int bytesPerPel, SimdLevel maxSimdLevel)
+{
+#if defined(BITMAPOPERATIONS_X86)
+	// there is no gather-instruction in SSE4.1, so there are only AVX2-kernels
+	if ((std::min)(maxSimdLevel, GetSupportedSimdLevel()) == SimdLevel::AVX2)
+	{
+		switch (bytesPerPel)
+		{
+		case 1:
+			return GatherLine1_AVX2;
+		case 2:
+			return GatherLine2_AVX2;
+		case 3:
+			return GatherLine3_AVX2;
+		case 6:
+			return GatherLine6_AVX2;
+		default:
+			break;
+		}
+	}
+#endif
+
+	switch (bytesPerPel)
+	{
+	case 1:
+		return GatherLineScalar<1>;
+	case 2:
+		return GatherLineScalar<2>;
+	case 3:
+		return GatherLineScalar<3>;
+	case 4:
+		return GatherLineScalar<4>;
+	case 6:
+		return GatherLineScalar<6>;
+	case 12:
+		return GatherLineScalar<12>;
+	default:
+		return nullptr;
+	}
+}
+
+/*static*/CBitmapOperations::AccumulateLineFunction CBitmapOperations::GetAccumulateLineFunction(libCZI::PixelType pixelType, SimdLevel maxSimdLevel)
+{
+	const SimdLevel simdLevel = (std::min)(maxSimdLevel, GetSupportedSimdLevel());
+	switch (pixelType)
+	{
+	case PixelType::Gray8:
+	case PixelType::Bgr24:
+	case PixelType::Bgra32:
+#if defined(BITMAPOPERATIONS_X86)
+		if (simdLevel == SimdLevel::AVX2)
+		{
+			return AccumulateLineUInt8_AVX2;
+		}
+		else if (simdLevel == SimdLevel::SSE41)
+		{
+			return AccumulateLineUInt8_SSE41;
+		}
+#endif
+		return AccumulateLineScalar<std::uint8_t>;
+	case PixelType::Gray16:
+	case PixelType::Bgr48:
+#if defined(BITMAPOPERATIONS_X86)
+		if (simdLevel == SimdLevel::AVX2)
+		{
+			return AccumulateLineUInt16_AVX2;
+		}
+		else if (simdLevel == SimdLevel::SSE41)
+		{
+			return AccumulateLineUInt16_SSE41;
+		}
+#endif
+		return AccumulateLineScalar<std::uint16_t>;
+	case PixelType::Gray32Float:
+	case PixelType::Bgr96Float:
+#if defined(BITMAPOPERATIONS_X86)
+		if (simdLevel == SimdLevel::AVX2)
+		{
+			return AccumulateLineFloat_AVX2;
+		}
+		else if (simdLevel == SimdLevel::SSE41)
+		{
+			return AccumulateLineFloat_SSE41;
+		}
+#endif
+		return AccumulateLineScalar<float>;
+	default:
+		return nullptr;
+	}
+}
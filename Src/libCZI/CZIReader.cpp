@@ -28,11 +28,12 @@
 #include "CziUtils.h"
 #include "utilities.h"
 #include "CziAttachment.h"
+#include "SidecarIndex.h"
 
 using namespace std;
 using namespace libCZI;
 
-CCZIReader::CCZIReader() : isOperational(false)
+CCZIReader::CCZIReader() : isOperational(false), useSidecarIndex(false), subBlkDirLoaded(false), attachmentDirLoaded(false)
 {
 }
 
@@ -41,6 +42,11 @@ CCZIReader::~CCZIReader()
 }
 
 /*virtual */void CCZIReader::Open(std::shared_ptr<IStream> stream)
+{
+	this->Open(stream, nullptr);
+}
+
+/*virtual */void CCZIReader::Open(std::shared_ptr<IStream> stream, const libCZI::ICZIReader::OpenOptions* pOptions)
 {
 	if (this->isOperational == true)
 	{
@@ -48,13 +54,34 @@ CCZIReader::~CCZIReader()
 	}
 
 	this->hdrSegmentData = CCZIParse::ReadFileHeaderSegment(stream.get());
-	this->subBlkDir = std::move(CCZIParse::ReadSubBlockDirectory(stream.get(), this->hdrSegmentData.GetSubBlockDirectoryPosition()));
-	auto attachmentPos = this->hdrSegmentData.GetAttachmentDirectoryPosition();
-	if (attachmentPos != 0)
+	if (pOptions != nullptr)
 	{
-		// we should be operational without an attachment-directory as well I suppose.
-		// TODO: how to determine whether there is "no attachment-directory" - is the check for 0 sufficient?
-		this->attachmentDir = std::move(CCZIParse::ReadAttachmentsDirectory(stream.get(), attachmentPos));
+		this->openOptions = *pOptions;
+	}
+	else
+	{
+		this->openOptions.Clear();
+	}
+
+	// the sidecar-index can only be used if we are able to determine whether it is still up-to-date
+	this->useSidecarIndex = false;
+	if (!this->openOptions.sidecarIndexFilename.empty())
+	{
+		IStreamFileInfo* streamFileInfo = dynamic_cast<IStreamFileInfo*>(stream.get());
+		if (streamFileInfo != nullptr && streamFileInfo->TryGetFileInfo(&this->sidecarIndexKey.fileSize, &this->sidecarIndexKey.modificationTime) == true)
+		{
+			this->sidecarIndexKey.fileGuid = this->hdrSegmentData.GetFileGuid();
+			this->sidecarIndexKey.subBlockDirectoryPosition = this->hdrSegmentData.GetSubBlockDirectoryPosition();
+			this->sidecarIndexKey.attachmentDirectoryPosition = this->hdrSegmentData.GetAttachmentDirectoryPosition();
+			this->useSidecarIndex = true;
+		}
+	}
+
+	this->subBlkDirLoaded = false;
+	this->attachmentDirLoaded = false;
+	if (this->openOptions.lazyLoadDirectories == false)
+	{
+		this->LoadDirectories(stream.get(), true, true);
 	}
 
 	this->stream = stream;
@@ -70,59 +97,48 @@ CCZIReader::~CCZIReader()
 /*virtual*/SubBlockStatistics CCZIReader::GetStatistics()
 {
 	this->ThrowIfNotOperational();
-	SubBlockStatistics s = this->subBlkDir.GetStatistics();
+	SubBlockStatistics s = this->GetSubBlockDirectory().GetStatistics();
 	return s;
 }
 
 /*virtual*/libCZI::PyramidStatistics CCZIReader::GetPyramidStatistics()
 {
 	this->ThrowIfNotOperational();
-	return this->subBlkDir.GetPyramidStatistics();
+	return this->GetSubBlockDirectory().GetPyramidStatistics();
 }
 
 /*virtual*/void CCZIReader::EnumerateSubBlocks(std::function<bool(int index, const SubBlockInfo& info)> funcEnum)
 {
 	this->ThrowIfNotOperational();
-	this->subBlkDir.EnumSubBlocks(
+	this->GetSubBlockDirectory().EnumSubBlocks(
 		[&](int index, const CCziSubBlockDirectory::SubBlkEntry& entry)->bool
 	{
-		SubBlockInfo info;
-		info.mode = CziUtils::CompressionModeFromInt(entry.Compression);
-		info.pixelType = CziUtils::PixelTypeFromInt(entry.PixelType);
-		info.coordinate = entry.coordinate;
-		info.logicalRect = IntRect{ entry.x,entry.y,entry.width,entry.height };
-		info.physicalSize = IntSize{ std::uint32_t(entry.storedWidth), std::uint32_t(entry.storedHeight) };
-		info.mIndex = entry.mIndex;
-		return funcEnum(index, info);
+		return funcEnum(index, CCZIReader::SubBlockInfoFromSubBlockEntry(entry));
 	});
 }
 
+/*static*/SubBlockInfo CCZIReader::SubBlockInfoFromSubBlockEntry(const CCziSubBlockDirectory::SubBlkEntry& entry)
+{
+	SubBlockInfo info;
+	info.mode = CziUtils::CompressionModeFromInt(entry.Compression);
+	info.pixelType = CziUtils::PixelTypeFromInt(entry.PixelType);
+	info.coordinate = entry.coordinate;
+	info.logicalRect = IntRect{ entry.x,entry.y,entry.width,entry.height };
+	info.physicalSize = IntSize{ std::uint32_t(entry.storedWidth), std::uint32_t(entry.storedHeight) };
+	info.mIndex = entry.mIndex;
+	return info;
+}
+
 /*virtual*/void CCZIReader::EnumSubset(const IDimCoordinate* planeCoordinate, const IntRect* roi, bool onlyLayer0, std::function<bool(int index, const SubBlockInfo& info)> funcEnum)
 {
 	this->ThrowIfNotOperational();
 
-	// TODO:
-	// Ok... for a first tentative, experimental and quick-n-dirty implementation, simply
-	//      walk through all the subblocks. We surely want to have something more elaborated
-	//      here.
-	this->EnumerateSubBlocks(
-		[&](int index, const SubBlockInfo& info)->bool
+	// TODO: we only deal with layer 0 currently... or, more precisely, we do not take "zoom" into account at all
+	//        -> well... added that boolean "onlyLayer0" - is this sufficient...?
+	this->GetSubBlockDirectory().EnumSubset(planeCoordinate, roi, onlyLayer0,
+		[&](int index, const CCziSubBlockDirectory::SubBlkEntry& entry)->bool
 	{
-		// TODO: we only deal with layer 0 currently... or, more precisely, we do not take "zoom" into account at all
-		//        -> well... added that boolean "onlyLayer0" - is this sufficient...?
-		if (onlyLayer0 == false || (info.physicalSize.w == info.logicalRect.w && info.physicalSize.h == info.logicalRect.h))
-		{
-			if (planeCoordinate == nullptr || CziUtils::CompareCoordinate(planeCoordinate, &info.coordinate) == true)
-			{
-				if (roi == nullptr || Utilities::DoIntersect(*roi, info.logicalRect))
-				{
-					bool b = funcEnum(index, info);
-					return b;
-				}
-			}
-		}
-
-		return true;
+		return funcEnum(index, CCZIReader::SubBlockInfoFromSubBlockEntry(entry));
 	});
 }
 
@@ -130,7 +146,7 @@ CCZIReader::~CCZIReader()
 {
 	this->ThrowIfNotOperational();
 	CCziSubBlockDirectory::SubBlkEntry entry;
-	if (this->subBlkDir.TryGetSubBlock(index, entry) == false)
+	if (this->GetSubBlockDirectory().TryGetSubBlock(index, entry) == false)
 	{
 		return std::shared_ptr<ISubBlock>();
 	}
@@ -138,44 +154,67 @@ CCZIReader::~CCZIReader()
 	return this->ReadSubBlock(entry);
 }
 
+/*virtual*/std::vector<std::shared_ptr<ISubBlock>> CCZIReader::ReadSubBlocks(const std::vector<int>& indices)
+{
+	this->ThrowIfNotOperational();
+	CCziSubBlockDirectory& subBlockDirectory = this->GetSubBlockDirectory();
+	std::vector<std::uint64_t> filePositions;
+	filePositions.reserve(indices.size());
+	for (int index : indices)
+	{
+		CCziSubBlockDirectory::SubBlkEntry entry;
+		if (subBlockDirectory.TryGetSubBlock(index, entry) == true)
+		{
+			filePositions.push_back(entry.FilePosition);
+		}
+	}
+
+	CCZIParse::SubBlockStorageAllocate allocateInfo{ malloc,free };
+	auto subBlkData = CCZIParse::ReadSubBlocks(this->stream.get(), filePositions, allocateInfo);
+
+	std::vector<std::shared_ptr<ISubBlock>> subBlocks;
+	subBlocks.reserve(indices.size());
+	size_t n = 0;
+	for (int index : indices)
+	{
+		CCziSubBlockDirectory::SubBlkEntry entry;
+		if (subBlockDirectory.TryGetSubBlock(index, entry) == true)
+		{
+			subBlocks.push_back(CCZIReader::CreateSubBlock(subBlkData[n++]));
+		}
+		else
+		{
+			subBlocks.push_back(std::shared_ptr<ISubBlock>());
+		}
+	}
+
+	return subBlocks;
+}
+
 /*virtual*/bool CCZIReader::TryGetSubBlockInfoOfArbitrarySubBlockInChannel(int channelIndex, SubBlockInfo& info)
 {
 	this->ThrowIfNotOperational();
 
-	// TODO: we should be able to gather this information when constructing the subblock-list
-	//  for the time being... just walk through the whole list
-	//  
-	bool foundASubBlock = false;
-	SubBlockStatistics s = this->subBlkDir.GetStatistics();
+	int index;
+	SubBlockStatistics s = this->GetSubBlockDirectory().GetStatistics();
 	if (!s.dimBounds.IsValid(DimensionIndex::C))
 	{
 		// in this case -> just take the first subblock...
-		this->EnumerateSubBlocks(
-			[&](int index, const SubBlockInfo& sbinfo)->bool
-		{
-			info = sbinfo;
-			foundASubBlock = true;
-			return false;
-		});
+		index = 0;
 	}
-	else
+	else if (this->GetSubBlockDirectory().TryGetFirstSubBlockInChannel(channelIndex, &index) == false)
 	{
-		this->EnumerateSubBlocks(
-			[&](int index, const SubBlockInfo& sbinfo)->bool
-		{
-			int c;
-			if (sbinfo.coordinate.TryGetPosition(DimensionIndex::C, &c) == true && c == channelIndex)
-			{
-				info = sbinfo;
-				foundASubBlock = true;
-				return false;
-			}
+		return false;
+	}
 
-			return true;
-		});
+	CCziSubBlockDirectory::SubBlkEntry entry;
+	if (this->GetSubBlockDirectory().TryGetSubBlock(index, entry) == false)
+	{
+		return false;
 	}
 
-	return foundASubBlock;
+	info = CCZIReader::SubBlockInfoFromSubBlockEntry(entry);
+	return true;
 }
 
 /*virtual*/std::shared_ptr<libCZI::IAccessor> CCZIReader::CreateAccessor(libCZI::AccessorType accessorType)
@@ -196,7 +235,7 @@ CCZIReader::~CCZIReader()
 	this->ThrowIfNotOperational();
 	libCZI::AttachmentInfo ai;
 	ai.contentFileType[sizeof(ai.contentFileType) - 1] = '\0';
-	this->attachmentDir.EnumAttachments(
+	this->GetAttachmentsDirectory().EnumAttachments(
 		[&](int index, const CCziAttachmentsDirectory::AttachmentEntry& ae)
 	{
 		ai.contentGuid = ae.ContentGuid;
@@ -211,7 +250,7 @@ CCZIReader::~CCZIReader()
 	this->ThrowIfNotOperational();
 	libCZI::AttachmentInfo ai;
 	ai.contentFileType[sizeof(ai.contentFileType) - 1] = '\0';
-	this->attachmentDir.EnumAttachments(
+	this->GetAttachmentsDirectory().EnumAttachments(
 		[&](int index, const CCziAttachmentsDirectory::AttachmentEntry& ae)
 	{
 		if (contentFileType == nullptr || strcmp(contentFileType, ae.ContentFileType) == 0)
@@ -234,7 +273,7 @@ CCZIReader::~CCZIReader()
 {
 	this->ThrowIfNotOperational();
 	CCziAttachmentsDirectory::AttachmentEntry entry;
-	if (this->attachmentDir.TryGetAttachment(index, entry) == false)
+	if (this->GetAttachmentsDirectory().TryGetAttachment(index, entry) == false)
 	{
 		return std::shared_ptr<IAttachment>();
 	}
@@ -248,7 +287,11 @@ std::shared_ptr<ISubBlock> CCZIReader::ReadSubBlock(const CCziSubBlockDirectory:
 	CCZIParse::SubBlockStorageAllocate allocateInfo{ malloc,free };
 
 	auto subBlkData = CCZIParse::ReadSubBlock(this->stream.get(), entry.FilePosition, allocateInfo);
+	return CCZIReader::CreateSubBlock(subBlkData);
+}
 
+/*static*/std::shared_ptr<ISubBlock> CCZIReader::CreateSubBlock(const CCZIParse::SubBlockData& subBlkData)
+{
 	libCZI::SubBlockInfo info;
 	info.pixelType = CziUtils::PixelTypeFromInt(subBlkData.pixelType);
 	info.mode = CziUtils::CompressionModeFromInt(subBlkData.compression);
@@ -283,6 +326,100 @@ std::shared_ptr<libCZI::IMetadataSegment> CCZIReader::ReadMetadataSegment(std::u
 	return std::make_shared<CCziMetadataSegment>(metaDataSegmentData, free);
 }
 
+CCziSubBlockDirectory& CCZIReader::GetSubBlockDirectory()
+{
+	if (this->subBlkDirLoaded.load() == false)
+	{
+		std::lock_guard<std::mutex> lck(this->directoriesMutex);
+		this->LoadDirectories(this->stream.get(), true, false);
+	}
+
+	return this->subBlkDir;
+}
+
+CCziAttachmentsDirectory& CCZIReader::GetAttachmentsDirectory()
+{
+	if (this->attachmentDirLoaded.load() == false)
+	{
+		std::lock_guard<std::mutex> lck(this->directoriesMutex);
+		this->LoadDirectories(this->stream.get(), false, true);
+	}
+
+	return this->attachmentDir;
+}
+
+void CCZIReader::LoadDirectories(libCZI::IStream* stream, bool subBlockDirectory, bool attachmentDirectory)
+{
+	if (this->useSidecarIndex == true)
+	{
+		// the sidecar-index contains both directories, so they are always loaded together
+		if (this->subBlkDirLoaded.load() == true)
+		{
+			return;
+		}
+
+		if (CSidecarIndex::TryRead(this->openOptions.sidecarIndexFilename.c_str(), this->sidecarIndexKey, this->openOptions.useCompactSubBlockDirectory, this->subBlkDir, this->attachmentDir) == false)
+		{
+			this->ReadSubBlockDirectory(stream);
+			this->ReadAttachmentsDirectory(stream);
+			try
+			{
+				CSidecarIndex::Write(this->openOptions.sidecarIndexFilename.c_str(), this->sidecarIndexKey, this->subBlkDir, this->attachmentDir);
+			}
+			catch (const std::exception&)
+			{
+				// failing to write the sidecar-index is not an error, it only means that we have to parse again next time
+			}
+		}
+
+		this->attachmentDirLoaded = true;
+		this->subBlkDirLoaded = true;
+		return;
+	}
+
+	if (subBlockDirectory == true && this->subBlkDirLoaded.load() == false)
+	{
+		this->ReadSubBlockDirectory(stream);
+		this->subBlkDirLoaded = true;
+	}
+
+	if (attachmentDirectory == true && this->attachmentDirLoaded.load() == false)
+	{
+		this->ReadAttachmentsDirectory(stream);
+		this->attachmentDirLoaded = true;
+	}
+}
+
+void CCZIReader::ReadSubBlockDirectory(libCZI::IStream* stream)
+{
+	if (this->openOptions.useCompactSubBlockDirectory == true)
+	{
+		CCziSubBlockDirectory compactSubBlkDir(true);
+		CCZIParse::ReadSubBlockDirectory(stream, this->hdrSegmentData.GetSubBlockDirectoryPosition(), compactSubBlkDir);
+		compactSubBlkDir.AddingFinished();
+		this->subBlkDir = std::move(compactSubBlkDir);
+	}
+	else
+	{
+		this->subBlkDir = std::move(CCZIParse::ReadSubBlockDirectory(stream, this->hdrSegmentData.GetSubBlockDirectoryPosition()));
+	}
+}
+
+void CCZIReader::ReadAttachmentsDirectory(libCZI::IStream* stream)
+{
+	auto attachmentPos = this->hdrSegmentData.GetAttachmentDirectoryPosition();
+	if (attachmentPos != 0)
+	{
+		// we should be operational without an attachment-directory as well I suppose.
+		// TODO: how to determine whether there is "no attachment-directory" - is the check for 0 sufficient?
+		this->attachmentDir = std::move(CCZIParse::ReadAttachmentsDirectory(stream, attachmentPos));
+	}
+	else
+	{
+		this->attachmentDir = CCziAttachmentsDirectory();
+	}
+}
+
 void CCZIReader::ThrowIfNotOperational()
 {
 	if (this->isOperational == false)
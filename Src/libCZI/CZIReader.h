@@ -23,10 +23,14 @@
 #pragma once
 
 #include <functional>
+#include <mutex>
+#include <atomic>
 #include "libCZI.h"
 #include "CziSubBlockDirectory.h"
 #include "CziAttachmentsDirectory.h"
 #include "CziDataStructs.h"
+#include "CziParse.h"
+#include "SidecarIndex.h"
 
 class CCZIReader : public libCZI::ICZIReader, public std::enable_shared_from_this<CCZIReader>
 {
@@ -36,6 +40,12 @@ private:
 	CCziSubBlockDirectory subBlkDir;
 	CCziAttachmentsDirectory attachmentDir;
 	bool	isOperational;	///<	If true, then stream, hdrSegmentData and subBlkDir can be considered valid and operational
+	libCZI::ICZIReader::OpenOptions openOptions;
+	bool	useSidecarIndex;
+	CSidecarIndex::Key sidecarIndexKey;
+	std::mutex directoriesMutex;					///< Protects the loading of the directories (if they are loaded lazily).
+	std::atomic<bool> subBlkDirLoaded;				///< True if subBlkDir has been loaded.
+	std::atomic<bool> attachmentDirLoaded;			///< True if attachmentDir has been loaded.
 public:
 	CCZIReader();
 	~CCZIReader() override;
@@ -44,12 +54,14 @@ public:
 	void EnumerateSubBlocks(std::function<bool(int index, const libCZI::SubBlockInfo& info)> funcEnum) override;
 	void EnumSubset(const libCZI::IDimCoordinate* planeCoordinate, const libCZI::IntRect* roi, bool onlyLayer0, std::function<bool(int index, const libCZI::SubBlockInfo& info)> funcEnum) override;
 	std::shared_ptr<libCZI::ISubBlock> ReadSubBlock(int index) override;
+	std::vector<std::shared_ptr<libCZI::ISubBlock>> ReadSubBlocks(const std::vector<int>& indices) override;
 	bool TryGetSubBlockInfoOfArbitrarySubBlockInChannel(int channelIndex, libCZI::SubBlockInfo& info) override;
 	libCZI::SubBlockStatistics GetStatistics() override;
 	libCZI::PyramidStatistics GetPyramidStatistics() override;
 	
 	// interface ICZIReader
 	void Open(std::shared_ptr<libCZI::IStream> stream) override;
+	void Open(std::shared_ptr<libCZI::IStream> stream, const libCZI::ICZIReader::OpenOptions* pOptions) override;
 	std::shared_ptr<libCZI::IMetadataSegment> ReadMetadataSegment() override;
 	std::shared_ptr<libCZI::IAccessor> CreateAccessor(libCZI::AccessorType accessorType) override;
 	void Close() override;
@@ -61,9 +73,23 @@ public:
 
 private:
 	std::shared_ptr<libCZI::ISubBlock> ReadSubBlock(const CCziSubBlockDirectory::SubBlkEntry& entry);
+	static std::shared_ptr<libCZI::ISubBlock> CreateSubBlock(const CCZIParse::SubBlockData& subBlkData);
+	static libCZI::SubBlockInfo SubBlockInfoFromSubBlockEntry(const CCziSubBlockDirectory::SubBlkEntry& entry);
 	std::shared_ptr<libCZI::IAttachment> ReadAttachment(const CCziAttachmentsDirectory::AttachmentEntry& entry);
 	std::shared_ptr<libCZI::IMetadataSegment> ReadMetadataSegment(std::uint64_t position);
 
+	/// Gets the sub-block directory, it is loaded if this has not yet been done.
+	CCziSubBlockDirectory& GetSubBlockDirectory();
+
+	/// Gets the attachments directory, it is loaded if this has not yet been done.
+	CCziAttachmentsDirectory& GetAttachmentsDirectory();
+
+	/// Loads the specified directories (if not already loaded). If a sidecar-index is used, then both directories
+	/// are loaded. If called after Open, directoriesMutex must be held.
+	void LoadDirectories(libCZI::IStream* stream, bool subBlockDirectory, bool attachmentDirectory);
+	void ReadSubBlockDirectory(libCZI::IStream* stream);
+	void ReadAttachmentsDirectory(libCZI::IStream* stream);
+
 	void ThrowIfNotOperational();
 	void SetOperationalState(bool operational);
 };
@@ -21,9 +21,12 @@
 //******************************************************************************
 
 #include "stdafx.h"
+#include "CreateBitmap.h"
 #include "bitmapData.h"
+#include "CziSubBlock.h"
 #include "Site.h"
 #include "libCZI.h"
+#include "utilities.h"
 
 using namespace libCZI;
 
@@ -35,6 +38,56 @@ static std::shared_ptr<libCZI::IBitmapData> CreateBitmapFromSubBlock_JpgXr(ISubB
 	return dec->Decode(ptr, size);
 }
 
+static std::shared_ptr<libCZI::IBitmapData> CreateBitmapFromSubBlock_JpgXr(ISubBlock* subBlk, const IntRect& roi)
+{
+	auto dec = GetSite()->GetDecoder(ImageDecoderType::JPXR_JxrLib, nullptr);
+	const void* ptr; size_t size;
+	subBlk->DangerousGetRawData(ISubBlock::MemBlkType::Data, ptr, size);
+	return dec->Decode(ptr, size, roi);
+}
+
+static bool IsSubBlockDataReadOnly(ISubBlock* subBlk)
+{
+	// only the sub-blocks created by libCZI may refer to a read-only view into the stream
+	const CCziSubBlock* cziSubBlk = dynamic_cast<const CCziSubBlock*>(subBlk);
+	return cziSubBlk != nullptr && cziSubBlk->IsDataReadOnly();
+}
+
+static std::shared_ptr<libCZI::IBitmapData> CopyBitmapFromSubBlock_Uncompressed(ISubBlock* subBlk, const IntRect& roi)
+{
+	const void* ptr; size_t size;
+	subBlk->DangerousGetRawData(ISubBlock::MemBlkType::Data, ptr, size);
+	const auto& sbInfo = subBlk->GetSubBlockInfo();
+	const std::uint8_t bytesPerPel = CziUtils::GetBytesPerPel(sbInfo.pixelType);
+	const std::uint32_t stride = sbInfo.physicalSize.w * bytesPerPel;
+
+	auto bm = GetSite()->CreateBitmap(sbInfo.pixelType, roi.w, roi.h);
+	ScopedBitmapLockerSP lck{ bm };
+	for (int y = 0; y < roi.h; ++y)
+	{
+		memcpy(
+			((char*)lck.ptrDataRoi) + y * ((std::ptrdiff_t)lck.stride),
+			((const char*)ptr) + (roi.y + y) * ((std::ptrdiff_t)stride) + roi.x * bytesPerPel,
+			roi.w * bytesPerPel);
+	}
+
+	return bm;
+}
+
+static std::shared_ptr<libCZI::IBitmapData> CreateBitmapFromSubBlock_Uncompressed(ISubBlock* subBlk, const IntRect& roi)
+{
+	size_t size;
+	auto spData = subBlk->GetRawData(ISubBlock::MemBlkType::Data, &size);
+	const auto& sbInfo = subBlk->GetSubBlockInfo();
+	std::uint32_t stride = sbInfo.physicalSize.w * CziUtils::GetBytesPerPel(sbInfo.pixelType);
+
+	// the bitmap refers to the region within the data of the sub-block, so no copy is made here
+	CSharedPtrAllocator sharedPtrAllocator(std::shared_ptr<const void>(
+		spData,
+		((const char*)spData.get()) + roi.y * ((std::ptrdiff_t)stride) + roi.x * CziUtils::GetBytesPerPel(sbInfo.pixelType)));
+	return CBitmapData<CSharedPtrAllocator>::Create(sharedPtrAllocator, sbInfo.pixelType, roi.w, roi.h, stride);
+}
+
 static std::shared_ptr<libCZI::IBitmapData> CreateBitmapFromSubBlock_Uncompressed(ISubBlock* subBlk)
 {
 	size_t size;
@@ -59,8 +112,59 @@ std::shared_ptr<libCZI::IBitmapData> libCZI::CreateBitmapFromSubBlock(ISubBlock*
 	case CompressionMode::JpgXr:
 		return CreateBitmapFromSubBlock_JpgXr(subBlk);
 	case CompressionMode::UnCompressed:
+		if (IsSubBlockDataReadOnly(subBlk))
+		{
+			// the caller may modify the bitmap, so we must not give out a bitmap referring to a read-only view
+			return CopyBitmapFromSubBlock_Uncompressed(subBlk, IntRect{ 0, 0, (int)sbInfo.physicalSize.w, (int)sbInfo.physicalSize.h });
+		}
+
 		return CreateBitmapFromSubBlock_Uncompressed(subBlk);
 	default:	// silence warnings
 		throw std::logic_error("The method or operation is not implemented.");
 	}
 }
+
+std::shared_ptr<libCZI::IBitmapData> libCZI::CreateBitmapFromSubBlock(ISubBlock* subBlk, const IntRect& roi)
+{
+	auto sbInfo = subBlk->GetSubBlockInfo();
+	if (!Utilities::IsNonEmptyAndInside(roi, sbInfo.physicalSize))
+	{
+		throw std::invalid_argument("The ROI must be non-empty and must lie within the sub-block.");
+	}
+
+	switch (sbInfo.mode)
+	{
+	case CompressionMode::JpgXr:
+		return CreateBitmapFromSubBlock_JpgXr(subBlk, roi);
+	case CompressionMode::UnCompressed:
+		if (IsSubBlockDataReadOnly(subBlk))
+		{
+			return CopyBitmapFromSubBlock_Uncompressed(subBlk, roi);
+		}
+
+		return CreateBitmapFromSubBlock_Uncompressed(subBlk, roi);
+	default:	// silence warnings
+		throw std::logic_error("The method or operation is not implemented.");
+	}
+}
+
+std::shared_ptr<libCZI::IBitmapData> CreateBitmapFromSubBlockForReading(libCZI::ISubBlock* subBlk, const libCZI::IntRect* roi)
+{
+	const auto& sbInfo = subBlk->GetSubBlockInfo();
+	if (sbInfo.mode != CompressionMode::UnCompressed || !IsSubBlockDataReadOnly(subBlk))
+	{
+		return roi != nullptr ? libCZI::CreateBitmapFromSubBlock(subBlk, *roi) : subBlk->CreateBitmap();
+	}
+
+	if (roi == nullptr)
+	{
+		return CreateBitmapFromSubBlock_Uncompressed(subBlk);
+	}
+
+	if (!Utilities::IsNonEmptyAndInside(*roi, sbInfo.physicalSize))
+	{
+		throw std::invalid_argument("The ROI must be non-empty and must lie within the sub-block.");
+	}
+
+	return CreateBitmapFromSubBlock_Uncompressed(subBlk, *roi);
+}
@@ -0,0 +1,33 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#pragma once
+#include "libCZI.h"
+
+/// Creates a bitmap from the sub-block (or from the specified region of it), which is only going to be read from - as
+/// it is done by the accessors. Other than with libCZI::CreateBitmapFromSubBlock, the bitmap of an uncompressed sub-block
+/// then refers to the data of the sub-block even if this is a read-only view into the stream (e.g. of a memory-mapped
+/// file), so the data is not copied.
+/// \param [in] subBlk The sub-block.
+/// \param roi		   If non-null, the region (in pixels of the stored bitmap) to create the bitmap from.
+/// \return The bitmap (whose pixels must not be modified).
+std::shared_ptr<libCZI::IBitmapData> CreateBitmapFromSubBlockForReading(libCZI::ISubBlock* subBlk, const libCZI::IntRect* roi);
@@ -22,6 +22,7 @@
 
 #include "stdafx.h"
 #include "CziAttachmentsDirectory.h"
+#include "SidecarIndex.h"
 
 void CCziAttachmentsDirectory::AddAttachmentEntry(const AttachmentEntry& entry)
 {
@@ -52,4 +53,14 @@ bool CCziAttachmentsDirectory::TryGetAttachment(int index, AttachmentEntry& entr
 	}
 
 	return false;
+}
+
+void CCziAttachmentsDirectory::Serialize(CSidecarIndexWriter& writer) const
+{
+	writer.WriteVector(this->attachmentEntries);
+}
+
+void CCziAttachmentsDirectory::Deserialize(CSidecarIndexReader& reader)
+{
+	reader.ReadVector(this->attachmentEntries);
 }
\ No newline at end of file
@@ -23,6 +23,9 @@
 #pragma once
 #include <functional>
 
+class CSidecarIndexWriter;
+class CSidecarIndexReader;
+
 class CCziAttachmentsDirectory
 {
 public:
@@ -45,4 +48,10 @@ public:
 	void AddAttachmentEntry(const AttachmentEntry& entry);
 	void EnumAttachments(std::function<bool(int index, const CCziAttachmentsDirectory::AttachmentEntry&)> func);
 	bool TryGetAttachment(int index, AttachmentEntry& entry);
+
+	/// Serializes the attachment-entries (for the sidecar-index).
+	void Serialize(CSidecarIndexWriter& writer) const;
+
+	/// Replaces the attachment-entries with the ones de-serialized from the sidecar-index.
+	void Deserialize(CSidecarIndexReader& reader);
 };
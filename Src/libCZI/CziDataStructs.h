@@ -36,6 +36,7 @@ public:
 	CFileHeaderSegmentData()
 		:verMajor(-1),
 		 verMinor(-1), 
+		 fileGuid(),
 		 subBlockDirectoryPosition((std::numeric_limits<decltype(subBlockDirectoryPosition)>::max)()), 
 		 attachmentDirectoryPosition((std::numeric_limits<decltype(subBlockDirectoryPosition)>::max)()),
 		 metadataPosition((std::numeric_limits<decltype(subBlockDirectoryPosition)>::max)())
@@ -44,6 +45,7 @@ public:
 	CFileHeaderSegmentData(const FileHeaderSegmentData* hdrSegmentData) :
 		verMajor(hdrSegmentData->Major),
 		verMinor(hdrSegmentData->Minor),
+		fileGuid(hdrSegmentData->FileGuid),
 		subBlockDirectoryPosition(hdrSegmentData->SubBlockDirectoryPosition),
 		attachmentDirectoryPosition(hdrSegmentData->AttachmentDirectoryPosition),
 		metadataPosition(hdrSegmentData->MetadataPosition)
@@ -55,6 +57,7 @@ public:
 		if (ptrMinor != nullptr) { *ptrMinor = this->verMinor; }
 	}
 
+	const GUID& GetFileGuid() const { return this->fileGuid; }
 	std::uint64_t GetSubBlockDirectoryPosition() const { return this->subBlockDirectoryPosition; }
 	std::uint64_t GetAttachmentDirectoryPosition() const { return this->attachmentDirectoryPosition; }
 	std::uint64_t  GetMetadataPosition() const { return this->metadataPosition; }
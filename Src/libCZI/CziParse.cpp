@@ -23,6 +23,10 @@
 #include "stdafx.h"
 #include "CziParse.h"
 #include <assert.h>
+#include <algorithm>
+#include <thread>
+#include <exception>
+#include <cstddef>
 #include "Site.h"
 
 using namespace std;
@@ -127,32 +131,67 @@ using namespace libCZI;
 		CCZIParse::ThrowNotEnoughDataRead(offset + sizeof(subBlckDirSegment), subBlkDirSize, bytesRead);
 	}
 
-	int currentOffset = 0;
-	CCZIParse::ParseThroughDirectoryEntries(
-		subBlckDirSegment.data.EntryCount,
-		[&](int numberOfBytes, void* ptr)->void
+	// first pass: determine where the entries start (the size of a DV-entry depends on its dimension-count)
+	const std::uint8_t* ptrEntries = static_cast<const std::uint8_t*>(pBuffer.get());
+	std::vector<std::uint64_t> entryOffsets;
+	CCZIParse::FindDirectoryEntries(ptrEntries, subBlkDirSize, subBlckDirSegment.data.EntryCount, offset + sizeof(subBlckDirSegment), entryOffsets);
+
+	// second pass: parse the entries - for a large directory this is done on multiple threads, where each thread
+	//  fills a directory of its own which are then merged in order
+	size_t threadCount = entryOffsets.size() / SUBBLKDIRENTRIESPERTHREAD;
+	threadCount = (std::min)(threadCount, (size_t)(std::max)(std::thread::hardware_concurrency(), 1u));
+	if (threadCount <= 1)
 	{
-		if (currentOffset + numberOfBytes <= subBlkDirSize)
-		{
-			memcpy(ptr, ((char*)pBuffer.get()) + currentOffset, numberOfBytes);
-			currentOffset += numberOfBytes;
-		}
-		else
-		{
-			CCZIParse::ThrowIllegalData(offset + sizeof(subBlckDirSegment) + currentOffset, "SubBlockDirectory data too small");
-		}
-	},
-		[&](const SubBlockDirectoryEntryDE* subBlkDirDE, const SubBlockDirectoryEntryDV* subBlkDirDV)->void
+		CCZIParse::AddDirectoryEntries(ptrEntries, entryOffsets, 0, entryOffsets.size(), subBlkDir);
+		return;
+	}
+
+	// the number of entries per thread is a multiple of the chunk-size of the compact representation, so that the
+	//  chunks of the partial directories can be taken over when merging
+	size_t entriesPerThread = (entryOffsets.size() + threadCount - 1) / threadCount;
+	entriesPerThread = (entriesPerThread + CCziSubBlockDirectory::COMPACTCHUNKSIZE - 1) / CCziSubBlockDirectory::COMPACTCHUNKSIZE * CCziSubBlockDirectory::COMPACTCHUNKSIZE;
+	threadCount = (entryOffsets.size() + entriesPerThread - 1) / entriesPerThread;
+
+	std::vector<CCziSubBlockDirectory> partialDirectories;
+	partialDirectories.reserve(threadCount);
+	for (size_t t = 0; t < threadCount; ++t)
+	{
+		partialDirectories.emplace_back(subBlkDir.GetUseCompactRepresentation());
+	}
+
+	std::vector<std::exception_ptr> exceptions(threadCount);
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < threadCount; ++t)
 	{
-		if (subBlkDirDE != nullptr)
+		threads.emplace_back(
+			[&, t]()->void
 		{
-			CCZIParse::AddEntryToSubBlockDirectory(subBlkDirDE, subBlkDir);
-		}
-		else if (subBlkDirDV != nullptr)
+			try
+			{
+				const size_t start = t * entriesPerThread;
+				CCZIParse::AddDirectoryEntries(ptrEntries, entryOffsets, start, (std::min)(start + entriesPerThread, entryOffsets.size()), partialDirectories[t]);
+			}
+			catch (...)
+			{
+				exceptions[t] = std::current_exception();
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	for (size_t t = 0; t < threadCount; ++t)
+	{
+		if (exceptions[t])
 		{
-			CCZIParse::AddEntryToSubBlockDirectory(subBlkDirDV, subBlkDir);
+			std::rethrow_exception(exceptions[t]);
 		}
-	});
+
+		subBlkDir.AddSubBlocks(std::move(partialDirectories[t]));
+	}
 }
 
 /*static*/CCziAttachmentsDirectory CCZIParse::ReadAttachmentsDirectory(libCZI::IStream* str, std::uint64_t offset)
@@ -223,24 +262,8 @@ using namespace libCZI;
 	return attDir;
 }
 
-/*static*/CCZIParse::SubBlockData CCZIParse::ReadSubBlock(libCZI::IStream* str, std::uint64_t offset, const SubBlockStorageAllocate& allocateInfo)
+/*static*/CCZIParse::SubBlockData CCZIParse::ParseSubBlockSegment(std::uint64_t offset, const SubBlockSegment& subBlckSegment)
 {
-	SubBlockSegment subBlckSegment;
-	std::uint64_t bytesRead;
-	try
-	{
-		str->Read(offset, &subBlckSegment, sizeof(subBlckSegment), &bytesRead);
-	}
-	catch (const std::exception&)
-	{
-		std::throw_with_nested(LibCZIIOException("Error reading SubBlock-Segment", offset, sizeof(subBlckSegment)));
-	}
-
-	if (bytesRead != sizeof(subBlckSegment))
-	{
-		CCZIParse::ThrowNotEnoughDataRead(offset, sizeof(subBlckSegment), bytesRead);
-	}
-
 	if (memcmp(subBlckSegment.header.Id, CCZIParse::SUBBLKMAGIC, 16) != 0)
 	{
 		CCZIParse::ThrowIllegalData(offset, "Invalid SubBlockk-magic");
@@ -289,72 +312,311 @@ using namespace libCZI;
 		CCZIParse::ThrowIllegalData(offset, "Invalid schema");
 	}
 
-	// TODO: if subBlckSegment.data.DataSize > size_t (=4GB for 32Bit) then bail out gracefully
-	auto deleter = [&](void* ptr) -> void {allocateInfo.free(ptr); };
-	std::unique_ptr<void, decltype(deleter)> pMetadataBuffer(subBlckSegment.data.MetadataSize > 0 ? allocateInfo.alloc(subBlckSegment.data.MetadataSize) : nullptr, deleter);
-	std::unique_ptr<void, decltype(deleter)> pDataBuffer(subBlckSegment.data.DataSize > 0 ? allocateInfo.alloc((size_t)subBlckSegment.data.DataSize) : nullptr, deleter);
-	std::unique_ptr<void, decltype(deleter)> pAttachmentBuffer(subBlckSegment.data.AttachmentSize > 0 ? allocateInfo.alloc(subBlckSegment.data.AttachmentSize) : nullptr, deleter);
+	return sbd;
+}
 
-	// TODO: now get the information from the SubBlockDirectoryEntryDV/DE structure, and figure out their size
-	// TODO: compare this information against the information from the SubBlock-directory
-	if (pMetadataBuffer)
+/*static*/CCZIParse::SubBlockData CCZIParse::ReadSubBlock(libCZI::IStream* str, std::uint64_t offset, const SubBlockStorageAllocate& allocateInfo)
+{
+	// Unless the stream gives us direct access to the data, we read more than just the segment-header - in
+	//  the hope that the complete segment is contained, so that we get away with a single round-trip. Otherwise,
+	//  the remaining part of the segment is read with a second call.
+	const bool isDirectAccess = dynamic_cast<libCZI::IStreamDirectAccess*>(str) != nullptr;
+	std::vector<std::uint8_t> buffer(isDirectAccess ? sizeof(SubBlockSegment) : (std::max)(sizeof(SubBlockSegment), (size_t)CCZIParse::SUBBLKSPECULATIVEREADSIZE));
+	std::uint64_t bytesRead;
+	try
 	{
-		try
+		str->Read(offset, &buffer[0], buffer.size(), &bytesRead);
+	}
+	catch (const std::exception&)
+	{
+		std::throw_with_nested(LibCZIIOException("Error reading SubBlock-Segment", offset, buffer.size()));
+	}
+
+	if (bytesRead < sizeof(SubBlockSegment))
+	{
+		CCZIParse::ThrowNotEnoughDataRead(offset, sizeof(SubBlockSegment), bytesRead);
+	}
+
+	SubBlockSegment subBlckSegment;
+	memcpy(&subBlckSegment, &buffer[0], sizeof(subBlckSegment));
+	SubBlockData sbd = CCZIParse::ParseSubBlockSegment(offset, subBlckSegment);
+
+	if (CCZIParse::TrySetSubBlockDataFromView(str, offset, subBlckSegment, sbd))
+	{
+		// the stream gave us a view of the data, so we do not need to copy anything
+		return sbd;
+	}
+
+	// TODO: if subBlckSegment.data.DataSize > size_t (=4GB for 32Bit) then bail out gracefully
+	const std::uint64_t payloadSize = CCZIParse::GetSubBlockPayloadSize(offset, subBlckSegment);
+	if (payloadSize > 0)
+	{
+		// the buffer is owned by a shared_ptr from the start, so that it is not leaked if anything below throws
+		auto freeFunc = allocateInfo.free;
+		std::shared_ptr<const void> spPayload(allocateInfo.alloc((size_t)payloadSize), [freeFunc](const void* ptr)->void {freeFunc(const_cast<void*>(ptr)); });
+		void* pPayloadBuffer = const_cast<void*>(spPayload.get());
+
+		// copy what we already got with the first read, and read the rest (if any)
+		const std::uint64_t payloadOffset = offset + sizeof(SegmentHeader) + 256;
+		std::uint64_t payloadAlreadyRead = bytesRead > sizeof(SegmentHeader) + 256 ? (std::min)(bytesRead - (sizeof(SegmentHeader) + 256), payloadSize) : 0;
+		memcpy(pPayloadBuffer, buffer.data() + sizeof(SegmentHeader) + 256, (size_t)payloadAlreadyRead);
+		if (payloadAlreadyRead < payloadSize)
 		{
-			str->Read(offset + 256 + sizeof(SegmentHeader), pMetadataBuffer.get(), subBlckSegment.data.MetadataSize, &bytesRead);
+			try
+			{
+				str->Read(payloadOffset + payloadAlreadyRead, static_cast<char*>(pPayloadBuffer) + payloadAlreadyRead, payloadSize - payloadAlreadyRead, &bytesRead);
+			}
+			catch (const std::exception&)
+			{
+				std::throw_with_nested(LibCZIIOException("Error reading SubBlock-Segment", payloadOffset + payloadAlreadyRead, payloadSize - payloadAlreadyRead));
+			}
+
+			if (bytesRead != payloadSize - payloadAlreadyRead)
+			{
+				CCZIParse::ThrowNotEnoughDataRead(payloadOffset + payloadAlreadyRead, payloadSize - payloadAlreadyRead, bytesRead);
+			}
 		}
-		catch (const std::exception&)
+
+		CCZIParse::SetSubBlockDataFromPayload(subBlckSegment, pPayloadBuffer, sbd);
+		sbd.spPayload = std::move(spPayload);
+	}
+	else
+	{
+		CCZIParse::SetSubBlockDataFromPayload(subBlckSegment, nullptr, sbd);
+	}
+
+	return sbd;
+}
+
+/*static*/std::uint64_t CCZIParse::GetSubBlockPayloadSize(std::uint64_t offset, const SubBlockSegment& subBlckSegment)
+{
+	if (subBlckSegment.data.MetadataSize < 0 || subBlckSegment.data.AttachmentSize < 0 || subBlckSegment.data.DataSize < 0)
+	{
+		CCZIParse::ThrowIllegalData(offset, "Invalid SubBlock-size");
+	}
+
+	std::uint64_t payloadSize = (std::uint64_t)subBlckSegment.data.MetadataSize + subBlckSegment.data.DataSize + subBlckSegment.data.AttachmentSize;
+
+	// the segment must be large enough to hold metadata, data and attachment
+	std::uint64_t usedSize = subBlckSegment.header.UsedSize;
+	if (usedSize == 0)
+	{
+		// allegedly, "UsedSize" may not be valid in early versions
+		usedSize = subBlckSegment.header.AllocatedSize;
+	}
+
+	if (usedSize < 256 + payloadSize)
+	{
+		CCZIParse::ThrowIllegalData(offset, "Invalid SubBlock-Segment-Size");
+	}
+
+	return payloadSize;
+}
+
+/*static*/void CCZIParse::SetSubBlockDataFromPayload(const SubBlockSegment& subBlckSegment, void* ptrPayload, SubBlockData& sbd)
+{
+	// the payload is laid out as: metadata, data, attachment
+	char* ptr = static_cast<char*>(ptrPayload);
+	sbd.ptrMetadata = subBlckSegment.data.MetadataSize > 0 ? ptr : nullptr;
+	sbd.metaDataSize = subBlckSegment.data.MetadataSize;
+	sbd.ptrData = subBlckSegment.data.DataSize > 0 ? ptr + subBlckSegment.data.MetadataSize : nullptr;
+	sbd.dataSize = subBlckSegment.data.DataSize;
+	sbd.ptrAttachment = subBlckSegment.data.AttachmentSize > 0 ? ptr + subBlckSegment.data.MetadataSize + subBlckSegment.data.DataSize : nullptr;
+	sbd.attachmentSize = subBlckSegment.data.AttachmentSize;
+	sbd.payloadIsReadOnly = false;
+}
+
+/*static*/bool CCZIParse::TrySetSubBlockDataFromView(libCZI::IStream* str, std::uint64_t offset, const SubBlockSegment& subBlckSegment, SubBlockData& sbd)
+{
+	libCZI::IStreamDirectAccess* directAccess = dynamic_cast<libCZI::IStreamDirectAccess*>(str);
+	if (directAccess == nullptr)
+	{
+		return false;
+	}
+
+	auto spView = directAccess->TryGetView(offset + 256 + sizeof(SegmentHeader), CCZIParse::GetSubBlockPayloadSize(offset, subBlckSegment));
+	if (!spView)
+	{
+		return false;
+	}
+
+	CCZIParse::SetSubBlockDataFromPayload(subBlckSegment, const_cast<void*>(spView.get()), sbd);
+	sbd.spPayload = std::move(spView);
+	sbd.payloadIsReadOnly = true;
+	return true;
+}
+
+/*static*/std::vector<CCZIParse::SubBlockData> CCZIParse::ReadSubBlocks(libCZI::IStream* str, const std::vector<std::uint64_t>& offsets, const SubBlockStorageAllocate& allocateInfo)
+{
+	// the sub-blocks are read in the order of their position in the file (which is usually not the order in which they are requested)
+	std::vector<size_t> fileOrder(offsets.size());
+	for (size_t i = 0; i < fileOrder.size(); ++i)
+	{
+		fileOrder[i] = i;
+	}
+
+	std::stable_sort(fileOrder.begin(), fileOrder.end(), [&](size_t a, size_t b)->bool {return offsets[a] < offsets[b]; });
+
+	// first pass: read the segment-headers of all sub-blocks - if the stream gives us direct access to the data, we do not read
+	//  more than the segment-headers (as we can get a view of the payload), otherwise the payload in between is read as well
+	//  if the sub-blocks are small
+	const bool isDirectAccess = dynamic_cast<libCZI::IStreamDirectAccess*>(str) != nullptr;
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges;
+	ranges.reserve(offsets.size());
+	for (size_t i : fileOrder)
+	{
+		ranges.emplace_back(offsets[i], sizeof(SubBlockSegment));
+	}
+
+	const auto headerReads = CCZIParse::ReadCoalesced(str, ranges, isDirectAccess ? 0 : CCZIParse::SUBBLKCOALESCEMAXGAP, allocateInfo, "Error reading SubBlock-Segment");
+
+	std::vector<SubBlockSegment> segments(offsets.size());
+	std::vector<SubBlockData> subBlocks(offsets.size());
+	for (size_t n = 0; n < fileOrder.size(); ++n)
+	{
+		const size_t i = fileOrder[n];
+		memcpy(&segments[i], headerReads[n].GetPointer(offsets[i]), sizeof(SubBlockSegment));
+		subBlocks[i] = CCZIParse::ParseSubBlockSegment(offsets[i], segments[i]);
+	}
+
+	// second pass: read the payload (metadata, data and attachment) of all sub-blocks (where we cannot get a view of them, and
+	//  where it was not contained in the first pass)
+	ranges.clear();
+	std::vector<size_t> subBlocksToRead;
+	for (size_t n = 0; n < fileOrder.size(); ++n)
+	{
+		const size_t i = fileOrder[n];
+		const SubBlockSegment& subBlckSegment = segments[i];
+		if (CCZIParse::TrySetSubBlockDataFromView(str, offsets[i], subBlckSegment, subBlocks[i]))
 		{
-			std::throw_with_nested(LibCZIIOException("Error reading FileHeaderSegement", offset + 256 + sizeof(SegmentHeader), subBlckSegment.data.MetadataSize));
+			continue;
 		}
 
-		if (bytesRead != subBlckSegment.data.MetadataSize)
+		const std::uint64_t payloadOffset = offsets[i] + sizeof(SegmentHeader) + 256;
+		const std::uint64_t payloadSize = CCZIParse::GetSubBlockPayloadSize(offsets[i], subBlckSegment);
+		if (payloadSize == 0)
 		{
-			CCZIParse::ThrowNotEnoughDataRead(offset + 256 + sizeof(SegmentHeader), subBlckSegment.data.MetadataSize, bytesRead);
+			CCZIParse::SetSubBlockDataFromPayload(subBlckSegment, nullptr, subBlocks[i]);
 		}
-	}
-
-	if (pDataBuffer)
-	{
-		try
+		else if (headerReads[n].Contains(payloadOffset, payloadSize))
 		{
-			str->Read(offset + 256 + sizeof(SegmentHeader) + subBlckSegment.data.MetadataSize, pDataBuffer.get(), subBlckSegment.data.DataSize, &bytesRead);
+			CCZIParse::SetSubBlockDataFromCoalescedRead(subBlckSegment, headerReads[n], payloadOffset, payloadSize, allocateInfo, subBlocks[i]);
 		}
-		catch (const std::exception&)
+		else
 		{
-			std::throw_with_nested(LibCZIIOException("Error reading FileHeaderSegement", offset + 256 + sizeof(SegmentHeader) + subBlckSegment.data.MetadataSize, subBlckSegment.data.DataSize));
+			ranges.emplace_back(payloadOffset, payloadSize);
+			subBlocksToRead.push_back(i);
 		}
+	}
+
+	// if the stream processes batches itself (e.g. with vectored I/O), we leave it to the stream to combine the reads - so
+	//  that each sub-block gets a buffer of its own, and the payload does not have to be copied
+	const bool isBatch = dynamic_cast<libCZI::IStreamBatch*>(str) != nullptr;
+	const auto payloadReads = CCZIParse::ReadCoalesced(str, ranges, isBatch ? 0 : CCZIParse::SUBBLKCOALESCEMAXGAP, allocateInfo, "Error reading SubBlock-Segment");
+	for (size_t n = 0; n < subBlocksToRead.size(); ++n)
+	{
+		const size_t i = subBlocksToRead[n];
+		CCZIParse::SetSubBlockDataFromCoalescedRead(segments[i], payloadReads[n], ranges[n].first, ranges[n].second, allocateInfo, subBlocks[i]);
+	}
 
-		if (bytesRead != subBlckSegment.data.DataSize)
+	return subBlocks;
+}
+
+/*static*/void CCZIParse::SetSubBlockDataFromCoalescedRead(const SubBlockSegment& subBlckSegment, const CoalescedRead& read, std::uint64_t payloadOffset, std::uint64_t payloadSize, const SubBlockStorageAllocate& allocateInfo, SubBlockData& sbd)
+{
+	// The sub-block (and e.g. a bitmap referring to its data, which may be kept in a cache) keeps its payload alive. So we
+	//  only share the buffer if it holds not much more than the segment of this sub-block, otherwise the payload is copied
+	//  - and the buffer is released as soon as all of its sub-blocks are set up.
+	if (read.size <= sizeof(SegmentHeader) + 256 + payloadSize)
+	{
+		CCZIParse::SetSubBlockDataFromPayload(subBlckSegment, const_cast<void*>(read.GetPointer(payloadOffset)), sbd);
+		sbd.spPayload = read.buffer;
+		return;
+	}
+
+	auto freeFunc = allocateInfo.free;
+	std::shared_ptr<const void> payload(allocateInfo.alloc((size_t)payloadSize), [freeFunc](const void* ptr)->void {freeFunc(const_cast<void*>(ptr)); });
+	memcpy(const_cast<void*>(payload.get()), read.GetPointer(payloadOffset), (size_t)payloadSize);
+	CCZIParse::SetSubBlockDataFromPayload(subBlckSegment, const_cast<void*>(payload.get()), sbd);
+	sbd.spPayload = std::move(payload);
+}
+
+/*static*/std::vector<CCZIParse::CoalescedRead> CCZIParse::ReadCoalesced(libCZI::IStream* str, const std::vector<std::pair<std::uint64_t, std::uint64_t>>& ranges, std::uint64_t maxGap, const SubBlockStorageAllocate& allocateInfo, const char* errorText)
+{
+	std::vector<CoalescedRead> reads(ranges.size());
+	std::vector<libCZI::IStreamBatch::ReadRequest> requests;
+	auto freeFunc = allocateInfo.free;
+	for (size_t i = 0; i < ranges.size();)
+	{
+		// extend the read as long as the gap to the next range is small enough
+		const std::uint64_t start = ranges[i].first;
+		std::uint64_t end = start + ranges[i].second;
+		size_t j = i + 1;
+		for (; j < ranges.size(); ++j)
+		{
+			const std::uint64_t newEnd = (std::max)(end, ranges[j].first + ranges[j].second);
+			if (ranges[j].first > end + maxGap || newEnd - start > (std::uint64_t)CCZIParse::SUBBLKCOALESCEMAXSIZE)
+			{
+				break;
+			}
+
+			end = newEnd;
+		}
+
+		// TODO: if the size > size_t (=4GB for 32Bit) then bail out gracefully
+		std::shared_ptr<const void> buffer(allocateInfo.alloc((size_t)(end - start)), [freeFunc](const void* ptr)->void {freeFunc(const_cast<void*>(ptr)); });
+		requests.push_back(libCZI::IStreamBatch::ReadRequest{ start, const_cast<void*>(buffer.get()), end - start, 0 });
+		for (; i < j; ++i)
 		{
-			CCZIParse::ThrowNotEnoughDataRead(offset + 256 + sizeof(SegmentHeader) + subBlckSegment.data.MetadataSize, subBlckSegment.data.DataSize, bytesRead);
+			reads[i] = CoalescedRead{ start, end - start, buffer };
 		}
 	}
 
-	if (pAttachmentBuffer)
+	CCZIParse::ReadBatch(str, requests, errorText);
+	return reads;
+}
+
+/*static*/void CCZIParse::ReadBatch(libCZI::IStream* str, std::vector<libCZI::IStreamBatch::ReadRequest>& requests, const char* errorText)
+{
+	if (requests.empty())
+	{
+		return;
+	}
+
+	libCZI::IStreamBatch* streamBatch = dynamic_cast<libCZI::IStreamBatch*>(str);
+	if (streamBatch != nullptr)
 	{
 		try
 		{
-			str->Read(offset + 256 + sizeof(SegmentHeader) + subBlckSegment.data.MetadataSize + subBlckSegment.data.DataSize, pAttachmentBuffer.get(), subBlckSegment.data.AttachmentSize, &bytesRead);
+			streamBatch->ReadBatch(&requests[0], requests.size());
 		}
 		catch (const std::exception&)
 		{
-			std::throw_with_nested(LibCZIIOException("Error reading FileHeaderSegement", offset + 256 + sizeof(SegmentHeader) + subBlckSegment.data.MetadataSize + subBlckSegment.data.DataSize, subBlckSegment.data.AttachmentSize));
+			std::throw_with_nested(LibCZIIOException(errorText, requests[0].offset, requests[0].size));
 		}
-
-		if (bytesRead != subBlckSegment.data.AttachmentSize)
+	}
+	else
+	{
+		for (auto& r : requests)
 		{
-			CCZIParse::ThrowNotEnoughDataRead(offset + 256 + sizeof(SegmentHeader) + subBlckSegment.data.MetadataSize + subBlckSegment.data.DataSize, subBlckSegment.data.AttachmentSize, bytesRead);
+			try
+			{
+				str->Read(r.offset, r.pv, r.size, &r.bytesRead);
+			}
+			catch (const std::exception&)
+			{
+				std::throw_with_nested(LibCZIIOException(errorText, r.offset, r.size));
+			}
 		}
 	}
 
-	sbd.ptrData = pDataBuffer.release();
-	sbd.dataSize = subBlckSegment.data.DataSize;
-	sbd.ptrAttachment = pAttachmentBuffer.release();
-	sbd.attachmentSize = subBlckSegment.data.AttachmentSize;
-	sbd.ptrMetadata = pMetadataBuffer.release();
-	sbd.metaDataSize = subBlckSegment.data.MetadataSize;
-	return sbd;
+	for (const auto& r : requests)
+	{
+		if (r.bytesRead != r.size)
+		{
+			CCZIParse::ThrowNotEnoughDataRead(r.offset, r.size, r.bytesRead);
+		}
+	}
 }
 
 /*static*/CCZIParse::AttachmentData CCZIParse::ReadAttachment(libCZI::IStream* str, std::uint64_t offset, const SubBlockStorageAllocate& allocateInfo)
@@ -407,29 +669,69 @@ using namespace libCZI;
 	return ad;
 }
 
-/*static*/void CCZIParse::ParseThroughDirectoryEntries(int count, std::function<void(int, void*)> funcRead, std::function<void(const SubBlockDirectoryEntryDE*, const SubBlockDirectoryEntryDV*)> funcAddEntry)
+/*static*/void CCZIParse::FindDirectoryEntries(const std::uint8_t* ptr, std::uint64_t size, int count, std::uint64_t offset, std::vector<std::uint64_t>& entryOffsets)
 {
+	entryOffsets.reserve(count > 0 ? count : 0);
+	std::uint64_t currentOffset = 0;
 	for (int i = 0; i < count; ++i)
 	{
-		char schemaType[2];
-		funcRead(2, schemaType);
+		if (currentOffset + 2 > size)
+		{
+			CCZIParse::ThrowIllegalData(offset + currentOffset, "SubBlockDirectory data too small");
+		}
+
+		const std::uint8_t* schemaType = ptr + currentOffset;
+		std::uint64_t entrySize;
 		if (schemaType[0] == 'D' && schemaType[1] == 'V')
 		{
-			SubBlockDirectoryEntryDV dv;
-			dv.SchemaType[0] = schemaType[0]; dv.SchemaType[1] = schemaType[1];
-			funcRead(4 + 8 + 4 + 4 + 6 + 4, ((char*)&dv) + 2);
+			if (currentOffset + offsetof(SubBlockDirectoryEntryDV, DimensionEntries) > size)
+			{
+				CCZIParse::ThrowIllegalData(offset + currentOffset, "SubBlockDirectory data too small");
+			}
 
-			int sizeToRead = dv.DimensionCount*sizeof(DimensionEntryDV);
-			// TODO: check for max size etc.
-			funcRead(sizeToRead, &dv.DimensionEntries[0]);
+			int dimensionCount = reinterpret_cast<const SubBlockDirectoryEntryDV*>(schemaType)->DimensionCount;
+			if (dimensionCount < 0 || dimensionCount > MAXDIMENSIONS)
+			{
+				CCZIParse::ThrowIllegalData(offset + currentOffset, "Invalid DimensionCount in SubBlockDirectory-entry");
+			}
 
-			funcAddEntry(nullptr, &dv);
+			entrySize = offsetof(SubBlockDirectoryEntryDV, DimensionEntries) + dimensionCount * sizeof(DimensionEntryDV);
 		}
 		else if (schemaType[0] == 'D' && schemaType[1] == 'E')
 		{
-			SubBlockDirectoryEntryDE de;
-			funcRead(sizeof(de), &de);
-			funcAddEntry(&de, nullptr);
+			entrySize = sizeof(SubBlockDirectoryEntryDE);
+		}
+		else
+		{
+			// unknown schema-type, skip it
+			currentOffset += 2;
+			continue;
+		}
+
+		if (currentOffset + entrySize > size)
+		{
+			CCZIParse::ThrowIllegalData(offset + currentOffset, "SubBlockDirectory data too small");
+		}
+
+		entryOffsets.push_back(currentOffset);
+		currentOffset += entrySize;
+	}
+}
+
+/*static*/void CCZIParse::AddDirectoryEntries(const std::uint8_t* ptr, const std::vector<std::uint64_t>& entryOffsets, size_t start, size_t end, CCziSubBlockDirectory& subBlkDir)
+{
+	// the structures are declared as "packed", so we can use them directly on the buffer (instead of copying
+	//  each entry into a structure with room for the maximum number of dimensions)
+	for (size_t i = start; i < end; ++i)
+	{
+		const std::uint8_t* ptrEntry = ptr + entryOffsets[i];
+		if (ptrEntry[1] == 'V')
+		{
+			CCZIParse::AddEntryToSubBlockDirectory(reinterpret_cast<const SubBlockDirectoryEntryDV*>(ptrEntry), subBlkDir);
+		}
+		else
+		{
+			CCZIParse::AddEntryToSubBlockDirectory(reinterpret_cast<const SubBlockDirectoryEntryDE*>(ptrEntry), subBlkDir);
 		}
 	}
 }
@@ -38,6 +38,21 @@ private:
 	static const std::uint8_t METADATASEGMENTMAGIC[16];
 	static const std::uint8_t ATTACHMENTSDIRMAGC[16];
 	static const std::uint8_t ATTACHMENTBLKMAGIC[16];
+
+	/// The number of bytes which are read (at least) when reading a sub-block. If the sub-block-segment fits into
+	/// this size, it can be read with a single call.
+	static const int SUBBLKSPECULATIVEREADSIZE = 16 * 1024;
+
+	/// When reading multiple sub-blocks, two ranges of the file whose gap is at most this number of bytes are read
+	/// with a single read-operation (the data in the gap is read and discarded).
+	static const int SUBBLKCOALESCEMAXGAP = 256 * 1024;
+
+	/// The maximal size of a read-operation into which the ranges of multiple sub-blocks are combined.
+	static const int SUBBLKCOALESCEMAXSIZE = 16 * 1024 * 1024;
+
+	/// The minimal number of sub-block-directory entries which are parsed by one thread. If the directory contains
+	/// less than twice this number of entries, it is parsed on the calling thread.
+	static const int SUBBLKDIRENTRIESPERTHREAD = 32 * 1024;
 public:
 	static CFileHeaderSegmentData ReadFileHeaderSegment(libCZI::IStream* str);
 
@@ -61,6 +76,14 @@ public:
 		void*			ptrMetadata;
 		std::uint32_t	metaDataSize;
 
+		/// If valid, then ptrData, ptrAttachment and ptrMetadata point into the memory owned by this
+		/// object (which is either a buffer holding the complete payload or a view given out by an
+		/// IStreamDirectAccess-stream) - and must not be freed.
+		std::shared_ptr<const void> spPayload;
+
+		/// True if the payload is a view given out by an IStreamDirectAccess-stream, which must not be written to.
+		bool			payloadIsReadOnly;
+
 		int						compression;
 		int						pixelType;
 		libCZI::CDimCoordinate	coordinate;
@@ -72,6 +95,15 @@ public:
 
 	static SubBlockData ReadSubBlock(libCZI::IStream* str, std::uint64_t offset, const SubBlockStorageAllocate& allocateInfo);
 
+	/// Reads the sub-blocks at the specified offsets. The I/O is done in two batches (first the segment-headers,
+	/// then the payload), using IStreamBatch if the stream implements it. Within a batch, the sub-blocks are read
+	/// in the order of their position in the file, and ranges which are close to each other are read with a single
+	/// read-operation (in which case the payload of each sub-block is copied out of the buffer, so that a sub-block
+	/// does not keep the data of the others alive). If the segment-headers are read together with the payload in
+	/// between, the payload is not read again. If the stream implements IStreamBatch, the payloads are not combined
+	/// (but passed to the stream as separate requests), so each sub-block gets a buffer of its own.
+	static std::vector<SubBlockData> ReadSubBlocks(libCZI::IStream* str, const std::vector<std::uint64_t>& offsets, const SubBlockStorageAllocate& allocateInfo);
+
 	struct MetadataSegmentData
 	{
 		void*			ptrXmlData;
@@ -90,7 +122,55 @@ public:
 
 	static AttachmentData ReadAttachment(libCZI::IStream* str, std::uint64_t offset, const SubBlockStorageAllocate& allocateInfo);
 private:
-	static void ParseThroughDirectoryEntries(int count, std::function<void(int, void*)> funcRead, std::function<void(const SubBlockDirectoryEntryDE*, const SubBlockDirectoryEntryDV*)> funcAddEntry);
+	static SubBlockData ParseSubBlockSegment(std::uint64_t offset, const SubBlockSegment& subBlckSegment);
+	static std::uint64_t GetSubBlockPayloadSize(std::uint64_t offset, const SubBlockSegment& subBlckSegment);
+	static void SetSubBlockDataFromPayload(const SubBlockSegment& subBlckSegment, void* ptrPayload, SubBlockData& sbd);
+	static bool TrySetSubBlockDataFromView(libCZI::IStream* str, std::uint64_t offset, const SubBlockSegment& subBlckSegment, SubBlockData& sbd);
+	static void ReadBatch(libCZI::IStream* str, std::vector<libCZI::IStreamBatch::ReadRequest>& requests, const char* errorText);
+
+	/// A range of the file which has been read (possibly containing multiple of the requested ranges).
+	struct CoalescedRead
+	{
+		std::uint64_t offset;
+		std::uint64_t size;
+		std::shared_ptr<const void> buffer;
+
+		bool Contains(std::uint64_t rangeOffset, std::uint64_t rangeSize) const
+		{
+			return rangeOffset >= this->offset && rangeOffset + rangeSize <= this->offset + this->size;
+		}
+
+		const void* GetPointer(std::uint64_t rangeOffset) const
+		{
+			return static_cast<const char*>(this->buffer.get()) + (rangeOffset - this->offset);
+		}
+	};
+
+	/// Reads the specified ranges of the file (which must be sorted by their offset). Ranges whose gap is at most
+	/// "maxGap" bytes are read with a single read-operation (unless it would exceed SUBBLKCOALESCEMAXSIZE).
+	///
+	/// \param str		 The stream.
+	/// \param ranges	 The ranges (offset and size), sorted by offset.
+	/// \param maxGap	 The maximal gap between two ranges which are read together.
+	/// \param allocateInfo Information describing how to allocate the buffers.
+	/// \param errorText The error text (for the exception in case of an I/O-error).
+	///
+	/// \return For each range, the read which contains it.
+	static std::vector<CoalescedRead> ReadCoalesced(libCZI::IStream* str, const std::vector<std::pair<std::uint64_t, std::uint64_t>>& ranges, std::uint64_t maxGap, const SubBlockStorageAllocate& allocateInfo, const char* errorText);
+
+	/// Sets the payload of the sub-block from a read which contains it. If the read contains (much) more than the segment
+	/// of the sub-block, the payload is copied into a buffer of its own, otherwise the sub-block shares the buffer.
+	///
+	/// \param subBlckSegment The segment of the sub-block.
+	/// \param read		   The read containing the payload.
+	/// \param payloadOffset  The offset of the payload (in the file).
+	/// \param payloadSize	   The size of the payload.
+	/// \param allocateInfo   Information describing how to allocate the buffer.
+	/// \param [in,out] sbd   The sub-block data.
+	static void SetSubBlockDataFromCoalescedRead(const SubBlockSegment& subBlckSegment, const CoalescedRead& read, std::uint64_t payloadOffset, std::uint64_t payloadSize, const SubBlockStorageAllocate& allocateInfo, SubBlockData& sbd);
+
+	static void FindDirectoryEntries(const std::uint8_t* ptr, std::uint64_t size, int count, std::uint64_t offset, std::vector<std::uint64_t>& entryOffsets);
+	static void AddDirectoryEntries(const std::uint8_t* ptr, const std::vector<std::uint64_t>& entryOffsets, size_t start, size_t end, CCziSubBlockDirectory& subBlkDir);
 
 	static void AddEntryToSubBlockDirectory(const SubBlockDirectoryEntryDE* subBlkDirDE, CCziSubBlockDirectory& subBlkDir);
 	static void AddEntryToSubBlockDirectory(const SubBlockDirectoryEntryDV* subBlkDirDE, CCziSubBlockDirectory& subBlkDir);
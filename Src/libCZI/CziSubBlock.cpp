@@ -26,14 +26,26 @@
 
 using namespace libCZI;
 
+static std::shared_ptr<const void> MakeSharedPtr(void* ptr, const std::shared_ptr<const void>& spPayload, const std::function<void(void*)>& deleter)
+{
+	if (spPayload)
+	{
+		// the memory is owned by the payload-object, so we create a shared_ptr which shares ownership with it
+		return std::shared_ptr<const void>(spPayload, ptr);
+	}
+
+	return std::shared_ptr<const void>(ptr, deleter);
+}
+
 CCziSubBlock::CCziSubBlock(const libCZI::SubBlockInfo& info, const CCZIParse::SubBlockData& data, std::function<void(void*)> deleter)
 	:
-	spData(std::shared_ptr<const void>(data.ptrData, deleter)),
-	spAttachment(std::shared_ptr<const void>(data.ptrAttachment, deleter)),
-	spMetadata(std::shared_ptr<const void>(data.ptrMetadata, deleter)),
+	spData(MakeSharedPtr(data.ptrData, data.spPayload, deleter)),
+	spAttachment(MakeSharedPtr(data.ptrAttachment, data.spPayload, deleter)),
+	spMetadata(MakeSharedPtr(data.ptrMetadata, data.spPayload, deleter)),
 	dataSize(data.dataSize),
 	attachmentSize(data.attachmentSize),
 	metaDataSize(data.metaDataSize),
+	dataIsReadOnly(data.payloadIsReadOnly),
 	info(info)
 {
 }
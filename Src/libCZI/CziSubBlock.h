@@ -32,6 +32,7 @@ private:
 	std::uint64_t	dataSize;
 	std::uint32_t	attachmentSize;
 	std::uint32_t	metaDataSize;
+	bool			dataIsReadOnly;
 	libCZI::SubBlockInfo	info;
 public:
 	CCziSubBlock(const libCZI::SubBlockInfo& info,const CCZIParse::SubBlockData& data, std::function<void(void*)> deleter);
@@ -42,4 +43,9 @@ public:
 	void DangerousGetRawData(libCZI::ISubBlock::MemBlkType type, const void*& ptr, size_t& size) const override;
 	std::shared_ptr<const void> GetRawData(MemBlkType type, size_t* ptrSize) override;
 	std::shared_ptr<libCZI::IBitmapData> CreateBitmap() override;
+
+	/// Gets a boolean indicating whether the data of this sub-block is a read-only view into the stream (see
+	/// libCZI::IStreamDirectAccess), e.g. of a memory-mapped file.
+	/// \return True if the data must not be written to, false otherwise.
+	bool IsDataReadOnly() const { return this->dataIsReadOnly; }
 };
@@ -23,10 +23,20 @@
 #include "stdafx.h"
 #include "CziSubBlockDirectory.h"
 #include "CziUtils.h"
+#include "utilities.h"
+#include "SidecarIndex.h"
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <tuple>
 
 using namespace libCZI;
 
-CCziSubBlockDirectory::CCziSubBlockDirectory() : state(State::AddingAllowed)
+CCziSubBlockDirectory::CCziSubBlockDirectory() : CCziSubBlockDirectory(false)
+{
+}
+
+CCziSubBlockDirectory::CCziSubBlockDirectory(bool useCompactRepresentation) : useCompactRepresentation(useCompactRepresentation), compactCount(0), state(State::AddingAllowed)
 {
 	this->statistics.Invalidate();
 	this->statistics.subBlockCount = 0;
@@ -39,14 +49,85 @@ void CCziSubBlockDirectory::AddSubBlock(const SubBlkEntry& entry)
 		throw std::logic_error("The object is not allowing to add subblocks any more.");
 	}
 
-	this->subBlks.push_back(entry);
+	this->AppendEntry(entry);
 	this->UpdateStatistics(entry);
 }
 
+void CCziSubBlockDirectory::AddSubBlocks(CCziSubBlockDirectory&& other)
+{
+	if (this->state != State::AddingAllowed || other.state != State::AddingAllowed)
+	{
+		throw std::logic_error("The object is not allowing to add subblocks any more.");
+	}
+
+	if (this->useCompactRepresentation == true && other.useCompactRepresentation == true && this->subBlks.empty())
+	{
+		// all our chunks are complete, so the chunks of "other" can be appended - only the indices into the
+		//  format-dictionary have to be translated
+		std::vector<std::uint32_t> formatMapping(other.formats.size());
+		bool formatMappingIsIdentity = true;
+		for (size_t i = 0; i < other.formats.size(); ++i)
+		{
+			auto it = this->formatIndices.insert(std::make_pair(other.formats[i], (std::uint32_t)this->formats.size()));
+			if (it.second == true)
+			{
+				this->formats.push_back(other.formats[i]);
+			}
+
+			formatMapping[i] = it.first->second;
+			formatMappingIsIdentity = formatMappingIsIdentity && formatMapping[i] == i;
+		}
+
+		for (auto& chunk : other.compactChunks)
+		{
+			if (formatMappingIsIdentity == false)
+			{
+				CPackedIntVector formatIndex;
+				formatIndex.Reset(chunk.formatIndex.GetCount(), this->formats.size() - 1);
+				for (size_t i = 0; i < chunk.formatIndex.GetCount(); ++i)
+				{
+					formatIndex.Set(i, formatMapping[(size_t)chunk.formatIndex.Get(i)]);
+				}
+
+				chunk.formatIndex = std::move(formatIndex);
+			}
+
+			this->compactChunks.push_back(std::move(chunk));
+		}
+
+		this->compactCount += other.compactCount;
+		this->subBlks = std::move(other.subBlks);
+	}
+	else if (this->useCompactRepresentation == false && other.useCompactRepresentation == false)
+	{
+		this->subBlks.insert(this->subBlks.end(), std::make_move_iterator(other.subBlks.begin()), std::make_move_iterator(other.subBlks.end()));
+	}
+	else
+	{
+		SubBlkEntry buffer;
+		for (size_t i = 0; i < other.GetSubBlockCount(); ++i)
+		{
+			this->AppendEntry(other.GetEntry((int)i, buffer));
+		}
+	}
+
+	this->MergeStatistics(other);
+	other.subBlks.clear();
+	other.compactChunks.clear();
+	other.compactCount = 0;
+}
+
 void CCziSubBlockDirectory::AddingFinished()
 {
 	this->state = State::AddingFinished;
 	this->SortPyramidStatistics();
+	if (this->useCompactRepresentation == true)
+	{
+		this->FinishCompactRepresentation();
+	}
+
+	this->BuildPlaneIndex();
+	this->BuildSpatialIndex();
 }
 
 const libCZI::SubBlockStatistics& CCziSubBlockDirectory::GetStatistics() const
@@ -61,10 +142,11 @@ const libCZI::PyramidStatistics& CCziSubBlockDirectory::GetPyramidStatistics() c
 
 void CCziSubBlockDirectory::EnumSubBlocks(std::function<bool(int index, const SubBlkEntry&)> func)
 {
-	int i = 0;
-	for (auto it = this->subBlks.cbegin(); it != this->subBlks.cend(); ++it)
+	SubBlkEntry buffer;
+	const int count = (int)this->GetSubBlockCount();
+	for (int i = 0; i < count; ++i)
 	{
-		bool b = func(i++, *it);
+		bool b = func(i, this->GetEntry(i, buffer));
 		if (b == false)
 		{
 			break;
@@ -72,17 +154,457 @@ void CCziSubBlockDirectory::EnumSubBlocks(std::function<bool(int index, const Su
 	}
 }
 
+void CCziSubBlockDirectory::EnumSubset(const libCZI::IDimCoordinate* planeCoordinate, const libCZI::IntRect* roi, bool onlyLayer0, std::function<bool(int index, const SubBlkEntry&)> func)
+{
+	if (this->state != State::AddingFinished)
+	{
+		// the index is not yet available, so we have to look at all sub-blocks
+		this->EnumSubBlocks(
+			[&](int index, const SubBlkEntry& entry)->bool
+		{
+			if (CCziSubBlockDirectory::IsInSubset(entry, planeCoordinate, roi, onlyLayer0))
+			{
+				return func(index, entry);
+			}
+
+			return true;
+		});
+
+		return;
+	}
+
+	// if possible, use the plane-key in order to locate the plane - otherwise we have to look at all planes
+	size_t firstPlane = 0, endPlane = this->planeLayerInfo.GetCount();
+	if (planeCoordinate != nullptr && this->TryGetPlaneRange(planeCoordinate, &firstPlane, &endPlane) == false)
+	{
+		firstPlane = 0;
+		endPlane = this->planeLayerInfo.GetCount();
+	}
+
+	auto getRect = [this](int index)->IntRect {return this->GetLogicalRect(index); };
+	std::vector<int> indices;
+	libCZI::CDimCoordinate coordinate;
+	for (size_t i = firstPlane; i < endPlane; ++i)
+	{
+		const std::uint64_t layerInfo = this->planeLayerInfo.Get(i);
+		if (onlyLayer0 == true && PyramidStatistics::PyramidLayerInfo{ (std::uint8_t)(layerInfo >> 8), (std::uint8_t)layerInfo }.IsLayer0() == false)
+		{
+			continue;
+		}
+
+		const size_t firstItem = (size_t)this->planeItemStart.Get(i);
+		const size_t endItem = (size_t)this->planeItemStart.Get(i + 1);
+		if (planeCoordinate != nullptr)
+		{
+			this->GetCoordinate((int)this->planeItems.Get(firstItem), coordinate);
+			if (CziUtils::CompareCoordinate(planeCoordinate, &coordinate) == false)
+			{
+				continue;
+			}
+		}
+
+		const CSubBlockSpatialIndex* spatialIndex = this->GetSpatialIndex(i);
+		if (spatialIndex == nullptr)
+		{
+			for (size_t n = firstItem; n < endItem; ++n)
+			{
+				int index = (int)this->planeItems.Get(n);
+				if (roi == nullptr || Utilities::DoIntersect(*roi, getRect(index)))
+				{
+					indices.push_back(index);
+				}
+			}
+		}
+		else if (roi != nullptr)
+		{
+			spatialIndex->Query(*roi, getRect, indices);
+		}
+		else
+		{
+			spatialIndex->GetAll(getRect, indices);
+		}
+	}
+
+	// we want to report the sub-blocks in the same order as EnumSubBlocks does
+	std::sort(indices.begin(), indices.end());
+	SubBlkEntry entry;
+	for (int index : indices)
+	{
+		if (func(index, this->GetEntry(index, entry)) == false)
+		{
+			break;
+		}
+	}
+}
+
+bool CCziSubBlockDirectory::TryGetFirstSubBlockInChannel(int channelIndex, int* index)
+{
+	if (this->state != State::AddingFinished)
+	{
+		bool found = false;
+		this->EnumSubBlocks(
+			[&](int i, const SubBlkEntry& entry)->bool
+		{
+			int c;
+			if (entry.coordinate.TryGetPosition(DimensionIndex::C, &c) == true && c == channelIndex)
+			{
+				*index = i;
+				found = true;
+				return false;
+			}
+
+			return true;
+		});
+
+		return found;
+	}
+
+	auto it = this->firstSubBlockInChannel.find(channelIndex);
+	if (it == this->firstSubBlockInChannel.end())
+	{
+		return false;
+	}
+
+	*index = it->second;
+	return true;
+}
+
 bool CCziSubBlockDirectory::TryGetSubBlock(int index, SubBlkEntry& entry)
 {
-	if (index < (int)this->subBlks.size())
+	if (index >= 0 && index < (int)this->GetSubBlockCount())
 	{
-		entry = this->subBlks.at(index);
+		const SubBlkEntry& e = this->GetEntry(index, entry);
+		if (&e != &entry)
+		{
+			entry = e;
+		}
+
 		return true;
 	}
 
 	return false;
 }
 
+size_t CCziSubBlockDirectory::GetSubBlockCount() const
+{
+	return this->compactCount + this->subBlks.size();
+}
+
+void CCziSubBlockDirectory::Serialize(CSidecarIndexWriter& writer) const
+{
+	if (this->state != State::AddingFinished)
+	{
+		throw std::logic_error("The object must have finished adding subblocks.");
+	}
+
+	const size_t count = this->GetSubBlockCount();
+	writer.Write<std::uint64_t>(count);
+	SubBlkEntry buffer;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const SubBlkEntry& entry = this->GetEntry((int)i, buffer);
+		writer.WriteCoordinate(entry.coordinate);
+		writer.Write<std::int32_t>(entry.mIndex);
+		writer.Write<std::int32_t>(entry.x);
+		writer.Write<std::int32_t>(entry.y);
+		writer.Write<std::int32_t>(entry.width);
+		writer.Write<std::int32_t>(entry.height);
+		writer.Write<std::int32_t>(entry.storedWidth);
+		writer.Write<std::int32_t>(entry.storedHeight);
+		writer.Write<std::int32_t>(entry.PixelType);
+		writer.Write<std::uint64_t>(entry.FilePosition);
+		writer.Write<std::int32_t>(entry.Compression);
+	}
+
+	writer.Write<std::int32_t>(this->statistics.subBlockCount);
+	writer.Write<std::int32_t>(this->statistics.minMindex);
+	writer.Write<std::int32_t>(this->statistics.maxMindex);
+	writer.WriteRect(this->statistics.boundingBox);
+	writer.WriteRect(this->statistics.boundingBoxLayer0Only);
+	std::vector<std::int32_t> dimBounds;
+	this->statistics.dimBounds.EnumValidDimensions(
+		[&](libCZI::DimensionIndex dim, int start, int size)->bool
+	{
+		dimBounds.push_back((std::int32_t)dim);
+		dimBounds.push_back(start);
+		dimBounds.push_back(size);
+		return true;
+	});
+
+	writer.WriteVector(dimBounds);
+	writer.Write<std::uint64_t>(this->statistics.sceneBoundingBoxes.size());
+	for (const auto& kv : this->statistics.sceneBoundingBoxes)
+	{
+		writer.Write<std::int32_t>(kv.first);
+		writer.WriteRect(kv.second.boundingBox);
+		writer.WriteRect(kv.second.boundingBoxLayer0);
+	}
+
+	writer.Write<std::uint64_t>(this->pyramidStatistics.scenePyramidStatistics.size());
+	for (const auto& kv : this->pyramidStatistics.scenePyramidStatistics)
+	{
+		writer.Write<std::int32_t>(kv.first);
+		writer.Write<std::uint64_t>(kv.second.size());
+		for (const auto& pls : kv.second)
+		{
+			writer.Write(pls.layerInfo.minificationFactor);
+			writer.Write(pls.layerInfo.pyramidLayerNo);
+			writer.Write<std::int32_t>(pls.count);
+		}
+	}
+
+	writer.Write<std::uint64_t>(this->planeItems.GetCount());
+	for (size_t i = 0; i < this->planeItems.GetCount(); ++i)
+	{
+		writer.Write<std::int32_t>((std::int32_t)this->planeItems.Get(i));
+	}
+
+	// for every plane-and-layer, the pyramid-layer and the end of its items are written
+	writer.Write<std::uint64_t>(this->planeLayerInfo.GetCount());
+	for (size_t i = 0; i < this->planeLayerInfo.GetCount(); ++i)
+	{
+		writer.Write<std::uint16_t>((std::uint16_t)this->planeLayerInfo.Get(i));
+		writer.Write<std::uint32_t>((std::uint32_t)this->planeItemStart.Get(i + 1));
+	}
+
+	writer.Write<std::uint64_t>(this->spatialIndices.size());
+	for (const auto& spatialIndex : this->spatialIndices)
+	{
+		writer.Write(spatialIndex.first);
+		spatialIndex.second->Serialize(writer);
+	}
+
+	writer.Write<std::uint64_t>(this->planeKeyDimensions.size());
+	for (const auto& pkd : this->planeKeyDimensions)
+	{
+		writer.Write<std::int32_t>((std::int32_t)pkd.dim);
+		writer.Write<std::int32_t>(pkd.start);
+		writer.Write<std::int32_t>(pkd.size);
+		writer.Write(pkd.weight);
+	}
+
+	// for every plane, its key and the end of its planes-and-layers are written
+	writer.Write<std::uint64_t>(this->planeKeys.GetCount());
+	for (size_t i = 0; i < this->planeKeys.GetCount(); ++i)
+	{
+		writer.Write<std::uint64_t>(this->planeKeys.Get(i));
+		writer.Write<std::uint32_t>((std::uint32_t)this->planeKeyStart.Get(i + 1));
+	}
+
+	writer.Write<std::uint64_t>(this->firstSubBlockInChannel.size());
+	for (const auto& kv : this->firstSubBlockInChannel)
+	{
+		writer.Write<std::int32_t>(kv.first);
+		writer.Write<std::int32_t>(kv.second);
+	}
+}
+
+void CCziSubBlockDirectory::Deserialize(CSidecarIndexReader& reader)
+{
+	if (this->state != State::AddingAllowed || this->GetSubBlockCount() != 0)
+	{
+		throw std::logic_error("The object must be empty.");
+	}
+
+	// a serialized coordinate has 40 bytes, followed by nine 32-bit values and the file-position
+	const size_t count = reader.ReadCount(40 + 9 * 4 + 8);
+	if (count > (size_t)(std::numeric_limits<int>::max)())
+	{
+		CSidecarIndexReader::ThrowCorrupt();
+	}
+
+	if (this->useCompactRepresentation == false)
+	{
+		this->subBlks.reserve(count);
+	}
+
+	SubBlkEntry entry;
+	for (size_t i = 0; i < count; ++i)
+	{
+		entry.coordinate = reader.ReadCoordinate();
+		entry.mIndex = reader.Read<std::int32_t>();
+		entry.x = reader.Read<std::int32_t>();
+		entry.y = reader.Read<std::int32_t>();
+		entry.width = reader.Read<std::int32_t>();
+		entry.height = reader.Read<std::int32_t>();
+		entry.storedWidth = reader.Read<std::int32_t>();
+		entry.storedHeight = reader.Read<std::int32_t>();
+		entry.PixelType = reader.Read<std::int32_t>();
+		entry.FilePosition = reader.Read<std::uint64_t>();
+		entry.Compression = reader.Read<std::int32_t>();
+		this->AppendEntry(entry);
+	}
+
+	this->statistics.subBlockCount = reader.Read<std::int32_t>();
+	this->statistics.minMindex = reader.Read<std::int32_t>();
+	this->statistics.maxMindex = reader.Read<std::int32_t>();
+	this->statistics.boundingBox = reader.ReadRect();
+	this->statistics.boundingBoxLayer0Only = reader.ReadRect();
+	std::vector<std::int32_t> dimBounds;
+	reader.ReadVector(dimBounds);
+	if (dimBounds.size() % 3 != 0)
+	{
+		CSidecarIndexReader::ThrowCorrupt();
+	}
+
+	for (size_t i = 0; i < dimBounds.size(); i += 3)
+	{
+		if (dimBounds[i] < (std::int32_t)DimensionIndex::MinDim || dimBounds[i] > (std::int32_t)DimensionIndex::MaxDim)
+		{
+			CSidecarIndexReader::ThrowCorrupt();
+		}
+
+		this->statistics.dimBounds.Set((DimensionIndex)dimBounds[i], dimBounds[i + 1], dimBounds[i + 2]);
+	}
+
+	for (size_t sceneCount = reader.ReadCount(4 + 2 * 16); sceneCount > 0; --sceneCount)
+	{
+		int sceneIndex = reader.Read<std::int32_t>();
+		BoundingBoxes& boundingBoxes = this->statistics.sceneBoundingBoxes[sceneIndex];
+		boundingBoxes.boundingBox = reader.ReadRect();
+		boundingBoxes.boundingBoxLayer0 = reader.ReadRect();
+	}
+
+	for (size_t sceneCount = reader.ReadCount(4 + 8); sceneCount > 0; --sceneCount)
+	{
+		int sceneIndex = reader.Read<std::int32_t>();
+		std::vector<PyramidStatistics::PyramidLayerStatistics>& vec = this->pyramidStatistics.scenePyramidStatistics[sceneIndex];
+		vec.resize(reader.ReadCount(2 + 4));
+		for (auto& pls : vec)
+		{
+			pls.layerInfo.minificationFactor = reader.Read<std::uint8_t>();
+			pls.layerInfo.pyramidLayerNo = reader.Read<std::uint8_t>();
+			pls.count = reader.Read<std::int32_t>();
+		}
+	}
+
+	// every sub-block is part of exactly one plane-and-layer
+	if (reader.ReadCount(4) != count)
+	{
+		CSidecarIndexReader::ThrowCorrupt();
+	}
+
+	this->planeItems.Reset(count, count > 0 ? count - 1 : 0);
+	for (size_t i = 0; i < count; ++i)
+	{
+		std::int32_t index = reader.Read<std::int32_t>();
+		if (index < 0 || index >= (int)count)
+		{
+			CSidecarIndexReader::ThrowCorrupt();
+		}
+
+		this->planeItems.Set(i, (std::uint64_t)index);
+	}
+
+	const size_t planeAndLayerCount = reader.ReadCount(2 + 4);
+	std::vector<std::uint16_t> layerInfos(planeAndLayerCount);
+	std::vector<std::uint32_t> itemEnds(planeAndLayerCount);
+	for (size_t i = 0; i < planeAndLayerCount; ++i)
+	{
+		layerInfos[i] = reader.Read<std::uint16_t>();
+		itemEnds[i] = reader.Read<std::uint32_t>();
+
+		// a plane-and-layer must not be empty
+		if (itemEnds[i] <= (i > 0 ? itemEnds[i - 1] : 0) || itemEnds[i] > count)
+		{
+			CSidecarIndexReader::ThrowCorrupt();
+		}
+	}
+
+	if ((planeAndLayerCount > 0 ? itemEnds.back() : 0) != count)
+	{
+		CSidecarIndexReader::ThrowCorrupt();
+	}
+
+	this->planeLayerInfo.Reset(planeAndLayerCount, layerInfos.empty() ? 0 : *std::max_element(layerInfos.cbegin(), layerInfos.cend()));
+	this->planeItemStart.Reset(planeAndLayerCount + 1, count);
+	for (size_t i = 0; i < planeAndLayerCount; ++i)
+	{
+		this->planeLayerInfo.Set(i, layerInfos[i]);
+		this->planeItemStart.Set(i + 1, itemEnds[i]);
+	}
+
+	this->spatialIndices.resize(reader.ReadCount(4));
+	for (size_t i = 0; i < this->spatialIndices.size(); ++i)
+	{
+		auto& spatialIndex = this->spatialIndices[i];
+		spatialIndex.first = reader.Read<std::uint32_t>();
+		if (spatialIndex.first >= planeAndLayerCount || (i > 0 && spatialIndex.first <= this->spatialIndices[i - 1].first))
+		{
+			CSidecarIndexReader::ThrowCorrupt();
+		}
+
+		spatialIndex.second.reset(new CSubBlockSpatialIndex());
+		spatialIndex.second->Deserialize(reader, (int)count);
+	}
+
+	this->planeKeyDimensions.resize(reader.ReadCount(3 * 4 + 8));
+	for (auto& pkd : this->planeKeyDimensions)
+	{
+		std::int32_t dim = reader.Read<std::int32_t>();
+		if (dim < (std::int32_t)DimensionIndex::MinDim || dim > (std::int32_t)DimensionIndex::MaxDim)
+		{
+			CSidecarIndexReader::ThrowCorrupt();
+		}
+
+		pkd.dim = (DimensionIndex)dim;
+		pkd.start = reader.Read<std::int32_t>();
+		pkd.size = reader.Read<std::int32_t>();
+		pkd.weight = reader.Read<std::uint64_t>();
+	}
+
+	const size_t planeCount = reader.ReadCount(8 + 4);
+	if (this->planeKeyDimensions.empty() && planeCount != 0)
+	{
+		CSidecarIndexReader::ThrowCorrupt();
+	}
+
+	std::vector<std::uint64_t> keys(planeCount);
+	std::vector<std::uint32_t> planeEnds(planeCount);
+	for (size_t i = 0; i < planeCount; ++i)
+	{
+		keys[i] = reader.Read<std::uint64_t>();
+		planeEnds[i] = reader.Read<std::uint32_t>();
+
+		// the keys must be ascending (for the binary search), and a plane must not be empty
+		if ((i > 0 && (keys[i] <= keys[i - 1] || planeEnds[i] <= planeEnds[i - 1])) || planeEnds[i] == 0 || planeEnds[i] > planeAndLayerCount)
+		{
+			CSidecarIndexReader::ThrowCorrupt();
+		}
+	}
+
+	if (planeCount > 0 && planeEnds.back() != planeAndLayerCount)
+	{
+		CSidecarIndexReader::ThrowCorrupt();
+	}
+
+	this->planeKeys.Reset(planeCount, planeCount > 0 ? keys.back() : 0);
+	this->planeKeyStart.Reset(planeCount > 0 ? planeCount + 1 : 0, planeAndLayerCount);
+	for (size_t i = 0; i < planeCount; ++i)
+	{
+		this->planeKeys.Set(i, keys[i]);
+		this->planeKeyStart.Set(i + 1, planeEnds[i]);
+	}
+
+	for (size_t channelCount = reader.ReadCount(2 * 4); channelCount > 0; --channelCount)
+	{
+		int c = reader.Read<std::int32_t>();
+		int index = reader.Read<std::int32_t>();
+		if (index < 0 || index >= (int)count)
+		{
+			CSidecarIndexReader::ThrowCorrupt();
+		}
+
+		this->firstSubBlockInChannel[c] = index;
+	}
+
+	this->state = State::AddingFinished;
+	if (this->useCompactRepresentation == true)
+	{
+		this->FinishCompactRepresentation();
+	}
+}
+
 void CCziSubBlockDirectory::UpdateStatistics(const SubBlkEntry& entry)
 {
 	// TODO: check validity of x,y etc.
@@ -200,6 +722,93 @@ void CCziSubBlockDirectory::UpdateStatistics(const SubBlkEntry& entry)
 	++this->statistics.subBlockCount;
 }
 
+void CCziSubBlockDirectory::MergeStatistics(const CCziSubBlockDirectory& other)
+{
+	const SubBlockStatistics& s = other.statistics;
+	CCziSubBlockDirectory::MergeBoundingBox(this->statistics.boundingBox, s.boundingBox);
+	CCziSubBlockDirectory::MergeBoundingBox(this->statistics.boundingBoxLayer0Only, s.boundingBoxLayer0Only);
+	CziUtils::EnumAllCoordinateDimensions(
+		[&](libCZI::DimensionIndex dim)->bool
+	{
+		int start, size;
+		if (s.dimBounds.TryGetInterval(dim, &start, &size) == true)
+		{
+			int startThis, sizeThis;
+			if (this->statistics.dimBounds.TryGetInterval(dim, &startThis, &sizeThis) == false)
+			{
+				this->statistics.dimBounds.Set(dim, start, size);
+			}
+			else
+			{
+				int end = (std::max)(start + size, startThis + sizeThis);
+				startThis = (std::min)(start, startThis);
+				this->statistics.dimBounds.Set(dim, startThis, end - startThis);
+			}
+		}
+
+		return true;
+	});
+
+	this->statistics.minMindex = (std::min)(this->statistics.minMindex, s.minMindex);
+	this->statistics.maxMindex = (std::max)(this->statistics.maxMindex, s.maxMindex);
+
+	for (const auto& sceneBoundingBoxes : s.sceneBoundingBoxes)
+	{
+		auto it = this->statistics.sceneBoundingBoxes.find(sceneBoundingBoxes.first);
+		if (it == this->statistics.sceneBoundingBoxes.end())
+		{
+			this->statistics.sceneBoundingBoxes.insert(sceneBoundingBoxes);
+		}
+		else
+		{
+			CCziSubBlockDirectory::MergeBoundingBox(it->second.boundingBox, sceneBoundingBoxes.second.boundingBox);
+			CCziSubBlockDirectory::MergeBoundingBox(it->second.boundingBoxLayer0, sceneBoundingBoxes.second.boundingBoxLayer0);
+		}
+	}
+
+	// the layers are added in the order in which they appear in "other", so the result is the same as if
+	//  the sub-blocks had been added one by one
+	for (const auto& scenePyramidStatistics : other.pyramidStatistics.scenePyramidStatistics)
+	{
+		auto& vec = this->pyramidStatistics.scenePyramidStatistics[scenePyramidStatistics.first];
+		for (const auto& pls : scenePyramidStatistics.second)
+		{
+			auto it = std::find_if(vec.begin(), vec.end(), [&](const PyramidStatistics::PyramidLayerStatistics& i) {return pls.layerInfo.minificationFactor == i.layerInfo.minificationFactor && pls.layerInfo.pyramidLayerNo == i.layerInfo.pyramidLayerNo; });
+			if (it != vec.end())
+			{
+				it->count += pls.count;
+			}
+			else
+			{
+				vec.push_back(pls);
+			}
+		}
+	}
+
+	this->statistics.subBlockCount += s.subBlockCount;
+}
+
+/*static*/void CCziSubBlockDirectory::MergeBoundingBox(libCZI::IntRect& rect, const libCZI::IntRect& other)
+{
+	if (other.IsValid() == false)
+	{
+		return;
+	}
+
+	if (rect.IsValid() == false)
+	{
+		rect = other;
+		return;
+	}
+
+	int right = (std::max)(rect.x + rect.w, other.x + other.w);
+	int bottom = (std::max)(rect.y + rect.h, other.y + other.h);
+	rect.x = (std::min)(rect.x, other.x);
+	rect.y = (std::min)(rect.y, other.y);
+	rect.w = right - rect.x;
+	rect.h = bottom - rect.y;
+}
+
 /*static*/void CCziSubBlockDirectory::UpdateBoundingBox(libCZI::IntRect& rect, const SubBlkEntry& entry)
 {
 	if (rect.IsValid() == true)
@@ -381,4 +990,489 @@ void CCziSubBlockDirectory::SortPyramidStatistics()
 			return minificationFactorA < minificationFactorB;
 		});
 	}
-}
\ No newline at end of file
+}
+
+void CCziSubBlockDirectory::BuildPlaneIndex()
+{
+	this->planeKeyDimensions.clear();
+	this->firstSubBlockInChannel.clear();
+
+	// the key of a plane is a mixed-radix number - for every dimension there is a digit which is zero if the dimension
+	//  is not present, and "value - start + 1" otherwise (so the radix is "size + 1")
+	bool planeKeyUsable = true;
+	std::uint64_t weight = 1;
+	CziUtils::EnumAllCoordinateDimensions(
+		[&](libCZI::DimensionIndex dim)->bool
+	{
+		int start, size;
+		if (this->statistics.dimBounds.TryGetInterval(dim, &start, &size) == true)
+		{
+			PlaneKeyDimension pkd{ dim, start, size, weight };
+			this->planeKeyDimensions.push_back(pkd);
+			const std::uint64_t radix = static_cast<std::uint64_t>(size) + 1;
+			if (weight > (std::numeric_limits<std::uint64_t>::max)() / radix)
+			{
+				planeKeyUsable = false;
+				return false;
+			}
+
+			weight *= radix;
+		}
+
+		return true;
+	});
+
+	if (planeKeyUsable == false)
+	{
+		// we cannot represent the key with 64 bits, so EnumSubset will look at all planes
+		this->planeKeyDimensions.clear();
+	}
+
+	// group the sub-blocks by sorting them by plane and pyramid-layer - if the plane-key cannot be used, the distinct
+	//  plane-coordinates are numbered instead (which requires a dictionary of them)
+	struct PlaneAndLayerItem
+	{
+		std::uint64_t plane;
+		std::uint16_t layerInfo;
+		int index;
+	};
+
+	const size_t count = this->GetSubBlockCount();
+	std::vector<PlaneAndLayerItem> items(count);
+	std::map<std::vector<int>, std::uint64_t> planeNumbers;
+	SubBlkEntry buffer;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const SubBlkEntry& entry = this->GetEntry((int)i, buffer);
+		PyramidStatistics::PyramidLayerInfo pli;
+		if (CCziSubBlockDirectory::TryToDeterminePyramidLayerInfo(entry, &pli.minificationFactor, &pli.pyramidLayerNo) == false)
+		{
+			pli.minificationFactor = pli.pyramidLayerNo = 0xff;
+		}
+
+		PlaneAndLayerItem& item = items[i];
+		item.index = (int)i;
+		item.layerInfo = (std::uint16_t)((pli.minificationFactor << 8) | pli.pyramidLayerNo);
+		if (this->planeKeyDimensions.empty())
+		{
+			item.plane = planeNumbers.insert(std::make_pair(CCziSubBlockDirectory::GetCoordinateKey(entry.coordinate), (std::uint64_t)planeNumbers.size())).first->second;
+		}
+		else
+		{
+			// this cannot fail, since the dimension-bounds contain all sub-blocks
+			this->TryGetPlaneKey(&entry.coordinate, &item.plane);
+		}
+
+		int c;
+		if (entry.coordinate.TryGetPosition(DimensionIndex::C, &c) == true)
+		{
+			// insert does not overwrite an existing entry, so we get the lowest index
+			this->firstSubBlockInChannel.insert(std::make_pair(c, (int)i));
+		}
+	}
+
+	planeNumbers.clear();
+	std::sort(items.begin(), items.end(),
+		[](const PlaneAndLayerItem& a, const PlaneAndLayerItem& b)->bool
+	{
+		return std::tie(a.plane, a.layerInfo, a.index) < std::tie(b.plane, b.layerInfo, b.index);
+	});
+
+	size_t planeAndLayerCount = 0, planeCount = 0;
+	std::uint16_t maxLayerInfo = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (i == 0 || items[i].plane != items[i - 1].plane)
+		{
+			++planeCount;
+			++planeAndLayerCount;
+		}
+		else if (items[i].layerInfo != items[i - 1].layerInfo)
+		{
+			++planeAndLayerCount;
+		}
+
+		maxLayerInfo = (std::max)(maxLayerInfo, items[i].layerInfo);
+	}
+
+	if (this->planeKeyDimensions.empty())
+	{
+		planeCount = 0;
+	}
+
+	this->planeItems.Reset(count, count > 0 ? count - 1 : 0);
+	this->planeItemStart.Reset(planeAndLayerCount + 1, count);
+	this->planeLayerInfo.Reset(planeAndLayerCount, maxLayerInfo);
+	this->planeKeys.Reset(planeCount, planeCount > 0 ? items.back().plane : 0);
+	this->planeKeyStart.Reset(planeCount > 0 ? planeCount + 1 : 0, planeAndLayerCount);
+	size_t planeAndLayer = 0, plane = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const bool isNewPlane = i == 0 || items[i].plane != items[i - 1].plane;
+		if (isNewPlane == true || items[i].layerInfo != items[i - 1].layerInfo)
+		{
+			if (isNewPlane == true && planeCount > 0)
+			{
+				this->planeKeys.Set(plane, items[i].plane);
+				this->planeKeyStart.Set(plane++, planeAndLayer);
+			}
+
+			this->planeLayerInfo.Set(planeAndLayer, items[i].layerInfo);
+			this->planeItemStart.Set(planeAndLayer++, i);
+		}
+
+		this->planeItems.Set(i, (std::uint64_t)items[i].index);
+	}
+
+	this->planeItemStart.Set(planeAndLayerCount, count);
+	if (planeCount > 0)
+	{
+		this->planeKeyStart.Set(planeCount, planeAndLayerCount);
+	}
+}
+
+void CCziSubBlockDirectory::BuildSpatialIndex()
+{
+	this->spatialIndices.clear();
+	auto getRect = [this](int index)->IntRect {return this->GetLogicalRect(index); };
+	std::vector<int> items;
+	for (size_t i = 0; i < this->planeLayerInfo.GetCount(); ++i)
+	{
+		const size_t firstItem = (size_t)this->planeItemStart.Get(i);
+		const size_t endItem = (size_t)this->planeItemStart.Get(i + 1);
+		if (endItem - firstItem >= CCziSubBlockDirectory::SPATIALINDEXMINSUBBLOCKS)
+		{
+			items.clear();
+			for (size_t n = firstItem; n < endItem; ++n)
+			{
+				items.push_back((int)this->planeItems.Get(n));
+			}
+
+			std::unique_ptr<CSubBlockSpatialIndex> spatialIndex(new CSubBlockSpatialIndex());
+			spatialIndex->Build(items, getRect);
+			this->spatialIndices.push_back(std::make_pair((std::uint32_t)i, std::move(spatialIndex)));
+		}
+	}
+}
+
+bool CCziSubBlockDirectory::TryGetPlaneKey(const libCZI::IDimCoordinate* coordinate, std::uint64_t* key) const
+{
+	std::uint64_t k = 0;
+	for (const auto& pkd : this->planeKeyDimensions)
+	{
+		int value;
+		if (coordinate->TryGetPosition(pkd.dim, &value) == true)
+		{
+			if (value < pkd.start || value >= pkd.start + pkd.size)
+			{
+				return false;
+			}
+
+			k += pkd.weight * static_cast<std::uint64_t>(value - pkd.start + 1);
+		}
+	}
+
+	*key = k;
+	return true;
+}
+
+bool CCziSubBlockDirectory::TryGetPlaneRange(const libCZI::IDimCoordinate* planeCoordinate, size_t* firstPlane, size_t* endPlane) const
+{
+	if (this->planeKeyDimensions.empty())
+	{
+		return false;
+	}
+
+	// CompareCoordinate requires the dimensions given in planeCoordinate to be present with the same value, additional
+	//  dimensions of the sub-block are ignored - so the key can only be used if planeCoordinate gives all dimensions
+	bool allDimensionsGiven = true;
+	CziUtils::EnumAllCoordinateDimensions(
+		[&](libCZI::DimensionIndex dim)->bool
+	{
+		if (planeCoordinate->TryGetPosition(dim, nullptr) != this->statistics.dimBounds.TryGetInterval(dim, nullptr, nullptr))
+		{
+			allDimensionsGiven = false;
+			return false;
+		}
+
+		return true;
+	});
+
+	if (allDimensionsGiven == false)
+	{
+		return false;
+	}
+
+	std::uint64_t key;
+	if (this->TryGetPlaneKey(planeCoordinate, &key) == true)
+	{
+		// binary search in the (ascending) keys
+		size_t low = 0, high = this->planeKeys.GetCount();
+		while (low < high)
+		{
+			const size_t mid = low + (high - low) / 2;
+			if (this->planeKeys.Get(mid) < key)
+			{
+				low = mid + 1;
+			}
+			else
+			{
+				high = mid;
+			}
+		}
+
+		if (low < this->planeKeys.GetCount() && this->planeKeys.Get(low) == key)
+		{
+			*firstPlane = (size_t)this->planeKeyStart.Get(low);
+			*endPlane = (size_t)this->planeKeyStart.Get(low + 1);
+			return true;
+		}
+	}
+
+	// there is no such plane
+	*firstPlane = *endPlane = 0;
+	return true;
+}
+
+const CSubBlockSpatialIndex* CCziSubBlockDirectory::GetSpatialIndex(size_t planeAndLayer) const
+{
+	auto it = std::lower_bound(this->spatialIndices.cbegin(), this->spatialIndices.cend(), planeAndLayer,
+		[](const std::pair<std::uint32_t, std::unique_ptr<CSubBlockSpatialIndex>>& spatialIndex, size_t value)->bool
+	{
+		return spatialIndex.first < value;
+	});
+
+	return (it != this->spatialIndices.cend() && it->first == planeAndLayer) ? it->second.get() : nullptr;
+}
+
+void CCziSubBlockDirectory::AppendEntry(const SubBlkEntry& entry)
+{
+	this->subBlks.push_back(entry);
+	if (this->useCompactRepresentation == true && this->subBlks.size() >= CCziSubBlockDirectory::COMPACTCHUNKSIZE)
+	{
+		this->CompactPendingEntries();
+	}
+}
+
+void CCziSubBlockDirectory::CompactPendingEntries()
+{
+	const size_t count = this->subBlks.size();
+	if (count == 0)
+	{
+		return;
+	}
+
+	// determine the ranges of the values in this chunk, and look up the formats in the dictionary
+	const int dimCount = (int)DimensionIndex::MaxDim + 1;
+	std::int64_t minDim[dimCount], maxDim[dimCount];
+	bool dimPresent[dimCount] = {};
+	std::int64_t minX = 0, maxX = 0, minY = 0, maxY = 0, minM = 0, maxM = 0;
+	std::uint64_t minFilePosition = 0, maxFilePosition = 0;
+	bool mIndexFound = false;
+	std::vector<std::uint32_t> formatIndex(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const SubBlkEntry& entry = this->subBlks[i];
+		minX = (i == 0) ? entry.x : (std::min)(minX, (std::int64_t)entry.x);
+		maxX = (i == 0) ? entry.x : (std::max)(maxX, (std::int64_t)entry.x);
+		minY = (i == 0) ? entry.y : (std::min)(minY, (std::int64_t)entry.y);
+		maxY = (i == 0) ? entry.y : (std::max)(maxY, (std::int64_t)entry.y);
+		minFilePosition = (i == 0) ? entry.FilePosition : (std::min)(minFilePosition, entry.FilePosition);
+		maxFilePosition = (i == 0) ? entry.FilePosition : (std::max)(maxFilePosition, entry.FilePosition);
+		if (entry.IsMIndexValid())
+		{
+			minM = mIndexFound ? (std::min)(minM, (std::int64_t)entry.mIndex) : entry.mIndex;
+			maxM = mIndexFound ? (std::max)(maxM, (std::int64_t)entry.mIndex) : entry.mIndex;
+			mIndexFound = true;
+		}
+
+		CziUtils::EnumAllCoordinateDimensions(
+			[&](libCZI::DimensionIndex dim)->bool
+		{
+			int value;
+			if (entry.coordinate.TryGetPosition(dim, &value) == true)
+			{
+				const int d = (int)dim;
+				minDim[d] = dimPresent[d] ? (std::min)(minDim[d], (std::int64_t)value) : value;
+				maxDim[d] = dimPresent[d] ? (std::max)(maxDim[d], (std::int64_t)value) : value;
+				dimPresent[d] = true;
+			}
+
+			return true;
+		});
+
+		SubBlkFormat format{ entry.width, entry.height, entry.storedWidth, entry.storedHeight, entry.PixelType, entry.Compression };
+		auto it = this->formatIndices.insert(std::make_pair(format, (std::uint32_t)this->formats.size()));
+		if (it.second == true)
+		{
+			this->formats.push_back(format);
+		}
+
+		formatIndex[i] = it.first->second;
+	}
+
+	CompactSubBlkChunk chunk;
+	chunk.minX = (int)minX;
+	chunk.minY = (int)minY;
+	chunk.minMIndex = (int)minM;
+	chunk.minFilePosition = minFilePosition;
+	CziUtils::EnumAllCoordinateDimensions(
+		[&](libCZI::DimensionIndex dim)->bool
+	{
+		if (dimPresent[(int)dim] == true)
+		{
+			CompactDimensionColumn column;
+			column.dim = dim;
+			column.start = (int)minDim[(int)dim];
+			column.values.Reset(count, (std::uint64_t)(maxDim[(int)dim] - minDim[(int)dim] + 1));
+			chunk.dimensions.push_back(std::move(column));
+		}
+
+		return true;
+	});
+
+	chunk.formatIndex.Reset(count, this->formats.size() - 1);
+	chunk.mIndex.Reset(count, mIndexFound ? (std::uint64_t)(maxM - minM + 1) : 0);
+	chunk.x.Reset(count, (std::uint64_t)(maxX - minX));
+	chunk.y.Reset(count, (std::uint64_t)(maxY - minY));
+	chunk.filePosition.Reset(count, maxFilePosition - minFilePosition);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const SubBlkEntry& entry = this->subBlks[i];
+		for (auto& column : chunk.dimensions)
+		{
+			int value;
+			if (entry.coordinate.TryGetPosition(column.dim, &value) == true)
+			{
+				column.values.Set(i, (std::uint64_t)((std::int64_t)value - column.start + 1));
+			}
+		}
+
+		chunk.formatIndex.Set(i, formatIndex[i]);
+		chunk.mIndex.Set(i, entry.IsMIndexValid() ? (std::uint64_t)((std::int64_t)entry.mIndex - minM + 1) : 0);
+		chunk.x.Set(i, (std::uint64_t)((std::int64_t)entry.x - minX));
+		chunk.y.Set(i, (std::uint64_t)((std::int64_t)entry.y - minY));
+		chunk.filePosition.Set(i, entry.FilePosition - minFilePosition);
+	}
+
+	chunk.dimensions.shrink_to_fit();
+	this->compactChunks.push_back(std::move(chunk));
+	this->compactCount += count;
+	this->subBlks.clear();
+}
+
+void CCziSubBlockDirectory::FinishCompactRepresentation()
+{
+	// the last chunk may contain less than COMPACTCHUNKSIZE entries, and from now on the entries are only available
+	//  from the compact representation
+	this->CompactPendingEntries();
+	std::vector<SubBlkEntry>().swap(this->subBlks);
+	this->formatIndices.clear();
+	this->formats.shrink_to_fit();
+	this->compactChunks.shrink_to_fit();
+}
+
+const CCziSubBlockDirectory::SubBlkEntry& CCziSubBlockDirectory::GetEntry(int index, SubBlkEntry& buffer) const
+{
+	if (index < 0 || (size_t)index >= this->GetSubBlockCount())
+	{
+		throw std::out_of_range("invalid sub-block index");
+	}
+
+	if ((size_t)index >= this->compactCount)
+	{
+		return this->subBlks[index - this->compactCount];
+	}
+
+	const CompactSubBlkChunk& chunk = this->compactChunks[index / CCziSubBlockDirectory::COMPACTCHUNKSIZE];
+	const size_t i = index % CCziSubBlockDirectory::COMPACTCHUNKSIZE;
+	const SubBlkFormat& format = this->formats[(size_t)chunk.formatIndex.Get(i)];
+	this->GetCoordinate(index, buffer.coordinate);
+	std::uint64_t m = chunk.mIndex.Get(i);
+	buffer.mIndex = m != 0 ? (int)(chunk.minMIndex + (std::int64_t)m - 1) : (std::numeric_limits<int>::min)();
+	buffer.x = (int)(chunk.minX + (std::int64_t)chunk.x.Get(i));
+	buffer.y = (int)(chunk.minY + (std::int64_t)chunk.y.Get(i));
+	buffer.width = format.width;
+	buffer.height = format.height;
+	buffer.storedWidth = format.storedWidth;
+	buffer.storedHeight = format.storedHeight;
+	buffer.PixelType = format.PixelType;
+	buffer.FilePosition = chunk.minFilePosition + chunk.filePosition.Get(i);
+	buffer.Compression = format.Compression;
+	return buffer;
+}
+
+void CCziSubBlockDirectory::GetCoordinate(int index, libCZI::CDimCoordinate& coordinate) const
+{
+	if ((size_t)index >= this->compactCount)
+	{
+		coordinate = this->subBlks[index - this->compactCount].coordinate;
+		return;
+	}
+
+	const CompactSubBlkChunk& chunk = this->compactChunks[index / CCziSubBlockDirectory::COMPACTCHUNKSIZE];
+	const size_t i = index % CCziSubBlockDirectory::COMPACTCHUNKSIZE;
+	coordinate = libCZI::CDimCoordinate();
+	for (const auto& column : chunk.dimensions)
+	{
+		std::uint64_t value = column.values.Get(i);
+		if (value != 0)
+		{
+			coordinate.Set(column.dim, (int)(column.start + (std::int64_t)value - 1));
+		}
+	}
+}
+
+libCZI::IntRect CCziSubBlockDirectory::GetLogicalRect(int index) const
+{
+	if ((size_t)index >= this->compactCount)
+	{
+		const SubBlkEntry& entry = this->subBlks[index - this->compactCount];
+		return IntRect{ entry.x, entry.y, entry.width, entry.height };
+	}
+
+	const CompactSubBlkChunk& chunk = this->compactChunks[index / CCziSubBlockDirectory::COMPACTCHUNKSIZE];
+	const size_t i = index % CCziSubBlockDirectory::COMPACTCHUNKSIZE;
+	const SubBlkFormat& format = this->formats[(size_t)chunk.formatIndex.Get(i)];
+	return IntRect{ (int)(chunk.minX + (std::int64_t)chunk.x.Get(i)), (int)(chunk.minY + (std::int64_t)chunk.y.Get(i)), format.width, format.height };
+}
+
+/*static*/std::vector<int> CCziSubBlockDirectory::GetCoordinateKey(const libCZI::CDimCoordinate& coordinate)
+{
+	// the key contains a bitfield for the valid dimensions, followed by the values for the dimensions
+	std::vector<int> key(1, 0);
+	CziUtils::EnumAllCoordinateDimensions(
+		[&](libCZI::DimensionIndex dim)->bool
+	{
+		int value;
+		if (coordinate.TryGetPosition(dim, &value))
+		{
+			key[0] |= (1 << (int)dim);
+			key.push_back(value);
+		}
+
+		return true;
+	});
+
+	return key;
+}
+
+/*static*/bool CCziSubBlockDirectory::IsInSubset(const SubBlkEntry& entry, const libCZI::IDimCoordinate* planeCoordinate, const libCZI::IntRect* roi, bool onlyLayer0)
+{
+	if (onlyLayer0 == true && entry.IsStoredSizeEqualLogicalSize() == false)
+	{
+		return false;
+	}
+
+	if (planeCoordinate != nullptr && CziUtils::CompareCoordinate(planeCoordinate, &entry.coordinate) == false)
+	{
+		return false;
+	}
+
+	if (roi != nullptr && Utilities::DoIntersect(*roi, IntRect{ entry.x, entry.y, entry.width, entry.height }) == false)
+	{
+		return false;
+	}
+
+	return true;
+}
@@ -23,7 +23,15 @@
 #pragma once
 
 #include <functional>
+#include <map>
+#include <tuple>
+#include <unordered_map>
 #include "libCZI.h"
+#include "SubBlockSpatialIndex.h"
+#include "PackedIntVector.h"
+
+class CSidecarIndexWriter;
+class CSidecarIndexReader;
 
 class CCziSubBlockDirectory
 {
@@ -58,10 +66,90 @@ public:
 		}
 	};
 
+	/// The number of entries in a chunk of the compact representation. The entries are converted into this representation
+	/// whenever this number of entries has been added, so the uncompressed entries only have to be held for one chunk.
+	static const size_t COMPACTCHUNKSIZE = 4096;
+
 private:
+	/// A dimension which is part of the plane-key, the digit for this dimension is multiplied with "weight".
+	struct PlaneKeyDimension
+	{
+		libCZI::DimensionIndex dim;
+		int start;
+		int size;
+		std::uint64_t weight;
+	};
+
+	/// The properties of a sub-block which typically only have a small number of distinct values in a document.
+	struct SubBlkFormat
+	{
+		int width;
+		int height;
+		int storedWidth;
+		int storedHeight;
+		int PixelType;
+		int Compression;
+
+		bool operator<(const SubBlkFormat& other) const
+		{
+			return std::tie(this->width, this->height, this->storedWidth, this->storedHeight, this->PixelType, this->Compression) <
+				std::tie(other.width, other.height, other.storedWidth, other.storedHeight, other.PixelType, other.Compression);
+		}
+	};
+
+	/// A dimension of the plane-coordinate in a chunk, the value is stored as "value - start + 1" (or zero if the
+	/// sub-block does not have this dimension).
+	struct CompactDimensionColumn
+	{
+		libCZI::DimensionIndex dim;
+		int start;
+		CPackedIntVector values;
+	};
+
+	/// Up to COMPACTCHUNKSIZE consecutive sub-block entries in a column-oriented representation (only the last chunk
+	/// may contain less entries). Every column is bit-packed, using the number of bits required for the range of its
+	/// values within the chunk.
+	struct CompactSubBlkChunk
+	{
+		int minX, minY, minMIndex;
+		std::uint64_t minFilePosition;
+		std::vector<CompactDimensionColumn> dimensions;
+		CPackedIntVector formatIndex;		///< Index into "formats".
+		CPackedIntVector mIndex;			///< The M-index minus minMIndex plus one, or zero if the M-index is not valid.
+		CPackedIntVector x;					///< The x-position minus minX.
+		CPackedIntVector y;					///< The y-position minus minY.
+		CPackedIntVector filePosition;		///< The file-position minus minFilePosition.
+	};
+
+	/// The sub-block entries - with the compact representation, only those which are not yet part of a chunk.
 	std::vector<SubBlkEntry> subBlks;
+	bool useCompactRepresentation;
+	std::vector<CompactSubBlkChunk> compactChunks;
+	size_t compactCount;									///< The number of entries in "compactChunks".
+	std::vector<SubBlkFormat> formats;						///< The distinct formats of the entries in "compactChunks".
+	std::map<SubBlkFormat, std::uint32_t> formatIndices;	///< The index in "formats" of a format, only used while adding.
 	libCZI::SubBlockStatistics statistics;
 	libCZI::PyramidStatistics pyramidStatistics;
+
+	/// The "planes-and-layers" are the groups of sub-blocks with the same plane-coordinate and on the same pyramid-layer.
+	/// The sub-blocks of the i-th group are given by the elements "planeItemStart[i]" up to (excluding) "planeItemStart[i+1]"
+	/// of "planeItems" (in ascending order), and all layers of a plane are adjacent.
+	CPackedIntVector planeItems;
+	CPackedIntVector planeItemStart;
+	CPackedIntVector planeLayerInfo;	///< The pyramid-layer of a group, as "minificationFactor * 256 + pyramidLayerNo".
+
+	/// The spatial indices, sorted by the index of the group. A spatial index is only built for groups with at least
+	/// SPATIALINDEXMINSUBBLOCKS sub-blocks, smaller ones are scanned linearly.
+	std::vector<std::pair<std::uint32_t, std::unique_ptr<CSubBlockSpatialIndex>>> spatialIndices;
+	std::vector<PlaneKeyDimension> planeKeyDimensions;
+	CPackedIntVector planeKeys;			///< The (ascending) keys of the planes, only if "planeKeyDimensions" is not empty.
+	CPackedIntVector planeKeyStart;		///< The first group of the plane with the key "planeKeys[i]" (with one additional element at the end).
+	std::unordered_map<int, int> firstSubBlockInChannel;
+
+	/// The minimum number of sub-blocks in a plane-and-layer for building a spatial index - for less sub-blocks, a linear
+	/// scan is fast enough, and the index would take more memory than the sub-block entries themselves.
+	static const std::uint32_t SPATIALINDEXMINSUBBLOCKS = 32;
+
 	enum class State
 	{
 		AddingAllowed,
@@ -71,19 +159,91 @@ private:
 public:
 	CCziSubBlockDirectory();
 
+	/// Constructor.
+	///
+	/// \param useCompactRepresentation If true, then the sub-block entries are converted into a compact (column-oriented)
+	/// 								 representation in chunks of COMPACTCHUNKSIZE entries while they are added. This
+	/// 								 reduces the memory consumption considerably, at the expense of the entries being
+	/// 								 reconstructed when accessed.
+	explicit CCziSubBlockDirectory(bool useCompactRepresentation);
+
+	/// Gets whether the compact representation is used.
+	///
+	/// \return True if the compact representation is used, false otherwise.
+	bool GetUseCompactRepresentation() const { return this->useCompactRepresentation; }
+
 	const libCZI::SubBlockStatistics& GetStatistics() const;
 	const libCZI::PyramidStatistics& GetPyramidStatistics() const;
 
 	void AddSubBlock(const SubBlkEntry& entry);
+
+	/// Adds all sub-blocks of the specified directory (after the sub-blocks already present), and merges
+	/// its statistics into the statistics of this object. This allows to build partial directories
+	/// concurrently. Both objects must still allow adding. If both use the compact representation and the number of
+	/// sub-blocks in this object is a multiple of COMPACTCHUNKSIZE, the chunks are taken over without being decoded.
+	///
+	/// \param other The directory whose sub-blocks are to be added (it is left in an unspecified state).
+	void AddSubBlocks(CCziSubBlockDirectory&& other);
 	void AddingFinished();
 
 	void EnumSubBlocks(std::function<bool(int index, const SubBlkEntry&)> func);
+
+	/// Enumerate the sub-blocks on the specified plane which intersect with the specified ROI. The sub-blocks are
+	/// enumerated in the order of their index. If adding has been finished, a spatial index (per plane and
+	/// pyramid-layer) is used, otherwise all sub-blocks are examined.
+	///
+	/// \param planeCoordinate The plane coordinate (if null, all planes are considered).
+	/// \param roi			   The ROI (if null, sub-blocks are not filtered by their position).
+	/// \param onlyLayer0	   If true, then only sub-blocks on pyramid-layer 0 will be considered.
+	/// \param func			   The functor which will be called for every sub-block. If the return value of the
+	/// 					   functor is true, the enumeration is continued, otherwise it is stopped.
+	void EnumSubset(const libCZI::IDimCoordinate* planeCoordinate, const libCZI::IntRect* roi, bool onlyLayer0, std::function<bool(int index, const SubBlkEntry&)> func);
+
+	/// Try to get the sub-block with the lowest index which has the specified C-index.
+	///
+	/// \param channelIndex The C-index.
+	/// \param index		 [out] The index of the sub-block.
+	///
+	/// \return True if a sub-block was found, false otherwise.
+	bool TryGetFirstSubBlockInChannel(int channelIndex, int* index);
 	bool TryGetSubBlock(int index, SubBlkEntry& entry);
 
+	/// Gets the number of sub-blocks.
+	///
+	/// \return The number of sub-blocks.
+	size_t GetSubBlockCount() const;
+
+	/// Serializes the directory (including the statistics and the indices) for the sidecar-index. Adding must have
+	/// been finished.
+	///
+	/// \param [in,out] writer The writer.
+	void Serialize(CSidecarIndexWriter& writer) const;
+
+	/// De-serializes the directory from the sidecar-index. The object must be empty (and allowing to add), after this
+	/// call adding is finished. If the data is inconsistent, an exception is thrown.
+	///
+	/// \param [in,out] reader The reader.
+	void Deserialize(CSidecarIndexReader& reader);
+
 private:
 	void UpdateStatistics(const SubBlkEntry& entry);
 	void SortPyramidStatistics();
+	void AppendEntry(const SubBlkEntry& entry);
+	void CompactPendingEntries();
+	void FinishCompactRepresentation();
+	void BuildPlaneIndex();
+	void BuildSpatialIndex();
+	bool TryGetPlaneKey(const libCZI::IDimCoordinate* coordinate, std::uint64_t* key) const;
+	bool TryGetPlaneRange(const libCZI::IDimCoordinate* planeCoordinate, size_t* firstPlane, size_t* endPlane) const;
+	const CSubBlockSpatialIndex* GetSpatialIndex(size_t planeAndLayer) const;
+	const SubBlkEntry& GetEntry(int index, SubBlkEntry& buffer) const;
+	void GetCoordinate(int index, libCZI::CDimCoordinate& coordinate) const;
+	libCZI::IntRect GetLogicalRect(int index) const;
+	static std::vector<int> GetCoordinateKey(const libCZI::CDimCoordinate& coordinate);
+	static bool IsInSubset(const SubBlkEntry& entry, const libCZI::IDimCoordinate* planeCoordinate, const libCZI::IntRect* roi, bool onlyLayer0);
+	void MergeStatistics(const CCziSubBlockDirectory& other);
 	static void UpdateBoundingBox(libCZI::IntRect& rect, const SubBlkEntry& entry);
+	static void MergeBoundingBox(libCZI::IntRect& rect, const libCZI::IntRect& other);
 	static bool TryToDeterminePyramidLayerInfo(const SubBlkEntry& entry, std::uint8_t* minificationFactor, std::uint8_t* pyramidLayerNo);
 	static void UpdatePyramidLayerStatistics(std::vector<libCZI::PyramidStatistics::PyramidLayerStatistics>& vec, const libCZI::PyramidStatistics::PyramidLayerInfo& pli);
 };
@@ -0,0 +1,126 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#include "stdafx.h"
+#include "NNResizePlanCache.h"
+
+using namespace std;
+
+bool CNNResizePlanCache::Key::operator==(const Key& other) const
+{
+	return this->srcWidth == other.srcWidth && this->srcHeight == other.srcHeight &&
+		this->srcOffsetX == other.srcOffsetX && this->srcOffsetY == other.srcOffsetY &&
+		this->srcRoiX == other.srcRoiX && this->srcRoiY == other.srcRoiY && this->srcRoiW == other.srcRoiW && this->srcRoiH == other.srcRoiH &&
+		this->dstRoiPhaseX == other.dstRoiPhaseX && this->dstRoiPhaseY == other.dstRoiPhaseY && this->dstRoiW == other.dstRoiW && this->dstRoiH == other.dstRoiH &&
+		this->dstXStart == other.dstXStart && this->dstXEnd == other.dstXEnd && this->dstYStart == other.dstYStart && this->dstYEnd == other.dstYEnd;
+}
+
+size_t CNNResizePlanCache::KeyHash::operator()(const Key& key) const
+{
+	size_t h = std::hash<int>()(key.srcWidth);
+	auto combine = [&](size_t v)->void { h ^= v + 0x9e3779b9u + (h << 6) + (h >> 2); };
+	combine(std::hash<int>()(key.srcHeight));
+	combine(std::hash<int>()(key.srcOffsetX));
+	combine(std::hash<int>()(key.srcOffsetY));
+	combine(std::hash<double>()(key.srcRoiX));
+	combine(std::hash<double>()(key.srcRoiY));
+	combine(std::hash<double>()(key.srcRoiW));
+	combine(std::hash<double>()(key.srcRoiH));
+	combine(std::hash<double>()(key.dstRoiPhaseX));
+	combine(std::hash<double>()(key.dstRoiPhaseY));
+	combine(std::hash<double>()(key.dstRoiW));
+	combine(std::hash<double>()(key.dstRoiH));
+	combine(std::hash<int>()(key.dstXStart));
+	combine(std::hash<int>()(key.dstXEnd));
+	combine(std::hash<int>()(key.dstYStart));
+	combine(std::hash<int>()(key.dstYEnd));
+	return h;
+}
+
+CNNResizePlanCache::CNNResizePlanCache(size_t maxCount)
+	: maxCount(maxCount)
+{
+}
+
+std::shared_ptr<const CBitmapOperations::NNResizePlan> CNNResizePlanCache::GetOrCreate(const CBitmapOperations::NNResizeInfo2Dbl& resizeInfo)
+{
+	const Key key = GetKey(resizeInfo);
+	{
+		std::lock_guard<std::mutex> lck(this->mutex);
+		auto it = this->entriesByKey.find(key);
+		if (it != this->entriesByKey.end())
+		{
+			// move the entry to the front (making it the most recently used one)
+			this->entries.splice(this->entries.begin(), this->entries, it->second);
+			return it->second->plan;
+		}
+	}
+
+	// the plan is created without holding the lock - if another thread creates the same plan concurrently, the
+	// plan added last replaces the other one (which is still valid)
+	auto plan = make_shared<CBitmapOperations::NNResizePlan>();
+	CBitmapOperations::CreateNNResizePlan(resizeInfo, *plan);
+
+	std::lock_guard<std::mutex> lck(this->mutex);
+	auto it = this->entriesByKey.find(key);
+	if (it != this->entriesByKey.end())
+	{
+		this->entries.erase(it->second);
+		this->entriesByKey.erase(it);
+	}
+
+	if (this->maxCount > 0)
+	{
+		this->entries.emplace_front(Entry{ key, plan });
+		this->entriesByKey[key] = this->entries.begin();
+		while (this->entries.size() > this->maxCount)
+		{
+			this->entriesByKey.erase(this->entries.back().key);
+			this->entries.pop_back();
+		}
+	}
+
+	return plan;
+}
+
+size_t CNNResizePlanCache::GetCount()
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	return this->entries.size();
+}
+
+/*static*/CNNResizePlanCache::Key CNNResizePlanCache::GetKey(const CBitmapOperations::NNResizeInfo2Dbl& resizeInfo)
+{
+	// the size of the destination bitmap and the integral part of the position of the destination-ROI only matter for
+	// the range of pixels which are drawn
+	int originX, originY;
+	CBitmapOperations::GetNNResizeOrigin(resizeInfo, originX, originY);
+	CBitmapOperations::NNResizePlan range;
+	CBitmapOperations::CalcNNResizeRange(resizeInfo, range);
+	return Key{
+		resizeInfo.srcWidth, resizeInfo.srcHeight,
+		resizeInfo.srcOffsetX, resizeInfo.srcOffsetY,
+		resizeInfo.srcRoiX, resizeInfo.srcRoiY, resizeInfo.srcRoiW, resizeInfo.srcRoiH,
+		resizeInfo.dstRoiX - originX, resizeInfo.dstRoiY - originY,
+		resizeInfo.dstRoiW, resizeInfo.dstRoiH,
+		range.dstXStart, range.dstXEnd, range.dstYStart, range.dstYEnd };
+}
@@ -0,0 +1,89 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "BitmapOperations.h"
+
+/// A cache for the plans of nearest-neighbor resizes (see CBitmapOperations::NNResizePlan), so that bitmaps with the same
+/// geometry (e. g. the tiles of a mosaic which are scaled in the same way, the tiles of the different channels of a
+/// multi-channel image, or the same view being rendered again) do not have to compute the source pixels again. As the
+/// plan does not depend on the integral part of the position of the destination-ROI, this is not part of the key - only
+/// its fractional part and the range of pixels which are drawn (relative to it). The least recently used plans are
+/// removed when the number of plans exceeds the specified maximum. The cache can be used concurrently.
+class CNNResizePlanCache
+{
+private:
+	/// The parameters of a resize which determine the plan.
+	struct Key
+	{
+		int srcWidth, srcHeight;
+		int srcOffsetX, srcOffsetY;
+		double srcRoiX, srcRoiY, srcRoiW, srcRoiH;
+		double dstRoiPhaseX, dstRoiPhaseY;		///< The fractional part of the position of the destination-ROI (in (-1,1)).
+		double dstRoiW, dstRoiH;
+		int dstXStart, dstXEnd, dstYStart, dstYEnd;	///< The range of pixels drawn (relative to the integral part of the position).
+
+		bool operator==(const Key& other) const;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry
+	{
+		Key key;
+		std::shared_ptr<const CBitmapOperations::NNResizePlan> plan;
+	};
+
+	size_t maxCount;
+	std::mutex mutex;
+	std::list<Entry> entries;		///< The entries, the most recently used one first.
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entriesByKey;
+public:
+	/// Constructor.
+	///
+	/// \param maxCount The maximum number of plans held in the cache.
+	explicit CNNResizePlanCache(size_t maxCount);
+
+	/// Gets the plan for the geometry given by the specified resize-info, the plan is created (and added to the cache)
+	/// if it is not in the cache.
+	///
+	/// \param resizeInfo The resize-info (only the geometry is used, not the pointers and strides).
+	///
+	/// \return The plan.
+	std::shared_ptr<const CBitmapOperations::NNResizePlan> GetOrCreate(const CBitmapOperations::NNResizeInfo2Dbl& resizeInfo);
+
+	/// Gets the number of plans in the cache.
+	///
+	/// \return The number of plans.
+	size_t GetCount();
+
+private:
+	static Key GetKey(const CBitmapOperations::NNResizeInfo2Dbl& resizeInfo);
+};
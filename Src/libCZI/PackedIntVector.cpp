@@ -0,0 +1,88 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#include "stdafx.h"
+#include "PackedIntVector.h"
+#include <limits>
+
+CPackedIntVector::CPackedIntVector() : bitsPerElement(0), count(0)
+{
+}
+
+void CPackedIntVector::Reset(size_t count, std::uint64_t maxValue)
+{
+	this->bitsPerElement = 0;
+	while (this->bitsPerElement < 64 && (maxValue >> this->bitsPerElement) != 0)
+	{
+		++this->bitsPerElement;
+	}
+
+	this->count = count;
+	this->data.assign((count * this->bitsPerElement + 63) / 64, 0);
+	this->data.shrink_to_fit();
+}
+
+void CPackedIntVector::Set(size_t index, std::uint64_t value)
+{
+	if (this->bitsPerElement == 0)
+	{
+		return;
+	}
+
+	const std::uint64_t mask = this->GetMask();
+	const size_t bitPosition = index * this->bitsPerElement;
+	const size_t word = bitPosition / 64;
+	const int shift = (int)(bitPosition % 64);
+	value &= mask;
+	this->data[word] = (this->data[word] & ~(mask << shift)) | (value << shift);
+	if (shift + this->bitsPerElement > 64)
+	{
+		// the element spans two words, the upper bits go into the next word
+		const int bitsInNextWord = shift + this->bitsPerElement - 64;
+		const std::uint64_t maskNextWord = (static_cast<std::uint64_t>(1) << bitsInNextWord) - 1;
+		this->data[word + 1] = (this->data[word + 1] & ~maskNextWord) | (value >> (64 - shift));
+	}
+}
+
+std::uint64_t CPackedIntVector::Get(size_t index) const
+{
+	if (this->bitsPerElement == 0)
+	{
+		return 0;
+	}
+
+	const size_t bitPosition = index * this->bitsPerElement;
+	const size_t word = bitPosition / 64;
+	const int shift = (int)(bitPosition % 64);
+	std::uint64_t value = this->data[word] >> shift;
+	if (shift + this->bitsPerElement > 64)
+	{
+		value |= this->data[word + 1] << (64 - shift);
+	}
+
+	return value & this->GetMask();
+}
+
+std::uint64_t CPackedIntVector::GetMask() const
+{
+	return this->bitsPerElement < 64 ? (static_cast<std::uint64_t>(1) << this->bitsPerElement) - 1 : (std::numeric_limits<std::uint64_t>::max)();
+}
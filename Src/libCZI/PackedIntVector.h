@@ -0,0 +1,72 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/// A vector of unsigned integers which are bit-packed - every element takes the number of bits
+/// which is required for the maximum value which is to be stored (so if the maximum value is zero,
+/// no memory is used at all).
+class CPackedIntVector
+{
+private:
+	std::vector<std::uint64_t> data;
+	std::uint8_t bitsPerElement;
+	size_t count;
+public:
+	CPackedIntVector();
+
+	/// Resets the vector so that it contains the specified number of elements (all zero), and the number
+	/// of bits per element is chosen so that values up to (and including) "maxValue" can be stored.
+	///
+	/// \param count    The number of elements.
+	/// \param maxValue The maximum value which is to be stored.
+	void Reset(size_t count, std::uint64_t maxValue);
+
+	/// Sets the element at the specified index. The value must not exceed the "maxValue" given with Reset.
+	///
+	/// \param index The index.
+	/// \param value The value.
+	void Set(size_t index, std::uint64_t value);
+
+	/// Gets the element at the specified index.
+	///
+	/// \param index The index.
+	///
+	/// \return The value.
+	std::uint64_t Get(size_t index) const;
+
+	/// Gets the number of elements.
+	///
+	/// \return The number of elements.
+	size_t GetCount() const { return this->count; }
+
+	/// Gets the number of bits used for an element.
+	///
+	/// \return The number of bits used for an element.
+	int GetBitsPerElement() const { return this->bitsPerElement; }
+private:
+	std::uint64_t GetMask() const;
+};
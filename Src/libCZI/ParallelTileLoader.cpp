@@ -0,0 +1,250 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#include "stdafx.h"
+#include "ParallelTileLoader.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+CParallelTileLoader::CParallelTileLoader(CThreadPool& threadPool, int count, int maxThreads, int prefetchDepth, std::function<void(int index)> readTile, std::function<void(int index)> decodeTile)
+	: threadPool(threadPool), count(count), prefetchDepth((std::max)(prefetchDepth, 0)), decodeThreadCount(0), readAhead(false), readTile(std::move(readTile)), decodeTile(std::move(decodeTile)),
+	runningTasks(0), decodingStarted(0), consumerIndex(0), nextIndex(0), cancelled(false)
+{
+	const int threadCount = (std::min)(maxThreads, count);
+	if (this->prefetchDepth > 0 && count > 0)
+	{
+		this->read.resize(count, false);
+		this->readExceptions.resize(count);
+	}
+
+	if (threadCount > 1)
+	{
+		this->loaded.resize(count, false);
+		this->exceptions.resize(count);
+	}
+
+	// The I/O-thread is started first, since the worker threads wait for it. If the pool cannot give us a thread, we do with
+	//  the threads we got (a task never waits for a task which has not been started, so this cannot deadlock).
+	try
+	{
+		this->readAhead = !this->read.empty() && this->TryStartThread(&CParallelTileLoader::ReadThread);
+		for (int i = 0; i < threadCount && !this->loaded.empty(); ++i)
+		{
+			{
+				std::lock_guard<std::mutex> lck(this->mutex);
+				++this->decodeThreadCount;
+			}
+
+			if (!this->TryStartThread(&CParallelTileLoader::DecodeThread))
+			{
+				std::lock_guard<std::mutex> lck(this->mutex);
+				--this->decodeThreadCount;
+				break;
+			}
+		}
+	}
+	catch (...)
+	{
+		this->Stop();
+		throw;
+	}
+}
+
+CParallelTileLoader::~CParallelTileLoader()
+{
+	this->Stop();
+}
+
+bool CParallelTileLoader::TryStartThread(void (CParallelTileLoader::*threadFunc)())
+{
+	{
+		std::lock_guard<std::mutex> lck(this->mutex);
+		++this->runningTasks;
+	}
+
+	bool started = false;
+	try
+	{
+		started = this->threadPool.TryExecute([this, threadFunc]()->void
+		{
+			(this->*threadFunc)();
+
+			// we notify while holding the lock, since the loader may be destroyed as soon as the lock is released
+			std::lock_guard<std::mutex> lck(this->mutex);
+			--this->runningTasks;
+			this->stateChanged.notify_all();
+		});
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lck(this->mutex);
+		--this->runningTasks;
+		throw;
+	}
+
+	if (!started)
+	{
+		std::lock_guard<std::mutex> lck(this->mutex);
+		--this->runningTasks;
+	}
+
+	return started;
+}
+
+void CParallelTileLoader::Stop()
+{
+	std::unique_lock<std::mutex> lck(this->mutex);
+	this->cancelled = true;
+	this->stateChanged.notify_all();
+	this->stateChanged.wait(lck, [this]()->bool {return this->runningTasks == 0; });
+}
+
+void CParallelTileLoader::WaitFor(int index)
+{
+	if (this->decodeThreadCount == 0)
+	{
+		this->LoadTile(index);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lck(this->mutex);
+	if (index > this->consumerIndex)
+	{
+		// this allows the worker threads to decode further ahead
+		this->consumerIndex = index;
+		this->stateChanged.notify_all();
+	}
+
+	this->stateChanged.wait(lck, [&]()->bool {return this->loaded[index]; });
+	if (this->exceptions[index])
+	{
+		std::rethrow_exception(this->exceptions[index]);
+	}
+}
+
+bool CParallelTileLoader::LoadTile(int index)
+{
+	if (!this->readAhead)
+	{
+		this->readTile(index);
+		this->decodeTile(index);
+		return true;
+	}
+
+	{
+		// starting to decode this tile allows the I/O-thread to read further ahead
+		std::unique_lock<std::mutex> lck(this->mutex);
+		this->decodingStarted = (std::max)(this->decodingStarted, index + 1);
+		this->stateChanged.notify_all();
+		this->stateChanged.wait(lck, [&]()->bool {return this->read[index] || this->cancelled; });
+		if (!this->read[index])
+		{
+			return false;
+		}
+
+		if (this->readExceptions[index])
+		{
+			std::rethrow_exception(this->readExceptions[index]);
+		}
+	}
+
+	this->decodeTile(index);
+	return true;
+}
+
+void CParallelTileLoader::ReadThread()
+{
+	for (int index = 0; index < this->count; ++index)
+	{
+		{
+			std::unique_lock<std::mutex> lck(this->mutex);
+			this->stateChanged.wait(lck, [&]()->bool {return this->cancelled || index < this->decodingStarted + this->prefetchDepth; });
+			if (this->cancelled)
+			{
+				return;
+			}
+		}
+
+		std::exception_ptr exception;
+		try
+		{
+			this->readTile(index);
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lck(this->mutex);
+			this->read[index] = true;
+			this->readExceptions[index] = exception;
+		}
+
+		this->stateChanged.notify_all();
+	}
+}
+
+void CParallelTileLoader::DecodeThread()
+{
+	// the tiles are taken in the order of their index, so that the tile which is needed next is loaded first
+	for (;;)
+	{
+		const int index = this->nextIndex++;
+		if (index >= this->count)
+		{
+			break;
+		}
+
+		{
+			// the decoded tiles are kept until they are consumed, so we must not get too far ahead of the caller
+			std::unique_lock<std::mutex> lck(this->mutex);
+			this->stateChanged.wait(lck, [&]()->bool {return this->cancelled || index < this->consumerIndex + this->decodeThreadCount + this->prefetchDepth; });
+			if (this->cancelled)
+			{
+				break;
+			}
+		}
+
+		std::exception_ptr exception;
+		try
+		{
+			if (!this->LoadTile(index))
+			{
+				break;
+			}
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lck(this->mutex);
+			this->loaded[index] = true;
+			this->exceptions[index] = exception;
+		}
+
+		this->stateChanged.notify_all();
+	}
+}
@@ -0,0 +1,101 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+class CThreadPool;
+
+/// Loads the tiles of a composite - i. e. reads and decodes the sub-blocks - while the tiles are consumed in the order of
+/// their index on the calling thread. Loading a tile is done in two stages, which are given as functors: "readTile" (which
+/// does the I/O) and "decodeTile". Both are called exactly once for every index, "decodeTile" only after "readTile" has
+/// finished for the index. They are expected to store their result where the next stage (or the caller, after "WaitFor"
+/// returned for the index) can pick it up.
+/// The tiles are decoded on up to "maxThreads" worker threads - or, if only one thread is to be used, on the calling thread
+/// from within "WaitFor". The workers do not decode further ahead than "maxThreads" plus the prefetch-depth tiles beyond the
+/// tile the caller is waiting for, so that the number of decoded tiles waiting to be consumed is bounded. If pipelining is
+/// enabled (by a prefetch-depth greater than zero), the sub-blocks are read on a separate I/O-thread, in the order of their
+/// index and ahead of the decoding, so that the latency of the I/O overlaps with the decoding. The number of sub-blocks which
+/// have been read ahead but whose decoding has not yet started is bounded by the prefetch-depth. Otherwise, the sub-block is
+/// read by the thread decoding it, immediately before decoding it.
+/// The worker threads and the I/O-thread are taken from a thread pool (owned by the accessor), so that they are not created
+/// for every composite. If the pool has no thread available (because its maximum number of threads is in use), fewer worker
+/// threads are used - down to decoding on the calling thread, and reading the sub-blocks without an I/O-thread.
+class CParallelTileLoader
+{
+private:
+	CThreadPool& threadPool;
+	int count;
+	int prefetchDepth;
+	int decodeThreadCount;							///< The number of worker threads decoding the tiles (zero if they are decoded on the calling thread, protected by "mutex" while the threads are started).
+	bool readAhead;									///< Whether the sub-blocks are read on the I/O-thread.
+	std::function<void(int index)> readTile;
+	std::function<void(int index)> decodeTile;
+	std::mutex mutex;
+	std::condition_variable stateChanged;
+	int runningTasks;								///< The number of worker threads and I/O-threads which have not yet finished (protected by "mutex").
+	std::vector<bool> read;							///< Whether "readTile" has finished for the index (protected by "mutex").
+	std::vector<std::exception_ptr> readExceptions;	///< The exception thrown by "readTile" for the index (if any).
+	int decodingStarted;							///< The number of tiles whose decoding has been started (protected by "mutex").
+	int consumerIndex;								///< The index of the tile the caller is waiting for (protected by "mutex").
+	std::vector<bool> loaded;						///< Whether the tile has been decoded by a worker thread (protected by "mutex").
+	std::vector<std::exception_ptr> exceptions;		///< The exception thrown while loading the tile (if any).
+	std::atomic<int> nextIndex;
+	std::atomic<bool> cancelled;
+public:
+	/// Constructor - the loading of the tiles is started here.
+	///
+	/// \param [in] threadPool The thread pool which executes the worker threads and the I/O-thread. It must outlive the loader.
+	/// \param count		 The number of tiles.
+	/// \param maxThreads	 The maximum number of threads to be used for decoding the tiles. If less than or equal to one,
+	/// 					 the tiles are decoded on the calling thread.
+	/// \param prefetchDepth The maximum number of sub-blocks which are read ahead of decoding (on a separate I/O-thread). If
+	/// 					 less than or equal to zero, the sub-blocks are not read ahead.
+	/// \param readTile		 The functor which reads the sub-block of the tile with the specified index.
+	/// \param decodeTile	 The functor which decodes the tile with the specified index.
+	CParallelTileLoader(CThreadPool& threadPool, int count, int maxThreads, int prefetchDepth, std::function<void(int index)> readTile, std::function<void(int index)> decodeTile);
+
+	/// The destructor stops the loading of further tiles, and waits for the threads to finish.
+	~CParallelTileLoader();
+
+	CParallelTileLoader(const CParallelTileLoader&) = delete;
+	CParallelTileLoader& operator=(const CParallelTileLoader&) = delete;
+
+	/// Waits until the tile with the specified index is loaded. If loading the tile failed, the exception is re-thrown.
+	/// The tiles are to be waited for in the order of their index.
+	///
+	/// \param index The index of the tile.
+	void WaitFor(int index);
+
+private:
+	bool TryStartThread(void (CParallelTileLoader::*threadFunc)());
+	void Stop();
+	void ReadThread();
+	void DecodeThread();
+	bool LoadTile(int index);
+};
@@ -0,0 +1,135 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#include "stdafx.h"
+#include "RegionCoverage.h"
+#include "utilities.h"
+
+using namespace libCZI;
+using namespace std;
+
+CRegionCoverage::CRegionCoverage(const libCZI::IntRect& region) : region(region)
+{
+	this->bands.push_back(Band{ region.y, {} });
+}
+
+void CRegionCoverage::Add(const libCZI::IntRect& rect)
+{
+	IntRect clipped;
+	if (!this->TryClip(rect, clipped))
+	{
+		return;
+	}
+
+	const size_t first = this->SplitBand(clipped.y);
+	const size_t end = this->SplitBand(clipped.y + clipped.h);
+	for (size_t i = first; i < end; ++i)
+	{
+		AddInterval(this->bands[i].intervals, clipped.x, clipped.x + clipped.w);
+	}
+}
+
+bool CRegionCoverage::IsCovered(const libCZI::IntRect& rect) const
+{
+	IntRect clipped;
+	if (!this->TryClip(rect, clipped))
+	{
+		return true;
+	}
+
+	for (size_t i = this->GetBandIndex(clipped.y); i < this->bands.size() && this->bands[i].y < clipped.y + clipped.h; ++i)
+	{
+		if (!IsCovered(this->bands[i].intervals, clipped.x, clipped.x + clipped.w))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool CRegionCoverage::IsCompletelyCovered() const
+{
+	return this->IsCovered(this->region);
+}
+
+bool CRegionCoverage::TryClip(const libCZI::IntRect& rect, libCZI::IntRect& clipped) const
+{
+	clipped = Utilities::Intersect(rect, this->region);
+	return clipped.w > 0 && clipped.h > 0;
+}
+
+size_t CRegionCoverage::GetBandIndex(int y) const
+{
+	// the band containing y is the last one starting at or above y
+	auto it = std::upper_bound(this->bands.cbegin(), this->bands.cend(), y, [](int v, const Band& band)->bool {return v < band.y; });
+	return (size_t)(it - this->bands.cbegin()) - 1;
+}
+
+size_t CRegionCoverage::SplitBand(int y)
+{
+	// returns the index of the band starting at y (which is created by splitting the band containing y if necessary), or
+	//  the number of bands if y is the bottom of the region
+	if (y >= this->region.y + this->region.h)
+	{
+		return this->bands.size();
+	}
+
+	const size_t index = this->GetBandIndex(y);
+	if (this->bands[index].y == y)
+	{
+		return index;
+	}
+
+	Band band{ y, this->bands[index].intervals };
+	this->bands.insert(this->bands.begin() + index + 1, std::move(band));
+	return index + 1;
+}
+
+/*static*/bool CRegionCoverage::IsCovered(const std::vector<std::pair<int, int>>& intervals, int start, int end)
+{
+	// since the intervals are disjoint (and adjacent ones are merged), the range must be contained in a single interval
+	auto it = std::upper_bound(intervals.cbegin(), intervals.cend(), start, [](int v, const std::pair<int, int>& interval)->bool {return v < interval.first; });
+	if (it == intervals.cbegin())
+	{
+		return false;
+	}
+
+	--it;
+	return it->second >= end;
+}
+
+/*static*/void CRegionCoverage::AddInterval(std::vector<std::pair<int, int>>& intervals, int start, int end)
+{
+	// find the intervals which overlap with (or touch) the new one, and replace them with their union
+	auto first = std::lower_bound(intervals.begin(), intervals.end(), start, [](const std::pair<int, int>& interval, int v)->bool {return interval.second < v; });
+	auto last = first;
+	while (last != intervals.end() && last->first <= end)
+	{
+		start = (std::min)(start, last->first);
+		end = (std::max)(end, last->second);
+		++last;
+	}
+
+	first = intervals.erase(first, last);
+	intervals.insert(first, std::make_pair(start, end));
+}
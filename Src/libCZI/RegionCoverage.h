@@ -0,0 +1,74 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include "libCZI_Pixels.h"
+
+/// Keeps track of which part of a rectangular region is covered by a set of rectangles (which are added one by one). The
+/// region is divided into horizontal bands (at the top and bottom edges of the rectangles added), and for every band the
+/// covered part is kept as a sorted list of disjoint intervals.
+class CRegionCoverage
+{
+private:
+	/// A horizontal band, which extends from "y" to the "y" of the next band (or to the bottom of the region).
+	struct Band
+	{
+		int y;
+		std::vector<std::pair<int, int>> intervals;	///< The covered intervals (start and end, exclusive), sorted and disjoint.
+	};
+
+	libCZI::IntRect region;
+	std::vector<Band> bands;
+public:
+	/// Constructor.
+	///
+	/// \param region The region (which is initially not covered at all).
+	explicit CRegionCoverage(const libCZI::IntRect& region);
+
+	/// Adds the specified rectangle to the covered area (only the part within the region is considered).
+	///
+	/// \param rect The rectangle.
+	void Add(const libCZI::IntRect& rect);
+
+	/// Query if the part of the specified rectangle which lies within the region is completely covered. If the rectangle
+	/// does not intersect with the region, it is considered covered.
+	///
+	/// \param rect The rectangle.
+	///
+	/// \return True if covered, false if not.
+	bool IsCovered(const libCZI::IntRect& rect) const;
+
+	/// Query if the region is completely covered.
+	///
+	/// \return True if completely covered, false if not.
+	bool IsCompletelyCovered() const;
+
+private:
+	bool TryClip(const libCZI::IntRect& rect, libCZI::IntRect& clipped) const;
+	size_t GetBandIndex(int y) const;
+	size_t SplitBand(int y);
+	static bool IsCovered(const std::vector<std::pair<int, int>>& intervals, int start, int end);
+	static void AddInterval(std::vector<std::pair<int, int>>& intervals, int start, int end);
+};
@@ -0,0 +1,306 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#include "stdafx.h"
+#include "SidecarIndex.h"
+#include "CziSubBlockDirectory.h"
+#include "CziAttachmentsDirectory.h"
+#include <cstdio>
+#include <sstream>
+#include <atomic>
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace libCZI;
+
+namespace
+{
+	/// Counter making the names of the temporary files unique within the process.
+	std::atomic<std::uint64_t> tempFileCounter(0);
+
+	const std::uint8_t SIDECARINDEXMAGIC[16] = { 'L','I','B','C','Z','I','S','I','D','E','C','A','R','I','D','X' };
+
+	struct SidecarIndexHeader
+	{
+		std::uint8_t magic[16];
+		std::uint32_t version;
+		std::uint32_t headerSize;
+		CSidecarIndex::Key key;
+		std::uint64_t payloadSize;
+		std::uint64_t payloadChecksum;
+	};
+
+	bool IsKeyEqual(const CSidecarIndex::Key& a, const CSidecarIndex::Key& b)
+	{
+		return memcmp(&a.fileGuid, &b.fileGuid, sizeof(GUID)) == 0 &&
+			a.fileSize == b.fileSize &&
+			a.modificationTime == b.modificationTime &&
+			a.subBlockDirectoryPosition == b.subBlockDirectoryPosition &&
+			a.attachmentDirectoryPosition == b.attachmentDirectoryPosition;
+	}
+
+	FILE* OpenFileForWriting(const std::wstring& filename)
+	{
+#if defined(_WIN32)
+		FILE* fp;
+		if (_wfopen_s(&fp, filename.c_str(), L"wb") != 0)
+		{
+			return nullptr;
+		}
+
+		return fp;
+#else
+		size_t requiredSize = std::wcstombs(nullptr, filename.c_str(), 0);
+		std::string conv(requiredSize, 0);
+		conv.resize(std::wcstombs(&conv[0], filename.c_str(), requiredSize));
+		return fopen(conv.c_str(), "wb");
+#endif
+	}
+
+	bool ReplaceFile(const std::wstring& source, const std::wstring& destination)
+	{
+#if defined(_WIN32)
+		return MoveFileExW(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+		size_t requiredSize = std::wcstombs(nullptr, source.c_str(), 0);
+		std::string convSource(requiredSize, 0);
+		convSource.resize(std::wcstombs(&convSource[0], source.c_str(), requiredSize));
+		requiredSize = std::wcstombs(nullptr, destination.c_str(), 0);
+		std::string convDestination(requiredSize, 0);
+		convDestination.resize(std::wcstombs(&convDestination[0], destination.c_str(), requiredSize));
+		return rename(convSource.c_str(), convDestination.c_str()) == 0;
+#endif
+	}
+
+	void RemoveFile(const std::wstring& filename)
+	{
+#if defined(_WIN32)
+		_wremove(filename.c_str());
+#else
+		size_t requiredSize = std::wcstombs(nullptr, filename.c_str(), 0);
+		std::string conv(requiredSize, 0);
+		conv.resize(std::wcstombs(&conv[0], filename.c_str(), requiredSize));
+		remove(conv.c_str());
+#endif
+	}
+}
+
+void CSidecarIndexWriter::WriteCoordinate(const libCZI::IDimCoordinate& coordinate)
+{
+	// a bitfield with the valid dimensions, followed by the values of all dimensions (0 if not valid)
+	std::uint32_t validMask = 0;
+	std::int32_t values[(int)DimensionIndex::MaxDim + 1] = {};
+	for (int i = (int)DimensionIndex::MinDim; i <= (int)DimensionIndex::MaxDim; ++i)
+	{
+		int value;
+		if (coordinate.TryGetPosition((DimensionIndex)i, &value) == true)
+		{
+			validMask |= (1u << i);
+			values[i] = value;
+		}
+	}
+
+	this->Write(validMask);
+	for (int i = (int)DimensionIndex::MinDim; i <= (int)DimensionIndex::MaxDim; ++i)
+	{
+		this->Write(values[i]);
+	}
+}
+
+void CSidecarIndexWriter::WriteRect(const libCZI::IntRect& rect)
+{
+	this->Write<std::int32_t>(rect.x);
+	this->Write<std::int32_t>(rect.y);
+	this->Write<std::int32_t>(rect.w);
+	this->Write<std::int32_t>(rect.h);
+}
+
+libCZI::CDimCoordinate CSidecarIndexReader::ReadCoordinate()
+{
+	CDimCoordinate coordinate;
+	std::uint32_t validMask = this->Read<std::uint32_t>();
+	for (int i = (int)DimensionIndex::MinDim; i <= (int)DimensionIndex::MaxDim; ++i)
+	{
+		std::int32_t value = this->Read<std::int32_t>();
+		if ((validMask & (1u << i)) != 0)
+		{
+			coordinate.Set((DimensionIndex)i, value);
+		}
+	}
+
+	return coordinate;
+}
+
+libCZI::IntRect CSidecarIndexReader::ReadRect()
+{
+	IntRect rect;
+	rect.x = this->Read<std::int32_t>();
+	rect.y = this->Read<std::int32_t>();
+	rect.w = this->Read<std::int32_t>();
+	rect.h = this->Read<std::int32_t>();
+	return rect;
+}
+
+size_t CSidecarIndexReader::ReadCount(size_t minSizeOfElement)
+{
+	std::uint64_t count = this->Read<std::uint64_t>();
+	if (minSizeOfElement > 0 && count > (this->size - this->position) / minSizeOfElement)
+	{
+		CSidecarIndexReader::ThrowCorrupt();
+	}
+
+	return (size_t)count;
+}
+
+void CSidecarIndexReader::ThrowIfNotEnoughData(std::uint64_t count) const
+{
+	if (count > this->size - this->position)
+	{
+		CSidecarIndexReader::ThrowCorrupt();
+	}
+}
+
+/*static*/void CSidecarIndexReader::ThrowCorrupt()
+{
+	throw std::runtime_error("The sidecar-index is corrupt.");
+}
+
+//----------------------------------------------------------------------------
+
+/*static*/bool CSidecarIndex::TryRead(const wchar_t* filename, const Key& key, bool useCompactRepresentation, CCziSubBlockDirectory& subBlkDir, CCziAttachmentsDirectory& attachmentDir)
+{
+	try
+	{
+		// the sidecar-index is mapped into memory, and parsed directly from the mapping
+		auto stream = CreateStreamFromFileMapped(filename);
+		std::uint64_t fileSize;
+		if (dynamic_cast<IStreamFileInfo*>(stream.get())->TryGetFileInfo(&fileSize, nullptr) == false || fileSize < sizeof(SidecarIndexHeader))
+		{
+			return false;
+		}
+
+		auto view = dynamic_cast<IStreamDirectAccess*>(stream.get())->TryGetView(0, fileSize);
+		if (!view)
+		{
+			return false;
+		}
+
+		const std::uint8_t* ptr = static_cast<const std::uint8_t*>(view.get());
+		SidecarIndexHeader header;
+		memcpy(&header, ptr, sizeof(header));
+		if (memcmp(header.magic, SIDECARINDEXMAGIC, sizeof(SIDECARINDEXMAGIC)) != 0 ||
+			header.version != CSidecarIndex::Version ||
+			header.headerSize != sizeof(SidecarIndexHeader) ||
+			IsKeyEqual(header.key, key) == false ||
+			header.payloadSize != fileSize - sizeof(SidecarIndexHeader) ||
+			header.payloadChecksum != CSidecarIndex::CalculateChecksum(ptr + sizeof(SidecarIndexHeader), header.payloadSize))
+		{
+			return false;
+		}
+
+		CSidecarIndexReader reader(ptr + sizeof(SidecarIndexHeader), header.payloadSize);
+		CCziSubBlockDirectory subBlkDirFromIndex(useCompactRepresentation);
+		subBlkDirFromIndex.Deserialize(reader);
+		CCziAttachmentsDirectory attachmentDirFromIndex;
+		attachmentDirFromIndex.Deserialize(reader);
+		if (reader.IsAtEnd() == false)
+		{
+			return false;
+		}
+
+		subBlkDir = std::move(subBlkDirFromIndex);
+		attachmentDir = std::move(attachmentDirFromIndex);
+		return true;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
+
+/*static*/void CSidecarIndex::Write(const wchar_t* filename, const Key& key, const CCziSubBlockDirectory& subBlkDir, const CCziAttachmentsDirectory& attachmentDir)
+{
+	CSidecarIndexWriter writer;
+	subBlkDir.Serialize(writer);
+	attachmentDir.Serialize(writer);
+	const std::vector<std::uint8_t>& payload = writer.GetData();
+
+	SidecarIndexHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SIDECARINDEXMAGIC, sizeof(SIDECARINDEXMAGIC));
+	header.version = CSidecarIndex::Version;
+	header.headerSize = sizeof(SidecarIndexHeader);
+	header.key = key;
+	header.payloadSize = payload.size();
+	header.payloadChecksum = CSidecarIndex::CalculateChecksum(payload.empty() ? nullptr : &payload[0], payload.size());
+
+	// write to a temporary file and then rename it - the name of the temporary file is unique for this call (as
+	//  the same sidecar-index may be written concurrently by other processes, or by other threads of this process)
+	std::wstringstream ss;
+#if defined(_WIN32)
+	ss << filename << L"." << _getpid() << L"." << tempFileCounter.fetch_add(1) << L".tmp";
+#else
+	ss << filename << L"." << getpid() << L"." << tempFileCounter.fetch_add(1) << L".tmp";
+#endif
+	std::wstring tempFilename = ss.str();
+	FILE* fp = OpenFileForWriting(tempFilename);
+	if (fp == nullptr)
+	{
+		throw std::runtime_error("Error creating the sidecar-index.");
+	}
+
+	bool success = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (success && !payload.empty())
+	{
+		success = fwrite(&payload[0], payload.size(), 1, fp) == 1;
+	}
+
+	success = (fclose(fp) == 0) && success;
+	if (!success || !ReplaceFile(tempFilename, filename))
+	{
+		RemoveFile(tempFilename);
+		throw std::runtime_error("Error writing the sidecar-index.");
+	}
+}
+
+/*static*/std::uint64_t CSidecarIndex::CalculateChecksum(const std::uint8_t* ptr, std::uint64_t size)
+{
+	// FNV-1a, but processing 8 bytes per step
+	std::uint64_t hash = 0xcbf29ce484222325ULL;
+	std::uint64_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		std::uint64_t v;
+		memcpy(&v, ptr + i, sizeof(v));
+		hash = (hash ^ v) * 0x100000001b3ULL;
+	}
+
+	for (; i < size; ++i)
+	{
+		hash = (hash ^ ptr[i]) * 0x100000001b3ULL;
+	}
+
+	return hash;
+}
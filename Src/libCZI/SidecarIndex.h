@@ -0,0 +1,166 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#include "libCZI.h"
+
+class CCziSubBlockDirectory;
+class CCziAttachmentsDirectory;
+
+/// Helper for serializing data into the binary format of the sidecar-index. Values are written
+/// in native byte-order and without any padding.
+class CSidecarIndexWriter
+{
+private:
+	std::vector<std::uint8_t> data;
+public:
+	template <typename t>
+	void Write(const t& value)
+	{
+		static_assert(std::is_trivially_copyable<t>::value, "only trivially copyable types can be written");
+		const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&value);
+		this->data.insert(this->data.end(), p, p + sizeof(t));
+	}
+
+	template <typename t>
+	void WriteVector(const std::vector<t>& vec)
+	{
+		static_assert(std::is_trivially_copyable<t>::value, "only trivially copyable types can be written");
+		this->Write<std::uint64_t>(vec.size());
+		if (!vec.empty())
+		{
+			const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&vec[0]);
+			this->data.insert(this->data.end(), p, p + vec.size() * sizeof(t));
+		}
+	}
+
+	void WriteCoordinate(const libCZI::IDimCoordinate& coordinate);
+	void WriteRect(const libCZI::IntRect& rect);
+
+	const std::vector<std::uint8_t>& GetData() const { return this->data; }
+};
+
+/// Helper for de-serializing data from the binary format of the sidecar-index. If the data is
+/// exhausted, an exception of type std::runtime_error is thrown.
+class CSidecarIndexReader
+{
+private:
+	const std::uint8_t* ptr;
+	std::uint64_t size;
+	std::uint64_t position;
+public:
+	CSidecarIndexReader(const void* ptr, std::uint64_t size) : ptr(static_cast<const std::uint8_t*>(ptr)), size(size), position(0) {}
+
+	template <typename t>
+	t Read()
+	{
+		static_assert(std::is_trivially_copyable<t>::value, "only trivially copyable types can be read");
+		this->ThrowIfNotEnoughData(sizeof(t));
+		t value;
+		memcpy(&value, this->ptr + this->position, sizeof(t));
+		this->position += sizeof(t);
+		return value;
+	}
+
+	template <typename t>
+	void ReadVector(std::vector<t>& vec)
+	{
+		static_assert(std::is_trivially_copyable<t>::value, "only trivially copyable types can be read");
+		std::uint64_t count = this->Read<std::uint64_t>();
+		if (count > (this->size - this->position) / sizeof(t))
+		{
+			CSidecarIndexReader::ThrowCorrupt();
+		}
+
+		vec.resize((size_t)count);
+		if (count > 0)
+		{
+			memcpy(&vec[0], this->ptr + this->position, (size_t)count * sizeof(t));
+			this->position += count * sizeof(t);
+		}
+	}
+
+	libCZI::CDimCoordinate ReadCoordinate();
+	libCZI::IntRect ReadRect();
+
+	/// Reads the number of elements of a list, and checks that there is enough data left for this number
+	/// of elements (assuming that each element requires at least "minSizeOfElement" bytes).
+	size_t ReadCount(size_t minSizeOfElement);
+
+	bool IsAtEnd() const { return this->position == this->size; }
+
+	static void ThrowCorrupt();
+private:
+	void ThrowIfNotEnoughData(std::uint64_t count) const;
+};
+
+/// The sidecar-index contains the parsed sub-block directory and attachment directory of a CZI-document, so that
+/// they can be loaded without reading and parsing them from the document. It is a binary file which starts with
+/// a header which identifies the document it was created for (by its file-GUID, its size and the time of its last
+/// modification), followed by the payload (whose integrity is checked with a checksum).
+class CSidecarIndex
+{
+public:
+	/// The current version of the format. If a sidecar-index has a different version, it is not used.
+	static const std::uint32_t Version = 3;
+
+	/// The information which identifies the document for which a sidecar-index is valid.
+	struct Key
+	{
+		GUID fileGuid;
+		std::uint64_t fileSize;
+		std::int64_t modificationTime;
+		std::uint64_t subBlockDirectoryPosition;
+		std::uint64_t attachmentDirectoryPosition;
+	};
+
+	/// Try to read the sidecar-index from the specified file. If the file does not exist, cannot be read, has been
+	/// created for a different key or is corrupt, then false is returned (and the directories are left unchanged).
+	///
+	/// \param filename					   The filename of the sidecar-index.
+	/// \param key						   The key of the document.
+	/// \param useCompactRepresentation	   Whether the sub-block directory should use the compact representation.
+	/// \param [out] subBlkDir			   The sub-block directory.
+	/// \param [out] attachmentDir		   The attachment directory.
+	///
+	/// \return True if it succeeds, false if it fails.
+	static bool TryRead(const wchar_t* filename, const Key& key, bool useCompactRepresentation, CCziSubBlockDirectory& subBlkDir, CCziAttachmentsDirectory& attachmentDir);
+
+	/// Writes the sidecar-index. The file is first written with a temporary name and then renamed, so that a
+	/// concurrent reader will not see a partially written file. In case of an error, an exception is thrown.
+	///
+	/// \param filename		 The filename of the sidecar-index.
+	/// \param key			 The key of the document.
+	/// \param subBlkDir	 The sub-block directory (adding must have been finished).
+	/// \param attachmentDir The attachment directory.
+	static void Write(const wchar_t* filename, const Key& key, const CCziSubBlockDirectory& subBlkDir, const CCziAttachmentsDirectory& attachmentDir);
+
+private:
+	static std::uint64_t CalculateChecksum(const std::uint8_t* ptr, std::uint64_t size);
+};
@@ -23,6 +23,8 @@
 #include "stdafx.h"
 #include "SingleChannelAccessorBase.h"
 #include "BitmapOperations.h"
+#include "Site.h"
+#include "CreateBitmap.h"
 
 using namespace std;
 using namespace libCZI;
@@ -46,6 +48,110 @@ bool CSingleChannelAccessorBase::TryGetPixelType(const libCZI::IDimCoordinate* p
 	}
 }
 
+/*static*/bool CSingleChannelAccessorBase::IsPartialDecodeWorthwhile(libCZI::CompressionMode mode, const libCZI::IntSize& size, const libCZI::IntRect& roi)
+{
+	// an uncompressed bitmap is not copied anyway, and decoding a region comes with some overhead (and the decoder
+	// may have to decode some more pixels around the region) - so we only go for it if the region is at most a quarter
+	// of the sub-block
+	if (mode != CompressionMode::JpgXr || roi.w <= 0 || roi.h <= 0)
+	{
+		return false;
+	}
+
+	return std::uint64_t(roi.w) * roi.h * 4 <= std::uint64_t(size.w) * size.h;
+}
+
+/*static*/std::shared_ptr<libCZI::IBitmapData> CSingleChannelAccessorBase::DecodeReduced(libCZI::ISubBlock* subBlk, int reductionFactor, const libCZI::IntRect* roi)
+{
+	auto dec = GetSite()->GetDecoder(ImageDecoderType::JPXR_JxrLib, nullptr);
+	const void* ptr; size_t size;
+	subBlk->DangerousGetRawData(ISubBlock::MemBlkType::Data, ptr, size);
+	return dec->DecodeReduced(ptr, size, reductionFactor, roi);
+}
+
+CSingleChannelAccessorBase::SubBlockOrBitmap CSingleChannelAccessorBase::ReadSubBlockOrGetCached(libCZI::ISubBlockCache* subBlockCache, int subBlockIndex)
+{
+	SubBlockOrBitmap result;
+	if (subBlockCache != nullptr)
+	{
+		result.bitmap = subBlockCache->Get(this->sbBlkRepository, subBlockIndex);
+		if (result.bitmap)
+		{
+			return result;
+		}
+	}
+
+	result.subBlock = this->sbBlkRepository->ReadSubBlock(subBlockIndex);
+	return result;
+}
+
+std::shared_ptr<libCZI::IBitmapData> CSingleChannelAccessorBase::GetSubBlockBitmap(libCZI::ISubBlockCache* subBlockCache, int subBlockIndex, const SubBlockOrBitmap& source)
+{
+	if (source.bitmap)
+	{
+		return source.bitmap;
+	}
+
+	auto bm = CreateBitmapFromSubBlockForReading(source.subBlock.get(), nullptr);
+	if (subBlockCache != nullptr)
+	{
+		subBlockCache->Add(this->sbBlkRepository, subBlockIndex, bm);
+	}
+
+	return bm;
+}
+
+CSingleChannelAccessorBase::TileReader::TileReader(CSingleChannelAccessorBase* accessor, libCZI::ISubBlockCache* subBlockCache, int count, int batchSize, std::function<int(int index)> getSubBlockIndex)
+	: accessor(accessor), subBlockCache(subBlockCache), count(count), batchSize(batchSize), getSubBlockIndex(std::move(getSubBlockIndex))
+{
+	if (this->batchSize > 1 && count > 0)
+	{
+		this->batchRead.reset(new std::once_flag[(count + this->batchSize - 1) / this->batchSize]);
+		this->subBlocks.resize(count);
+	}
+}
+
+CSingleChannelAccessorBase::SubBlockOrBitmap CSingleChannelAccessorBase::TileReader::Read(int index)
+{
+	if (!this->batchRead)
+	{
+		return this->accessor->ReadSubBlockOrGetCached(this->subBlockCache, this->getSubBlockIndex(index));
+	}
+
+	const int batch = index / this->batchSize;
+	std::call_once(this->batchRead[batch], [&]()->void {this->ReadBatch(batch); });
+	return std::move(this->subBlocks[index]);
+}
+
+void CSingleChannelAccessorBase::TileReader::ReadBatch(int batch)
+{
+	const int start = batch * this->batchSize;
+	const int end = (std::min)(start + this->batchSize, this->count);
+	std::vector<int> tilesToRead;
+	std::vector<int> subBlockIndices;
+	for (int i = start; i < end; ++i)
+	{
+		const int subBlockIndex = this->getSubBlockIndex(i);
+		if (this->subBlockCache != nullptr)
+		{
+			this->subBlocks[i].bitmap = this->subBlockCache->Get(this->accessor->sbBlkRepository, subBlockIndex);
+			if (this->subBlocks[i].bitmap)
+			{
+				continue;
+			}
+		}
+
+		tilesToRead.push_back(i);
+		subBlockIndices.push_back(subBlockIndex);
+	}
+
+	auto subBlocksRead = this->accessor->sbBlkRepository->ReadSubBlocks(subBlockIndices);
+	for (size_t i = 0; i < tilesToRead.size(); ++i)
+	{
+		this->subBlocks[tilesToRead[i]].subBlock = std::move(subBlocksRead[i]);
+	}
+}
+
 void CSingleChannelAccessorBase::CheckPlaneCoordinates(const libCZI::IDimCoordinate* planeCoordinate) const
 {
 	// planeCoordinate must not contain S
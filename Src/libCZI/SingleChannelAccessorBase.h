@@ -22,15 +22,73 @@
 
 #pragma once
 
+#include <mutex>
+#include <algorithm>
 #include "libCZI.h"
+#include "ThreadPool.h"
 
 class CSingleChannelAccessorBase
 {
 protected:
 	std::shared_ptr<libCZI::ISubBlockRepository> sbBlkRepository;
 
+	/// The threads reading and decoding the tiles (c.f. CParallelTileLoader) - they are kept for the lifetime of the accessor,
+	/// and shared by concurrent calls. The number of threads is bounded (by twice the number of hardware threads), if a call
+	/// finds all of them in use, it makes do with fewer threads.
+	CThreadPool loaderThreadPool;
+
+	/// The result of reading a sub-block - either the sub-block itself or, if it was found in the sub-block cache, its bitmap.
+	struct SubBlockOrBitmap
+	{
+		std::shared_ptr<libCZI::ISubBlock> subBlock;
+		std::shared_ptr<libCZI::IBitmapData> bitmap;
+	};
+
+	/// Reads the sub-blocks of the tiles of a composite (or gets their bitmaps from the sub-block cache). If the batch size is
+	/// greater than one, the sub-blocks of consecutive tiles are read together with ISubBlockRepository::ReadSubBlocks (i. e. in
+	/// the order of their position in the file) when the first of them is requested. "Read" may be called concurrently, but
+	/// only once for every tile.
+	class TileReader
+	{
+	private:
+		CSingleChannelAccessorBase* accessor;
+		libCZI::ISubBlockCache* subBlockCache;
+		int count;
+		int batchSize;
+		std::function<int(int index)> getSubBlockIndex;
+		std::unique_ptr<std::once_flag[]> batchRead;
+		std::vector<SubBlockOrBitmap> subBlocks;
+	public:
+		/// Constructor.
+		///
+		/// \param [in] accessor	  The accessor.
+		/// \param [in] subBlockCache The sub-block cache (may be null).
+		/// \param count			  The number of tiles.
+		/// \param batchSize		  The number of sub-blocks which are read together.
+		/// \param getSubBlockIndex	  A functor which gives the index of the sub-block for the specified tile.
+		TileReader(CSingleChannelAccessorBase* accessor, libCZI::ISubBlockCache* subBlockCache, int count, int batchSize, std::function<int(int index)> getSubBlockIndex);
+
+		/// Reads the sub-block (or gets its bitmap from the cache) of the specified tile.
+		///
+		/// \param index The index of the tile.
+		///
+		/// \return Either the sub-block or its bitmap.
+		SubBlockOrBitmap Read(int index);
+	private:
+		void ReadBatch(int batch);
+	};
+
+	/// A tile (i. e. a bitmap and its position) which is to be composed.
+	struct TileBitmap
+	{
+		SubBlockOrBitmap source;	///< The sub-block as it has been read (and which is yet to be decoded).
+		std::shared_ptr<libCZI::IBitmapData> bitmap;
+		int x;
+		int y;
+	};
+
 	explicit CSingleChannelAccessorBase(std::shared_ptr<libCZI::ISubBlockRepository> sbBlkRepository)
-		: sbBlkRepository(sbBlkRepository)
+		: sbBlkRepository(sbBlkRepository), loaderThreadPool(1, 2 * (std::max)((int)std::thread::hardware_concurrency(), 2))
 	{}
 
 	bool TryGetPixelType(const libCZI::IDimCoordinate* planeCoordinate, libCZI::PixelType& pixeltype);
@@ -38,4 +96,42 @@ protected:
 	static void Clear(libCZI::IBitmapData* bm, const libCZI::RgbFloatColor& floatColor);
 
 	void CheckPlaneCoordinates(const libCZI::IDimCoordinate* planeCoordinate) const;
+
+	/// Determine whether it is worthwhile to only decode the specified region of the sub-block (instead of decoding it completely).
+	/// This is the case if the sub-block is compressed and if the region is much smaller than the sub-block.
+	///
+	/// \param mode The compression mode of the sub-block.
+	/// \param size The size of the bitmap (as it is decoded).
+	/// \param roi  The region (in pixels of the decoded bitmap).
+	///
+	/// \return True if only the region should be decoded, false otherwise.
+	static bool IsPartialDecodeWorthwhile(libCZI::CompressionMode mode, const libCZI::IntSize& size, const libCZI::IntRect& roi);
+
+	/// Decode the specified JPG-XR compressed sub-block with its resolution reduced by the specified factor.
+	///
+	/// \param [in] subBlk	   The sub-block.
+	/// \param reductionFactor The factor by which the resolution is reduced (1, 2, 4, 8 or 16).
+	/// \param roi			   If non-null, only this region (in pixels of the reduced bitmap) is decoded.
+	///
+	/// \return The decoded bitmap.
+	static std::shared_ptr<libCZI::IBitmapData> DecodeReduced(libCZI::ISubBlock* subBlk, int reductionFactor, const libCZI::IntRect* roi);
+
+	/// Reads the specified sub-block - unless a cache is given and the bitmap of the sub-block is found in it, in which case
+	/// the sub-block is not read and the bitmap is returned instead.
+	///
+	/// \param [in] subBlockCache The sub-block cache (may be null).
+	/// \param subBlockIndex	  The index of the sub-block.
+	///
+	/// \return Either the sub-block or its bitmap.
+	SubBlockOrBitmap ReadSubBlockOrGetCached(libCZI::ISubBlockCache* subBlockCache, int subBlockIndex);
+
+	/// Gets the (complete) bitmap of the specified sub-block, which has been obtained with "ReadSubBlockOrGetCached". If it
+	/// was not found in the cache, the sub-block is decoded, and (if a cache is given) the bitmap is added to the cache.
+	///
+	/// \param [in] subBlockCache The sub-block cache (may be null).
+	/// \param subBlockIndex	  The index of the sub-block.
+	/// \param source			  The sub-block or its bitmap.
+	///
+	/// \return The bitmap of the sub-block.
+	std::shared_ptr<libCZI::IBitmapData> GetSubBlockBitmap(libCZI::ISubBlockCache* subBlockCache, int subBlockIndex, const SubBlockOrBitmap& source);
 };
@@ -25,6 +25,7 @@
 #include "SingleChannelPyramidLevelTileAccessor.h"
 #include "utilities.h"
 #include "Site.h"
+#include "ParallelTileLoader.h"
 
 using namespace libCZI;
 using namespace std;
@@ -95,6 +96,24 @@ void CSingleChannelPyramidLevelTileAccessor::InternalGet(libCZI::IBitmapData* pD
 
 void CSingleChannelPyramidLevelTileAccessor::ComposeTiles(libCZI::IBitmapData* bm, int xPos, int yPos, int sizeOfPixel, int bitmapCnt, const Options& options, std::function<SbInfo(int)> getSbInfo)
 {
+	// the tiles are read and decoded (possibly on multiple threads and with the reading ahead of the decoding), and they are
+	// composed in the order of their index
+	std::vector<TileBitmap> tiles(bitmapCnt);
+	TileReader reader(this, options.subBlockCache.get(), bitmapCnt, options.readBatchSize, [&](int index)->int {return getSbInfo(index).index; });
+	CParallelTileLoader loader(this->loaderThreadPool, bitmapCnt, options.maxThreads, options.prefetchDepth,
+		[&](int index)->void
+	{
+		tiles[index].source = reader.Read(index);
+	},
+		[&](int index)->void
+	{
+		SbInfo sbinfo = getSbInfo(index);
+		const SubBlockOrBitmap source = std::move(tiles[index].source);
+		tiles[index].bitmap = this->GetSubBlockBitmap(options.subBlockCache.get(), sbinfo.index, source);
+		tiles[index].x = (sbinfo.logicalRect.x - xPos) / sizeOfPixel;
+		tiles[index].y = (sbinfo.logicalRect.y - yPos) / sizeOfPixel;
+	});
+
 	Compositors::ComposeSingleTileOptions composeOptions; composeOptions.Clear();
 	composeOptions.drawTileBorder = options.drawTileBorder;
 
@@ -103,11 +122,10 @@ void CSingleChannelPyramidLevelTileAccessor::ComposeTiles(libCZI::IBitmapData* b
 	{
 		if (index < bitmapCnt)
 		{
-			SbInfo sbinfo = getSbInfo(index);
-			auto sb = this->sbBlkRepository->ReadSubBlock(sbinfo.index);
-			spBm = sb->CreateBitmap();
-			xPosTile = (sb->GetSubBlockInfo().logicalRect.x - xPos) / sizeOfPixel;
-			yPosTile = (sb->GetSubBlockInfo().logicalRect.y - yPos) / sizeOfPixel;
+			loader.WaitFor(index);
+			spBm = std::move(tiles[index].bitmap);
+			xPosTile = tiles[index].x;
+			yPosTile = tiles[index].y;
 			return true;
 		}
 
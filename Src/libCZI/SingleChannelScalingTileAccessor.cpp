@@ -25,12 +25,14 @@
 #include "utilities.h"
 #include "BitmapOperations.h"
 #include "Site.h"
+#include "CreateBitmap.h"
+#include "ParallelTileLoader.h"
 
 using namespace libCZI;
 using namespace std;
 
 CSingleChannelScalingTileAccessor::CSingleChannelScalingTileAccessor(std::shared_ptr<ISubBlockRepository> sbBlkRepository)
-	: CSingleChannelAccessorBase(sbBlkRepository)
+	: CSingleChannelAccessorBase(sbBlkRepository), nnResizePlanCache(256)
 {
 }
 
@@ -83,7 +85,7 @@ CSingleChannelScalingTileAccessor::CSingleChannelScalingTileAccessor(std::shared
 	return IntSize{ (uint32_t)(roi.w*zoom),(uint32_t)(roi.h*zoom) };
 }
 
-void CSingleChannelScalingTileAccessor::ScaleBlt(libCZI::IBitmapData* bmDest, float zoom, const libCZI::IntRect&  roi, const SbInfo& sbInfo)
+CSingleChannelScalingTileAccessor::ScaleBltSource CSingleChannelScalingTileAccessor::GetScaleBltSource(const libCZI::IntSize& sizeDest, const libCZI::IntRect& roi, const SbInfo& sbInfo, libCZI::ISubBlockCache* subBlockCache, bool decodeReducedResolution, const SubBlockOrBitmap& source)
 {
 	// calculate the intersection of the with the subblock (logical rect) and the destination
 	auto intersect = Utilities::Intersect(sbInfo.logicalRect, roi);
@@ -106,12 +108,19 @@ void CSingleChannelScalingTileAccessor::ScaleBlt(libCZI::IBitmapData* bmDest, fl
 	srcRoi.w *= sbInfo.physicalSize.w;
 	srcRoi.h *= sbInfo.physicalSize.h;
 
-	dstRoi.x *= bmDest->GetWidth();
-	dstRoi.y *= bmDest->GetHeight();
-	dstRoi.w *= bmDest->GetWidth();
-	dstRoi.h *= bmDest->GetHeight();
+	dstRoi.x *= sizeDest.w;
+	dstRoi.y *= sizeDest.h;
+	dstRoi.w *= sizeDest.w;
+	dstRoi.h *= sizeDest.h;
 
-	auto sb = this->sbBlkRepository->ReadSubBlock(sbInfo.index);
+	// the cache holds the complete sub-block in its stored resolution, which we can use for any zoom
+	if (source.bitmap)
+	{
+		return ScaleBltSource{ source.bitmap, 0, 0, srcRoi, dstRoi };
+	}
+
+	std::shared_ptr<IBitmapData> spBm;
+	const auto& sb = source.subBlock;
 	if (GetSite()->IsEnabled(LOGLEVEL_CHATTYINFORMATION))
 	{
 		stringstream ss;
@@ -119,9 +128,67 @@ void CSingleChannelScalingTileAccessor::ScaleBlt(libCZI::IBitmapData* bmDest, fl
 		GetSite()->Log(LOGLEVEL_CHATTYINFORMATION, ss);
 	}
 
-	auto spBm = sb->CreateBitmap();
+	int srcOffsetX = 0, srcOffsetY = 0;
+	const CompressionMode mode = sb->GetSubBlockInfo().mode;
+
+	// if the sub-block is scaled down by (at least) a factor of two, we let the decoder reduce the resolution - it can
+	// then skip (part of) the work for the finer levels of its frequency hierarchy
+	int reductionFactor = 1;
+	if (decodeReducedResolution && mode == CompressionMode::JpgXr && dstRoi.w > 0 && dstRoi.h > 0)
+	{
+		// (the ratio is calculated from the normalized coordinates, so we allow for a small rounding error)
+		double srcPixelsPerDestPixel = (std::min)(srcRoi.w / dstRoi.w, srcRoi.h / dstRoi.h) * (1 + 1e-9);
+		while (reductionFactor < 16 && reductionFactor * 2 <= srcPixelsPerDestPixel)
+		{
+			reductionFactor *= 2;
+		}
+	}
+
+	IntSize sizeSrc{ (sbInfo.physicalSize.w + reductionFactor - 1) / reductionFactor, (sbInfo.physicalSize.h + reductionFactor - 1) / reductionFactor };
+	srcRoi.x /= reductionFactor;
+	srcRoi.y /= reductionFactor;
+	srcRoi.w /= reductionFactor;
+	srcRoi.h /= reductionFactor;
+
+	// determine the pixels of the source which are needed (plus one pixel for the rounding with nearest-neighbor), and
+	// if this is only a small part of the sub-block, we only decode this part
+	int srcX1 = (std::max)((int)std::floor(srcRoi.x), 0);
+	int srcY1 = (std::max)((int)std::floor(srcRoi.y), 0);
+	int srcX2 = (std::min)((int)std::ceil(srcRoi.x + srcRoi.w) + 1, (int)sizeSrc.w);
+	int srcY2 = (std::min)((int)std::ceil(srcRoi.y + srcRoi.h) + 1, (int)sizeSrc.h);
+	IntRect roiSrc{ srcX1, srcY1, srcX2 - srcX1, srcY2 - srcY1 };
+	if (subBlockCache != nullptr && reductionFactor == 1)
+	{
+		// with a cache, the sub-block is decoded completely (so that it can be re-used for other ROIs)
+		spBm = this->GetSubBlockBitmap(subBlockCache, sbInfo.index, source);
+	}
+	else if (IsPartialDecodeWorthwhile(mode, sizeSrc, roiSrc))
+	{
+		spBm = DecodeReduced(sb.get(), reductionFactor, &roiSrc);
+		srcOffsetX = roiSrc.x;
+		srcOffsetY = roiSrc.y;
+	}
+	else if (reductionFactor > 1)
+	{
+		spBm = DecodeReduced(sb.get(), reductionFactor, nullptr);
+	}
+	else
+	{
+		spBm = CreateBitmapFromSubBlockForReading(sb.get(), nullptr);
+	}
+
+	return ScaleBltSource{ spBm, srcOffsetX, srcOffsetY, srcRoi, dstRoi };
+}
+
+void CSingleChannelScalingTileAccessor::ScaleBlt(libCZI::IBitmapData* bmDest, const ScaleBltSource& source, libCZI::ISingleChannelScalingTileAccessor::ResamplingMode resamplingMode)
+{
+	if (resamplingMode == ResamplingMode::AreaAverage && (source.srcRoi.w > source.dstRoi.w || source.srcRoi.h > source.dstRoi.h))
+	{
+		CBitmapOperations::BoxResize(source.bitmap.get(), source.srcOffsetX, source.srcOffsetY, bmDest, source.srcRoi, source.dstRoi);
+		return;
+	}
 
-	CBitmapOperations::NNResize(spBm.get(), bmDest, srcRoi, dstRoi);
+	CBitmapOperations::NNResize(source.bitmap.get(), source.srcOffsetX, source.srcOffsetY, bmDest, source.srcRoi, source.dstRoi, &this->nnResizePlanCache);
 }
 
 int CSingleChannelScalingTileAccessor::GetIdxOf1stSubBlockWithZoomGreater(const std::vector<SbInfo>& sbBlks, const std::vector<int>& byZoom, float zoom)
@@ -217,19 +284,19 @@ void CSingleChannelScalingTileAccessor::InternalGet(libCZI::IBitmapData* bmDest,
 	{
 		// we only have to deal with a single scene (or: the document does not include a scene-dimension at all)
 		auto sbSetsortedByZoom = this->GetSubSetSortedByZoom(roi, planeCoordinate);
-		this->Paint(bmDest, roi, sbSetsortedByZoom, zoom);
+		this->Paint(bmDest, roi, sbSetsortedByZoom, zoom, options);
 	}
 	else
 	{
 		auto sbSetSortedByZoomPerScene = this->GetSubSetSortedByZoomPerScene(scenesInvolved, roi, planeCoordinate);
 		for (const auto& it : sbSetSortedByZoomPerScene)
 		{
-			this->Paint(bmDest, roi, get<1>(it), zoom);
+			this->Paint(bmDest, roi, get<1>(it), zoom, options);
 		}
 	}
 }
 
-void CSingleChannelScalingTileAccessor::Paint(libCZI::IBitmapData* bmDest, const libCZI::IntRect&  roi, const SubSetSortedByZoom& sbSetSortedByZoom, float zoom)
+void CSingleChannelScalingTileAccessor::Paint(libCZI::IBitmapData* bmDest, const libCZI::IntRect&  roi, const SubSetSortedByZoom& sbSetSortedByZoom, float zoom, const libCZI::ISingleChannelScalingTileAccessor::Options& options)
 {
 	int idxOf1stSSubBlockOfZoomGreater = this->GetIdxOf1stSubBlockWithZoomGreater(sbSetSortedByZoom.subBlocks, sbSetSortedByZoom.sortedByZoom, zoom);
 	if (idxOf1stSSubBlockOfZoomGreater < 0)
@@ -247,6 +314,7 @@ void CSingleChannelScalingTileAccessor::Paint(libCZI::IBitmapData* bmDest, const
 
 	float startZoom = sbSetSortedByZoom.subBlocks.at(*it).GetZoom();
 
+	std::vector<const SbInfo*> sbInfos;
 	for (; it != sbSetSortedByZoom.sortedByZoom.cend(); ++it)
 	{
 		const SbInfo& sbInfo = sbSetSortedByZoom.subBlocks.at(*it);
@@ -257,6 +325,29 @@ void CSingleChannelScalingTileAccessor::Paint(libCZI::IBitmapData* bmDest, const
 			break;
 		}
 
+		sbInfos.push_back(&sbInfo);
+	}
+
+	// the sub-blocks are read and decoded (possibly on multiple threads and with the reading ahead of the decoding), and they
+	// are drawn in the order determined above
+	const IntSize sizeDest = bmDest->GetSize();
+	std::vector<SubBlockOrBitmap> subBlocks(sbInfos.size());
+	std::vector<ScaleBltSource> sources(sbInfos.size());
+	TileReader reader(this, options.subBlockCache.get(), (int)sbInfos.size(), options.readBatchSize, [&](int index)->int {return sbInfos[index]->index; });
+	CParallelTileLoader loader(this->loaderThreadPool, (int)sbInfos.size(), options.maxThreads, options.prefetchDepth,
+		[&](int index)->void
+	{
+		subBlocks[index] = reader.Read(index);
+	},
+		[&](int index)->void
+	{
+		const SubBlockOrBitmap source = std::move(subBlocks[index]);
+		sources[index] = this->GetScaleBltSource(sizeDest, roi, *sbInfos[index], options.subBlockCache.get(), options.decodeReducedResolution, source);
+	});
+
+	for (size_t i = 0; i < sbInfos.size(); ++i)
+	{
+		const SbInfo& sbInfo = *sbInfos[i];
 		if (GetSite()->IsEnabled(LOGLEVEL_CHATTYINFORMATION))
 		{
 			stringstream ss;
@@ -264,7 +355,9 @@ void CSingleChannelScalingTileAccessor::Paint(libCZI::IBitmapData* bmDest, const
 			GetSite()->Log(LOGLEVEL_CHATTYINFORMATION, ss);
 		}
 
-		this->ScaleBlt(bmDest, zoom, roi, sbInfo);
+		loader.WaitFor((int)i);
+		ScaleBlt(bmDest, sources[i], options.resamplingMode);
+		sources[i].bitmap.reset();
 	}
 }
 
@@ -27,6 +27,7 @@
 #include "CZIReader.h"
 #include "libCZI.h"
 #include "SingleChannelAccessorBase.h"
+#include "NNResizePlanCache.h"
 
 class CSingleChannelScalingTileAccessor : public CSingleChannelAccessorBase, public libCZI::ISingleChannelScalingTileAccessor
 {
@@ -41,6 +42,10 @@ private:
 		float	GetZoom() const { return libCZI::Utils::CalcZoom(this->logicalRect, this->physicalSize); }
 	};
 
+	/// The plans for scaling the sub-blocks into the destination bitmap - they are re-used when the same geometry is
+	/// requested again (e. g. for the other channels of a multi-channel image).
+	CNNResizePlanCache nnResizePlanCache;
+
 public:
 	explicit CSingleChannelScalingTileAccessor(std::shared_ptr<libCZI::ISubBlockRepository> sbBlkRepository);
 
@@ -55,7 +60,34 @@ private:
 	std::vector<int> CreateSortByZoom(const std::vector<SbInfo>& sbBlks);
 	std::vector<SbInfo> GetSubSet(const libCZI::IntRect& roi, const libCZI::IDimCoordinate* planeCoordinate);
 	int GetIdxOf1stSubBlockWithZoomGreater(const std::vector<SbInfo>& sbBlks, const std::vector<int>& byZoom, float zoom);
-	void ScaleBlt(libCZI::IBitmapData* bmDest, float zoom, const libCZI::IntRect&  roi, const SbInfo& sbInfo);
+
+	/// The decoded sub-block and the parameters for scaling it into the destination bitmap.
+	struct ScaleBltSource
+	{
+		std::shared_ptr<libCZI::IBitmapData> bitmap;
+		int srcOffsetX, srcOffsetY;		///< The position of the decoded bitmap within the sub-block (if only a region was decoded).
+		libCZI::DblRect srcRoi;
+		libCZI::DblRect dstRoi;
+	};
+
+	/// Decodes the specified sub-block (which has been read before), and determines how it is to be scaled into the destination bitmap.
+	///
+	/// \param sizeDest			  The size of the destination bitmap.
+	/// \param roi				  The ROI (which the destination bitmap is representing).
+	/// \param sbInfo			  Information about the sub-block.
+	/// \param [in] subBlockCache The sub-block cache (may be null).
+	/// \param decodeReducedResolution Whether JPG-XR sub-blocks which are scaled down may be decoded with a reduced resolution.
+	/// \param source			  The sub-block or (if it was found in the cache) its bitmap.
+	///
+	/// \return The decoded sub-block and the parameters for scaling it.
+	ScaleBltSource GetScaleBltSource(const libCZI::IntSize& sizeDest, const libCZI::IntRect& roi, const SbInfo& sbInfo, libCZI::ISubBlockCache* subBlockCache, bool decodeReducedResolution, const SubBlockOrBitmap& source);
+
+	/// Scales the decoded sub-block into the destination bitmap.
+	///
+	/// \param [in] bmDest	  The destination bitmap.
+	/// \param source		  The decoded sub-block and the parameters for scaling it.
+	/// \param resamplingMode The algorithm used if the sub-block is scaled down.
+	void ScaleBlt(libCZI::IBitmapData* bmDest, const ScaleBltSource& source, libCZI::ISingleChannelScalingTileAccessor::ResamplingMode resamplingMode);
 
 	void InternalGet(libCZI::IBitmapData* bmDest, const libCZI::IntRect&  roi, const libCZI::IDimCoordinate* planeCoordinate, float zoom, const libCZI::ISingleChannelScalingTileAccessor::Options& options);
 
@@ -70,5 +102,5 @@ private:
 	SubSetSortedByZoom GetSubSetSortedByZoom(const libCZI::IntRect& roi, const libCZI::IDimCoordinate* planeCoordinate);
 
 	std::vector<std::tuple<int, SubSetSortedByZoom>> GetSubSetSortedByZoomPerScene(const std::vector<int>& scenes, const libCZI::IntRect& roi, const libCZI::IDimCoordinate* planeCoordinate);
-	void Paint(libCZI::IBitmapData* bmDest, const libCZI::IntRect&  roi,const SubSetSortedByZoom& sbSetSortedByZoom, float zoom);
+	void Paint(libCZI::IBitmapData* bmDest, const libCZI::IntRect&  roi,const SubSetSortedByZoom& sbSetSortedByZoom, float zoom, const libCZI::ISingleChannelScalingTileAccessor::Options& options);
 };
@@ -26,8 +26,11 @@
 #include "utilities.h"
 #include "SingleChannelTileCompositor.h"
 #include "Site.h"
+#include "CreateBitmap.h"
 #include <iterator> 
 #include "bitmapData.h"
+#include "ParallelTileLoader.h"
+#include "RegionCoverage.h"
 
 using namespace libCZI;
 using namespace std;
@@ -64,17 +67,65 @@ CSingleChannelTileAccessor::CSingleChannelTileAccessor(std::shared_ptr<ISubBlock
 
 void CSingleChannelTileAccessor::ComposeTiles(libCZI::IBitmapData* pBm, int xPos, int yPos, const std::vector<IndexAndM>& subBlocksSet, const ISingleChannelTileAccessor::Options& options)
 {
+	IntSize sizeBm = pBm->GetSize();
+	IntRect roi{ xPos,yPos,(int)sizeBm.w,(int)sizeBm.h };
+
+	// the tiles are read and decoded (possibly on multiple threads and with the reading ahead of the decoding), and they are
+	// composed in the order of the set
+	std::vector<TileBitmap> tiles(subBlocksSet.size());
+	TileReader reader(this, options.subBlockCache.get(), (int)subBlocksSet.size(), options.readBatchSize, [&](int index)->int {return subBlocksSet[index].index; });
+	CParallelTileLoader loader(this->loaderThreadPool, (int)subBlocksSet.size(), options.maxThreads, options.prefetchDepth,
+		[&](int index)->void
+	{
+		tiles[index].source = reader.Read(index);
+	},
+		[&](int index)->void
+	{
+		TileBitmap& tile = tiles[index];
+		const SubBlockOrBitmap source = std::move(tile.source);
+		if (options.subBlockCache)
+		{
+			// with a cache, the sub-block is always decoded completely (so that it can be re-used for other ROIs)
+			tile.bitmap = this->GetSubBlockBitmap(options.subBlockCache.get(), subBlocksSet[index].index, source);
+			tile.x = subBlocksSet[index].logicalRect.x;
+			tile.y = subBlocksSet[index].logicalRect.y;
+			return;
+		}
+
+		const auto& sb = source.subBlock;
+		const SubBlockInfo& sbInfo = sb->GetSubBlockInfo();
+		tile.x = sbInfo.logicalRect.x;
+		tile.y = sbInfo.logicalRect.y;
+
+		// if only a small part of the tile is visible, we only decode this part (which we cannot do if the border of the tile is to be drawn)
+		if (!options.drawTileBorder &&
+			sbInfo.physicalSize.w == (std::uint32_t)sbInfo.logicalRect.w && sbInfo.physicalSize.h == (std::uint32_t)sbInfo.logicalRect.h)
+		{
+			auto intersection = Utilities::Intersect(sbInfo.logicalRect, roi);
+			IntRect roiPhysical{ intersection.x - sbInfo.logicalRect.x, intersection.y - sbInfo.logicalRect.y, intersection.w, intersection.h };
+			if (IsPartialDecodeWorthwhile(sbInfo.mode, sbInfo.physicalSize, roiPhysical))
+			{
+				tile.bitmap = CreateBitmapFromSubBlockForReading(sb.get(), &roiPhysical);
+				tile.x = intersection.x;
+				tile.y = intersection.y;
+				return;
+			}
+		}
+
+		tile.bitmap = CreateBitmapFromSubBlockForReading(sb.get(), nullptr);
+	});
+
 	Compositors::ComposeSingleTileOptions composeOptions; composeOptions.Clear();
 	composeOptions.drawTileBorder = options.drawTileBorder;
 	Compositors::ComposeSingleChannelTiles(
 		[&](int index, std::shared_ptr<libCZI::IBitmapData>& spBm, int& xPosTile, int& yPosTile)->bool
 	{
-		if (index < (int)subBlocksSet.size())
+		if (index < (int)tiles.size())
 		{
-			auto sb = this->sbBlkRepository->ReadSubBlock(subBlocksSet[index].index);
-			spBm = sb->CreateBitmap();
-			xPosTile = sb->GetSubBlockInfo().logicalRect.x;
-			yPosTile = sb->GetSubBlockInfo().logicalRect.y;
+			loader.WaitFor(index);
+			spBm = std::move(tiles[index].bitmap);
+			xPosTile = tiles[index].x;
+			yPosTile = tiles[index].y;
 			return true;
 		}
 
@@ -96,20 +147,63 @@ void CSingleChannelTileAccessor::InternalGet(int xPos, int yPos, libCZI::IBitmap
 	}
 
 	this->CheckPlaneCoordinates(planeCoordinate);
-	Clear(pBm, pOptions->backGroundColor);
 	IntSize sizeBm = pBm->GetSize();
 	IntRect roi{ xPos,yPos,(int)sizeBm.w,(int)sizeBm.h };
 	std::vector<IndexAndM> subBlocksSet = this->GetSubBlocksSubset(roi, planeCoordinate, pOptions->sortByM);
 
+	// sub-blocks which are hidden by the ones drawn on top of them are neither read nor decoded, and if the ROI is covered
+	// completely, the background does not need to be cleared
+	if (!RemoveOccludedSubBlocks(roi, subBlocksSet))
+	{
+		Clear(pBm, pOptions->backGroundColor);
+	}
+
 	this->ComposeTiles(pBm, xPos, yPos, subBlocksSet, *pOptions);
 }
 
+/*static*/bool CSingleChannelTileAccessor::RemoveOccludedSubBlocks(const libCZI::IntRect& roi, std::vector<IndexAndM>& subBlocksSet)
+{
+	CRegionCoverage coverage(roi);
+	std::vector<bool> occluded(subBlocksSet.size(), false);
+	for (size_t i = subBlocksSet.size(); i-- > 0;)
+	{
+		// a sub-block is drawn with its stored size (at the position of its logical rect), so if the stored size differs
+		// from the logical size, we do not know exactly which area it is covering
+		const IndexAndM& sb = subBlocksSet[i];
+		if (sb.physicalSize.w != (std::uint32_t)sb.logicalRect.w || sb.physicalSize.h != (std::uint32_t)sb.logicalRect.h)
+		{
+			continue;
+		}
+
+		if (coverage.IsCovered(sb.logicalRect))
+		{
+			occluded[i] = true;
+		}
+		else
+		{
+			coverage.Add(sb.logicalRect);
+		}
+	}
+
+	size_t n = 0;
+	for (size_t i = 0; i < subBlocksSet.size(); ++i)
+	{
+		if (!occluded[i])
+		{
+			subBlocksSet[n++] = subBlocksSet[i];
+		}
+	}
+
+	subBlocksSet.resize(n);
+	return coverage.IsCompletelyCovered();
+}
+
 std::vector<CSingleChannelTileAccessor::IndexAndM> CSingleChannelTileAccessor::GetSubBlocksSubset(const IntRect& roi, const IDimCoordinate* planeCoordinate, bool sortByM /*,libCZI::PixelType* pPixelTypeOfFirstFoundSubBlock=nullptr*/)
 {
 	// ok... for a first tentative, experimental and quick-n-dirty implementation, simply
 	// get all subblocks by enumerating all
 	std::vector<IndexAndM> subBlocksSet;
-	this->GetAllSubBlocks(roi, planeCoordinate, [&](int index, int mIndex)->void {subBlocksSet.emplace_back(IndexAndM{ index,mIndex }); });
+	this->GetAllSubBlocks(roi, planeCoordinate, [&](int index, const SubBlockInfo& info)->void {subBlocksSet.emplace_back(IndexAndM{ index,info.mIndex,info.logicalRect,info.physicalSize }); });
 	if (sortByM == true)
 	{
 		// sort ascending-by-M-index (-> lowest M-index first, highest last)
@@ -119,14 +213,14 @@ std::vector<CSingleChannelTileAccessor::IndexAndM> CSingleChannelTileAccessor::G
 	return subBlocksSet;
 }
 
-void CSingleChannelTileAccessor::GetAllSubBlocks(const IntRect& roi, const IDimCoordinate* planeCoordinate, std::function<void(int index, int mIndex)> appender/*, libCZI::PixelType* pPixelTypeOfFirstFoundSubBlock*/)
+void CSingleChannelTileAccessor::GetAllSubBlocks(const IntRect& roi, const IDimCoordinate* planeCoordinate, std::function<void(int index, const SubBlockInfo& info)> appender/*, libCZI::PixelType* pPixelTypeOfFirstFoundSubBlock*/)
 {
 	this->sbBlkRepository->EnumSubset(planeCoordinate, nullptr, true,
 		[&](int idx, const SubBlockInfo& info)->bool
 	{
 		if (Utilities::DoIntersect(roi, info.logicalRect))
 		{
-			appender(idx, info.mIndex);
+			appender(idx, info);
 		}
 
 		return true;
@@ -38,14 +38,26 @@ public:	// interface ISingleChannelTileAccessor
 private:
 	void InternalGet(int xPos, int yPos, libCZI::IBitmapData* pBm, const libCZI::IDimCoordinate* planeCoordinate, const libCZI::ISingleChannelTileAccessor::Options* pOptions);
 	//std::shared_ptr<libCZI::IBitmapData> InternalGet(const libCZI::IntRect& roi, const libCZI::IDimCoordinate* planeCoordinate, const ISingleChannelTileAccessor::Options* pOptions);
-	void GetAllSubBlocks(const libCZI::IntRect& roi, const libCZI::IDimCoordinate* planeCoordinate, std::function<void(int index, int mIndex)> appender/*, libCZI::PixelType* pPixelTypeOfFirstFoundSubBlock*/);
+	void GetAllSubBlocks(const libCZI::IntRect& roi, const libCZI::IDimCoordinate* planeCoordinate, std::function<void(int index, const libCZI::SubBlockInfo& info)> appender/*, libCZI::PixelType* pPixelTypeOfFirstFoundSubBlock*/);
 
 	struct IndexAndM
 	{
 		int index;
 		int mIndex;
+		libCZI::IntRect logicalRect;
+		libCZI::IntSize physicalSize;
 	};
 
 	std::vector<CSingleChannelTileAccessor::IndexAndM> GetSubBlocksSubset(const libCZI::IntRect& roi, const libCZI::IDimCoordinate* planeCoordinate, bool sortByM/*, libCZI::PixelType* pPixelTypeOfFirstFoundSubBlock = nullptr*/);
+
+	/// Removes the sub-blocks which are completely hidden (within the ROI) by sub-blocks composed after them. This is
+	/// determined by walking the sub-blocks from the last one composed to the first one, and keeping track of the area
+	/// covered so far. Only sub-blocks whose stored size is equal to their logical size are considered here.
+	///
+	/// \param roi				   The ROI.
+	/// \param [in,out] subBlocksSet The sub-blocks (in the order in which they are composed).
+	///
+	/// \return True if the ROI is completely covered by the remaining sub-blocks, false otherwise.
+	static bool RemoveOccludedSubBlocks(const libCZI::IntRect& roi, std::vector<IndexAndM>& subBlocksSet);
 	void ComposeTiles(libCZI::IBitmapData* pBm, int xPos, int yPos, const std::vector<IndexAndM>& subBlocksSet, const libCZI::ISingleChannelTileAccessor::Options& options);
 };
@@ -26,9 +26,32 @@
 #include <sstream>
 #include <codecvt>
 #include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <climits>
+#include <limits>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
+#if !defined(_WIN32)
+/// Gets the time of the last modification (in nanoseconds) from the information returned by stat.
+static std::int64_t GetModificationTime(const struct stat& statBuf)
+{
+#if defined(__APPLE__)
+	return (std::int64_t)statBuf.st_mtimespec.tv_sec * 1000000000 + statBuf.st_mtimespec.tv_nsec;
+#else
+	return (std::int64_t)statBuf.st_mtim.tv_sec * 1000000000 + statBuf.st_mtim.tv_nsec;
+#endif
+}
+#endif
+
 CSimpleStreamImpl::CSimpleStreamImpl(const wchar_t* filename)
 {
 #if defined(_WIN32)
@@ -116,6 +139,165 @@ void CSimpleStreamImplCppStreams::Read(std::uint64_t offset, void *pv, std::uint
 
 //----------------------------------------------------------------------------
 
+#if !defined(_WIN32)
+CSimpleStreamImplPread::CSimpleStreamImplPread(const wchar_t* filename)
+	: fileDescriptor(-1)
+{
+	// convert the wchar_t to an UTF8-string
+	size_t requiredSize = std::wcstombs(nullptr, filename, 0);
+	std::string conv(requiredSize, 0);
+	conv.resize(std::wcstombs(&conv[0], filename, requiredSize));
+
+	this->fileDescriptor = open(conv.c_str(), O_RDONLY);
+	if (this->fileDescriptor < 0)
+	{
+		int err = errno;
+		std::stringstream ss;
+		ss << "Error opening the file \"" << conv << "\" -> errno=" << err << " (" << strerror(err) << ")";
+		throw std::runtime_error(ss.str());
+	}
+}
+
+CSimpleStreamImplPread::~CSimpleStreamImplPread()
+{
+	close(this->fileDescriptor);
+}
+
+/*virtual*/void CSimpleStreamImplPread::Read(std::uint64_t offset, void *pv, std::uint64_t size, std::uint64_t* ptrBytesRead)
+{
+	// pread may return less than requested (without having reached the end of the file), so we loop until
+	//  we either got all the data or hit the end of the file
+	std::uint64_t bytesRead = 0;
+	while (bytesRead < size)
+	{
+		ssize_t r = pread(this->fileDescriptor, static_cast<char*>(pv) + bytesRead, (size_t)(size - bytesRead), (off_t)(offset + bytesRead));
+		if (r < 0)
+		{
+			int err = errno;
+			if (err == EINTR)
+			{
+				continue;
+			}
+
+			std::stringstream ss;
+			ss << "Error reading from file -> errno=" << err << " (" << strerror(err) << ")";
+			throw std::runtime_error(ss.str());
+		}
+
+		if (r == 0)
+		{
+			break;
+		}
+
+		bytesRead += r;
+	}
+
+	if (ptrBytesRead != nullptr)
+	{
+		*ptrBytesRead = bytesRead;
+	}
+}
+
+/*virtual*/void CSimpleStreamImplPread::ReadBatch(ReadRequest* requests, size_t count)
+{
+	// sort the requests by their position in the file, so that we can find runs of requests which are close to each other
+	std::vector<size_t> order(count);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b)->bool {return requests[a].offset < requests[b].offset; });
+
+	// the data in the gaps between the requests of a run is read into this buffer (and discarded), all gaps share it
+	std::vector<char> gapBuffer;
+	std::vector<struct iovec> iov;
+	for (size_t i = 0; i < count;)
+	{
+		iov.clear();
+		iov.push_back(iovec{ requests[order[i]].pv, (size_t)requests[order[i]].size });
+		std::uint64_t end = requests[order[i]].offset + requests[order[i]].size;
+		size_t runEnd = i + 1;
+		for (; runEnd < count && iov.size() + 2 <= IOV_MAX; ++runEnd)
+		{
+			const ReadRequest& next = requests[order[runEnd]];
+			if (next.offset < end || next.offset - end > (std::uint64_t)CSimpleStreamImplPread::BATCHMAXGAP)
+			{
+				break;
+			}
+
+			if (next.offset > end)
+			{
+				if (gapBuffer.empty())
+				{
+					gapBuffer.resize(CSimpleStreamImplPread::BATCHMAXGAP);
+				}
+
+				iov.push_back(iovec{ &gapBuffer[0], (size_t)(next.offset - end) });
+			}
+
+			iov.push_back(iovec{ next.pv, (size_t)next.size });
+			end = next.offset + next.size;
+		}
+
+		const std::uint64_t runStart = requests[order[i]].offset;
+		ssize_t r = 0;
+		if (runEnd - i > 1)
+		{
+			do
+			{
+				r = preadv(this->fileDescriptor, &iov[0], (int)iov.size(), (off_t)runStart);
+			} while (r < 0 && errno == EINTR);
+
+			if (r < 0)
+			{
+				int err = errno;
+				std::stringstream ss;
+				ss << "Error reading from file -> errno=" << err << " (" << strerror(err) << ")";
+				throw std::runtime_error(ss.str());
+			}
+		}
+
+		// determine what we got for each request - and if the read was short (or we did not use preadv at all), read
+		//  the rest of the requests individually
+		for (size_t n = i; n < runEnd; ++n)
+		{
+			ReadRequest& req = requests[order[n]];
+			const std::uint64_t runPosition = req.offset - runStart;
+			const std::uint64_t got = (std::uint64_t)r > runPosition ? (std::min)((std::uint64_t)r - runPosition, req.size) : 0;
+			req.bytesRead = got;
+			if (got < req.size)
+			{
+				std::uint64_t bytesRead;
+				this->Read(req.offset + got, static_cast<char*>(req.pv) + got, req.size - got, &bytesRead);
+				req.bytesRead += bytesRead;
+			}
+		}
+
+		i = runEnd;
+	}
+}
+
+/*virtual*/bool CSimpleStreamImplPread::TryGetFileInfo(std::uint64_t* fileSize, std::int64_t* modificationTime)
+{
+	struct stat statBuf;
+	if (fstat(this->fileDescriptor, &statBuf) != 0)
+	{
+		return false;
+	}
+
+	if (fileSize != nullptr)
+	{
+		*fileSize = (std::uint64_t)statBuf.st_size;
+	}
+
+	if (modificationTime != nullptr)
+	{
+		*modificationTime = GetModificationTime(statBuf);
+	}
+
+	return true;
+}
+#endif
+
+//----------------------------------------------------------------------------
+
 #if defined(_WIN32)
 CSimpleStreamImplWindows::CSimpleStreamImplWindows(const wchar_t* filename)
 	: handle(INVALID_HANDLE_VALUE)
@@ -160,6 +342,28 @@ void CSimpleStreamImplWindows::Read(std::uint64_t offset, void *pv, std::uint64_
 		*ptrBytesRead = bytesRead;
 	}
 }
+
+/*virtual*/bool CSimpleStreamImplWindows::TryGetFileInfo(std::uint64_t* fileSize, std::int64_t* modificationTime)
+{
+	LARGE_INTEGER size;
+	FILETIME lastWriteTime;
+	if (!GetFileSizeEx(this->handle, &size) || !GetFileTime(this->handle, NULL, NULL, &lastWriteTime))
+	{
+		return false;
+	}
+
+	if (fileSize != nullptr)
+	{
+		*fileSize = (std::uint64_t)size.QuadPart;
+	}
+
+	if (modificationTime != nullptr)
+	{
+		*modificationTime = (std::int64_t)((((std::uint64_t)lastWriteTime.dwHighDateTime) << 32) | lastWriteTime.dwLowDateTime);
+	}
+
+	return true;
+}
 #endif
 
 //----------------------------------------------------------------------------
@@ -196,3 +400,165 @@ CStreamImplInMemory::CStreamImplInMemory(libCZI::IAttachment* attachement)
 		*ptrBytesRead = sizeToCopy;
 	}
 }
+
+/*virtual*/std::shared_ptr<const void> CStreamImplInMemory::TryGetView(std::uint64_t offset, std::uint64_t size)
+{
+	if (offset > this->dataBufferSize || size > this->dataBufferSize - offset)
+	{
+		return std::shared_ptr<const void>();
+	}
+
+	// the aliasing constructor gives us a pointer which shares ownership with the memory-block
+	return std::shared_ptr<const void>(this->rawData, static_cast<const char*>(this->rawData.get()) + offset);
+}
+
+//----------------------------------------------------------------------------
+
+CStreamImplMemoryMapped::CStreamImplMemoryMapped(const wchar_t* filename)
+	: CStreamImplMemoryMapped(CStreamImplMemoryMapped::MapFile(filename))
+{
+}
+
+CStreamImplMemoryMapped::CStreamImplMemoryMapped(const MappedFile& mappedFile)
+	: CStreamImplInMemory(mappedFile.ptr, mappedFile.size), fileSize(mappedFile.size), modificationTime(mappedFile.modificationTime)
+{
+}
+
+/*virtual*/bool CStreamImplMemoryMapped::TryGetFileInfo(std::uint64_t* fileSize, std::int64_t* modificationTime)
+{
+	// the information is determined when the file is mapped (we do not keep the file open)
+	if (fileSize != nullptr)
+	{
+		*fileSize = this->fileSize;
+	}
+
+	if (modificationTime != nullptr)
+	{
+		*modificationTime = this->modificationTime;
+	}
+
+	return true;
+}
+
+#if defined(_WIN32)
+/*static*/CStreamImplMemoryMapped::MappedFile CStreamImplMemoryMapped::MapFile(const wchar_t* filename)
+{
+	HANDLE h = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+	{
+		std::stringstream ss;
+		wstring_convert<codecvt_utf8<wchar_t>> utf8_conv;
+		ss << "Error opening the file \"" << utf8_conv.to_bytes(filename) << "\"";
+		throw std::runtime_error(ss.str());
+	}
+
+	LARGE_INTEGER fileSize;
+	FILETIME lastWriteTime;
+	if (!GetFileSizeEx(h, &fileSize) || !GetFileTime(h, NULL, NULL, &lastWriteTime))
+	{
+		DWORD lastError = GetLastError();
+		CloseHandle(h);
+		std::stringstream ss;
+		ss << "Error determining the size of the file (LastError=" << std::setfill('0') << std::setw(8) << std::showbase << lastError << ")";
+		throw std::runtime_error(ss.str());
+	}
+
+	if ((std::uint64_t)fileSize.QuadPart > (std::numeric_limits<size_t>::max)())
+	{
+		CloseHandle(h);
+		throw std::runtime_error("The file is too large to be mapped into the address space");
+	}
+
+	MappedFile mappedFile;
+	mappedFile.size = (size_t)fileSize.QuadPart;
+	mappedFile.modificationTime = (std::int64_t)((((std::uint64_t)lastWriteTime.dwHighDateTime) << 32) | lastWriteTime.dwLowDateTime);
+	if (mappedFile.size == 0)
+	{
+		// an empty file cannot be mapped, so we just give out an empty stream
+		CloseHandle(h);
+		return mappedFile;
+	}
+
+	HANDLE hMapping = CreateFileMappingW(h, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(h);
+	if (hMapping == NULL)
+	{
+		DWORD lastError = GetLastError();
+		std::stringstream ss;
+		ss << "Error creating a file-mapping (LastError=" << std::setfill('0') << std::setw(8) << std::showbase << lastError << ")";
+		throw std::runtime_error(ss.str());
+	}
+
+	const void* p = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+	if (p == NULL)
+	{
+		DWORD lastError = GetLastError();
+		std::stringstream ss;
+		ss << "Error mapping the file (LastError=" << std::setfill('0') << std::setw(8) << std::showbase << lastError << ")";
+		throw std::runtime_error(ss.str());
+	}
+
+	mappedFile.ptr = std::shared_ptr<const void>(p, [](const void* ptr)->void {UnmapViewOfFile(ptr); });
+	return mappedFile;
+}
+#else
+/*static*/CStreamImplMemoryMapped::MappedFile CStreamImplMemoryMapped::MapFile(const wchar_t* filename)
+{
+	// convert the wchar_t to an UTF8-string
+	size_t requiredSize = std::wcstombs(nullptr, filename, 0);
+	std::string conv(requiredSize, 0);
+	conv.resize(std::wcstombs(&conv[0], filename, requiredSize));
+
+	int fd = open(conv.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		int err = errno;
+		std::stringstream ss;
+		ss << "Error opening the file \"" << conv << "\" -> errno=" << err << " (" << strerror(err) << ")";
+		throw std::runtime_error(ss.str());
+	}
+
+	struct stat statBuf;
+	if (fstat(fd, &statBuf) != 0)
+	{
+		int err = errno;
+		close(fd);
+		std::stringstream ss;
+		ss << "Error determining the size of the file \"" << conv << "\" -> errno=" << err << " (" << strerror(err) << ")";
+		throw std::runtime_error(ss.str());
+	}
+
+	if ((std::uint64_t)statBuf.st_size > (std::numeric_limits<size_t>::max)())
+	{
+		close(fd);
+		std::stringstream ss;
+		ss << "The file \"" << conv << "\" is too large to be mapped into the address space";
+		throw std::runtime_error(ss.str());
+	}
+
+	MappedFile mappedFile;
+	mappedFile.size = (size_t)statBuf.st_size;
+	mappedFile.modificationTime = GetModificationTime(statBuf);
+	if (mappedFile.size == 0)
+	{
+		// an empty file cannot be mapped, so we just give out an empty stream
+		close(fd);
+		return mappedFile;
+	}
+
+	void* p = mmap(nullptr, mappedFile.size, PROT_READ, MAP_SHARED, fd, 0);
+	int err = errno;
+	close(fd);	// the mapping stays valid after closing the file-descriptor
+	if (p == MAP_FAILED)
+	{
+		std::stringstream ss;
+		ss << "Error mapping the file \"" << conv << "\" -> errno=" << err << " (" << strerror(err) << ")";
+		throw std::runtime_error(ss.str());
+	}
+
+	size_t size = mappedFile.size;
+	mappedFile.ptr = std::shared_ptr<const void>(p, [size](const void* ptr)->void {munmap(const_cast<void*>(ptr), size); });
+	return mappedFile;
+}
+#endif
@@ -51,8 +51,33 @@ public:	// interface libCZI::IStream
 	virtual void Read(std::uint64_t offset, void *pv, std::uint64_t size, std::uint64_t* ptrBytesRead);
 };
 
+#if !defined(_WIN32)
+/// <summary>	A stream implementation based on positional reads (pread). The file position is not shared
+/// 			between calls, so this implementation is thread-safe. Batches of requests which are close to
+/// 			each other in the file are read with one call to preadv (where the gaps in between are read
+/// 			into a scratch buffer). </summary>
+class CSimpleStreamImplPread : public libCZI::IStream, public libCZI::IStreamBatch, public libCZI::IStreamFileInfo
+{
+private:
+	/// The maximal gap between two requests of a batch which are read with one call to preadv.
+	static const int BATCHMAXGAP = 64 * 1024;
+
+	int fileDescriptor;
+public:
+	CSimpleStreamImplPread() = delete;
+	CSimpleStreamImplPread(const wchar_t* filename);
+	~CSimpleStreamImplPread();
+public:	// interface libCZI::IStream
+	virtual void Read(std::uint64_t offset, void *pv, std::uint64_t size, std::uint64_t* ptrBytesRead);
+public:	// interface libCZI::IStreamBatch
+	virtual void ReadBatch(ReadRequest* requests, size_t count);
+public:	// interface libCZI::IStreamFileInfo
+	virtual bool TryGetFileInfo(std::uint64_t* fileSize, std::int64_t* modificationTime);
+};
+#endif
+
 #if defined(_WIN32)
-class CSimpleStreamImplWindows : public libCZI::IStream
+class CSimpleStreamImplWindows : public libCZI::IStream, public libCZI::IStreamFileInfo
 {
 private:
 	HANDLE handle;
@@ -62,11 +87,13 @@ public:
 	~CSimpleStreamImplWindows();
 public:	// interface libCZI::IStream
 	virtual void Read(std::uint64_t offset, void *pv, std::uint64_t size, std::uint64_t* ptrBytesRead);
+public:	// interface libCZI::IStreamFileInfo
+	virtual bool TryGetFileInfo(std::uint64_t* fileSize, std::int64_t* modificationTime);
 };
 #endif
 
 /// <summary>	A stream implementation (based on a memory-block). </summary>
-class CStreamImplInMemory : public libCZI::IStream
+class CStreamImplInMemory : public libCZI::IStream, public libCZI::IStreamDirectAccess
 {
 private:
 	std::shared_ptr<const void> rawData;
@@ -77,4 +104,30 @@ public:
 	CStreamImplInMemory(libCZI::IAttachment* attachement);
 public:	// interface libCZI::IStream
 	virtual void Read(std::uint64_t offset, void* pv, std::uint64_t size, std::uint64_t* ptrBytesRead);
+public:	// interface libCZI::IStreamDirectAccess
+	virtual std::shared_ptr<const void> TryGetView(std::uint64_t offset, std::uint64_t size);
+};
+
+/// <summary>	A stream implementation which maps the file into memory (using mmap or MapViewOfFile). Views given out
+/// 			by this stream keep the mapping alive, even after the stream-object has been destroyed. </summary>
+class CStreamImplMemoryMapped : public CStreamImplInMemory, public libCZI::IStreamFileInfo
+{
+private:
+	struct MappedFile
+	{
+		std::shared_ptr<const void> ptr;
+		std::size_t size;
+		std::int64_t modificationTime;
+	};
+
+	std::uint64_t fileSize;
+	std::int64_t modificationTime;
+public:
+	CStreamImplMemoryMapped() = delete;
+	CStreamImplMemoryMapped(const wchar_t* filename);
+public:	// interface libCZI::IStreamFileInfo
+	virtual bool TryGetFileInfo(std::uint64_t* fileSize, std::int64_t* modificationTime);
+private:
+	CStreamImplMemoryMapped(const MappedFile& mappedFile);
+	static MappedFile MapFile(const wchar_t* filename);
 };
@@ -0,0 +1,117 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#include "stdafx.h"
+#include "SubBlockCache.h"
+#include "CziUtils.h"
+
+using namespace libCZI;
+using namespace std;
+
+CSubBlockCache::CSubBlockCache(std::uint64_t maxMemoryUsage)
+	: maxMemoryUsage(maxMemoryUsage), memoryUsage(0), hits(0), misses(0), evictions(0)
+{
+}
+
+/*virtual*/std::shared_ptr<libCZI::IBitmapData> CSubBlockCache::Get(const std::shared_ptr<libCZI::ISubBlockRepository>& repository, int subBlockIndex)
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	auto it = this->entriesByKey.find(Key{ repository.get(), subBlockIndex });
+	if (it == this->entriesByKey.end())
+	{
+		++this->misses;
+		return nullptr;
+	}
+
+	if (it->second->repository.expired())
+	{
+		// the repository this entry was added for does not exist anymore, so the entry is stale
+		this->Remove(it->second);
+		++this->misses;
+		return nullptr;
+	}
+
+	// move the entry to the front (making it the most recently used one)
+	this->entries.splice(this->entries.begin(), this->entries, it->second);
+	++this->hits;
+	return it->second->bitmap;
+}
+
+/*virtual*/void CSubBlockCache::Add(const std::shared_ptr<libCZI::ISubBlockRepository>& repository, int subBlockIndex, std::shared_ptr<libCZI::IBitmapData> bitmap)
+{
+	const std::uint64_t size = CalcSize(bitmap.get());
+	const Key key{ repository.get(), subBlockIndex };
+	std::lock_guard<std::mutex> lck(this->mutex);
+	auto it = this->entriesByKey.find(key);
+	if (it != this->entriesByKey.end())
+	{
+		this->Remove(it->second);
+	}
+
+	if (size > this->maxMemoryUsage)
+	{
+		return;
+	}
+
+	this->entries.emplace_front(Entry{ key, repository, std::move(bitmap), size });
+	this->entriesByKey[key] = this->entries.begin();
+	this->memoryUsage += size;
+
+	while (this->memoryUsage > this->maxMemoryUsage)
+	{
+		this->Remove(std::prev(this->entries.end()));
+		++this->evictions;
+	}
+}
+
+/*virtual*/void CSubBlockCache::Clear()
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	this->entries.clear();
+	this->entriesByKey.clear();
+	this->memoryUsage = 0;
+}
+
+/*virtual*/libCZI::ISubBlockCache::Statistics CSubBlockCache::GetStatistics() const
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	Statistics statistics;
+	statistics.hits = this->hits;
+	statistics.misses = this->misses;
+	statistics.evictions = this->evictions;
+	statistics.memoryUsage = this->memoryUsage;
+	statistics.elementsCount = (std::uint32_t)this->entries.size();
+	return statistics;
+}
+
+void CSubBlockCache::Remove(std::list<Entry>::iterator it)
+{
+	this->memoryUsage -= it->size;
+	this->entriesByKey.erase(it->key);
+	this->entries.erase(it);
+}
+
+/*static*/std::uint64_t CSubBlockCache::CalcSize(libCZI::IBitmapData* bitmap)
+{
+	auto size = bitmap->GetSize();
+	return std::uint64_t(size.w) * size.h * CziUtils::GetBytesPerPel(bitmap->GetPixelType());
+}
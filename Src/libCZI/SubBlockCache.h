@@ -0,0 +1,88 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include "libCZI.h"
+
+/// The stock implementation of a cache for decoded sub-blocks. The entries are kept in a list ordered by their last
+/// usage, and when the budget is exceeded, the least recently used entries are removed. Since the key contains the
+/// address of the repository, an entry also keeps a weak reference to the repository - so that an entry is not
+/// mistaken for one of a different repository which happens to be allocated at the same address later on.
+class CSubBlockCache : public libCZI::ISubBlockCache
+{
+private:
+	struct Key
+	{
+		const libCZI::ISubBlockRepository* repository;
+		int subBlockIndex;
+
+		bool operator==(const Key& other) const
+		{
+			return this->repository == other.repository && this->subBlockIndex == other.subBlockIndex;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			return std::hash<const void*>()(key.repository) ^ (std::hash<int>()(key.subBlockIndex) * 0x9e3779b9u);
+		}
+	};
+
+	struct Entry
+	{
+		Key key;
+		std::weak_ptr<libCZI::ISubBlockRepository> repository;
+		std::shared_ptr<libCZI::IBitmapData> bitmap;
+		std::uint64_t size;
+	};
+
+	std::uint64_t maxMemoryUsage;
+	mutable std::mutex mutex;
+	std::list<Entry> entries;		///< The entries, the most recently used one first.
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entriesByKey;
+	std::uint64_t memoryUsage;
+	std::uint64_t hits;
+	std::uint64_t misses;
+	std::uint64_t evictions;
+public:
+	/// Constructor.
+	///
+	/// \param maxMemoryUsage The budget (in bytes) for the bitmaps held in the cache.
+	explicit CSubBlockCache(std::uint64_t maxMemoryUsage);
+
+public:	// interface ISubBlockCache
+	std::shared_ptr<libCZI::IBitmapData> Get(const std::shared_ptr<libCZI::ISubBlockRepository>& repository, int subBlockIndex) override;
+	void Add(const std::shared_ptr<libCZI::ISubBlockRepository>& repository, int subBlockIndex, std::shared_ptr<libCZI::IBitmapData> bitmap) override;
+	void Clear() override;
+	Statistics GetStatistics() const override;
+
+private:
+	void Remove(std::list<Entry>::iterator it);
+	static std::uint64_t CalcSize(libCZI::IBitmapData* bitmap);
+};
@@ -0,0 +1,272 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#include "stdafx.h"
+#include "SubBlockSpatialIndex.h"
+#include "utilities.h"
+#include "SidecarIndex.h"
+#include <cmath>
+#include <limits>
+
+using namespace libCZI;
+
+CSubBlockSpatialIndex::CSubBlockSpatialIndex()
+	: originX(0), originY(0), cellWidth(1), cellHeight(1), cellsX(0), cellsY(0)
+{
+}
+
+void CSubBlockSpatialIndex::Build(const std::vector<int>& items, const std::function<libCZI::IntRect(int)>& getRect)
+{
+	this->cellStart.clear();
+	this->cellItems.clear();
+	this->unindexedItems.clear();
+	this->cellsX = this->cellsY = 0;
+
+	// determine the bounding box and the average size of the sub-blocks
+	std::int64_t minX = (std::numeric_limits<std::int64_t>::max)(), minY = (std::numeric_limits<std::int64_t>::max)();
+	std::int64_t maxX = (std::numeric_limits<std::int64_t>::min)(), maxY = (std::numeric_limits<std::int64_t>::min)();
+	std::int64_t sumWidth = 0, sumHeight = 0, count = 0;
+	for (int index : items)
+	{
+		IntRect r = getRect(index);
+		if (r.w <= 0 || r.h <= 0)
+		{
+			// those cannot intersect with anything, but we keep them in order to be able to report them in "GetAll"
+			this->unindexedItems.push_back(index);
+			continue;
+		}
+
+		minX = (std::min)(minX, (std::int64_t)r.x);
+		minY = (std::min)(minY, (std::int64_t)r.y);
+		maxX = (std::max)(maxX, (std::int64_t)r.x + r.w);
+		maxY = (std::max)(maxY, (std::int64_t)r.y + r.h);
+		sumWidth += r.w;
+		sumHeight += r.h;
+		++count;
+	}
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	// we use the average size of the sub-blocks as cell size, but limit the number of cells to
+	//  something proportional to the number of sub-blocks
+	this->originX = minX;
+	this->originY = minY;
+	this->cellWidth = (std::max)((std::int64_t)1, sumWidth / count);
+	this->cellHeight = (std::max)((std::int64_t)1, sumHeight / count);
+	const std::int64_t maxCells = 4 * count + 16;
+	for (;;)
+	{
+		std::int64_t cx = (maxX - minX + this->cellWidth - 1) / this->cellWidth;
+		std::int64_t cy = (maxY - minY + this->cellHeight - 1) / this->cellHeight;
+		if (cx * cy <= maxCells)
+		{
+			this->cellsX = (int)cx;
+			this->cellsY = (int)cy;
+			break;
+		}
+
+		double f = std::sqrt(double(cx) * double(cy) / maxCells);
+		this->cellWidth = (std::max)(this->cellWidth + 1, (std::int64_t)std::ceil(this->cellWidth * f));
+		this->cellHeight = (std::max)(this->cellHeight + 1, (std::int64_t)std::ceil(this->cellHeight * f));
+	}
+
+	// now, fill the cells - first count the items in each cell, then place them
+	this->cellStart.assign((size_t)this->cellsX * this->cellsY + 1, 0);
+	for (int index : items)
+	{
+		IntRect r = getRect(index);
+		if (r.w > 0 && r.h > 0)
+		{
+			int x0, y0, x1, y1;
+			this->GetCellRange(r, x0, y0, x1, y1);
+			for (int y = y0; y <= y1; ++y)
+			{
+				for (int x = x0; x <= x1; ++x)
+				{
+					++this->cellStart[(size_t)y * this->cellsX + x + 1];
+				}
+			}
+		}
+	}
+
+	for (size_t i = 1; i < this->cellStart.size(); ++i)
+	{
+		this->cellStart[i] += this->cellStart[i - 1];
+	}
+
+	this->cellItems.resize(this->cellStart.back());
+	std::vector<std::uint32_t> fillPosition(this->cellStart.begin(), this->cellStart.end() - 1);
+	for (int index : items)
+	{
+		IntRect r = getRect(index);
+		if (r.w > 0 && r.h > 0)
+		{
+			int x0, y0, x1, y1;
+			this->GetCellRange(r, x0, y0, x1, y1);
+			for (int y = y0; y <= y1; ++y)
+			{
+				for (int x = x0; x <= x1; ++x)
+				{
+					this->cellItems[fillPosition[(size_t)y * this->cellsX + x]++] = index;
+				}
+			}
+		}
+	}
+}
+
+void CSubBlockSpatialIndex::Query(const libCZI::IntRect& roi, const std::function<libCZI::IntRect(int)>& getRect, std::vector<int>& result) const
+{
+	for (int index : this->unindexedItems)
+	{
+		if (Utilities::DoIntersect(roi, getRect(index)))
+		{
+			result.push_back(index);
+		}
+	}
+
+	if (this->cellsX == 0 || roi.w <= 0 || roi.h <= 0)
+	{
+		return;
+	}
+
+	// check whether the ROI is outside of the grid
+	if ((std::int64_t)roi.x + roi.w <= this->originX || (std::int64_t)roi.y + roi.h <= this->originY ||
+		roi.x >= this->originX + this->cellsX * this->cellWidth || roi.y >= this->originY + this->cellsY * this->cellHeight)
+	{
+		return;
+	}
+
+	int x0, y0, x1, y1;
+	this->GetCellRange(roi, x0, y0, x1, y1);
+	this->AddItemsInCellRange(x0, y0, x1, y1, &roi, getRect, result);
+}
+
+void CSubBlockSpatialIndex::GetAll(const std::function<libCZI::IntRect(int)>& getRect, std::vector<int>& result) const
+{
+	result.insert(result.end(), this->unindexedItems.cbegin(), this->unindexedItems.cend());
+	if (this->cellsX > 0)
+	{
+		this->AddItemsInCellRange(0, 0, this->cellsX - 1, this->cellsY - 1, nullptr, getRect, result);
+	}
+}
+
+void CSubBlockSpatialIndex::Serialize(CSidecarIndexWriter& writer) const
+{
+	writer.Write(this->originX);
+	writer.Write(this->originY);
+	writer.Write(this->cellWidth);
+	writer.Write(this->cellHeight);
+	writer.Write<std::int32_t>(this->cellsX);
+	writer.Write<std::int32_t>(this->cellsY);
+	writer.WriteVector(this->cellStart);
+	writer.WriteVector(this->cellItems);
+	writer.WriteVector(this->unindexedItems);
+}
+
+void CSubBlockSpatialIndex::Deserialize(CSidecarIndexReader& reader, int itemCount)
+{
+	this->originX = reader.Read<std::int64_t>();
+	this->originY = reader.Read<std::int64_t>();
+	this->cellWidth = reader.Read<std::int64_t>();
+	this->cellHeight = reader.Read<std::int64_t>();
+	this->cellsX = reader.Read<std::int32_t>();
+	this->cellsY = reader.Read<std::int32_t>();
+	reader.ReadVector(this->cellStart);
+	reader.ReadVector(this->cellItems);
+	reader.ReadVector(this->unindexedItems);
+
+	// check that the grid is consistent, so that a query cannot access out-of-bounds
+	bool isValid = this->cellWidth > 0 && this->cellHeight > 0 && this->cellsX >= 0 && this->cellsY >= 0 && (this->cellsX == 0) == (this->cellsY == 0);
+	if (isValid)
+	{
+		if (this->cellsX == 0)
+		{
+			isValid = this->cellStart.empty() && this->cellItems.empty();
+		}
+		else
+		{
+			isValid = this->cellStart.size() == (size_t)this->cellsX * this->cellsY + 1 && this->cellStart.front() == 0 && this->cellStart.back() == this->cellItems.size();
+			for (size_t i = 1; isValid && i < this->cellStart.size(); ++i)
+			{
+				isValid = this->cellStart[i - 1] <= this->cellStart[i];
+			}
+		}
+	}
+
+	for (size_t i = 0; isValid && i < this->cellItems.size(); ++i)
+	{
+		isValid = this->cellItems[i] >= 0 && this->cellItems[i] < itemCount;
+	}
+
+	for (size_t i = 0; isValid && i < this->unindexedItems.size(); ++i)
+	{
+		isValid = this->unindexedItems[i] >= 0 && this->unindexedItems[i] < itemCount;
+	}
+
+	if (!isValid)
+	{
+		CSidecarIndexReader::ThrowCorrupt();
+	}
+}
+
+void CSubBlockSpatialIndex::AddItemsInCellRange(int cellX0, int cellY0, int cellX1, int cellY1, const libCZI::IntRect* roi, const std::function<libCZI::IntRect(int)>& getRect, std::vector<int>& result) const
+{
+	for (int y = cellY0; y <= cellY1; ++y)
+	{
+		for (int x = cellX0; x <= cellX1; ++x)
+		{
+			size_t cell = (size_t)y * this->cellsX + x;
+			for (std::uint32_t i = this->cellStart[cell]; i < this->cellStart[cell + 1]; ++i)
+			{
+				int index = this->cellItems[i];
+				IntRect r = getRect(index);
+
+				// an item spanning multiple cells is reported only from the first cell (within the queried range) it is in
+				int itemX0, itemY0, itemX1, itemY1;
+				this->GetCellRange(r, itemX0, itemY0, itemX1, itemY1);
+				if ((std::max)(itemX0, cellX0) == x && (std::max)(itemY0, cellY0) == y)
+				{
+					if (roi == nullptr || Utilities::DoIntersect(*roi, r))
+					{
+						result.push_back(index);
+					}
+				}
+			}
+		}
+	}
+}
+
+void CSubBlockSpatialIndex::GetCellRange(const libCZI::IntRect& rect, int& cellX0, int& cellY0, int& cellX1, int& cellY1) const
+{
+	// the rectangle is clipped to the grid (which is only relevant for the ROI)
+	std::int64_t x0 = (std::max)((std::int64_t)rect.x - this->originX, (std::int64_t)0) / this->cellWidth;
+	std::int64_t y0 = (std::max)((std::int64_t)rect.y - this->originY, (std::int64_t)0) / this->cellHeight;
+	std::int64_t x1 = (std::max)((std::int64_t)rect.x + rect.w - 1 - this->originX, (std::int64_t)0) / this->cellWidth;
+	std::int64_t y1 = (std::max)((std::int64_t)rect.y + rect.h - 1 - this->originY, (std::int64_t)0) / this->cellHeight;
+	cellX0 = (int)(std::min)(x0, (std::int64_t)this->cellsX - 1);
+	cellY0 = (int)(std::min)(y0, (std::int64_t)this->cellsY - 1);
+	cellX1 = (int)(std::min)(x1, (std::int64_t)this->cellsX - 1);
+	cellY1 = (int)(std::min)(y1, (std::int64_t)this->cellsY - 1);
+}
@@ -0,0 +1,82 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include "libCZI_Pixels.h"
+
+class CSidecarIndexWriter;
+class CSidecarIndexReader;
+
+/// A spatial index for the logical rectangles of a set of sub-blocks (which is intended to contain the
+/// sub-blocks of one plane and one pyramid-layer). It is implemented as a uniform grid, where the cell size
+/// is derived from the average size of the sub-blocks. This allows to find the sub-blocks intersecting with
+/// a ROI without having to look at all of them.
+class CSubBlockSpatialIndex
+{
+private:
+	std::int64_t originX, originY;
+	std::int64_t cellWidth, cellHeight;
+	int cellsX, cellsY;
+	std::vector<std::uint32_t> cellStart;	///< For each cell, the index into cellItems where its items start (with one additional element at the end).
+	std::vector<int> cellItems;				///< The sub-block indices in the cells.
+	std::vector<int> unindexedItems;		///< Sub-blocks with an empty rectangle (which are not put into the grid).
+public:
+	CSubBlockSpatialIndex();
+
+	/// Builds the index.
+	///
+	/// \param items   The indices of the sub-blocks to be put into the index.
+	/// \param getRect Functor which gives the logical rectangle of a sub-block (identified by its index).
+	void Build(const std::vector<int>& items, const std::function<libCZI::IntRect(int)>& getRect);
+
+	/// Adds the indices of all sub-blocks which intersect with the specified ROI to the result vector. Each
+	/// sub-block is reported only once, the order is arbitrary.
+	///
+	/// \param roi			  The ROI.
+	/// \param getRect		  Functor which gives the logical rectangle of a sub-block (identified by its index).
+	/// \param [in,out] result The indices of the sub-blocks intersecting with the ROI are appended here.
+	void Query(const libCZI::IntRect& roi, const std::function<libCZI::IntRect(int)>& getRect, std::vector<int>& result) const;
+
+	/// Adds the indices of all sub-blocks in the index to the result vector (in arbitrary order).
+	///
+	/// \param getRect		  Functor which gives the logical rectangle of a sub-block (identified by its index).
+	/// \param [in,out] result The indices of the sub-blocks are appended here.
+	void GetAll(const std::function<libCZI::IntRect(int)>& getRect, std::vector<int>& result) const;
+
+	/// Serializes the index (for the sidecar-index).
+	///
+	/// \param [in,out] writer The writer.
+	void Serialize(CSidecarIndexWriter& writer) const;
+
+	/// De-serializes the index (from the sidecar-index). If the data is inconsistent, an exception is thrown.
+	///
+	/// \param [in,out] reader The reader.
+	/// \param itemCount		The number of sub-blocks (all indices in the index must be less than this).
+	void Deserialize(CSidecarIndexReader& reader, int itemCount);
+
+private:
+	void GetCellRange(const libCZI::IntRect& rect, int& cellX0, int& cellY0, int& cellX1, int& cellY1) const;
+	void AddItemsInCellRange(int cellX0, int cellY0, int cellX1, int cellY1, const libCZI::IntRect* roi, const std::function<libCZI::IntRect(int)>& getRect, std::vector<int>& result) const;
+};
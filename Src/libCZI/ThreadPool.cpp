@@ -0,0 +1,218 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+
+#include "stdafx.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+CThreadPool::CThreadPool(int threadCount, int maxTaskThreads)
+	: func(nullptr), count(0), generation(0), activeWorkers(0), shutdown(false), nextIndex(0), cancelled(false), maxTaskThreads(maxTaskThreads), idleTaskThreads(0)
+{
+	for (int i = 1; i < threadCount; ++i)
+	{
+		this->threads.emplace_back([this]()->void {this->WorkerThread(); });
+	}
+}
+
+CThreadPool::~CThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lck(this->mutex);
+		this->shutdown = true;
+	}
+
+	this->workAvailable.notify_all();
+	this->taskAvailable.notify_all();
+	for (auto& t : this->threads)
+	{
+		t.join();
+	}
+
+	// no more task threads are added once "shutdown" is set, so we can access the vector without the lock
+	for (auto& t : this->taskThreads)
+	{
+		t.join();
+	}
+}
+
+void CThreadPool::ParallelFor(int count, const std::function<void(int index)>& func)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	std::unique_lock<std::mutex> loopLck(this->loopMutex, std::try_to_lock);
+	if (this->threads.empty() || count == 1 || !loopLck.owns_lock())
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			func(i);
+		}
+
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lck(this->mutex);
+		this->func = &func;
+		this->count = count;
+		this->nextIndex.store(0);
+		this->cancelled.store(false);
+		this->exception = nullptr;
+		++this->generation;
+	}
+
+	this->workAvailable.notify_all();
+	this->RunIterations(func, count);
+
+	std::exception_ptr ex;
+	{
+		// wait for the workers which joined the loop, and make sure that no worker joins it after we return
+		std::unique_lock<std::mutex> lck(this->mutex);
+		this->workDone.wait(lck, [this]()->bool {return this->activeWorkers == 0; });
+		this->func = nullptr;
+		ex = this->exception;
+		this->exception = nullptr;
+	}
+
+	if (ex)
+	{
+		std::rethrow_exception(ex);
+	}
+}
+
+void CThreadPool::RunIterations(const std::function<void(int index)>& func, int count)
+{
+	for (;;)
+	{
+		if (this->cancelled.load())
+		{
+			break;
+		}
+
+		const int index = this->nextIndex.fetch_add(1);
+		if (index >= count)
+		{
+			break;
+		}
+
+		try
+		{
+			func(index);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lck(this->mutex);
+			if (!this->exception)
+			{
+				this->exception = std::current_exception();
+			}
+
+			this->cancelled.store(true);
+		}
+	}
+}
+
+void CThreadPool::WorkerThread()
+{
+	std::uint64_t lastGeneration = 0;
+	std::unique_lock<std::mutex> lck(this->mutex);
+	for (;;)
+	{
+		this->workAvailable.wait(lck, [&]()->bool {return this->shutdown || (this->func != nullptr && this->generation != lastGeneration); });
+		if (this->shutdown)
+		{
+			break;
+		}
+
+		lastGeneration = this->generation;
+		const std::function<void(int index)>* f = this->func;
+		const int cnt = this->count;
+		++this->activeWorkers;
+		lck.unlock();
+
+		this->RunIterations(*f, cnt);
+
+		lck.lock();
+		if (--this->activeWorkers == 0)
+		{
+			this->workDone.notify_all();
+		}
+	}
+}
+
+bool CThreadPool::TryExecute(std::function<void()> task)
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	if (this->idleTaskThreads == 0 && (int)this->taskThreads.size() >= this->maxTaskThreads)
+	{
+		return false;
+	}
+
+	this->tasks.push_back(std::move(task));
+	if (this->idleTaskThreads > 0)
+	{
+		--this->idleTaskThreads;
+		this->taskAvailable.notify_one();
+		return true;
+	}
+
+	try
+	{
+		this->taskThreads.emplace_back([this]()->void {this->TaskThread(); });
+	}
+	catch (...)
+	{
+		// the task must not be executed after we reported the failure (we hold the lock, so no thread has picked it up)
+		this->tasks.pop_back();
+		throw;
+	}
+
+	return true;
+}
+
+void CThreadPool::TaskThread()
+{
+	// a thread is started for a task, so it is not idle initially - and a task is queued only if there is a thread
+	//  which is going to pick it up
+	std::unique_lock<std::mutex> lck(this->mutex);
+	for (;;)
+	{
+		this->taskAvailable.wait(lck, [this]()->bool {return this->shutdown || !this->tasks.empty(); });
+		if (this->tasks.empty())
+		{
+			break;
+		}
+
+		std::function<void()> task = std::move(this->tasks.front());
+		this->tasks.pop_front();
+		lck.unlock();
+
+		task();
+
+		lck.lock();
+		++this->idleTaskThreads;
+	}
+}
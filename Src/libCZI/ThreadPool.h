@@ -0,0 +1,105 @@
+//******************************************************************************
+// 
+// libCZI is a reader for the CZI fileformat written in C++
+// Copyright (C) 2017  Zeiss Microscopy GmbH
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// To obtain a commercial version please contact Zeiss Microscopy GmbH.
+// 
+//******************************************************************************
+
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <cstdint>
+#include <deque>
+
+/// A pool of worker threads which execute the iterations of a loop in parallel (see "ParallelFor"). The threads are
+/// started in the constructor and are kept waiting for work until the pool is destroyed, so that a loop can be distributed
+/// without the cost of creating threads. The calling thread takes part in executing the iterations.
+/// Only one loop is executed in parallel at a time - if "ParallelFor" is called while another loop is in progress (from
+/// another thread, or from within an iteration), the loop is executed sequentially on the calling thread.
+/// In addition, the pool executes tasks in the background (see "TryExecute") - those run on a separate set of threads, which
+/// is grown on demand (up to a maximum number of threads) and kept for re-use afterwards.
+class CThreadPool
+{
+private:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workDone;
+	std::mutex loopMutex;									///< Held while a loop is executed in parallel.
+	const std::function<void(int index)>* func;				///< The body of the current loop (protected by "mutex").
+	int count;												///< The number of iterations of the current loop (protected by "mutex").
+	std::uint64_t generation;								///< Incremented for every loop (protected by "mutex").
+	int activeWorkers;										///< The number of worker threads executing the current loop (protected by "mutex").
+	bool shutdown;											///< Whether the threads are to terminate (protected by "mutex").
+	std::atomic<int> nextIndex;
+	std::atomic<bool> cancelled;
+	std::exception_ptr exception;							///< The first exception thrown by an iteration (protected by "mutex").
+	int maxTaskThreads;										///< The maximum number of threads executing tasks.
+	std::vector<std::thread> taskThreads;					///< The threads executing tasks (protected by "mutex").
+	std::deque<std::function<void()>> tasks;				///< The tasks which have not yet been picked up by a thread (protected by "mutex").
+	int idleTaskThreads;									///< The number of task threads which are neither executing a task nor reserved for one of "tasks" (protected by "mutex").
+	std::condition_variable taskAvailable;
+public:
+	/// Constructor - the threads are started here.
+	///
+	/// \param threadCount	  The number of threads executing a loop, including the calling thread. If less than or equal to one,
+	/// 					  no worker threads are started and loops are executed sequentially.
+	/// \param maxTaskThreads The maximum number of threads executing tasks (which are only started when needed).
+	explicit CThreadPool(int threadCount, int maxTaskThreads = 0);
+
+	/// The destructor waits for the threads to finish.
+	~CThreadPool();
+
+	CThreadPool(const CThreadPool&) = delete;
+	CThreadPool& operator=(const CThreadPool&) = delete;
+
+	/// Gets the number of threads executing a loop (including the calling thread).
+	///
+	/// \return The number of threads.
+	int GetThreadCount() const { return (int)this->threads.size() + 1; }
+
+	/// Calls the specified functor for every index from 0 to "count"-1 and waits until all calls have finished. The calls are
+	/// distributed over the threads of the pool in no specific order. If a call throws an exception, the calls which have
+	/// not yet been started are skipped and the (first) exception is re-thrown.
+	///
+	/// \param count The number of iterations.
+	/// \param func  The functor to be called for every index.
+	void ParallelFor(int count, const std::function<void(int index)>& func);
+
+	/// Executes the specified task on a background thread and returns immediately. The task is started without delay - if
+	/// no task thread is idle, a new one is added to the pool - so tasks may block while waiting for each other. If no thread
+	/// is idle and the maximum number of task threads is reached, the task is not executed (and false is returned). The task
+	/// must not throw an exception, and it has to be finished before the pool is destroyed.
+	///
+	/// \param task The task.
+	///
+	/// \return True if the task is executed, false if no thread is available for it.
+	bool TryExecute(std::function<void()> task);
+
+private:
+	void WorkerThread();
+	void TaskThread();
+	void RunIterations(const std::function<void(int index)>& func, int count);
+};
@@ -25,7 +25,6 @@
 #include "../JxrDecode/JxrDecode.h"
 #include "bitmapData.h"
 #include "stdAllocator.h"
-#include "BitmapOperations.h"
 #include "Site.h"
 
 using namespace libCZI;
@@ -36,22 +35,111 @@ using namespace std;
 	return make_shared<CJxrLibDecoder>(JxrDecode::Initialize());
 }
 
+CJxrLibDecoder::CJxrLibDecoder(JxrDecode::codecHandle handle)
+{
+	this->handles.push_back(handle);
+}
+
+CJxrLibDecoder::~CJxrLibDecoder()
+{
+	for (auto h : this->handles)
+	{
+		JxrDecode::Destroy(h);
+	}
+}
+
+JxrDecode::codecHandle CJxrLibDecoder::AcquireHandle()
+{
+	{
+		std::lock_guard<std::mutex> lck(this->handlesMutex);
+		if (!this->handles.empty())
+		{
+			auto h = this->handles.back();
+			this->handles.pop_back();
+			return h;
+		}
+	}
+
+	// all contexts are in use (by other threads), so we create another one (outside of the lock)
+	return JxrDecode::Initialize();
+}
+
+void CJxrLibDecoder::ReleaseHandle(JxrDecode::codecHandle handle)
+{
+	std::lock_guard<std::mutex> lck(this->handlesMutex);
+	this->handles.push_back(handle);
+}
+
 /*virtual*/std::shared_ptr<libCZI::IBitmapData> CJxrLibDecoder::Decode(const void* ptrData, size_t size)
+{
+	return this->InternalDecode(ptrData, size, nullptr, 0);
+}
+
+/*virtual*/std::shared_ptr<libCZI::IBitmapData> CJxrLibDecoder::Decode(const void* ptrData, size_t size, const libCZI::IntRect& roi)
+{
+	return this->DecodeReduced(ptrData, size, 1, &roi);
+}
+
+/*virtual*/std::shared_ptr<libCZI::IBitmapData> CJxrLibDecoder::DecodeReduced(const void* ptrData, size_t size, int reductionFactor, const libCZI::IntRect* roi)
+{
+	int thumbnailFactor;
+	switch (reductionFactor)
+	{
+	case 1: thumbnailFactor = 0; break;
+	case 2: thumbnailFactor = 1; break;
+	case 4: thumbnailFactor = 2; break;
+	case 8: thumbnailFactor = 3; break;
+	case 16: thumbnailFactor = 4; break;
+	default: throw std::invalid_argument("The reduction factor must be 1, 2, 4, 8 or 16.");
+	}
+
+	if (roi != nullptr && (roi->w <= 0 || roi->h <= 0 || roi->x < 0 || roi->y < 0))
+	{
+		throw std::invalid_argument("The ROI must be non-empty and must lie within the image.");
+	}
+
+	return this->InternalDecode(ptrData, size, roi, thumbnailFactor);
+}
+
+std::shared_ptr<libCZI::IBitmapData> CJxrLibDecoder::InternalDecode(const void* ptrData, size_t size, const libCZI::IntRect* roi, int thumbnailFactor)
 {
 	std::shared_ptr<IBitmapData> bm;
 
 	JxrDecode::WMPDECAPPARGS args; args.Clear();
 	args.uAlphaMode = 0;	// we don't need any alpha, never
+	args.bBgr48 = true;		// since BGR48 is not available as output, the decoder swaps the channels for us (#36)
+	args.tThumbnailFactor = thumbnailFactor;	// the decoder skips the work which is not needed for the reduced resolution
+	if (roi != nullptr)
+	{
+		// the decoder only decodes the macro-blocks (and, if the stream contains an index-table, only the tiles) which are needed for this region
+		args.rLeftX = roi->x;
+		args.rTopY = roi->y;
+		args.rWidth = roi->w;
+		args.rHeight = roi->h;
+	}
 
 	try
 	{
 		if (GetSite()->IsEnabled(LOGLEVEL_CHATTYINFORMATION))
 		{
 			stringstream ss; ss << "Begin JxrDecode with " << size << " bytes";
+			if (roi != nullptr)
+			{
+				ss << ", ROI=" << *roi;
+			}
+
+			if (thumbnailFactor > 0)
+			{
+				ss << ", reduced by " << (1 << thumbnailFactor);
+			}
+
 			GetSite()->Log(LOGLEVEL_CHATTYINFORMATION, ss.str());
 		}
 
-		JxrDecode::Decode(this->handle, &args, ptrData, size,
+		// the bitmap is locked while the decoder writes into it
+		std::unique_ptr<ScopedBitmapLockerSP> bmLck;
+		std::unique_ptr<void, std::function<void(void*)>> upHandle(this->AcquireHandle(), [this](void* h)->void {this->ReleaseHandle(h); });
+		JxrDecode::DecodeInto(upHandle.get(), &args, ptrData, size,
 			[](JxrDecode::PixelFormat decPixFmt)->JxrDecode::PixelFormat
 		{
 			// We get the "original pixelformat" of the compressed data, and we need to respond
@@ -117,15 +205,15 @@ using namespace std;
 
 			return destFmt;
 		},
-			[&](JxrDecode::PixelFormat pixFmt, std::uint32_t  width, std::uint32_t  height, std::uint32_t linesCount, const void* ptrData, std::uint32_t stride)->void
+			[&](JxrDecode::PixelFormat pixFmt, std::uint32_t width, std::uint32_t height, void** ptrDestination, std::uint32_t* stride)->void
 		{
 			if (GetSite()->IsEnabled(LOGLEVEL_CHATTYINFORMATION))
 			{
-				stringstream ss; ss << "JxrDecode: decode done - pixelfmt="<<JxrDecode::PixelFormatAsInformalString(pixFmt)<<" width=" << width << " height=" << height << " linesCount=" << linesCount << " stride=" << stride;
+				stringstream ss; ss << "JxrDecode: decoding - pixelfmt=" << JxrDecode::PixelFormatAsInformalString(pixFmt) << " width=" << width << " height=" << height;
 				GetSite()->Log(LOGLEVEL_CHATTYINFORMATION, ss.str());
 			}
 
-			// TODO: it seems feasible to directly decode to the buffer (saving us the copy)
+			// we let the decoder write directly into the bitmap
 			PixelType px_type;
 			switch (pixFmt)
 			{
@@ -138,24 +226,9 @@ using namespace std;
 			}
 
 			bm = GetSite()->CreateBitmap(px_type, width, height);
-			auto bmLckInfo = ScopedBitmapLockerSP(bm);
-			if (bmLckInfo.stride != stride)
-			{
-				for (uint32_t i = 0; i < linesCount; ++i)
-				{
-					memcpy(static_cast<char*>(bmLckInfo.ptrDataRoi) + i*bmLckInfo.stride, static_cast<const char*>(ptrData) + i*stride, stride);
-				}
-			}
-			else
-			{
-				memcpy(bmLckInfo.ptrDataRoi, ptrData, stride*linesCount);
-			}
-
-			// since BGR48 is not available as output, we need to convert (#36)
-			if (px_type == PixelType::Bgr48)
-			{
-				CBitmapOperations::RGB48ToBGR48(width, height, (uint16_t*)bmLckInfo.ptrDataRoi, bmLckInfo.stride);
-			}
+			bmLck.reset(new ScopedBitmapLockerSP(bm));
+			*ptrDestination = bmLck->ptrDataRoi;
+			*stride = bmLck->stride;
 		});
 	}
 	catch (std::runtime_error& err)
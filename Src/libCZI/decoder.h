@@ -22,21 +22,43 @@
 
 #pragma once
 
+#include <mutex>
+#include <vector>
 #include "libCZI_Pixels.h"
 #include "../JxrDecode/JxrDecode.h"
 #include "libCZI_Site.h"
 
+/// A JPG-XR decoder based on JxrLib. The decoder is thread-safe - the methods may be called concurrently from any
+/// number of threads. Every call uses a decoder context (a JxrDecode codec-handle, together with its buffers) of
+/// its own, which is taken from a pool and returned to it afterwards. So, there are at most as many contexts as
+/// there are concurrent calls, and the contexts are re-used by subsequent calls.
 class CJxrLibDecoder : public libCZI::IDecoder
 {
 private:
-	JxrDecode::codecHandle handle;
+	std::mutex handlesMutex;						///< Protects "handles" (the lock is only held for taking out or putting back a context).
+	std::vector<JxrDecode::codecHandle> handles;	///< The decoder contexts which are currently not in use.
 public:
 	static std::shared_ptr<CJxrLibDecoder> Create();
 
-	explicit CJxrLibDecoder(JxrDecode::codecHandle handle)
-		: handle(handle)
-	{}
+	/// Constructor. The decoder takes ownership of the specified codec-handle, which is put into the pool.
+	///
+	/// \param handle The codec-handle.
+	explicit CJxrLibDecoder(JxrDecode::codecHandle handle);
+	~CJxrLibDecoder();
+
+	CJxrLibDecoder(const CJxrLibDecoder&) = delete;
+	CJxrLibDecoder& operator=(const CJxrLibDecoder&) = delete;
 
 public:
 	std::shared_ptr<libCZI::IBitmapData> Decode(const void* ptrData, size_t size) override;
+	std::shared_ptr<libCZI::IBitmapData> Decode(const void* ptrData, size_t size, const libCZI::IntRect& roi) override;
+	std::shared_ptr<libCZI::IBitmapData> DecodeReduced(const void* ptrData, size_t size, int reductionFactor, const libCZI::IntRect* roi) override;
+private:
+	std::shared_ptr<libCZI::IBitmapData> InternalDecode(const void* ptrData, size_t size, const libCZI::IntRect* roi, int thumbnailFactor);
+
+	/// Takes a decoder context out of the pool, or creates a new one if the pool is empty.
+	///
+	/// \return The codec-handle, which is to be given back with "ReleaseHandle".
+	JxrDecode::codecHandle AcquireHandle();
+	void ReleaseHandle(JxrDecode::codecHandle handle);
 };
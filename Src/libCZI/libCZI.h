@@ -37,6 +37,8 @@
 #include <memory>
 #include <map>
 #include <limits>
+#include <vector>
+#include <string>
 
 // virtual d'tor -> https://isocpp.org/wiki/faq/virtual-functions#virtual-dtors
 
@@ -88,10 +90,22 @@ namespace libCZI
 	LIBCZI_API std::shared_ptr<ICZIReader> CreateCZIReader();
 
 	/// Creates bitmap from sub block.
+	/// \remark
+	/// If the sub-block is uncompressed, the bitmap refers to the data of the sub-block (it is not copied) - unless the
+	/// data is a read-only view into the stream (e.g. one created with CreateStreamFromFileMapped), in which case the
+	/// bitmap is a copy of the data. So, the pixels of the bitmap can always be modified.
 	/// \param [in] subBlk The sub-block.
 	/// \return The newly allocated bitmap containing the image from the sub-block.
 	LIBCZI_API std::shared_ptr<IBitmapData>  CreateBitmapFromSubBlock(ISubBlock* subBlk);
 
+	/// Creates a bitmap from a region of the sub-block. If the sub-block is compressed, then only the
+	/// region is decoded (as far as the decoder supports this).
+	/// \param [in] subBlk The sub-block.
+	/// \param roi		   The region (in pixels of the stored bitmap, i. e. relative to its physical size). It
+	/// 				   must be non-empty and must lie completely within the bitmap.
+	/// \return The newly allocated bitmap (with the size of the region) containing the image from the sub-block.
+	LIBCZI_API std::shared_ptr<IBitmapData>  CreateBitmapFromSubBlock(ISubBlock* subBlk, const IntRect& roi);
+
 	/// Creates metadata-object from a metadata segment.
 	/// \param [in] metadataSegment The metadata segment object.
 	/// \return The newly created metadata object.
@@ -103,13 +117,38 @@ namespace libCZI
 	/// \return The newly created accessor object.
 	LIBCZI_API std::shared_ptr<IAccessor> CreateAccesor(std::shared_ptr<ISubBlockRepository> repository, AccessorType accessorType);
 
+	/// Creates a cache for decoded sub-blocks (which is thread-safe and can be shared between accessors).
+	/// \param maxMemoryUsage The budget (in bytes) for the bitmaps held in the cache.
+	/// \return The newly created cache object.
+	LIBCZI_API std::shared_ptr<ISubBlockCache> CreateSubBlockCache(std::uint64_t maxMemoryUsage);
+
+	/// Sets the number of threads used by the operations on large bitmaps (e. g. filling the background of a composite,
+	/// scaling and copying the tiles into it, and Utils::CalcMd5SumTreeHash) - the rows of the bitmap are then processed
+	/// in bands in parallel. The result does not depend on the number of threads. The setting applies to all accessors.
+	/// \param threadCount The number of threads (including the calling thread). If less than or equal to one (which is
+	/// 				   the default), the operations are executed on the calling thread only.
+	LIBCZI_API void SetBitmapOperationsThreadCount(int threadCount);
+
 	/// Creates a stream-object for the specified file.
 	/// A stock-implementation of a stream-object (for reading a file from disk) is provided here.
+	/// The stream-object uses positional reads, so it is safe to call Read concurrently from multiple threads.
 	/// \param szFilename Filename of the file.
 	/// \return The new stream object.
 	LIBCZI_API std::shared_ptr<IStream> CreateStreamFromFile(const wchar_t* szFilename);
 
+	/// Creates a stream-object for the specified file, where the file is mapped into memory.
+	/// The stream-object implements the IStreamDirectAccess-interface, so the data of sub-blocks
+	/// read with it are not copied, but are given out as views into the mapping (which keep the mapping alive).
+	/// The mapping is read-only - the bitmaps created from uncompressed sub-blocks (with ISubBlock::CreateBitmap
+	/// or CreateBitmapFromSubBlock) are therefore copies of the data, only the accessors use the mapping directly.
+	/// \param szFilename Filename of the file.
+	/// \return The new stream object.
+	LIBCZI_API std::shared_ptr<IStream> CreateStreamFromFileMapped(const wchar_t* szFilename);
+
 	/// Creates a stream-object on a memory-block.
+	/// The stream-object implements the IStreamDirectAccess-interface, so the data of sub-blocks read with it are not
+	/// copied, but refer to the memory-block (and keep it alive) - so it must not be modified while in use. As with
+	/// CreateStreamFromFileMapped, the bitmaps created from uncompressed sub-blocks are copies of the data.
 	/// \param ptr	Shared pointer to a memory-block.
 	/// \param dataSize Size of the memory-block.
 	/// \return			The new stream object.
@@ -138,6 +177,68 @@ namespace libCZI
 		virtual ~IStream() {}
 	};
 
+	/// Optional interface which may be implemented by a stream-object (in addition to IStream) if it is
+	/// able to give direct access to its data, e.g. because the data is residing in memory or is memory-mapped.
+	/// If a stream-object implements this interface, the CZI-reader will use the views instead of copying the data.
+	class IStreamDirectAccess
+	{
+	public:
+		/// Try to get a view of the specified range of the stream. The returned shared_ptr must keep the
+		/// underlying memory valid for as long as it (or a copy of it) is alive.
+		///
+		/// \param offset The offset of the range.
+		/// \param size   The size of the range (in bytes).
+		///
+		/// \return A pointer to the data at the specified offset; or an empty shared_ptr if the range cannot be accessed directly.
+		virtual std::shared_ptr<const void> TryGetView(std::uint64_t offset, std::uint64_t size) = 0;
+
+		virtual ~IStreamDirectAccess() {}
+	};
+
+	/// Optional interface which may be implemented by a stream-object (in addition to IStream) if it is
+	/// able to process a list of read-requests more efficiently than by issuing them one after the other
+	/// (e.g. by using vectored I/O). If a stream-object does not implement this interface, the CZI-reader
+	/// will fall back to calling IStream::Read for each request.
+	class IStreamBatch
+	{
+	public:
+		/// A read-request, which is part of a batch.
+		struct ReadRequest
+		{
+			std::uint64_t	offset;		///< The offset to start reading from.
+			void*			pv;			///< The caller-provided buffer for the data. Must be non-null.
+			std::uint64_t	size;		///< The size of the buffer.
+			std::uint64_t	bytesRead;	///< [out] Will receive the number of bytes actually read.
+		};
+
+		/// Reads the specified list of requests. The requests may be processed in any order. If an
+		/// error occurs, an exception is thrown (as with IStream::Read).
+		///
+		/// \param [in,out] requests The read-requests.
+		/// \param count			   The number of read-requests.
+		virtual void ReadBatch(ReadRequest* requests, size_t count) = 0;
+
+		virtual ~IStreamBatch() {}
+	};
+
+	/// Optional interface which may be implemented by a stream-object (in addition to IStream) if it is
+	/// backed by a file. The information is used to determine whether a sidecar-index (c.f. ICZIReader::OpenOptions)
+	/// is still valid for the file.
+	class IStreamFileInfo
+	{
+	public:
+		/// Try to get the size and the time of the last modification of the file.
+		///
+		/// \param [out] fileSize		   The size of the file in bytes.
+		/// \param [out] modificationTime  The time of the last modification. This is an opaque value (with a platform-specific
+		/// 								resolution), which is only guaranteed to change if the file is modified.
+		///
+		/// \return True if it succeeds, false if it fails.
+		virtual bool TryGetFileInfo(std::uint64_t* fileSize, std::int64_t* modificationTime) = 0;
+
+		virtual ~IStreamFileInfo() {}
+	};
+
 	/// Information about a sub-block.
 	struct SubBlockInfo
 	{
@@ -452,6 +553,27 @@ namespace libCZI
 		virtual PyramidStatistics GetPyramidStatistics() = 0;
 
 		virtual ~ISubBlockRepository() {}
+
+		/// Reads the sub-blocks identified by the specified indices. Compared to calling ReadSubBlock for
+		/// each index, the I/O-operations are submitted together (as a batch if the stream implements
+		/// IStreamBatch), which reduces the number of round-trips. For an index where there is no
+		/// sub-block present, the corresponding element in the result is an empty shared_ptr. If a
+		/// different kind of problem occurs (e. g. I/O error or corrupted data) an exception is thrown.
+		/// The default implementation calls ReadSubBlock for each index. This method is declared after the
+		/// destructor, so that the layout of the vtable of existing implementations is not changed.
+		/// \param indices The indices of the sub-blocks (as reported by the Enumerate-methods).
+		/// \return The sub-block objects, in the same order as the indices.
+		virtual std::vector<std::shared_ptr<ISubBlock>> ReadSubBlocks(const std::vector<int>& indices)
+		{
+			std::vector<std::shared_ptr<ISubBlock>> subBlocks;
+			subBlocks.reserve(indices.size());
+			for (int index : indices)
+			{
+				subBlocks.push_back(this->ReadSubBlock(index));
+			}
+
+			return subBlocks;
+		}
 	};
 
 	/// Interface for the attachment repository. This interface is used to access the attachments in a CZI-file.
@@ -488,6 +610,38 @@ namespace libCZI
 	class ICZIReader : public ISubBlockRepository, public IAttachmentRepository
 	{
 	public:
+		/// Options for controlling how the CZI-document is opened.
+		struct OpenOptions
+		{
+			/// If true, then the sub-block directory is kept in a compact (column-oriented) representation, where
+			/// every dimension of the plane-coordinates and every other property is stored as a bit-packed column
+			/// (in chunks of sub-blocks, which are compacted already while the directory is parsed). This considerably
+			/// reduces the memory needed for documents with a large number of sub-blocks, at the expense of a (small)
+			/// overhead when enumerating the sub-blocks.
+			bool useCompactSubBlockDirectory;
+
+			/// If not empty, the filename of a sidecar-index. The sidecar-index contains the parsed sub-block directory
+			/// and attachment directory (including the statistics and the spatial index), so that re-opening a document
+			/// does not require to read and parse the directories again. If the sidecar-index does not exist, is stale
+			/// (i. e. it was created for a different file, or the file has been modified since) or is corrupt, then the
+			/// directories are parsed from the document and the sidecar-index is (re-)written.
+			/// The sidecar-index is only used if the stream implements the IStreamFileInfo-interface.
+			std::wstring sidecarIndexFilename;
+
+			/// If true, then the sub-block directory and the attachment directory are not read when the document is
+			/// opened, but only when they are first needed. This makes opening the document considerably faster for
+			/// clients which are only interested in the metadata (opening then only reads the file header).
+			bool lazyLoadDirectories;
+
+			/// Clears this object to its blank state.
+			void Clear()
+			{
+				this->useCompactSubBlockDirectory = false;
+				this->sidecarIndexFilename.clear();
+				this->lazyLoadDirectories = false;
+			}
+		};
+
 		/// Opens the specified stream and reads the global information from the CZI-document.
 		/// The stream passed in will have its refcount incremented, a reference is held until Close
 		/// is called (or the instance is destroyed).
@@ -519,6 +673,22 @@ namespace libCZI
 		/// is usually not neccesary to explitely call `Close`. Also, take care that the ownership of
 		/// the class must be defined when calling `Close`.
 		virtual void Close() = 0;
+
+		/// Opens the specified stream and reads the global information from the CZI-document.
+		/// The stream passed in will have its refcount incremented, a reference is held until Close
+		/// is called (or the instance is destroyed).
+		/// \remark
+		/// If this method is called twice, then an exception of type std::logic_error is thrown.
+		/// The default implementation ignores the options and calls Open(stream), so that existing implementations of
+		/// this interface need not be changed. It is declared after the other methods, so that their vtable slots are
+		/// unchanged.
+		///
+		/// \param stream   The stream object.
+		/// \param pOptions Options for controlling the operation (if null, the default options are used).
+		virtual void Open(std::shared_ptr<IStream> stream, const OpenOptions* /*pOptions*/)
+		{
+			this->Open(stream);
+		}
 	public:
 		/// Creates a single channel tile accessor.
 		/// \return The new single channel tile accessor.
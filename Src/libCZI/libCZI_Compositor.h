@@ -32,6 +32,7 @@ namespace libCZI
 {
 	class IBitmapData;
 	class IDimCoordinate;
+	class ISubBlockRepository;
 
 	/// Values that represent the accessor types.
 	enum class AccessorType
@@ -41,6 +42,52 @@ namespace libCZI
 		SingleChannelScalingTileAccessor		///< The scaling-single-channel-tile accessor (associated interface: ISingleChannelScalingTileAccessor).
 	};
 
+	/// A cache for decoded sub-blocks, which can be shared between accessors (and between repositories) - it is given to
+	/// an accessor with its options. An entry is identified by the repository and the index of the sub-block, and it
+	/// holds the complete bitmap of the sub-block (in its stored resolution). The total size of the bitmaps is kept
+	/// within a budget by removing the least recently used entries. The bitmaps in the cache must not be modified.
+	/// Implementations must be thread-safe.
+	class ISubBlockCache
+	{
+	public:
+		/// Statistics about the usage of the cache.
+		struct Statistics
+		{
+			std::uint64_t hits;				///< The number of calls to "Get" which found the bitmap in the cache.
+			std::uint64_t misses;			///< The number of calls to "Get" which did not find the bitmap in the cache.
+			std::uint64_t evictions;		///< The number of entries which have been removed in order to stay within the budget.
+			std::uint64_t memoryUsage;		///< The total size (in bytes) of the bitmaps currently held in the cache.
+			std::uint32_t elementsCount;	///< The number of bitmaps currently held in the cache.
+		};
+
+		/// Gets the bitmap of the specified sub-block from the cache. The bitmap is shared with the cache (and the bitmap of an
+		/// uncompressed sub-block added by an accessor may refer to read-only data of the stream), so it must not be modified.
+		///
+		/// \param repository    The repository the sub-block belongs to.
+		/// \param subBlockIndex The index of the sub-block.
+		///
+		/// \return The bitmap if it is in the cache, an empty shared_ptr otherwise.
+		virtual std::shared_ptr<IBitmapData> Get(const std::shared_ptr<ISubBlockRepository>& repository, int subBlockIndex) = 0;
+
+		/// Adds the bitmap of the specified sub-block to the cache (replacing an existing entry). If the bitmap is larger
+		/// than the budget, it is not added.
+		///
+		/// \param repository    The repository the sub-block belongs to.
+		/// \param subBlockIndex The index of the sub-block.
+		/// \param bitmap		 The (complete) bitmap of the sub-block.
+		virtual void Add(const std::shared_ptr<ISubBlockRepository>& repository, int subBlockIndex, std::shared_ptr<IBitmapData> bitmap) = 0;
+
+		/// Removes all entries from the cache (the counters are not reset).
+		virtual void Clear() = 0;
+
+		/// Gets the statistics.
+		///
+		/// \return The statistics.
+		virtual Statistics GetStatistics() const = 0;
+
+		virtual ~ISubBlockCache() {}
+	};
+
 	/// The base interface (all accessor-interface must derive from this).
 	class IAccessor
 	{
@@ -86,6 +133,27 @@ namespace libCZI
 			/// If specified, only subblocks with a scene-index contained in the set will be considered.
 			std::shared_ptr<libCZI::IIndexSet> sceneFilter;
 
+			/// If specified, the bitmaps of the sub-blocks are taken from this cache (if present there), and the sub-blocks which
+			/// are decoded (in their stored resolution) are added to it.
+			std::shared_ptr<libCZI::ISubBlockCache> subBlockCache;
+
+			/// The maximum number of threads used for reading and decoding the sub-blocks. The sub-blocks are still
+			/// composed in the same order, so the result is identical to the one obtained with a single thread. If
+			/// less than or equal to one, the sub-blocks are read and decoded on the calling thread.
+			int maxThreads;
+
+			/// The maximum number of sub-blocks which are read ahead of decoding. If greater than zero, the sub-blocks are read
+			/// on a separate I/O-thread (in the order in which they are composed), so that the latency of reading a sub-block
+			/// overlaps with decoding the sub-blocks read before. If less than or equal to zero, a sub-block is read
+			/// immediately before it is decoded.
+			int prefetchDepth;
+
+			/// The number of sub-blocks which are read together. The sub-blocks of a batch (which are consecutive in the order
+			/// in which they are composed) are read with ISubBlockRepository::ReadSubBlocks - i. e. in the order of their position
+			/// in the file, with reads of sub-blocks which are close to each other combined. If less than or equal to one, the
+			/// sub-blocks are read one by one.
+			int readBatchSize;
+
 			/// Clears this object to its blank state.
 			void Clear()
 			{
@@ -93,6 +161,10 @@ namespace libCZI
 				this->sortByM = true;
 				this->drawTileBorder = false;
 				this->sceneFilter.reset();
+				this->subBlockCache.reset();
+				this->maxThreads = 1;
+				this->prefetchDepth = 0;
+				this->readBatchSize = 1;
 			}
 		};
 
@@ -181,12 +253,37 @@ namespace libCZI
 			/// If specified, only subblocks with a scene-index contained in the set will be considered.
 			std::shared_ptr<libCZI::IIndexSet> sceneFilter;
 
+			/// If specified, the bitmaps of the sub-blocks are taken from this cache (if present there), and the sub-blocks which
+			/// are decoded (in their stored resolution) are added to it.
+			std::shared_ptr<libCZI::ISubBlockCache> subBlockCache;
+
+			/// The maximum number of threads used for reading and decoding the sub-blocks. The sub-blocks are still
+			/// composed in the same order, so the result is identical to the one obtained with a single thread. If
+			/// less than or equal to one, the sub-blocks are read and decoded on the calling thread.
+			int maxThreads;
+
+			/// The maximum number of sub-blocks which are read ahead of decoding. If greater than zero, the sub-blocks are read
+			/// on a separate I/O-thread (in the order in which they are composed), so that the latency of reading a sub-block
+			/// overlaps with decoding the sub-blocks read before. If less than or equal to zero, a sub-block is read
+			/// immediately before it is decoded.
+			int prefetchDepth;
+
+			/// The number of sub-blocks which are read together. The sub-blocks of a batch (which are consecutive in the order
+			/// in which they are composed) are read with ISubBlockRepository::ReadSubBlocks - i. e. in the order of their position
+			/// in the file, with reads of sub-blocks which are close to each other combined. If less than or equal to one, the
+			/// sub-blocks are read one by one.
+			int readBatchSize;
+
 			/// Clears this object to its blank state.
 			void Clear()
 			{
 				this->drawTileBorder = false;
 				this->backGroundColor.r = this->backGroundColor.g = this->backGroundColor.b = std::numeric_limits<float>::quiet_NaN();
 				this->sceneFilter.reset();
+				this->subBlockCache.reset();
+				this->maxThreads = 1;
+				this->prefetchDepth = 0;
+				this->readBatchSize = 1;
 			}
 		};
 
@@ -235,10 +332,20 @@ namespace libCZI
 	/// This accessor creates a multi-tile composite of a single channel (and a single plane) with a given zoom-factor.
 	/// It will use pyramid sub-blocks (if present) in order to create the destination bitmap. In this operation, it will use
 	/// the pyramid-layer just above the specified zoom-factor and scale down to the requested size.\n
-	/// The scaling operation employed here is a simple nearest-neighbor algorithm.
+	/// The scaling operation employed here is a simple nearest-neighbor algorithm by default, an area-averaging algorithm
+	/// can be chosen with the options. Optionally, JPG-XR compressed sub-blocks which are scaled down by a factor of two or
+	/// more are decoded with a reduced resolution (see Options::decodeReducedResolution), so the pixels are then taken
+	/// from the decoder's downscaled image instead of from the full-resolution image.
 	class ISingleChannelScalingTileAccessor : public IAccessor
 	{
 	public:
+		/// The algorithms for scaling down the sub-blocks.
+		enum class ResamplingMode
+		{
+			NearestNeighbor,	///< Each destination pixel is taken from a single source pixel (fastest, but prone to aliasing).
+			AreaAverage			///< Each destination pixel is the average of the source pixels it covers (weighted with the covered area).
+		};
+
 		/// Options used for this accessor.
 		struct Options
 		{
@@ -255,12 +362,52 @@ namespace libCZI
 			/// If specified, only subblocks with a scene-index contained in the set will be considered.
 			std::shared_ptr<libCZI::IIndexSet> sceneFilter;
 
+			/// If specified, the bitmaps of the sub-blocks are taken from this cache (if present there), and the sub-blocks which
+			/// are decoded (in their stored resolution) are added to it.
+			std::shared_ptr<libCZI::ISubBlockCache> subBlockCache;
+
+			/// The maximum number of threads used for reading and decoding the sub-blocks. The sub-blocks are still
+			/// composed in the same order, so the result is identical to the one obtained with a single thread. If
+			/// less than or equal to one, the sub-blocks are read and decoded on the calling thread.
+			int maxThreads;
+
+			/// The maximum number of sub-blocks which are read ahead of decoding. If greater than zero, the sub-blocks are read
+			/// on a separate I/O-thread (in the order in which they are composed), so that the latency of reading a sub-block
+			/// overlaps with decoding the sub-blocks read before. If less than or equal to zero, a sub-block is read
+			/// immediately before it is decoded.
+			int prefetchDepth;
+
+			/// The number of sub-blocks which are read together. The sub-blocks of a batch (which are consecutive in the order
+			/// in which they are composed) are read with ISubBlockRepository::ReadSubBlocks - i. e. in the order of their position
+			/// in the file, with reads of sub-blocks which are close to each other combined. If less than or equal to one, the
+			/// sub-blocks are read one by one.
+			int readBatchSize;
+
+			/// The algorithm used for sub-blocks which are scaled down. With ResamplingMode::AreaAverage, an overview gives a
+			/// smooth (display-quality) image instead of the noise and moire patterns of a nearest-neighbor resize, at the expense
+			/// of reading all source pixels. Sub-blocks which are enlarged are always scaled with nearest-neighbor.
+			ResamplingMode resamplingMode;
+
+			/// If true, JPG-XR compressed sub-blocks which are scaled down by (at least) a factor of two
+			/// are decoded with the resolution reduced by the largest power of two (up to 16) which does not exceed the scale
+			/// factor - the decoder then skips (part of) the work for the finer levels of its frequency hierarchy, and the
+			/// scaling starts from its downscaled image. This is considerably faster, but the pixels differ from the ones of
+			/// scaling the full-resolution image. If false (which is the default), the sub-blocks are always decoded in their
+			/// full resolution.
+			bool decodeReducedResolution;
+
 			/// Clears this object to its blank state.
 			void Clear()
 			{
 				this->drawTileBorder = false;
 				this->backGroundColor.r = this->backGroundColor.g = this->backGroundColor.b = std::numeric_limits<float>::quiet_NaN();
 				this->sceneFilter.reset();
+				this->subBlockCache.reset();
+				this->maxThreads = 1;
+				this->prefetchDepth = 0;
+				this->readBatchSize = 1;
+				this->resamplingMode = ResamplingMode::NearestNeighbor;
+				this->decodeReducedResolution = false;
 			}
 		};
 
@@ -28,6 +28,9 @@
 #include "SingleChannelPyramidLevelTileAccessor.h"
 #include "SingleChannelScalingTileAccessor.h"
 #include "StreamImpl.h"
+#include "SubBlockCache.h"
+#include "BitmapOperations.h"
+#include "ThreadPool.h"
 
 using namespace libCZI;
 using namespace std;
@@ -70,15 +73,30 @@ std::shared_ptr<IAccessor> libCZI::CreateAccesor(std::shared_ptr<ISubBlockReposi
 	throw std::invalid_argument("unknown accessorType");
 }
 
+std::shared_ptr<ISubBlockCache> libCZI::CreateSubBlockCache(std::uint64_t maxMemoryUsage)
+{
+	return std::make_shared<CSubBlockCache>(maxMemoryUsage);
+}
+
+void libCZI::SetBitmapOperationsThreadCount(int threadCount)
+{
+	CBitmapOperations::SetThreadPool(threadCount > 1 ? std::make_shared<CThreadPool>(threadCount) : nullptr);
+}
+
 std::shared_ptr<IStream> libCZI::CreateStreamFromFile(const wchar_t* szFilename)
 {
 #ifdef _WIN32
 	return make_shared<CSimpleStreamImplWindows>(szFilename);
 #else
-	return make_shared<CSimpleStreamImpl>(szFilename);
+	return make_shared<CSimpleStreamImplPread>(szFilename);
 #endif
 }
 
+std::shared_ptr<IStream> libCZI::CreateStreamFromFileMapped(const wchar_t* szFilename)
+{
+	return make_shared<CStreamImplMemoryMapped>(szFilename);
+}
+
 std::shared_ptr<IStream> libCZI::CreateStreamFromMemory(std::shared_ptr<const void> ptr, size_t dataSize)
 {
 	return make_shared<CStreamImplInMemory>(ptr, dataSize);
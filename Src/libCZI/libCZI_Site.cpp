@@ -26,12 +26,74 @@
 #include <mutex>
 #include "bitmapData.h"
 #include "decoder_wic.h"
+#include "BitmapOperations.h"
+#include "utilities.h"
 
 using namespace libCZI;
 using namespace std;
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 
+std::shared_ptr<libCZI::IBitmapData> libCZI::DecodeRegionFromCompleteImage(libCZI::IDecoder* decoder, const void* ptrData, size_t size, const libCZI::IntRect& roi)
+{
+	auto bmComplete = decoder->Decode(ptrData, size);
+	if (!Utilities::IsNonEmptyAndInside(roi, bmComplete->GetSize()))
+	{
+		throw std::invalid_argument("The ROI must be non-empty and must lie within the image.");
+	}
+
+	auto bm = GetSite()->CreateBitmap(bmComplete->GetPixelType(), roi.w, roi.h);
+	ScopedBitmapLockerSP lckSrc{ bmComplete };
+	ScopedBitmapLockerSP lckDst{ bm };
+	CBitmapOperations::Copy(
+		bmComplete->GetPixelType(),
+		((const char*)lckSrc.ptrDataRoi) + roi.y * ((std::ptrdiff_t)lckSrc.stride) + roi.x * CziUtils::GetBytesPerPel(bmComplete->GetPixelType()),
+		lckSrc.stride,
+		bm->GetPixelType(),
+		lckDst.ptrDataRoi,
+		lckDst.stride,
+		roi.w,
+		roi.h,
+		false);
+	return bm;
+}
+
+std::shared_ptr<libCZI::IBitmapData> libCZI::DecodeReducedFromCompleteImage(libCZI::IDecoder* decoder, const void* ptrData, size_t size, int reductionFactor, const libCZI::IntRect* roi)
+{
+	if (reductionFactor != 1 && reductionFactor != 2 && reductionFactor != 4 && reductionFactor != 8 && reductionFactor != 16)
+	{
+		throw std::invalid_argument("The reduction factor must be 1, 2, 4, 8 or 16.");
+	}
+
+	auto bmComplete = decoder->Decode(ptrData, size);
+	IntSize sizeComplete = bmComplete->GetSize();
+	IntSize sizeReduced{ (sizeComplete.w + reductionFactor - 1) / reductionFactor, (sizeComplete.h + reductionFactor - 1) / reductionFactor };
+	IntRect roiReduced = roi != nullptr ? *roi : IntRect{ 0, 0, (int)sizeReduced.w, (int)sizeReduced.h };
+	if (!Utilities::IsNonEmptyAndInside(roiReduced, sizeReduced))
+	{
+		throw std::invalid_argument("The ROI must be non-empty and must lie within the image.");
+	}
+
+	// we take every reductionFactor-th pixel
+	auto bm = GetSite()->CreateBitmap(bmComplete->GetPixelType(), roiReduced.w, roiReduced.h);
+	auto bytesPerPel = CziUtils::GetBytesPerPel(bmComplete->GetPixelType());
+	ScopedBitmapLockerSP lckSrc{ bmComplete };
+	ScopedBitmapLockerSP lckDst{ bm };
+	for (int y = 0; y < roiReduced.h; ++y)
+	{
+		const char* pSrc = ((const char*)lckSrc.ptrDataRoi) + (roiReduced.y + y) * reductionFactor * ((std::ptrdiff_t)lckSrc.stride) + roiReduced.x * reductionFactor * bytesPerPel;
+		char* pDst = ((char*)lckDst.ptrDataRoi) + y * ((std::ptrdiff_t)lckDst.stride);
+		for (int x = 0; x < roiReduced.w; ++x)
+		{
+			memcpy(pDst + x * bytesPerPel, pSrc + x * reductionFactor * bytesPerPel, bytesPerPel);
+		}
+	}
+
+	return bm;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+
 class CSiteImpBase : public ISite
 {
 public:
@@ -23,6 +23,8 @@
 #pragma once
 
 #include <sstream>
+#include <memory>
+#include "ImportExport.h"
 
 namespace libCZI
 {
@@ -34,6 +36,31 @@ namespace libCZI
 	};
 
 	class IBitmapData;
+	struct IntRect;
+	class IDecoder;
+
+	/// Decodes the specified region of an image by decoding the complete image (with IDecoder::Decode) and copying the
+	/// region out of it. This is the default implementation of IDecoder::Decode(ptrData, size, roi).
+	///
+	/// \param decoder The decoder.
+	/// \param ptrData Pointer to a a block of memory (which contains the encoded image).
+	/// \param size    The size of the memory block pointed by `ptrData`.
+	/// \param roi	   The region to decode. It must be non-empty and must lie completely within the image.
+	///
+	/// \return A bitmap object with the decoded data of the region.
+	LIBCZI_API std::shared_ptr<IBitmapData> DecodeRegionFromCompleteImage(IDecoder* decoder, const void* ptrData, size_t size, const IntRect& roi);
+
+	/// Decodes an image with a reduced resolution by decoding the complete image (with IDecoder::Decode) and taking every
+	/// n-th pixel of it. This is the default implementation of IDecoder::DecodeReduced.
+	///
+	/// \param decoder		  The decoder.
+	/// \param ptrData		  Pointer to a a block of memory (which contains the encoded image).
+	/// \param size			  The size of the memory block pointed by `ptrData`.
+	/// \param reductionFactor The factor by which the resolution is reduced, must be 1, 2, 4, 8 or 16.
+	/// \param roi			  If non-null, only this region (in pixels of the reduced image) is returned.
+	///
+	/// \return A bitmap object with the decoded data.
+	LIBCZI_API std::shared_ptr<IBitmapData> DecodeReducedFromCompleteImage(IDecoder* decoder, const void* ptrData, size_t size, int reductionFactor, const IntRect* roi);
 
 	/// The interface used for operating image decoder. That is the simplest possible interface at this point...
 	class IDecoder
@@ -53,6 +80,42 @@ namespace libCZI
 		///
 		/// \return A bitmap object witht the decoded data.
 		virtual std::shared_ptr<libCZI::IBitmapData> Decode(const void* ptrData, size_t size) = 0;
+
+		/// Passing in a block of raw data, decode only the specified region of the image and return a bitmap object
+		/// (with the size of the region). Decoders which are capable of decoding a region only should override this
+		/// method, the default implementation decodes the complete image and copies the region out of it.
+		/// \remark
+		/// The same remarks as for the method above apply.
+		///
+		/// \param ptrData Pointer to a a block of memory (which contains the encoded image).
+		/// \param size    The size of the memory block pointed by `ptrData`.
+		/// \param roi	   The region to decode (in pixels of the encoded image). It must be non-empty and must lie
+		/// 			   completely within the image, otherwise an exception is thrown.
+		///
+		/// \return A bitmap object with the decoded data of the region.
+		virtual std::shared_ptr<libCZI::IBitmapData> Decode(const void* ptrData, size_t size, const libCZI::IntRect& roi)
+		{
+			return DecodeRegionFromCompleteImage(this, ptrData, size, roi);
+		}
+
+		/// Passing in a block of raw data, decode the image with a reduced resolution - the size of the image is divided
+		/// by the specified factor in both directions (and rounded up). Decoders which can make use of the frequency
+		/// hierarchy of the encoded data should override this method, the default implementation decodes the image
+		/// with full resolution and downscales it (with nearest-neighbor).
+		/// \remark
+		/// The same remarks as for the methods above apply.
+		///
+		/// \param ptrData		  Pointer to a a block of memory (which contains the encoded image).
+		/// \param size			  The size of the memory block pointed by `ptrData`.
+		/// \param reductionFactor The factor by which the resolution is reduced, must be 1, 2, 4, 8 or 16.
+		/// \param roi			  If non-null, only this region (in pixels of the reduced image) is decoded. It must be
+		/// 					  non-empty and must lie completely within the reduced image.
+		///
+		/// \return A bitmap object with the decoded data.
+		virtual std::shared_ptr<libCZI::IBitmapData> DecodeReduced(const void* ptrData, size_t size, int reductionFactor, const libCZI::IntRect* roi)
+		{
+			return DecodeReducedFromCompleteImage(this, ptrData, size, reductionFactor, roi);
+		}
 	};
 
 	const int LOGLEVEL_CATASTROPHICERROR = 0;	///< Identifies a catastrophic error (i. e. the program cannot continue).
@@ -87,6 +150,10 @@ namespace libCZI
 		virtual void Log(int level, const char* szMsg) = 0;
 
 		/// Gets a decoder object.
+		/// \remark
+		/// The decoder object is shared by all callers and it may be used concurrently, so it must be
+		/// thread-safe. The JxrLib-based decoder keeps a decoder context
+		/// for each concurrent caller, so that no call has to wait for another one.
 		///
 		/// \param type		 The type.
 		/// \param arguments The arguments.
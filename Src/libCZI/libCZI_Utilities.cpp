@@ -81,6 +81,11 @@ using namespace std;
 	return CBitmapOperations::CalcMd5Sum(bm, ptrHash, hashSize);
 }
 
+/*static*/int Utils::CalcMd5SumTreeHash(libCZI::IBitmapData* bm, std::uint8_t* ptrHash, int hashSize)
+{
+	return CBitmapOperations::CalcMd5TreeSum(bm, ptrHash, hashSize);
+}
+
 /*static*/int Utils::CalcMd5SumHash(const void* ptrData, size_t sizeData, std::uint8_t* ptrHash, int hashSize)
 {
 	if (ptrHash == nullptr) { return 16; }
@@ -313,6 +318,7 @@ std::vector<std::uint8_t> InternalCreate8BitLookUpTableFromGamma(int tableElemen
 	resizeInfo.srcStride = lckSrc.stride;
 	resizeInfo.srcWidth = bmSrc->GetWidth();
 	resizeInfo.srcHeight = bmSrc->GetHeight();
+	resizeInfo.srcOffsetX = resizeInfo.srcOffsetY = 0;
 	resizeInfo.srcRoiX = roiSrc.x;
 	resizeInfo.srcRoiY = roiSrc.y;
 	resizeInfo.srcRoiW = roiSrc.w;
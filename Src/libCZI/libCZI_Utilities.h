@@ -54,6 +54,17 @@ namespace libCZI
 		/// \return The count of bytes that were written to in ptrHash as the MD5SUM-hash (always 16).
 		static int CalcMd5SumHash(libCZI::IBitmapData* bm, std::uint8_t* ptrHash, int hashSize);
 
+		/// Calculates a tree-hash for the pixels in the specified bitmap, which can be calculated in parallel (see
+		/// libCZI::SetBitmapOperationsThreadCount) - the result is different from the one of CalcMd5SumHash, but it
+		/// does not depend on the number of threads. The rows of the bitmap are divided into bands of 64 rows (the last
+		/// band may be smaller), the MD5SUM-hash is calculated for every band, and the result is the MD5SUM-hash of the
+		/// concatenation of the (16 bytes) hashes of the bands.
+		/// \param [in] bm	    The bitmap.
+		/// \param [in,out] ptrHash Pointer to the hash-code result. The result will be of size 16 bytes.
+		/// \param hashSize		    Size of the hash-code result pointed to by <tt>ptrHash</tt>. We need 16 bytes.
+		/// \return The count of bytes that were written to in ptrHash as the hash (always 16).
+		static int CalcMd5SumTreeHash(libCZI::IBitmapData* bm, std::uint8_t* ptrHash, int hashSize);
+
 		/// Calculates the MD5SUM hash for the specified data.
 		/// \param [in] ptrData	    Pointer to the data (for which to calculate the MD5SUM-hash).
 		/// \param [in] sizeData	The size of the data (pointed to by ptrData).
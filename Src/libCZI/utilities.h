@@ -73,6 +73,13 @@ public:
 		return (r.w <= 0 || r.h <= 0) ? false : true;
 	}
 
+	/// Query if the specified rectangle is non-empty and lies completely within a bitmap of the specified size.
+	static inline bool IsNonEmptyAndInside(const libCZI::IntRect& roi, const libCZI::IntSize& size)
+	{
+		return roi.w > 0 && roi.h > 0 && roi.x >= 0 && roi.y >= 0 &&
+			std::uint64_t(roi.x) + roi.w <= size.w && std::uint64_t(roi.y) + roi.h <= size.h;
+	}
+
 	static inline std::uint8_t clampToByte(float f)
 	{
 		if (f <= 0)